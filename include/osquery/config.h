@@ -61,7 +61,7 @@ class Config : private boost::noncopyable {
   /**
    * @brief Record performance (monitoring) information about a scheduled query.
    *
-   * The daemon and query scheduler will optionally record process metadata
+   * The daemon and query scheduler will optionally sample resource usage
    * before and after executing each query. This can be compared and reported
    * on an interval or within the osquery_schedule table.
    *
@@ -72,16 +72,10 @@ class Config : private boost::noncopyable {
    * to the updates/changes reflected in the schedule, from the config.
    *
    * @param name The unique name of the scheduled item
-   * @param delay Number of seconds (wall time) taken by the query
-   * @param size Number of characters generated by query
-   * @param r0 the process row before the query
-   * @param r1 the process row after the query
+   * @param execution The resources used by one execution of the query
    */
   void recordQueryPerformance(const std::string& name,
-                              size_t delay,
-                              size_t size,
-                              const Row& r0,
-                              const Row& r1);
+                              const QueryExecution& execution);
 
   /**
    * @brief Record a query 'initialization', meaning the query will run.
@@ -218,6 +212,16 @@ class Config : private boost::noncopyable {
       const std::string& name,
       std::function<void(const QueryPerformance& query)> predicate);
 
+  /**
+   * @brief Get the degradation state of a query, by name.
+   *
+   * The predicate is only called if the query exceeded its cost budget or
+   * changed degradation level, see --schedule_degrade.
+   */
+  void getDegradation(
+      const std::string& name,
+      std::function<void(const QueryDegradationState& state)> predicate);
+
   /**
    * @brief Helper to access config parsers via the registry
    *
@@ -287,6 +291,9 @@ class Config : private boost::noncopyable {
    * the content of each configuration pack. There is an optional black list
    * parameter to differentiate pack content.
    *
+   * A parser is only updated with top-level content if its keys changed
+   * since the last update from the same source.
+   *
    * @param source The input configuration source name.
    * @param obj The input configuration JSON.
    * @param pack True if the JSON was built from pack data, otherwise false.
@@ -325,6 +332,9 @@ class Config : private boost::noncopyable {
   /// A set of hashes for each source of the config.
   std::map<std::string, std::string> hash_;
 
+  /// Hashes of the keys last applied to each parser, by source and parser.
+  std::map<std::string, std::map<std::string, std::string>> parser_hash_;
+
   /// Check if the config received valid/parsable content from a config plugin.
   bool valid_{false};
 
@@ -356,6 +366,7 @@ class Config : private boost::noncopyable {
   FRIEND_TEST(ConfigTests, test_config_refresh);
   FRIEND_TEST(ConfigTests, test_get_scheduled_queries);
   FRIEND_TEST(ConfigTests, test_nonblacklist_query);
+  FRIEND_TEST(ConfigTests, test_schedule_degrade_steps);
   FRIEND_TEST(OptionsConfigParserPluginTests, test_get_option);
   FRIEND_TEST(ViewsConfigParserPluginTests, test_add_view);
   FRIEND_TEST(ViewsConfigParserPluginTests, test_swap_view);
@@ -368,6 +379,7 @@ class Config : private boost::noncopyable {
   FRIEND_TEST(SchedulerTests, test_config_results_purge);
   FRIEND_TEST(EventsTests, test_event_subscriber_configure);
   FRIEND_TEST(TLSConfigTests, test_retrieve_config);
+  FRIEND_TEST(TLSConfigTests, test_conditional_config);
   FRIEND_TEST(TLSConfigTests, test_runner_and_scheduler);
 };
 
@@ -405,6 +417,7 @@ class ConfigPlugin : public Plugin {
    * ConfigPlugin which needs to retrieve config data in a custom way.
    *
    * @param config The output ConfigSourceMap, a map of JSON to source names.
+   * A plugin may leave the map empty to indicate no source has changed.
    *
    * @return A failure status will prevent the source map from merging.
    */
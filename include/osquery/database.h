@@ -59,6 +59,9 @@ extern const std::string kCarves;
  */
 extern const std::string kLogs;
 
+/// The "domain" where file hashes are cached, keyed by device and inode.
+extern const std::string kHashes;
+
 /**
  * @brief An osquery backing storage (database) type that persists executions.
  *
@@ -230,7 +230,17 @@ class Distributed {
   /// Serialize result data into a JSON string and clear the results
   Status serializeResults(std::string& json);
 
-  /// Process and execute queued queries
+  /**
+   * @brief Process and execute queued queries
+   *
+   * Up to `distributed_concurrency` queries execute at once, each within the
+   * `distributed_timeout`, `distributed_max_rows`, and `distributed_max_bytes`
+   * limits. Results are flushed as queries complete.
+   *
+   * Each query's progress is kept in the database. Results that could not be
+   * flushed are sent by the next run, and a query that was executing when the
+   * process stopped is reported as failed rather than executed again.
+   */
   Status runQueries();
 
   // Getter for ID of currently executing request
@@ -255,15 +265,33 @@ class Distributed {
    */
   DistributedQueryRequest popRequest();
 
+  /**
+   * @brief Execute a single request within the configured query budget
+   *
+   * @param request is a DistributedQueryRequest popped from the queue
+   * @return the DistributedQueryResult to be sent to the server
+   */
+  DistributedQueryResult runQuery(const DistributedQueryRequest& request);
+
+  /**
+   * @brief Recover work left by a previous run
+   *
+   * Results persisted because they could not be flushed are queued again, and
+   * queries left executing are completed with a failure status.
+   */
+  void recoverQueries();
+
   /**
    * @brief Queue a result to be batch sent to the server
    *
    * @param result is a DistributedQueryResult object to be sent to the server
    */
-  void addResult(const DistributedQueryResult& result);
+  void addResult(DistributedQueryResult result);
 
   /**
    * @brief Flush all of the collected results to the server
+   *
+   * Results that cannot be flushed are persisted and retried by a later run.
    */
   Status flushCompleted();
 
@@ -272,11 +300,13 @@ class Distributed {
 
   std::vector<DistributedQueryResult> results_;
 
-  // ID of the currently executing query
-  static std::string currentRequestId_;
+  // ID of the query executing on the calling thread
+  static thread_local std::string currentRequestId_;
 
  private:
   friend class DistributedTests;
   FRIEND_TEST(DistributedTests, test_workflow);
+  FRIEND_TEST(DistributedTests, test_run_queries_budget);
+  FRIEND_TEST(DistributedTests, test_recover_queries);
 };
 }
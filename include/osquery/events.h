@@ -15,6 +15,7 @@
 #include <map>
 #include <memory>
 #include <mutex>
+#include <set>
 #include <thread>
 #include <utility>
 #include <vector>
@@ -33,6 +34,7 @@ class EventPublisher;
 template <class PUB>
 class EventSubscriber;
 class EventFactory;
+class MetricCounter;
 
 using EventID = const std::string;
 using EventContextID = uint64_t;
@@ -686,6 +688,9 @@ class EventSubscriberPlugin : public Plugin, public Eventer {
   /// Lock used when recording queries executing against this subscriber.
   mutable Mutex event_query_record_;
 
+  /// Events added by this subscriber, found when the subscriber is set up.
+  MetricCounter* added_counter_{nullptr};
+
  private:
   friend class EventFactory;
   friend class EventPublisherPlugin;
@@ -847,7 +852,12 @@ class EventFactory : private boost::noncopyable {
   /// The dispatched event thread's entry-point (if needed).
   static Status run(const std::string& type_id);
 
-  /// An initializer's entry-point for spawning all event type run loops.
+  /**
+   * @brief An initializer's entry-point for spawning event type run loops.
+   *
+   * When events_lazy_start is set, a publisher without subscriptions is not
+   * started, its run loop starts when a configuration update subscribes.
+   */
   static void delay();
 
   /// If a static EventPublisher callback wants to fire
@@ -891,6 +901,9 @@ class EventFactory : private boost::noncopyable {
   EventFactory() = default;
   ~EventFactory() = default;
 
+  /// Start the run loop of each set up publisher that has subscriptions.
+  static void startPublishers();
+
  private:
   /// Set of registered EventPublisher instances.
   std::map<std::string, EventPublisherRef> event_pubs_;
@@ -901,11 +914,20 @@ class EventFactory : private boost::noncopyable {
   /// Set of running EventPublisher run loop threads.
   std::vector<std::shared_ptr<std::thread>> threads_;
 
+  /// Set of EventPublisher types with a run loop thread.
+  std::set<std::string> started_;
+
+  /// True once the initializer allowed run loops to start.
+  bool delayed_{false};
+
   /// Set of logger plugins to forward events.
   std::vector<std::string> loggers_;
 
   /// Factory publisher state manipulation.
   Mutex factory_lock_;
+
+ private:
+  FRIEND_TEST(EventsTests, test_event_publisher_lazy_start);
 };
 
 /**
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <sys/stat.h>
+
 #include <map>
 #include <set>
 #include <string>
@@ -41,6 +43,27 @@ const std::string kSQLGlobWildcard{"%"};
 /// Globbing wildcard recursive character (double wildcard).
 const std::string kSQLGlobRecursive{kSQLGlobWildcard + kSQLGlobWildcard};
 
+/**
+ * @brief A path resolved from a pattern, with the status of the file if known.
+ *
+ * Directories are walked with a stat of each entry, so tables can use the
+ * status instead of calling stat again. Paths of directories end with a '/'.
+ */
+struct ResolvedPath {
+  std::string path;
+
+  /// True if file_stat is the status of the path.
+  bool has_stat{false};
+
+  /// True if the path is a symlink, file_stat is of the target if it exists.
+  bool symlink{false};
+
+  struct stat file_stat;
+
+  ResolvedPath() = default;
+  explicit ResolvedPath(std::string resolved) : path(std::move(resolved)) {}
+};
+
 /**
  * @brief Read a file from disk.
  *
@@ -200,6 +223,22 @@ Status resolveFilePattern(const boost::filesystem::path& pattern,
                           std::vector<std::string>& results,
                           GlobLimits setting);
 
+/**
+ * @brief Given a filesystem globbing patten, resolve all matching paths.
+ *
+ * See resolveFilePattern, but return the status of each file when it is
+ * known. Patterns ending in a recursive wildcard are walked in parallel.
+ *
+ * @param pattern filesystem globbing pattern.
+ * @param results output vector of matching paths.
+ * @param setting a bit list of match types, e.g., files, folders.
+ *
+ * @return an instance of Status, indicating success or failure.
+ */
+Status resolveFilePattern(const boost::filesystem::path& pattern,
+                          std::vector<ResolvedPath>& results,
+                          GlobLimits setting);
+
 /**
  * @brief Transform a path with SQL wildcards to globbing wildcard.
  *
@@ -218,6 +218,44 @@ class LoggerPlugin : public Plugin {
     return logString(s);
   }
 
+  /**
+   * @brief Optionally handle a batch of result log lines at once.
+   *
+   * A query log item serialized as events produces one line per row.
+   * The lines are delivered together so a plugin can coalesce writes or
+   * network requests. The default forwards each line to logString.
+   *
+   * The items are mutable, a plugin may move each line into its own storage.
+   *
+   * @param name The name of the scheduled query that produced every line.
+   * @param items The set of serialized result lines.
+   * @return log status
+   */
+  virtual Status logStringBatch(const std::string& name,
+                                std::vector<std::string>& items) {
+    (void)name;
+    Status status;
+    for (const auto& item : items) {
+      status = logString(item);
+    }
+    return status;
+  }
+
+  /**
+   * @brief Optionally handle a batch of snapshot log lines at once.
+   *
+   * See logStringBatch, the default forwards each line to logSnapshot.
+   */
+  virtual Status logSnapshotBatch(const std::string& name,
+                                  std::vector<std::string>& items) {
+    (void)name;
+    Status status;
+    for (const auto& item : items) {
+      status = logSnapshot(item);
+    }
+    return status;
+  }
+
   /**
    * @brief Optionally handle each published event via the logger.
    *
@@ -251,20 +251,168 @@ struct QueryPerformance {
   /// Last UNIX time in seconds the query was executed successfully.
   size_t last_executed{0};
 
-  /// Total wall time taken
+  /// Total wall time taken in seconds.
   unsigned long long int wall_time{0};
 
-  /// Total user time (cycles)
+  /// Total wall time taken in nanoseconds.
+  unsigned long long int wall_time_ns{0};
+
+  /// Total user time in milliseconds.
   unsigned long long int user_time{0};
 
-  /// Total system time (cycles)
+  /// Total system time in milliseconds.
   unsigned long long int system_time{0};
 
   /// Average memory differentials. This should be near 0.
   unsigned long long int average_memory{0};
 
+  /// Largest growth of the peak resident size during a single execution.
+  unsigned long long int peak_memory{0};
+
   /// Total characters, bytes, generated by query.
   unsigned long long int output_size{0};
+
+  /// Total rows generated by query.
+  unsigned long long int output_rows{0};
+
+  /// Number of executions that started after their planned time.
+  unsigned long long int missed_deadlines{0};
+
+  /// Number of executions aborted for exceeding their output budget.
+  unsigned long long int truncations{0};
+};
+
+/**
+ * @brief The steps of a scheduled query's adaptive degradation.
+ *
+ * With --schedule_degrade a query that repeatedly exceeds its cost budget, or
+ * was executing when the watchdog stopped a worker, steps through each level.
+ * A level steps down after --schedule_degrade_duration seconds.
+ */
+enum class QueryDegradation {
+  /// The query runs as configured.
+  NONE = 0,
+
+  /// The query runs at a lengthened interval.
+  INTERVAL = 1,
+
+  /// The query runs its fallback SQL, or with a row limit, at a lengthened
+  /// interval.
+  REDUCED = 2,
+
+  /// The query is blacklisted.
+  BLACKLISTED = 3,
+};
+
+/// The name of a degradation level, empty for NONE.
+std::string getQueryDegradationName(QueryDegradation level);
+
+/// The degradation of a scheduled query, kept across worker restarts.
+struct QueryDegradationState {
+  /// The current level.
+  QueryDegradation level{QueryDegradation::NONE};
+
+  /// UNIX time in seconds the level steps down.
+  size_t expire{0};
+
+  /// Consecutive executions over the cost budget.
+  size_t strikes{0};
+
+  /// Number of level changes.
+  size_t transitions{0};
+
+  /// UNIX time in seconds of the last level change.
+  size_t last_transition{0};
+};
+
+/**
+ * @brief Resources used by a single execution of a scheduled query.
+ */
+struct QueryExecution {
+  /// Seconds the execution started after its planned time.
+  unsigned long long int delay{0};
+
+  /// Wall time in nanoseconds.
+  unsigned long long int wall_time_ns{0};
+
+  /// User time in milliseconds used by the executing thread.
+  unsigned long long int user_time{0};
+
+  /// System time in milliseconds used by the executing thread.
+  unsigned long long int system_time{0};
+
+  /// Change of the process resident size in bytes.
+  long long int memory{0};
+
+  /// Growth of the process peak resident size in bytes.
+  unsigned long long int peak_memory{0};
+
+  /// Characters, bytes, generated by the query.
+  unsigned long long int output_size{0};
+
+  /// Rows generated by the query.
+  unsigned long long int output_rows{0};
+
+  /// True if the execution was aborted for exceeding its output budget.
+  bool truncated{false};
+};
+
+/**
+ * @brief Time spent and rows produced by one table within a query.
+ */
+struct TableProfile {
+  /// Number of table scans (xFilter calls).
+  unsigned long long int scans{0};
+
+  /// Nanoseconds spent generating rows, or reading snapshots.
+  unsigned long long int generate_time_ns{0};
+
+  /// Rows produced by the table, before SQLite applies the query.
+  unsigned long long int rows{0};
+};
+
+/**
+ * @brief Where the time of a single query execution was spent.
+ *
+ * A profile is recorded for scheduled and distributed queries when the
+ * `query_profile` flag is enabled.
+ */
+struct QueryProfile {
+  /// Scheduled query name or distributed query ID.
+  std::string name;
+
+  /// The SQL query.
+  std::string query;
+
+  /// UNIX time in seconds the execution started.
+  unsigned long long int time{0};
+
+  /// Nanoseconds from start to the logged (or returned) results.
+  unsigned long long int wall_time_ns{0};
+
+  /// Nanoseconds executing SQL, including table generation.
+  unsigned long long int query_time_ns{0};
+
+  /// Rows returned by the query.
+  unsigned long long int rows{0};
+
+  /// Nanoseconds comparing results with the previous execution.
+  unsigned long long int diff_time_ns{0};
+
+  /// Nanoseconds serializing results into log lines.
+  unsigned long long int serialize_time_ns{0};
+
+  /// Nanoseconds forwarding log lines to logger plugins.
+  unsigned long long int log_time_ns{0};
+
+  /// Bytes of values read from the database.
+  unsigned long long int database_read_bytes{0};
+
+  /// Bytes of values written to the database.
+  unsigned long long int database_write_bytes{0};
+
+  /// Counters for each table, by name.
+  std::map<std::string, TableProfile> tables;
 };
 
 /**
@@ -293,6 +441,18 @@ struct ScheduledQuery : private only_movable {
    */
   bool blacklisted{false};
 
+  /// The degradation level, set by the config like blacklisted.
+  QueryDegradation degradation{QueryDegradation::NONE};
+
+  /// Cheaper SQL to run when the query is degraded, from the pack.
+  std::string fallback;
+
+  /// Maximum rows of an execution, 0 uses --schedule_max_rows.
+  size_t max_rows{0};
+
+  /// Maximum result bytes of an execution, 0 uses --schedule_max_bytes.
+  size_t max_bytes{0};
+
   /// Set of query options.
   std::map<std::string, bool> options;
 
@@ -347,6 +507,9 @@ struct QueryLogItem {
   /// A set of additional fields to emit with the log line.
   std::map<std::string, std::string> decorations;
 
+  /// The reason results were cut short by an output budget, empty if whole.
+  std::string truncated;
+
   /// The ordered map of columns from the query.
   ColumnNames columns;
 
@@ -58,6 +58,7 @@ using RemoveExternalCallback = std::function<void(const std::string&)>;
 
 /// The registry includes a single optimization for table generation.
 struct QueryContext;
+class MetricHistogram;
 
 class Plugin : private boost::noncopyable {
  public:
@@ -148,8 +149,7 @@ using PluginRef = std::shared_ptr<Plugin>;
  */
 class RegistryInterface : private boost::noncopyable {
  public:
-  explicit RegistryInterface(std::string name, bool auto_setup = false)
-      : name_(std::move(name)), auto_setup_(auto_setup) {}
+  explicit RegistryInterface(std::string name, bool auto_setup = false);
   virtual ~RegistryInterface() = default;
 
   /**
@@ -298,9 +298,7 @@ class RegistryInterface : private boost::noncopyable {
   virtual void removeExternalPlugin(const std::string& name) const = 0;
 
   /// Allow the registry to introspect into the registered name (for logging).
-  void setName(const std::string& name) {
-    name_ = name;
-  }
+  void setName(const std::string& name);
 
   /**
    * @brief The implementation adder will call addPlugin.
@@ -349,6 +347,17 @@ class RegistryInterface : private boost::noncopyable {
   /// be directed to the 'active' plugin.
   std::string active_;
 
+ private:
+  /// Find the call latency histograms labeled with the registry name.
+  void resolveMetrics();
+
+ private:
+  /// Latency of calls to local plugins.
+  MetricHistogram* call_histogram_{nullptr};
+
+  /// Latency of calls to plugins within extensions, or to the core.
+  MetricHistogram* extension_call_histogram_{nullptr};
+
  private:
   friend class RegistryFactory;
 };
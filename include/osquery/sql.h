@@ -23,6 +23,32 @@ namespace osquery {
 
 DECLARE_int32(value_max);
 
+/**
+ * @brief Resource limits applied while a single query executes.
+ *
+ * A zero value disables the limit. A query exceeding any limit is aborted,
+ * the rows collected before the abort are kept, and the query status uses
+ * the kQueryBudgetExceeded code.
+ */
+struct QueryBudget {
+  /// Maximum number of result rows.
+  size_t max_rows{0};
+
+  /// Maximum result size, the sum of each column name and value length.
+  size_t max_bytes{0};
+
+  /// Maximum milliseconds spent executing the query.
+  size_t timeout{0};
+
+  /// True if any limit is set.
+  bool limited() const {
+    return max_rows > 0 || max_bytes > 0 || timeout > 0;
+  }
+};
+
+/// The status code of a query aborted for exceeding its QueryBudget.
+extern const int kQueryBudgetExceeded;
+
 /**
  * @brief The core interface to executing osquery SQL commands.
  *
@@ -169,6 +195,20 @@ class SQLPlugin : public Plugin {
                        QueryData& results,
                        bool use_cache) const = 0;
 
+  /**
+   * @brief Run a SQL query string within a set of resource limits.
+   *
+   * The default ignores the budget, SQL implementations should abort the
+   * query once a limit is exceeded.
+   */
+  virtual Status queryWithBudget(const std::string& query,
+                                 QueryData& results,
+                                 bool use_cache,
+                                 const QueryBudget& budget) const {
+    (void)budget;
+    return this->query(query, results, use_cache);
+  }
+
   /// Use the SQL implementation to parse a query string and return details
   /// (name, type) about the columns.
   virtual Status getQueryColumns(const std::string& query,
@@ -225,6 +265,21 @@ Status query(const std::string& query,
              QueryData& results,
              bool use_cache = false);
 
+/**
+ * @brief Execute a query within a set of resource limits.
+ *
+ * See QueryBudget, rows collected before a limit is exceeded are returned
+ * along with a kQueryBudgetExceeded status.
+ *
+ * @param query the query to execute
+ * @param results [output] A QueryData structure to emit result rows.
+ * @param budget the limits applied to the execution.
+ * @return A status indicating query success.
+ */
+Status query(const std::string& query,
+             QueryData& results,
+             const QueryBudget& budget);
+
 /**
  * @brief Analyze a query, providing information about the result columns.
  *
@@ -10,9 +10,12 @@
 
 #pragma once
 
+#include <chrono>
+#include <functional>
 #include <map>
 #include <set>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -35,6 +38,7 @@
 #endif
 
 #include <boost/lexical_cast.hpp>
+#include <boost/optional.hpp>
 
 #include <osquery/core.h>
 #include <osquery/query.h>
@@ -450,6 +454,9 @@ using ConstraintMap = std::map<std::string, struct ConstraintList>;
 /// Populate a constraint list from a query's parsed predicate.
 using ConstraintSet = std::vector<std::pair<std::string, struct Constraint>>;
 
+/// The names of the columns a query reads from a table.
+using UsedColumns = std::unordered_set<std::string>;
+
 /**
  * @brief osquery table content descriptor.
  *
@@ -487,6 +494,9 @@ struct VirtualTableContent {
   /// Transient set of virtual table access constraints.
   std::unordered_map<size_t, ConstraintSet> constraints;
 
+  /// Transient bitmask of columns used, as planned by SQLite, for each index.
+  std::unordered_map<size_t, uint64_t> colsUsed;
+
   /*
    * @brief A table implementation specific query result cache.
    *
@@ -549,6 +559,21 @@ struct QueryContext : private only_movable {
   bool hasConstraint(const std::string& column,
                      ConstraintOperator op = EQUALS) const;
 
+  /**
+   * @brief Check if the query reads a column.
+   *
+   * Tables may skip generating expensive columns the query does not select,
+   * join, or filter on. If the set of used columns is not known, such as when
+   * a table is called outside of SQLite, every column is considered used.
+   *
+   * @param column The name of a column within this table.
+   * @return true if the column is used or the usage is unknown.
+   */
+  bool isColumnUsed(const std::string& column) const;
+
+  /// Check if the query reads any of a set of columns.
+  bool isAnyColumnUsed(std::initializer_list<std::string> columns) const;
+
   /**
    * @brief Apply a predicate function to each expression in a constraint list.
    *
@@ -631,6 +656,20 @@ struct QueryContext : private only_movable {
   /// Check if the query requested use of the warm query cache.
   bool useCache() const;
 
+  /**
+   * @brief Set the time after which the query is interrupted.
+   *
+   * SQLite checks the deadline between rows, a generator that does expensive
+   * work for each row, such as hashing or scanning files, checks expired.
+   */
+  void setDeadline(std::chrono::steady_clock::time_point deadline);
+
+  /// The time after which the query is interrupted, the maximum if none.
+  std::chrono::steady_clock::time_point deadline() const;
+
+  /// Check if the query passed its deadline, a generator stops and returns.
+  bool expired() const;
+
   /// Set the entire cache for an index.
   void setCache(const std::string& index, Row _cache);
 
@@ -642,6 +681,9 @@ struct QueryContext : private only_movable {
   /// The map of column name to constraint list.
   ConstraintMap constraints;
 
+  /// The columns used by the query, if known.
+  boost::optional<UsedColumns> colsUsed;
+
  private:
   /// If false then the context is maintaining an ephemeral cache.
   bool enable_cache_{false};
@@ -649,6 +691,10 @@ struct QueryContext : private only_movable {
   /// If the context is allowed to use the warm query cache.
   bool use_cache_{false};
 
+  /// The time after which the query is interrupted.
+  std::chrono::steady_clock::time_point deadline_{
+      std::chrono::steady_clock::time_point::max()};
+
   /// Persistent table content for table caching.
   VirtualTableContent* table_{nullptr};
 
@@ -712,13 +758,13 @@ class TablePlugin : public Plugin {
    * virtual table APIs. In the best case this context include a limit or
    * constraints organized by each possible column.
    *
+   * Tables using a generator collect every row yielded, for extensions and
+   * other callers of the "generate" action.
+   *
    * @param context A query context filled in by SQLite's virtual table API.
    * @return The result rows for this table, given the query context.
    */
-  virtual QueryData generate(QueryContext& context) {
-    (void)context;
-    return QueryData();
-  }
+  virtual QueryData generate(QueryContext& context);
 
   /**
    * @brief Generate a table representation by yielding each row.
@@ -872,9 +918,24 @@ class TablePlugin : public Plugin {
   FRIEND_TEST(VirtualTableTests, test_tableplugin_statement);
   FRIEND_TEST(VirtualTableTests, test_indexing_costs);
   FRIEND_TEST(VirtualTableTests, test_table_results_cache);
+  FRIEND_TEST(VirtualTableTests, test_table_snapshots);
+  FRIEND_TEST(VirtualTableTests, test_table_snapshot_batch);
   FRIEND_TEST(VirtualTableTests, test_yield_generator);
+  FRIEND_TEST(VirtualTableTests, test_yield_generator_limit);
+  FRIEND_TEST(VirtualTableTests, test_query_profile);
 };
 
+/// A table implementation yielding each row.
+using TableGenerator = std::function<void(RowYield&, QueryContext&)>;
+
+/**
+ * @brief Run a table implementation yielding rows and collect every row.
+ *
+ * A query streams the rows of a generator table, this is used by callers
+ * needing the complete results, such as extensions and tests.
+ */
+QueryData collectRows(const TableGenerator& generator, QueryContext& context);
+
 /// Helper method to generate the virtual table CREATE statement.
 std::string columnDefinition(const TableColumns& columns);
 
@@ -74,6 +74,27 @@ FLAG_ALIAS(google::uint64,
            config_tls_accelerated_refresh,
            config_accelerated_refresh);
 
+FLAG(bool,
+     schedule_degrade,
+     false,
+     "Lengthen the interval and reduce expensive queries before blacklisting");
+
+FLAG(uint64,
+     schedule_degrade_cost,
+     0,
+     "Milliseconds of CPU time an execution may use before counting against "
+     "its query (0 = only watchdog failures degrade)");
+
+FLAG(uint64,
+     schedule_degrade_strikes,
+     3,
+     "Consecutive executions over the cost budget that degrade a query");
+
+FLAG(uint64,
+     schedule_degrade_duration,
+     86400,
+     "Seconds before a degraded query steps down one level");
+
 DECLARE_string(config_plugin);
 DECLARE_string(pack_delimiter);
 
@@ -86,6 +107,7 @@ DECLARE_string(pack_delimiter);
  */
 const std::string kExecutingQuery{"executing_query"};
 const std::string kFailedQueries{"failed_queries"};
+const std::string kDegradedQueries{"degraded_queries"};
 
 /// The time osquery was started.
 std::atomic<size_t> kStartTime;
@@ -174,6 +196,17 @@ class Schedule : private boost::noncopyable {
    */
   std::map<std::string, size_t> blacklist_;
 
+  /// Degradation state of queries that exceeded their cost budget.
+  std::map<std::string, QueryDegradationState> degraded_;
+
+ private:
+  /**
+   * @brief Move a query one degradation level up or down, and save the state.
+   *
+   * Reaching the BLACKLISTED level adds the query to the blacklist.
+   */
+  void degrade(const std::string& name, bool up, const std::string& reason);
+
  private:
   friend class Config;
 };
@@ -278,6 +311,92 @@ void saveScheduleBlacklist(const std::map<std::string, size_t>& blacklist) {
   setDatabaseValue(kPersistentSettings, kFailedQueries, content);
 }
 
+void restoreScheduleDegradation(
+    std::map<std::string, QueryDegradationState>& degraded) {
+  std::string content;
+  getDatabaseValue(kPersistentSettings, kDegradedQueries, content);
+
+  // Each line is a query name, level, expiration, transitions, and time.
+  for (const auto& line : osquery::split(content, "\n")) {
+    auto fields = osquery::split(line, ":");
+    if (fields.size() != 5) {
+      continue;
+    }
+
+    long long level = 0;
+    long long expire = 0;
+    long long transitions = 0;
+    long long time = 0;
+    if (!safeStrtoll(fields[1], 10, level) || level < 0 ||
+        level > static_cast<long long>(QueryDegradation::BLACKLISTED) ||
+        !safeStrtoll(fields[2], 10, expire) ||
+        !safeStrtoll(fields[3], 10, transitions) ||
+        !safeStrtoll(fields[4], 10, time)) {
+      continue;
+    }
+
+    auto& state = degraded[fields[0]];
+    state.level = static_cast<QueryDegradation>(level);
+    state.expire = static_cast<size_t>(expire);
+    state.transitions = static_cast<size_t>(transitions);
+    state.last_transition = static_cast<size_t>(time);
+  }
+}
+
+void saveScheduleDegradation(
+    const std::map<std::string, QueryDegradationState>& degraded) {
+  std::string content;
+  for (const auto& query : degraded) {
+    // Strikes are not kept, queries that never changed level are not saved.
+    if (query.second.transitions == 0) {
+      continue;
+    }
+
+    if (!content.empty()) {
+      content += "\n";
+    }
+    content += query.first + ":" +
+               std::to_string(static_cast<int>(query.second.level)) + ":" +
+               std::to_string(query.second.expire) + ":" +
+               std::to_string(query.second.transitions) + ":" +
+               std::to_string(query.second.last_transition);
+  }
+  setDatabaseValue(kPersistentSettings, kDegradedQueries, content);
+}
+
+void Schedule::degrade(const std::string& name,
+                       bool up,
+                       const std::string& reason) {
+  auto& state = degraded_[name];
+  auto level = static_cast<int>(state.level) + ((up) ? 1 : -1);
+  if (level < static_cast<int>(QueryDegradation::NONE) ||
+      level > static_cast<int>(QueryDegradation::BLACKLISTED)) {
+    return;
+  }
+
+  auto previous = state.level;
+  auto now = getUnixTime();
+  state.level = static_cast<QueryDegradation>(level);
+  state.expire = now + FLAGS_schedule_degrade_duration;
+  state.strikes = 0;
+  state.transitions++;
+  state.last_transition = now;
+
+  if (state.level == QueryDegradation::BLACKLISTED) {
+    blacklist_[name] = state.expire;
+    saveScheduleBlacklist(blacklist_);
+  } else if (previous == QueryDegradation::BLACKLISTED) {
+    blacklist_.erase(name);
+    saveScheduleBlacklist(blacklist_);
+  }
+  saveScheduleDegradation(degraded_);
+
+  auto level_name = getQueryDegradationName(state.level);
+  LOG(WARNING) << "Scheduled query " << name << " degradation "
+               << ((level_name.empty()) ? "removed" : "set to " + level_name)
+               << ": " << reason;
+}
+
 Schedule::Schedule() {
   if (RegistryFactory::get().external()) {
     // Extensions should not restore or save schedule details.
@@ -285,15 +404,21 @@ Schedule::Schedule() {
   }
   // Parse the schedule's query blacklist from backing storage.
   restoreScheduleBlacklist(blacklist_);
+  restoreScheduleDegradation(degraded_);
 
   // Check if any queries were executing when the tool last stopped.
   getDatabaseValue(kPersistentSettings, kExecutingQuery, failed_query_);
   if (!failed_query_.empty()) {
     LOG(WARNING) << "Scheduled query may have failed: " << failed_query_;
     setDatabaseValue(kPersistentSettings, kExecutingQuery, "");
-    // Add this query name to the blacklist and save the blacklist.
-    blacklist_[failed_query_] = getUnixTime() + 86400;
-    saveScheduleBlacklist(blacklist_);
+    if (FLAGS_schedule_degrade) {
+      // Degrade the query one level, it is blacklisted as a last resort.
+      degrade(failed_query_, true, "the worker failed while executing");
+    } else {
+      // Add this query name to the blacklist and save the blacklist.
+      blacklist_[failed_query_] = getUnixTime() + 86400;
+      saveScheduleBlacklist(blacklist_);
+    }
   }
 }
 
@@ -397,6 +522,19 @@ void Config::scheduledQueries(
                FLAGS_pack_delimiter + it.first;
       }
 
+      // A degraded query steps down a level when its time expires.
+      it.second.degradation = QueryDegradation::NONE;
+      auto degraded_query = schedule_->degraded_.find(name);
+      if (degraded_query != schedule_->degraded_.end()) {
+        auto& state = degraded_query->second;
+        if (state.level != QueryDegradation::NONE &&
+            getUnixTime() > state.expire) {
+          schedule_->degrade(name, false, "the degradation expired");
+        }
+
+        it.second.degradation = state.level;
+      }
+
       // They query may have failed and been added to the schedule's blacklist.
       auto blacklisted_query = schedule_->blacklist_.find(name);
       if (blacklisted_query != schedule_->blacklist_.end()) {
@@ -415,6 +553,12 @@ void Config::scheduledQueries(
         }
       }
 
+      // A query that cannot be blacklisted remains reduced.
+      if (it.second.degradation == QueryDegradation::BLACKLISTED &&
+          schedule_->blacklist_.count(name) == 0) {
+        it.second.degradation = QueryDegradation::REDUCED;
+      }
+
       // Call the predicate.
       predicate(name, it.second);
     }
@@ -448,6 +592,12 @@ Status Config::refresh() {
 
   // if there was a response, parse it and update internal state
   valid_ = true;
+  if (response.size() > 0 && response[0].empty()) {
+    // The config plugin reported that no source has changed.
+    loaded_ = true;
+    return status;
+  }
+
   if (response.size() > 0) {
     if (FLAGS_config_dump) {
       // If config checking is enabled, debug-write the raw config data.
@@ -532,8 +682,8 @@ Status Config::updateSource(const std::string& source,
     RecursiveLock lock(config_schedule_mutex_);
     // Remove all packs from this source.
     schedule_->removeAll(source);
-    // Remove all files from this source.
-    removeFiles(source);
+    // Files from this source are replaced by the file paths parser, which
+    // only updates if its keys changed.
   }
 
   // load the config (source.second) into a JSON object.
@@ -648,14 +798,33 @@ void Config::applyParsers(const std::string& source,
 
     // For each key requested by the parser, add a property tree reference.
     std::map<std::string, JSON> parser_config;
+    std::string content;
     for (const auto& key : parser->keys()) {
+      content += key + '\n';
       if (obj.HasMember(key) && !obj[key].IsNull()) {
         auto doc = JSON::newFromValue(obj[key]);
+        if (!pack) {
+          std::string value;
+          doc.toString(value);
+          content += value + '\n';
+        }
         parser_config.emplace(std::make_pair(key, std::move(doc)));
       } else {
         parser_config.emplace(std::make_pair(key, JSON::newObject()));
       }
     }
+
+    // Skip parsers whose keys did not change since the last update. A pack is
+    // parsed each time it is added, its previous state has been removed.
+    if (!pack) {
+      auto hash = getBufferSHA1(content.data(), content.size());
+      auto& applied = parser_hash_[source][plugin.first];
+      if (applied == hash) {
+        continue;
+      }
+      applied = hash;
+    }
+
     // The config parser plugin will receive a copy of each property tree for
     // each top-level-config key. The parser may choose to update the config's
     // internal state
@@ -784,6 +953,7 @@ void Config::reset() {
   std::map<std::string, QueryPerformance>().swap(performance_);
   std::map<std::string, FileCategories>().swap(files_);
   std::map<std::string, std::string>().swap(hash_);
+  parser_hash_.clear();
   valid_ = false;
   loaded_ = false;
 
@@ -814,10 +984,22 @@ void ConfigParserPlugin::reset() {
 }
 
 void Config::recordQueryPerformance(const std::string& name,
-                                    size_t delay,
-                                    size_t size,
-                                    const Row& r0,
-                                    const Row& r1) {
+                                    const QueryExecution& execution) {
+  if (FLAGS_schedule_degrade && FLAGS_schedule_degrade_cost > 0) {
+    RecursiveLock lock(config_schedule_mutex_);
+    auto& state = schedule_->degraded_[name];
+    auto cost = execution.user_time + execution.system_time;
+    if (cost <= FLAGS_schedule_degrade_cost) {
+      state.strikes = 0;
+    } else if (++state.strikes >= FLAGS_schedule_degrade_strikes) {
+      schedule_->degrade(name,
+                         true,
+                         "used " + std::to_string(cost) +
+                             "ms of CPU time, over the budget " +
+                             std::to_string(state.strikes) + " times");
+    }
+  }
+
   RecursiveLock lock(config_performance_mutex_);
   if (performance_.count(name) == 0) {
     performance_[name] = QueryPerformance();
@@ -825,35 +1007,26 @@ void Config::recordQueryPerformance(const std::string& name,
 
   // Grab access to the non-const schedule item.
   auto& query = performance_.at(name);
-  BIGINT_LITERAL diff = 0;
-  if (!r1.at("user_time").empty() && !r0.at("user_time").empty()) {
-    diff = AS_LITERAL(BIGINT_LITERAL, r1.at("user_time")) -
-           AS_LITERAL(BIGINT_LITERAL, r0.at("user_time"));
-    if (diff > 0) {
-      query.user_time += diff;
-    }
+  query.user_time += execution.user_time;
+  query.system_time += execution.system_time;
+  if (execution.memory > 0) {
+    // Memory is stored as an average of RSS changes between query executions.
+    auto diff = static_cast<unsigned long long int>(execution.memory);
+    query.average_memory = (query.average_memory * query.executions) + diff;
+    query.average_memory = (query.average_memory / (query.executions + 1));
   }
-
-  if (!r1.at("system_time").empty() && !r0.at("system_time").empty()) {
-    diff = AS_LITERAL(BIGINT_LITERAL, r1.at("system_time")) -
-           AS_LITERAL(BIGINT_LITERAL, r0.at("system_time"));
-    if (diff > 0) {
-      query.system_time += diff;
-    }
+  query.peak_memory = std::max(query.peak_memory, execution.peak_memory);
+
+  query.wall_time_ns += execution.wall_time_ns;
+  query.wall_time = query.wall_time_ns / 1000000000;
+  query.output_size += execution.output_size;
+  query.output_rows += execution.output_rows;
+  if (execution.delay > 0) {
+    query.missed_deadlines += 1;
   }
-
-  if (!r1.at("resident_size").empty() && !r0.at("resident_size").empty()) {
-    diff = AS_LITERAL(BIGINT_LITERAL, r1.at("resident_size")) -
-           AS_LITERAL(BIGINT_LITERAL, r0.at("resident_size"));
-    if (diff > 0) {
-      // Memory is stored as an average of RSS changes between query executions.
-      query.average_memory = (query.average_memory * query.executions) + diff;
-      query.average_memory = (query.average_memory / (query.executions + 1));
-    }
+  if (execution.truncated) {
+    query.truncations += 1;
   }
-
-  query.wall_time += delay;
-  query.output_size += size;
   query.executions += 1;
   query.last_executed = getUnixTime();
 
@@ -872,6 +1045,16 @@ void Config::recordQueryStart(const std::string& name) {
       kPersistentSettings, "timestamp." + name, std::to_string(getUnixTime()));
 }
 
+void Config::getDegradation(
+    const std::string& name,
+    std::function<void(const QueryDegradationState& state)> predicate) {
+  RecursiveLock lock(config_schedule_mutex_);
+  auto it = schedule_->degraded_.find(name);
+  if (it != schedule_->degraded_.end()) {
+    predicate(it->second);
+  }
+}
+
 void Config::getPerformanceStats(
     const std::string& name,
     std::function<void(const QueryPerformance& query)> predicate) {
@@ -218,6 +218,17 @@ void Pack::initialize(const std::string& name,
                                      ? q.value["blacklist"].GetBool()
                                      : true;
 
+    if (q.value.HasMember("fallback") && q.value["fallback"].IsString()) {
+      query.fallback = q.value["fallback"].GetString();
+    }
+
+    if (q.value.HasMember("max_rows")) {
+      query.max_rows = JSON::valueToSize(q.value["max_rows"]);
+    }
+    if (q.value.HasMember("max_bytes")) {
+      query.max_bytes = JSON::valueToSize(q.value["max_bytes"]);
+    }
+
     schedule_.emplace(std::make_pair(q.name.GetString(), std::move(query)));
   }
 }
@@ -103,6 +103,28 @@ TEST_F(TLSConfigTests, test_retrieve_config) {
   EXPECT_EQ("baz", response[0]["tls_plugin"]);
 }
 
+TEST_F(TLSConfigTests, test_conditional_config) {
+  Flag::updateValue("config_tls_endpoint", "/config_etag");
+  Registry::get().setActive("config", "tls");
+
+  // The first request receives the config and its entity tag.
+  Config c;
+  ASSERT_TRUE(c.load().ok());
+  auto hash = c.getHash("tls_plugin");
+  EXPECT_FALSE(hash.empty());
+
+  // The server responds to the entity tag with 304 Not Modified.
+  PluginResponse response;
+  auto status = Registry::call("config", {{"action", "genConfig"}}, response);
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(1U, response.size());
+  EXPECT_TRUE(response[0].empty());
+
+  // An unchanged config leaves the sources in place.
+  EXPECT_TRUE(c.load().ok());
+  EXPECT_EQ(hash, c.getHash("tls_plugin"));
+}
+
 TEST_F(TLSConfigTests, test_runner_and_scheduler) {
   Flag::updateValue("config_tls_endpoint", "/config");
   // Will cause another enroll.
@@ -40,6 +40,12 @@ CLI_FLAG(string,
          "",
          "TLS/HTTPS endpoint for config retrieval");
 
+/// Send the entity tag of the last config in config requests.
+CLI_FLAG(bool,
+         config_tls_conditional,
+         true,
+         "Skip downloading an unchanged config if the server sends an ETag");
+
 DECLARE_bool(tls_secret_always);
 DECLARE_string(tls_enroll_override);
 DECLARE_bool(tls_node_api);
@@ -70,9 +76,25 @@ Status TLSConfigPlugin::genConfig(std::map<std::string, std::string>& config) {
     params.add("_get", true);
   }
 
+  if (FLAGS_config_tls_conditional && !etag_.empty()) {
+    params.add("_etag", etag_);
+  }
+
   auto s = TLSRequestHelper::go<JSONSerializer>(
       uri_, params, json, FLAGS_config_tls_max_attempts);
   if (s.ok()) {
+    auto it = params.doc().FindMember("_etag");
+    if (FLAGS_config_tls_conditional && it != params.doc().MemberEnd() &&
+        it->value.IsString()) {
+      etag_ = it->value.GetString();
+    }
+
+    if (params.doc().HasMember("_not_modified")) {
+      // The config did not change, no sources are returned.
+      VLOG(1) << "TLS config has not changed since the last request";
+      return s;
+    }
+
     if (FLAGS_tls_node_api) {
       // The node API embeds configuration data (JSON escaped).
 
@@ -27,6 +27,9 @@ class TLSConfigPlugin : public ConfigPlugin,
   /// Calculate the URL once and cache the result.
   std::string uri_;
 
+  /// Entity tag of the last config response.
+  std::string etag_;
+
  private:
   friend class TLSConfigTests;
 };
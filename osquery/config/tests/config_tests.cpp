@@ -31,6 +31,9 @@ namespace osquery {
 
 DECLARE_uint64(config_refresh);
 DECLARE_uint64(config_accelerated_refresh);
+DECLARE_bool(schedule_degrade);
+DECLARE_uint64(schedule_degrade_cost);
+DECLARE_uint64(schedule_degrade_strikes);
 
 const std::string kConfigTestNonBlacklistQuery{
     "pack_unrestricted_pack_process_heartbeat"};
@@ -39,6 +42,10 @@ const std::string kConfigTestNonBlacklistQuery{
 extern void restoreScheduleBlacklist(std::map<std::string, size_t>& blacklist);
 extern void saveScheduleBlacklist(
     const std::map<std::string, size_t>& blacklist);
+extern void restoreScheduleDegradation(
+    std::map<std::string, QueryDegradationState>& degraded);
+extern void saveScheduleDegradation(
+    const std::map<std::string, QueryDegradationState>& degraded);
 
 class ConfigTests : public testing::Test {
  public:
@@ -175,6 +182,111 @@ TEST_F(ConfigTests, test_schedule_blacklist) {
   EXPECT_EQ(blacklist.size(), 1U);
 }
 
+TEST_F(ConfigTests, test_schedule_degradation) {
+  std::map<std::string, QueryDegradationState> degraded;
+  degraded["test_1"].level = QueryDegradation::REDUCED;
+  degraded["test_1"].expire = 100;
+  degraded["test_1"].transitions = 2;
+  degraded["test_1"].last_transition = 50;
+  // Queries that never changed level are not saved.
+  degraded["test_2"].strikes = 1;
+  saveScheduleDegradation(degraded);
+
+  degraded.clear();
+  restoreScheduleDegradation(degraded);
+  ASSERT_EQ(1U, degraded.size());
+  ASSERT_EQ(1U, degraded.count("test_1"));
+  EXPECT_EQ(QueryDegradation::REDUCED, degraded["test_1"].level);
+  EXPECT_EQ(100U, degraded["test_1"].expire);
+  EXPECT_EQ(2U, degraded["test_1"].transitions);
+  EXPECT_EQ(50U, degraded["test_1"].last_transition);
+
+  saveScheduleDegradation({});
+  saveScheduleBlacklist({});
+}
+
+TEST_F(ConfigTests, test_schedule_degrade_steps) {
+  auto degrade = FLAGS_schedule_degrade;
+  auto cost = FLAGS_schedule_degrade_cost;
+  auto strikes = FLAGS_schedule_degrade_strikes;
+  FLAGS_schedule_degrade = true;
+  FLAGS_schedule_degrade_cost = 10;
+  FLAGS_schedule_degrade_strikes = 2;
+
+  saveScheduleDegradation({});
+  saveScheduleBlacklist({});
+  get().reset();
+
+  auto pack = JSON::newObject();
+  pack.fromString(
+      "{\"queries\": {\"expensive\": {\"query\": \"select * from time\", "
+      "\"interval\": 60, \"fallback\": \"select 1\"}}}");
+  get().addPack("degrade_pack", "", pack.doc());
+  std::string name = "pack_degrade_pack_expensive";
+
+  auto getLevel = [this, &name]() {
+    auto level = QueryDegradation::NONE;
+    bool found = false;
+    get().scheduledQueries(
+        [&](const std::string& query_name, const ScheduledQuery& query) {
+          if (query_name == name) {
+            level = query.degradation;
+            found = !query.blacklisted;
+          }
+        },
+        true);
+    EXPECT_EQ(found, level != QueryDegradation::BLACKLISTED);
+    return level;
+  };
+
+  QueryExecution expensive;
+  expensive.user_time = 20;
+  QueryExecution cheap;
+  cheap.user_time = 5;
+
+  // A cheap execution resets the consecutive strikes.
+  get().recordQueryPerformance(name, expensive);
+  get().recordQueryPerformance(name, cheap);
+  get().recordQueryPerformance(name, expensive);
+  EXPECT_EQ(QueryDegradation::NONE, getLevel());
+
+  // Each level is reached after consecutive executions over the budget.
+  get().recordQueryPerformance(name, expensive);
+  EXPECT_EQ(QueryDegradation::INTERVAL, getLevel());
+  get().recordQueryPerformance(name, expensive);
+  get().recordQueryPerformance(name, expensive);
+  EXPECT_EQ(QueryDegradation::REDUCED, getLevel());
+  get().recordQueryPerformance(name, expensive);
+  get().recordQueryPerformance(name, expensive);
+  EXPECT_EQ(QueryDegradation::BLACKLISTED, getLevel());
+
+  size_t transitions = 0;
+  get().getDegradation(name, [&transitions](const QueryDegradationState& s) {
+    transitions = s.transitions;
+  });
+  EXPECT_EQ(3U, transitions);
+
+  // The state is restored by a new worker.
+  get().reset();
+  get().addPack("degrade_pack", "", pack.doc());
+  EXPECT_EQ(QueryDegradation::BLACKLISTED, getLevel());
+
+  // A worker failure while executing the query degrades it one level.
+  saveScheduleDegradation({});
+  saveScheduleBlacklist({});
+  setDatabaseValue(kPersistentSettings, kExecutingQuery, name);
+  get().reset();
+  get().addPack("degrade_pack", "", pack.doc());
+  EXPECT_EQ(QueryDegradation::INTERVAL, getLevel());
+
+  saveScheduleDegradation({});
+  saveScheduleBlacklist({});
+  get().reset();
+  FLAGS_schedule_degrade = degrade;
+  FLAGS_schedule_degrade_cost = cost;
+  FLAGS_schedule_degrade_strikes = strikes;
+}
+
 TEST_F(ConfigTests, test_pack_noninline) {
   auto& rf = RegistryFactory::get();
   rf.registry("config")->add("test", std::make_shared<TestConfigPlugin>());
@@ -450,6 +562,46 @@ TEST_F(ConfigTests, test_plugin_reconfigure) {
   rf.registry("config_parser")->remove("placebo");
 }
 
+class CountingConfigParserPlugin : public ConfigParserPlugin {
+ public:
+  std::vector<std::string> keys() const override {
+    return {"counted"};
+  }
+
+  Status update(const std::string&, const ParserConfig&) override {
+    updates++;
+    return Status();
+  }
+
+  size_t updates{0};
+};
+
+TEST_F(ConfigTests, test_parser_unchanged_keys) {
+  auto& rf = RegistryFactory::get();
+  auto parser = std::make_shared<CountingConfigParserPlugin>();
+  rf.registry("config_parser")->add("counting", parser);
+
+  get().update({{"data", "{\"counted\": {\"a\": 1}}"}});
+  EXPECT_EQ(parser->updates, 1U);
+
+  // The source changed but the parser's key did not.
+  get().update({{"data", "{\"counted\": {\"a\": 1}, \"options\": {}}"}});
+  EXPECT_EQ(parser->updates, 1U);
+
+  get().update({{"data", "{\"counted\": {\"a\": 2}, \"options\": {}}"}});
+  EXPECT_EQ(parser->updates, 2U);
+
+  // Each source is tracked separately.
+  get().update({{"data2", "{\"counted\": {\"a\": 2}}"}});
+  EXPECT_EQ(parser->updates, 3U);
+
+  // Removing the key is a change.
+  get().update({{"data", "{\"options\": {}}"}});
+  EXPECT_EQ(parser->updates, 4U);
+
+  rf.registry("config_parser")->remove("counting");
+}
+
 TEST_F(ConfigTests, test_pack_file_paths) {
   size_t count = 0;
   auto fileCounter = [&count](const std::string& c,
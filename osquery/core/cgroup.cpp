@@ -0,0 +1,179 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <cctype>
+#include <fstream>
+
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/filesystem.hpp>
+
+#include "osquery/core/cgroup.h"
+#include "osquery/core/conversions.h"
+#include "osquery/core/process.h"
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+const std::string kCGroupMount{"/sys/fs/cgroup"};
+
+/// The cpu.max period in microseconds.
+const size_t kCGroupCPUPeriod{100000};
+
+/// Read a cgroup interface file, these cannot be seeked or sized.
+static Status readInterface(const fs::path& path, std::string& content) {
+  std::ifstream fd(path.string(), std::ios::in);
+  if (!fd) {
+    return Status(1, "Cannot read " + path.string());
+  }
+
+  content = std::string(std::istreambuf_iterator<char>(fd),
+                        std::istreambuf_iterator<char>());
+  return Status(0);
+}
+
+/// Write a cgroup interface file, each write is a single request.
+static Status writeInterface(const fs::path& path, const std::string& content) {
+  std::ofstream fd(path.string(), std::ios::out | std::ios::trunc);
+  if (!fd) {
+    return Status(1, "Cannot open " + path.string());
+  }
+
+  fd << content;
+  fd.flush();
+  if (!fd) {
+    return Status(1, "Cannot write " + path.string());
+  }
+  return Status(0);
+}
+
+Status WatchdogCGroup::getProcessPath(std::string& path) {
+  std::string content;
+  auto status = readInterface("/proc/self/cgroup", content);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // The unified hierarchy is listed with an ID of 0 and no controllers.
+  for (const auto& line : osquery::split(content, "\n")) {
+    if (line.compare(0, 3, "0::") == 0) {
+      path = kCGroupMount + line.substr(3);
+      return Status(0);
+    }
+  }
+  return Status(1, "The process is not in a cgroup v2 hierarchy");
+}
+
+std::string WatchdogCGroup::getLeaf(const std::string& extension) {
+  auto name = fs::path(extension).filename().string();
+  for (auto& c : name) {
+    if (!std::isalnum(static_cast<unsigned char>(c)) && c != '.' && c != '-') {
+      c = '_';
+    }
+  }
+  return "extension-" + name;
+}
+
+Status WatchdogCGroup::create() const {
+  boost::system::error_code ec;
+  auto watcher = fs::path(path_) / "watcher";
+  fs::create_directories(watcher, ec);
+  if (ec) {
+    return Status(1, "Cannot create cgroup " + watcher.string());
+  }
+
+  // A cgroup that contains processes cannot enable controllers for children.
+  auto pid = PlatformProcess::getCurrentProcess()->pid();
+  auto status = writeInterface(watcher / "cgroup.procs", std::to_string(pid));
+  if (!status.ok()) {
+    return status;
+  }
+  return writeInterface(fs::path(path_) / "cgroup.subtree_control",
+                        "+cpu +memory");
+}
+
+Status WatchdogCGroup::attach(const std::string& leaf, pid_t pid) const {
+  boost::system::error_code ec;
+  auto path = fs::path(path_) / leaf;
+  fs::create_directories(path, ec);
+  if (ec) {
+    return Status(1, "Cannot create cgroup " + path.string());
+  }
+
+  // A leaf is reused by each respawn of the same child.
+  auto status = throttle(leaf, 0);
+  if (!status.ok()) {
+    return status;
+  }
+  return writeInterface(path / "cgroup.procs", std::to_string(pid));
+}
+
+bool WatchdogCGroup::contains(const std::string& leaf, pid_t pid) const {
+  std::string content;
+  if (!readInterface(fs::path(path_) / leaf / "cgroup.procs", content).ok()) {
+    return false;
+  }
+
+  auto member = std::to_string(pid);
+  for (const auto& line : osquery::split(content, "\n")) {
+    if (line == member) {
+      return true;
+    }
+  }
+  return false;
+}
+
+Status WatchdogCGroup::sample(const std::string& leaf,
+                              CGroupUsage& usage) const {
+  auto path = fs::path(path_) / leaf;
+
+  std::string content;
+  auto status = readInterface(path / "memory.current", content);
+  if (!status.ok()) {
+    return status;
+  }
+
+  unsigned long long value = 0;
+  boost::trim(content);
+  if (!safeStrtoull(content, 10, value).ok()) {
+    return Status(1, "Invalid memory.current: " + content);
+  }
+  usage.memory = value;
+
+  status = readInterface(path / "cpu.stat", content);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Each line is a key and a counter, the cpu controller adds throttling.
+  for (const auto& line : osquery::split(content, "\n")) {
+    auto fields = osquery::split(line, " ");
+    if (fields.size() != 2 || !safeStrtoull(fields[1], 10, value).ok()) {
+      continue;
+    }
+
+    if (fields[0] == "user_usec") {
+      usage.user_usec = value;
+    } else if (fields[0] == "system_usec") {
+      usage.system_usec = value;
+    } else if (fields[0] == "throttled_usec") {
+      usage.throttled_usec = value;
+    }
+  }
+  return Status(0);
+}
+
+Status WatchdogCGroup::throttle(const std::string& leaf, size_t percent) const {
+  auto quota = (percent == 0) ? std::string("max")
+                              : std::to_string(percent * kCGroupCPUPeriod / 100);
+  return writeInterface(fs::path(path_) / leaf / "cpu.max",
+                        quota + " " + std::to_string(kCGroupCPUPeriod));
+}
+} // namespace osquery
@@ -0,0 +1,91 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core.h>
+
+namespace osquery {
+
+/// The cgroup v2 unified hierarchy mount point.
+extern const std::string kCGroupMount;
+
+/// Resource accounting read from a cgroup v2 leaf.
+struct CGroupUsage {
+  /// Bytes charged to the cgroup, from memory.current.
+  uint64_t memory{0};
+
+  /// Microseconds of user CPU time, from cpu.stat.
+  uint64_t user_usec{0};
+
+  /// Microseconds of system CPU time, from cpu.stat.
+  uint64_t system_usec{0};
+
+  /// Microseconds the cgroup was throttled by cpu.max, from cpu.stat.
+  uint64_t throttled_usec{0};
+};
+
+/**
+ * @brief A cgroup v2 subtree holding the watchdog's children.
+ *
+ * The watcher moves itself into a `watcher` leaf of the subtree, enables the
+ * cpu and memory controllers for the subtree, and places the worker and each
+ * managed extension into a leaf of their own. Accounting is read from the
+ * leaf interface files and CPU time is limited with cpu.max.
+ *
+ * Every operation is a read or write of a file below the subtree path, so a
+ * plain directory may stand in for cgroupfs.
+ */
+class WatchdogCGroup : private boost::noncopyable {
+ public:
+  /// Use the subtree at a cgroup v2 directory.
+  explicit WatchdogCGroup(std::string path) : path_(std::move(path)) {}
+
+  /// The cgroup v2 directory of the current process.
+  static Status getProcessPath(std::string& path);
+
+  /// The leaf name for the worker or a managed extension binary.
+  static std::string getLeaf(const std::string& extension);
+
+  /// Move the watcher into its leaf and enable the cpu and memory controllers.
+  Status create() const;
+
+  /// Create a leaf, without a CPU limit, and move a process into it.
+  Status attach(const std::string& leaf, pid_t pid) const;
+
+  /// Check if a process is a member of a leaf.
+  bool contains(const std::string& leaf, pid_t pid) const;
+
+  /// Read the memory and CPU accounting of a leaf.
+  Status sample(const std::string& leaf, CGroupUsage& usage) const;
+
+  /**
+   * @brief Limit the CPU time of a leaf.
+   *
+   * @param leaf The leaf name.
+   * @param percent The percent of one CPU the leaf may use, 0 for no limit.
+   */
+  Status throttle(const std::string& leaf, size_t percent) const;
+
+  /// The subtree path.
+  const std::string& path() const {
+    return path_;
+  }
+
+ private:
+  /// The cgroup v2 directory containing the watchdog leaves.
+  std::string path_;
+};
+} // namespace osquery
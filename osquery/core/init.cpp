@@ -48,6 +48,7 @@
 #include <osquery/system.h>
 
 #include "osquery/core/process.h"
+#include "osquery/core/startup_profile.h"
 #include "osquery/core/watcher.h"
 
 #ifdef __linux__
@@ -239,6 +240,9 @@ static inline void printUsage(const std::string& binary, ToolType tool) {
 
 Initializer::Initializer(int& argc, char**& argv, ToolType tool)
     : argc_(&argc), argv_(&argv) {
+  // Startup phases are measured from the construction of the Initializer.
+  StartupProfile::get();
+
   // Initialize random number generated based on time.
   std::srand(static_cast<unsigned int>(
       chrono_clock::now().time_since_epoch().count()));
@@ -521,6 +525,9 @@ void Initializer::initWorker(const std::string& name) const {
     }
   }
 
+  // Accept graduated responses from a watcher managing a cgroup.
+  initWorkerPressure();
+
   // Start a 'watcher watcher' thread to exit the process if the watcher exits.
   // In this case the parent process is called the 'watcher' process.
   Dispatcher::addService(std::make_shared<WatcherWatcherRunner>(
@@ -586,6 +593,7 @@ void Initializer::start() const {
   // If there are spurious access then warning logs will be emitted since the
   // set-allow-open will never be called.
   if (!isWatcher()) {
+    StartupProfile::Phase phase("database");
     DatabasePlugin::setAllowOpen(true);
     // A daemon must always have R/W access to the database.
     DatabasePlugin::setRequireWrite(isDaemon());
@@ -609,7 +617,11 @@ void Initializer::start() const {
   // Bind to an extensions socket and wait for registry additions.
   // After starting the extension manager, osquery MUST shutdown using the
   // internal 'shutdown' method.
-  auto s = osquery::startExtensionManager();
+  auto s = Status(0);
+  {
+    StartupProfile::Phase phase("extensions");
+    s = osquery::startExtensionManager();
+  }
   if (!s.ok()) {
     auto severity = (Watcher::get().hasManagedExtensions()) ? google::GLOG_ERROR
                                                             : google::GLOG_INFO;
@@ -625,7 +637,10 @@ void Initializer::start() const {
   initActivePlugin("config", FLAGS_config_plugin);
 
   // Run the setup for all lazy registries (tables, SQL).
-  Registry::setUp();
+  {
+    StartupProfile::Phase phase("registry");
+    Registry::setUp();
+  }
 
   if (FLAGS_config_check) {
     // The initiator requested an initialization and config check.
@@ -644,7 +659,10 @@ void Initializer::start() const {
   }
 
   // Load the osquery config using the default/active config plugin.
-  s = Config::get().load();
+  {
+    StartupProfile::Phase phase("config");
+    s = Config::get().load();
+  }
   if (!s.ok()) {
     auto message = "Error reading config: " + s.toString();
     if (isDaemon()) {
@@ -655,10 +673,13 @@ void Initializer::start() const {
   }
 
   // Initialize the status and result plugin logger.
-  if (!FLAGS_disable_logging) {
-    initActivePlugin("logger", FLAGS_logger_plugin);
+  {
+    StartupProfile::Phase phase("logger");
+    if (!FLAGS_disable_logging) {
+      initActivePlugin("logger", FLAGS_logger_plugin);
+    }
+    initLogger(binary_);
   }
-  initLogger(binary_);
 
   // Initialize the distributed plugin, if necessary
   if (!FLAGS_disable_distributed) {
@@ -666,8 +687,11 @@ void Initializer::start() const {
   }
 
   // Start event threads.
-  osquery::attachEvents();
-  EventFactory::delay();
+  {
+    StartupProfile::Phase phase("events");
+    osquery::attachEvents();
+    EventFactory::delay();
+  }
 }
 
 void Initializer::waitForShutdown() {
@@ -0,0 +1,304 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <cmath>
+#include <sstream>
+
+#include "osquery/core/metrics.h"
+
+namespace osquery {
+
+const size_t MetricHistogram::kSubBucketBits;
+const size_t MetricHistogram::kMaxPower;
+const size_t MetricHistogram::kBuckets;
+
+/// The quantiles exported for each histogram.
+const std::vector<double> kMetricQuantiles{0.5, 0.9, 0.99};
+
+size_t getMetricShard() {
+  static std::atomic<size_t> next{0};
+  static thread_local size_t shard{next++ % kMetricShards};
+  return shard;
+}
+
+uint64_t MetricCounter::value() const {
+  uint64_t value = 0;
+  for (const auto& shard : shards_) {
+    value += shard.value.load(std::memory_order_relaxed);
+  }
+  return value;
+}
+
+size_t MetricHistogram::getBucket(uint64_t value) {
+  const size_t sub_buckets = size_t(1) << kSubBucketBits;
+  if (value < sub_buckets) {
+    return static_cast<size_t>(value);
+  }
+
+  size_t power = 0;
+  for (auto high = value >> 1; high != 0; high >>= 1) {
+    power++;
+  }
+  if (power > kMaxPower) {
+    return kBuckets - 1;
+  }
+
+  // The bits following the highest set bit select a sub-bucket.
+  auto sub = (value >> (power - kSubBucketBits)) & (sub_buckets - 1);
+  return ((power - kSubBucketBits + 1) << kSubBucketBits) + sub;
+}
+
+uint64_t MetricHistogram::getBucketValue(size_t bucket) {
+  const size_t sub_buckets = size_t(1) << kSubBucketBits;
+  if (bucket < sub_buckets) {
+    return bucket;
+  }
+
+  auto power = (bucket >> kSubBucketBits) + kSubBucketBits - 1;
+  auto sub = bucket & (sub_buckets - 1);
+  auto width = uint64_t(1) << (power - kSubBucketBits);
+  return ((sub_buckets + sub) * width) + width - 1;
+}
+
+void MetricHistogram::record(uint64_t value) {
+  auto& shard = (*shards_)[getMetricShard()];
+  shard.count.fetch_add(1, std::memory_order_relaxed);
+  shard.sum.fetch_add(value, std::memory_order_relaxed);
+  shard.buckets[getBucket(value)].fetch_add(1, std::memory_order_relaxed);
+}
+
+MetricHistogram::Snapshot MetricHistogram::snapshot() const {
+  Snapshot snapshot;
+  for (const auto& shard : *shards_) {
+    snapshot.count += shard.count.load(std::memory_order_relaxed);
+    snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < kBuckets; i++) {
+      snapshot.buckets[i] += shard.buckets[i].load(std::memory_order_relaxed);
+    }
+  }
+  return snapshot;
+}
+
+uint64_t MetricHistogram::Snapshot::quantile(double q) const {
+  // Shards are read one at a time, use the bucket counts as the total.
+  uint64_t total = 0;
+  for (const auto& count : buckets) {
+    total += count;
+  }
+  if (total == 0) {
+    return 0;
+  }
+
+  auto rank = static_cast<uint64_t>(std::ceil(q * total));
+  rank = std::max<uint64_t>(rank, 1);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; i++) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      return getBucketValue(i);
+    }
+  }
+  return getBucketValue(kBuckets - 1);
+}
+
+/// Serialize labels as they appear within braces of the exposition format.
+static std::string serializeLabels(const MetricLabels& labels) {
+  std::string serialized;
+  for (const auto& label : labels) {
+    if (!serialized.empty()) {
+      serialized += ",";
+    }
+    serialized += label.first + "=\"";
+    for (const auto& c : label.second) {
+      if (c == '\\' || c == '"') {
+        serialized += '\\';
+        serialized += c;
+      } else if (c == '\n') {
+        serialized += "\\n";
+      } else {
+        serialized += c;
+      }
+    }
+    serialized += "\"";
+  }
+  return serialized;
+}
+
+/// Append a label to serialized labels.
+static std::string addLabel(const std::string& labels,
+                            const std::string& label) {
+  return (labels.empty()) ? label : labels + "," + label;
+}
+
+/// Metric values are integral, avoid the exponent notation of large doubles.
+static std::string serializeValue(double value) {
+  if (std::floor(value) == value && std::fabs(value) < 1e18) {
+    return std::to_string(static_cast<long long int>(value));
+  }
+
+  std::ostringstream stream;
+  stream << value;
+  return stream.str();
+}
+
+Metrics& Metrics::get() {
+  static Metrics metrics;
+  return metrics;
+}
+
+template <typename T>
+T& Metrics::find(std::map<std::string, Family<T>>& families,
+                 const std::string& name,
+                 const std::string& help,
+                 const MetricLabels& labels) {
+  auto key = serializeLabels(labels);
+  {
+    ReadLock lock(mutex_);
+    auto family = families.find(name);
+    if (family != families.end()) {
+      auto metric = family->second.metrics.find(key);
+      if (metric != family->second.metrics.end()) {
+        return *metric->second;
+      }
+    }
+  }
+
+  WriteLock lock(mutex_);
+  auto& family = families[name];
+  if (family.help.empty()) {
+    family.help = help;
+  }
+
+  auto& metric = family.metrics[key];
+  if (metric == nullptr) {
+    metric = std::make_unique<T>();
+  }
+  return *metric;
+}
+
+MetricCounter& Metrics::counter(const std::string& name,
+                                const std::string& help,
+                                const MetricLabels& labels) {
+  return find(counters_, name, help, labels);
+}
+
+MetricGauge& Metrics::gauge(const std::string& name,
+                            const std::string& help,
+                            const MetricLabels& labels) {
+  return find(gauges_, name, help, labels);
+}
+
+MetricHistogram& Metrics::histogram(const std::string& name,
+                                    const std::string& help,
+                                    const MetricLabels& labels) {
+  return find(histograms_, name, help, labels);
+}
+
+MetricCounterFamily::MetricCounterFamily(
+    const std::string& name,
+    const std::string& help,
+    const std::string& label,
+    const std::vector<std::string>& values) {
+  for (const auto& value : values) {
+    counters_[value] = &Metrics::get().counter(name, help, {{label, value}});
+  }
+}
+
+void Metrics::addCollector(std::function<void()> collector) {
+  WriteLock lock(mutex_);
+  collectors_.push_back(std::move(collector));
+}
+
+std::vector<MetricSample> Metrics::samples() {
+  // Collectors may create gauges, call them without holding the lock.
+  std::vector<std::function<void()>> collectors;
+  {
+    ReadLock lock(mutex_);
+    collectors = collectors_;
+  }
+  for (const auto& collector : collectors) {
+    collector();
+  }
+
+  std::vector<MetricSample> samples;
+  ReadLock lock(mutex_);
+  for (const auto& family : counters_) {
+    for (const auto& metric : family.second.metrics) {
+      samples.push_back({family.first,
+                         family.first,
+                         metric.first,
+                         "counter",
+                         family.second.help,
+                         static_cast<double>(metric.second->value())});
+    }
+  }
+
+  for (const auto& family : gauges_) {
+    for (const auto& metric : family.second.metrics) {
+      samples.push_back({family.first,
+                         family.first,
+                         metric.first,
+                         "gauge",
+                         family.second.help,
+                         static_cast<double>(metric.second->value())});
+    }
+  }
+
+  // Histograms are exported as summaries with fixed quantiles.
+  for (const auto& family : histograms_) {
+    const auto& help = family.second.help;
+    for (const auto& metric : family.second.metrics) {
+      auto snapshot = metric.second->snapshot();
+      for (const auto& q : kMetricQuantiles) {
+        std::ostringstream quantile;
+        quantile << "quantile=\"" << q << "\"";
+        samples.push_back({family.first,
+                           family.first,
+                           addLabel(metric.first, quantile.str()),
+                           "summary",
+                           help,
+                           static_cast<double>(snapshot.quantile(q))});
+      }
+      samples.push_back({family.first,
+                         family.first + "_sum",
+                         metric.first,
+                         "summary",
+                         help,
+                         static_cast<double>(snapshot.sum)});
+      samples.push_back({family.first,
+                         family.first + "_count",
+                         metric.first,
+                         "summary",
+                         help,
+                         static_cast<double>(snapshot.count)});
+    }
+  }
+  return samples;
+}
+
+std::string Metrics::toText() {
+  std::string text;
+  std::string family;
+  for (const auto& sample : samples()) {
+    if (sample.family != family) {
+      family = sample.family;
+      text += "# HELP " + family + " " + sample.help + "\n";
+      text += "# TYPE " + family + " " + sample.type + "\n";
+    }
+
+    text += sample.name;
+    if (!sample.labels.empty()) {
+      text += "{" + sample.labels + "}";
+    }
+    text += " " + serializeValue(sample.value) + "\n";
+  }
+  return text;
+}
+} // namespace osquery
@@ -0,0 +1,252 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core.h>
+
+namespace osquery {
+
+/// Labels of a metric, such as {{"registry", "table"}}.
+using MetricLabels = std::map<std::string, std::string>;
+
+/// Number of shards of counters and histograms, threads update their own.
+const size_t kMetricShards{8};
+
+/// The shard updated by the calling thread.
+size_t getMetricShard();
+
+/**
+ * @brief A monotonically increasing count, such as events added.
+ *
+ * Each thread increments a shard on its own cache line, the shards are summed
+ * when the counter is read.
+ */
+class MetricCounter : private boost::noncopyable {
+ public:
+  void increment(uint64_t value = 1) {
+    shards_[getMetricShard()].value.fetch_add(value,
+                                              std::memory_order_relaxed);
+  }
+
+  /// The sum of every shard.
+  uint64_t value() const;
+
+ private:
+  struct alignas(64) Shard {
+    std::atomic<uint64_t> value{0};
+  };
+
+  std::array<Shard, kMetricShards> shards_;
+};
+
+/// A value that may go up and down, such as a queue depth.
+class MetricGauge : private boost::noncopyable {
+ public:
+  void set(int64_t value) {
+    value_.store(value, std::memory_order_relaxed);
+  }
+
+  void add(int64_t value) {
+    value_.fetch_add(value, std::memory_order_relaxed);
+  }
+
+  int64_t value() const {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<int64_t> value_{0};
+};
+
+/**
+ * @brief A distribution of values, such as call latencies in microseconds.
+ *
+ * Values are counted in log-linear buckets, as an HDR histogram: each power of
+ * two is divided into 8 buckets, a quantile is accurate to 12.5%. Values below
+ * 2^41 are counted, larger values are counted in the last bucket.
+ */
+class MetricHistogram : private boost::noncopyable {
+ public:
+  /// Sub-buckets within each power of two.
+  static const size_t kSubBucketBits{3};
+
+  /// The highest power of two with buckets.
+  static const size_t kMaxPower{40};
+
+  /// Number of buckets, values below 8 have a bucket each.
+  static const size_t kBuckets{(kMaxPower - kSubBucketBits + 2)
+                               << kSubBucketBits};
+
+  /// Record the microseconds spent within a scope.
+  class Timer : private boost::noncopyable {
+   public:
+    explicit Timer(MetricHistogram& histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+
+    ~Timer() {
+      histogram_.record(std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now() - start_)
+                            .count());
+    }
+
+   private:
+    MetricHistogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  /// The counts of every shard.
+  struct Snapshot {
+    uint64_t count{0};
+    uint64_t sum{0};
+    std::array<uint64_t, kBuckets> buckets{};
+
+    /// The highest value of the bucket containing a quantile (0 to 1).
+    uint64_t quantile(double q) const;
+  };
+
+ public:
+  MetricHistogram() : shards_(new std::array<Shard, kMetricShards>()) {}
+
+  void record(uint64_t value);
+
+  Snapshot snapshot() const;
+
+  /// The bucket counting a value.
+  static size_t getBucket(uint64_t value);
+
+  /// The highest value counted by a bucket.
+  static uint64_t getBucketValue(size_t bucket);
+
+ private:
+  /// Each shard spans many cache lines, only its edges are shared.
+  struct Shard {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sum{0};
+    std::array<std::atomic<uint64_t>, kBuckets> buckets{};
+  };
+
+  std::unique_ptr<std::array<Shard, kMetricShards>> shards_;
+};
+
+/**
+ * @brief The counters of a metric, one for each value of a single label.
+ *
+ * The counters are found in the registry when the family is constructed, a
+ * function-local static family lets a hot path count a result, such as
+ * "cached" or "failed", without the registry lock.
+ */
+class MetricCounterFamily : private boost::noncopyable {
+ public:
+  MetricCounterFamily(const std::string& name,
+                      const std::string& help,
+                      const std::string& label,
+                      const std::vector<std::string>& values);
+
+  /// The counter for a label value given when the family was constructed.
+  MetricCounter& get(const std::string& value) const {
+    return *counters_.at(value);
+  }
+
+ private:
+  std::map<std::string, MetricCounter*> counters_;
+};
+
+/// A single exported value, a histogram exports several.
+struct MetricSample {
+  /// The metric family name.
+  std::string family;
+
+  /// Metric name, with a suffix for histogram sums and counts.
+  std::string name;
+
+  /// Labels in the text exposition format, without braces.
+  std::string labels;
+
+  /// The metric type: counter, gauge, or summary.
+  std::string type;
+
+  /// The metric description.
+  std::string help;
+
+  double value{0};
+};
+
+/**
+ * @brief The registry of osquery's internal metrics.
+ *
+ * Metrics are created on first use and never removed, a caller may keep the
+ * returned reference. A name must be used with a single type.
+ *
+ * Values are read by the osquery_metrics table and the optional exporter in
+ * the Prometheus text exposition format.
+ */
+class Metrics : private boost::noncopyable {
+ public:
+  static Metrics& get();
+
+  MetricCounter& counter(const std::string& name,
+                         const std::string& help,
+                         const MetricLabels& labels = {});
+
+  MetricGauge& gauge(const std::string& name,
+                     const std::string& help,
+                     const MetricLabels& labels = {});
+
+  MetricHistogram& histogram(const std::string& name,
+                             const std::string& help,
+                             const MetricLabels& labels = {});
+
+  /// Call a function to update gauges each time metrics are read.
+  void addCollector(std::function<void()> collector);
+
+  /// Every value, histograms export quantiles, a sum, and a count.
+  std::vector<MetricSample> samples();
+
+  /// Serialize every value in the Prometheus text exposition format.
+  std::string toText();
+
+ private:
+  Metrics() = default;
+
+  template <typename T>
+  struct Family {
+    std::string help;
+    std::map<std::string, std::unique_ptr<T>> metrics;
+  };
+
+  template <typename T>
+  T& find(std::map<std::string, Family<T>>& families,
+          const std::string& name,
+          const std::string& help,
+          const MetricLabels& labels);
+
+ private:
+  std::map<std::string, Family<MetricCounter>> counters_;
+  std::map<std::string, Family<MetricGauge>> gauges_;
+  std::map<std::string, Family<MetricHistogram>> histograms_;
+  std::vector<std::function<void()>> collectors_;
+
+  /// Protect the families, metric values are atomic.
+  mutable Mutex mutex_;
+};
+} // namespace osquery
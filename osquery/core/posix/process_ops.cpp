@@ -8,10 +8,12 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <cstdio>
 #include <string>
 
 #include <dlfcn.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include <sys/resource.h>
 #include <sys/syscall.h>
@@ -19,12 +21,24 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+
+#ifdef __linux__
+#include <fcntl.h>
+#endif
+
 #include <boost/optional.hpp>
 
 #include <osquery/flags.h>
 
 #include "osquery/core/process.h"
 
+#ifdef __linux__
+#include "osquery/filesystem/linux/proc.h"
+#endif
+
 namespace osquery {
 
 DECLARE_uint64(alarm_timeout);
@@ -91,4 +105,119 @@ int platformGetPid() {
 int platformGetTid() {
   return std::hash<std::thread::id>()(std::this_thread::get_id());
 }
+
+static uint64_t toMilliseconds(const struct timeval& tv) {
+  return static_cast<uint64_t>(tv.tv_sec) * 1000 + tv.tv_usec / 1000;
+}
+
+/// Read the resident set size of the calling process.
+static uint64_t getResidentSize() {
+#if defined(__linux__)
+  auto statm = ::fopen("/proc/self/statm", "r");
+  if (statm == nullptr) {
+    return 0;
+  }
+
+  // The second field is the number of resident pages.
+  unsigned long long pages = 0;
+  if (::fscanf(statm, "%*s %llu", &pages) != 1) {
+    pages = 0;
+  }
+  ::fclose(statm);
+  return pages * ::sysconf(_SC_PAGESIZE);
+#elif defined(__APPLE__)
+  mach_task_basic_info_data_t info;
+  mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+  if (::task_info(mach_task_self(),
+                  MACH_TASK_BASIC_INFO,
+                  reinterpret_cast<task_info_t>(&info),
+                  &count) != KERN_SUCCESS) {
+    return 0;
+  }
+  return info.resident_size;
+#else
+  return 0;
+#endif
+}
+
+ResourceChargeRef getThreadResourceCharge() {
+  static thread_local auto charge = std::make_shared<ResourceCharge>();
+  return charge;
+}
+
+ScopedResourceCharge::ScopedResourceCharge(ResourceChargeRef charge) {
+#ifdef RUSAGE_THREAD
+  if (charge != nullptr && charge != getThreadResourceCharge() &&
+      getThreadResourceUsage(start_).ok()) {
+    charge_ = std::move(charge);
+  }
+#else
+  // The process CPU time already includes the time of every thread.
+  (void)charge;
+#endif
+}
+
+ScopedResourceCharge::~ScopedResourceCharge() {
+  ResourceUsage end;
+  if (charge_ != nullptr && getThreadResourceUsage(end).ok()) {
+    charge_->user_time += end.user_time - start_.user_time;
+    charge_->system_time += end.system_time - start_.system_time;
+  }
+}
+
+Status getThreadResourceUsage(ResourceUsage& usage) {
+  struct rusage ru;
+#ifdef RUSAGE_THREAD
+  if (::getrusage(RUSAGE_THREAD, &ru) != 0) {
+    return Status(1, "Cannot read thread resource usage");
+  }
+  const auto& charge = *getThreadResourceCharge();
+  usage.user_time = toMilliseconds(ru.ru_utime) + charge.user_time;
+  usage.system_time = toMilliseconds(ru.ru_stime) + charge.system_time;
+
+  // The peak resident size is only maintained for the process.
+  if (::getrusage(RUSAGE_SELF, &ru) != 0) {
+    return Status(1, "Cannot read process resource usage");
+  }
+#else
+  if (::getrusage(RUSAGE_SELF, &ru) != 0) {
+    return Status(1, "Cannot read process resource usage");
+  }
+  usage.user_time = toMilliseconds(ru.ru_utime);
+  usage.system_time = toMilliseconds(ru.ru_stime);
+#endif
+
+#ifdef __APPLE__
+  // Darwin reports the maximum resident size in bytes.
+  usage.peak_resident_size = static_cast<uint64_t>(ru.ru_maxrss);
+#else
+  usage.peak_resident_size = static_cast<uint64_t>(ru.ru_maxrss) * 1024;
+#endif
+  usage.resident_size = getResidentSize();
+  return Status(0);
+}
+
+Status getProcessResourceUsage(int pid, ResourceUsage& usage) {
+#ifdef __linux__
+  // The stat is read relative to a kept /proc descriptor without allocating.
+  static int proc_fd = ::open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  ProcStat stat;
+  auto status = procReadStat(proc_fd, std::to_string(pid), stat);
+  if (!status.ok()) {
+    return status;
+  }
+
+  auto ticks = static_cast<uint64_t>(::sysconf(_SC_CLK_TCK));
+  ticks = (ticks == 0) ? 100 : ticks;
+  usage.parent = static_cast<int>(stat.parent);
+  usage.user_time = stat.user_time * 1000 / ticks;
+  usage.system_time = stat.system_time * 1000 / ticks;
+  usage.resident_size = stat.resident_pages * ::sysconf(_SC_PAGESIZE);
+  return Status(0);
+#else
+  (void)pid;
+  (void)usage;
+  return Status(1, "Not supported");
+#endif
+}
 }
@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <memory>
 #include <string>
@@ -286,4 +287,73 @@ int platformGetPid();
 * and on posix platforms returns gettid()
 */
 int platformGetTid();
+
+/**
+ * @brief CPU and memory usage sampled from the operating system.
+ *
+ * CPU times are in milliseconds and memory sizes are in bytes.
+ */
+struct ResourceUsage {
+  /// CPU time spent in user mode.
+  uint64_t user_time{0};
+
+  /// CPU time spent in the kernel.
+  uint64_t system_time{0};
+
+  /// Current resident set size of the process.
+  uint64_t resident_size{0};
+
+  /// Largest resident set size of the process, 0 if unknown.
+  uint64_t peak_resident_size{0};
+
+  /// The parent process, only set when sampling a process.
+  int parent{-1};
+};
+
+/// CPU time other threads spent on behalf of a thread, in milliseconds.
+struct ResourceCharge {
+  std::atomic<uint64_t> user_time{0};
+  std::atomic<uint64_t> system_time{0};
+};
+
+using ResourceChargeRef = std::shared_ptr<ResourceCharge>;
+
+/**
+ * @brief Sample the CPU time of the calling thread and its process memory.
+ *
+ * This avoids the processes table and is cheap enough to call before and
+ * after every scheduled query. The CPU time includes the time charged to the
+ * thread by helper threads, see ScopedResourceCharge. Platforms without
+ * per-thread accounting report the CPU time of the whole process.
+ */
+Status getThreadResourceUsage(ResourceUsage& usage);
+
+/// The charge of the calling thread, for helper threads working on its behalf.
+ResourceChargeRef getThreadResourceCharge();
+
+/**
+ * @brief Charge the CPU time of the calling thread, within a scope, to
+ * another thread.
+ *
+ * Worker threads hashing, traversing, or scanning for a query wrap their work
+ * in a scope so the query thread's resource usage includes their time.
+ * Charging the calling thread itself, or a null charge, does nothing.
+ */
+class ScopedResourceCharge : private boost::noncopyable {
+ public:
+  explicit ScopedResourceCharge(ResourceChargeRef charge);
+  ~ScopedResourceCharge();
+
+ private:
+  ResourceChargeRef charge_;
+  ResourceUsage start_;
+};
+
+/**
+ * @brief Sample the CPU time and memory of a process.
+ *
+ * Not every platform has a native implementation, callers should fall back
+ * to the processes table when this fails.
+ */
+Status getProcessResourceUsage(int pid, ResourceUsage& usage);
 } // namespace osquery
@@ -25,6 +25,19 @@ namespace osquery {
 
 DECLARE_bool(decorations_top_level);
 
+std::string getQueryDegradationName(QueryDegradation level) {
+  switch (level) {
+  case QueryDegradation::INTERVAL:
+    return "interval";
+  case QueryDegradation::REDUCED:
+    return "reduced";
+  case QueryDegradation::BLACKLISTED:
+    return "blacklisted";
+  default:
+    return "";
+  }
+}
+
 uint64_t Query::getPreviousEpoch() const {
   uint64_t epoch = 0;
   std::string raw;
@@ -366,6 +379,9 @@ inline void addLegacyFieldsAndDecorations(const QueryLogItem& item,
   doc.add("unixTime", item.time, obj);
   doc.add("epoch", static_cast<size_t>(item.epoch), obj);
   doc.add("counter", static_cast<size_t>(item.counter), obj);
+  if (!item.truncated.empty()) {
+    doc.addRef("truncated", item.truncated, obj);
+  }
 
   // Append the decorations.
   if (!item.decorations.empty()) {
@@ -396,6 +412,9 @@ inline void getLegacyFieldsAndDecorations(const JSON& doc, QueryLogItem& item) {
   item.identifier = doc.doc()["hostIdentifier"].GetString();
   item.calendar_time = doc.doc()["calendarTime"].GetString();
   item.time = doc.doc()["unixTime"].GetUint64();
+  if (doc.doc().HasMember("truncated") && doc.doc()["truncated"].IsString()) {
+    item.truncated = doc.doc()["truncated"].GetString();
+  }
 }
 
 Status serializeQueryLogItem(const QueryLogItem& item, JSON& doc) {
@@ -0,0 +1,52 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <osquery/logger.h>
+
+#include "osquery/core/metrics.h"
+#include "osquery/core/startup_profile.h"
+
+namespace osquery {
+
+StartupProfile& StartupProfile::get() {
+  static StartupProfile profile;
+  return profile;
+}
+
+void StartupProfile::record(const std::string& name,
+                            std::chrono::steady_clock::time_point start) {
+  using namespace std::chrono;
+
+  auto now = steady_clock::now();
+  StartupPhase phase;
+  phase.name = name;
+  phase.duration_us = duration_cast<microseconds>(now - start).count();
+  // A phase may not start before the profile, such as a static initializer.
+  if (start > start_) {
+    phase.offset_us = duration_cast<microseconds>(start - start_).count();
+  }
+
+  VLOG(1) << "Startup phase " << name << " took " << phase.duration_us
+          << " microseconds";
+  Metrics::get()
+      .gauge("osquery_startup_phase_duration_us",
+             "Microseconds spent within an initialization phase",
+             {{"phase", name}})
+      .set(static_cast<int64_t>(phase.duration_us));
+
+  WriteLock lock(mutex_);
+  phases_.push_back(std::move(phase));
+}
+
+std::vector<StartupPhase> StartupProfile::phases() const {
+  ReadLock lock(mutex_);
+  return phases_;
+}
+} // namespace osquery
@@ -0,0 +1,82 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core.h>
+
+namespace osquery {
+
+/// The timing of a single initialization phase.
+struct StartupPhase {
+  /// The phase name, such as "database" or "config".
+  std::string name;
+
+  /// Microseconds between the start of initialization and the phase.
+  uint64_t offset_us{0};
+
+  /// Microseconds spent within the phase.
+  uint64_t duration_us{0};
+};
+
+/**
+ * @brief Timings of the initialization phases of this process.
+ *
+ * The Initializer records each phase of its start, the phases are read by
+ * the osquery_startup table. Phases are kept in the order they finished.
+ */
+class StartupProfile : private boost::noncopyable {
+ public:
+  /// Record the time spent within a scope as a phase.
+  class Phase : private boost::noncopyable {
+   public:
+    explicit Phase(const std::string& name)
+        : name_(name), start_(std::chrono::steady_clock::now()) {}
+
+    ~Phase() {
+      StartupProfile::get().record(name_, start_);
+    }
+
+   private:
+    std::string name_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+ public:
+  /// The profile is created when first used, the Initializer uses it early.
+  static StartupProfile& get();
+
+  /// Record a phase that started at a time and ends now.
+  void record(const std::string& name,
+              std::chrono::steady_clock::time_point start);
+
+  /// Every recorded phase.
+  std::vector<StartupPhase> phases() const;
+
+ private:
+  StartupProfile() : start_(std::chrono::steady_clock::now()) {}
+
+ private:
+  /// The time of the first use.
+  std::chrono::steady_clock::time_point start_;
+
+  std::vector<StartupPhase> phases_;
+
+  /// Phases may be recorded from several threads.
+  mutable Mutex mutex_;
+};
+} // namespace osquery
@@ -69,6 +69,15 @@ void TablePlugin::setRequestFromContext(const QueryContext& context,
   }
 
   doc.add("constraints", constraints);
+
+  // Extensions may also skip the columns the query does not use.
+  if (context.colsUsed) {
+    auto columns = doc.getArray();
+    for (const auto& column : *context.colsUsed) {
+      doc.pushCopy(column, columns);
+    }
+    doc.add("colsUsed", columns);
+  }
   doc.toString(request["context"]);
 }
 
@@ -86,6 +95,26 @@ void TablePlugin::setContextFromRequest(const PluginRequest& request,
     auto column_name = constraint["name"].GetString();
     context.constraints[column_name].deserialize(constraint);
   }
+
+  if (doc.doc().HasMember("colsUsed") && doc.doc()["colsUsed"].IsArray()) {
+    UsedColumns columns;
+    for (const auto& column : doc.doc()["colsUsed"].GetArray()) {
+      if (column.IsString()) {
+        columns.insert(column.GetString());
+      }
+    }
+    context.colsUsed = std::move(columns);
+  }
+}
+
+QueryData TablePlugin::generate(QueryContext& context) {
+  if (!usesGenerator()) {
+    return QueryData();
+  }
+
+  return collectRows(
+      [this](RowYield& yield, QueryContext& ctx) { generator(yield, ctx); },
+      context);
 }
 
 Status TablePlugin::call(const PluginRequest& request,
@@ -166,6 +195,12 @@ static bool cacheAllowed(const TableColumns& cols, const QueryContext& ctx) {
     if (opts && ctx.constraints.at(std::get<0>(column)).exists()) {
       return false;
     }
+
+    // The results may not include the columns the query did not use.
+    if ((std::get<2>(column) & ColumnOptions::HIDDEN) == 0 &&
+        !ctx.isColumnUsed(std::get<0>(column))) {
+      return false;
+    }
   }
   return true;
 }
@@ -206,6 +241,17 @@ void TablePlugin::setCache(size_t step,
   }
 }
 
+QueryData collectRows(const TableGenerator& generator, QueryContext& context) {
+  QueryData results;
+  RowGenerator::pull_type rows(
+      [&generator, &context](RowYield& yield) { generator(yield, context); });
+  for (const auto& row : rows) {
+    // A generator may change and yield the same row again.
+    results.push_back(row);
+  }
+  return results;
+}
+
 std::string columnDefinition(const TableColumns& columns) {
   std::map<std::string, bool> epilog;
   bool indexed = false;
@@ -415,6 +461,19 @@ bool QueryContext::useCache() const {
   return use_cache_;
 }
 
+void QueryContext::setDeadline(std::chrono::steady_clock::time_point deadline) {
+  deadline_ = deadline;
+}
+
+std::chrono::steady_clock::time_point QueryContext::deadline() const {
+  return deadline_;
+}
+
+bool QueryContext::expired() const {
+  return deadline_ != std::chrono::steady_clock::time_point::max() &&
+         std::chrono::steady_clock::now() >= deadline_;
+}
+
 void QueryContext::setCache(const std::string& index, Row _cache) {
   table_->cache[index] = std::move(_cache);
 }
@@ -446,6 +505,20 @@ bool QueryContext::hasConstraint(const std::string& column,
   return constraints.at(column).exists(op);
 }
 
+bool QueryContext::isColumnUsed(const std::string& column) const {
+  return !colsUsed || colsUsed->count(column) > 0;
+}
+
+bool QueryContext::isAnyColumnUsed(
+    std::initializer_list<std::string> columns) const {
+  for (const auto& column : columns) {
+    if (isColumnUsed(column)) {
+      return true;
+    }
+  }
+  return false;
+}
+
 Status QueryContext::expandConstraints(
     const std::string& column,
     ConstraintOperator op,
@@ -0,0 +1,126 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "osquery/core/metrics.h"
+
+namespace osquery {
+
+class MetricsTests : public testing::Test {};
+
+TEST_F(MetricsTests, test_counter) {
+  auto& counter = Metrics::get().counter("test_counter_total", "help");
+  EXPECT_EQ(0U, counter.value());
+
+  // Each thread increments its own shard.
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < 4; i++) {
+    threads.emplace_back([&counter]() {
+      for (size_t j = 0; j < 1000; j++) {
+        counter.increment();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(4000U, counter.value());
+
+  // The same name and labels return the same metric.
+  auto& same = Metrics::get().counter("test_counter_total", "help");
+  EXPECT_EQ(&counter, &same);
+  auto& other =
+      Metrics::get().counter("test_counter_total", "help", {{"a", "b"}});
+  EXPECT_NE(&counter, &other);
+}
+
+TEST_F(MetricsTests, test_counter_family) {
+  MetricCounterFamily family(
+      "test_family_total", "help", "result", {"hit", "miss"});
+  family.get("hit").increment();
+  family.get("miss").increment(2);
+
+  // Each value is a labeled counter in the registry.
+  auto& hit = Metrics::get().counter(
+      "test_family_total", "help", {{"result", "hit"}});
+  EXPECT_EQ(&family.get("hit"), &hit);
+  EXPECT_EQ(1U, hit.value());
+  EXPECT_EQ(2U, family.get("miss").value());
+  EXPECT_THROW(family.get("other"), std::out_of_range);
+}
+
+TEST_F(MetricsTests, test_histogram_buckets) {
+  // Small values have a bucket each.
+  for (size_t i = 0; i < 16; i++) {
+    EXPECT_EQ(i, MetricHistogram::getBucket(i));
+    EXPECT_EQ(i, MetricHistogram::getBucketValue(i));
+  }
+
+  // Larger values share a bucket with values within 12.5%.
+  EXPECT_EQ(MetricHistogram::getBucket(1000), MetricHistogram::getBucket(1023));
+  EXPECT_NE(MetricHistogram::getBucket(1023), MetricHistogram::getBucket(1024));
+  EXPECT_EQ(1023U,
+            MetricHistogram::getBucketValue(MetricHistogram::getBucket(1000)));
+
+  // Every value is counted in a bucket that includes it.
+  for (uint64_t value = 1; value < (uint64_t(1) << 41); value = value * 3 + 1) {
+    auto bucket = MetricHistogram::getBucket(value);
+    EXPECT_GE(MetricHistogram::getBucketValue(bucket), value);
+    EXPECT_LT(bucket, MetricHistogram::kBuckets);
+  }
+  EXPECT_EQ(MetricHistogram::kBuckets - 1,
+            MetricHistogram::getBucket(static_cast<uint64_t>(-1)));
+}
+
+TEST_F(MetricsTests, test_histogram_quantiles) {
+  auto& histogram = Metrics::get().histogram("test_histogram_us", "help");
+  for (uint64_t i = 1; i <= 100; i++) {
+    histogram.record(i);
+  }
+
+  auto snapshot = histogram.snapshot();
+  EXPECT_EQ(100U, snapshot.count);
+  EXPECT_EQ(5050U, snapshot.sum);
+  EXPECT_EQ(51U, snapshot.quantile(0.5));
+  EXPECT_EQ(95U, snapshot.quantile(0.9));
+  EXPECT_EQ(103U, snapshot.quantile(0.99));
+}
+
+TEST_F(MetricsTests, test_text) {
+  Metrics::get()
+      .gauge("test_text_depth", "Queue depth", {{"queue", "a\"b"}})
+      .set(7);
+
+  // Collectors outlive the test, they may not reference the stack.
+  auto collected = std::make_shared<bool>(false);
+  Metrics::get().addCollector([collected]() { *collected = true; });
+
+  auto text = Metrics::get().toText();
+  EXPECT_TRUE(*collected);
+  EXPECT_NE(std::string::npos,
+            text.find("# HELP test_text_depth Queue depth\n"));
+  EXPECT_NE(std::string::npos, text.find("# TYPE test_text_depth gauge\n"));
+  EXPECT_NE(std::string::npos,
+            text.find("test_text_depth{queue=\"a\\\"b\"} 7\n"));
+
+  Metrics::get().histogram("test_text_us", "Latency").record(3);
+  text = Metrics::get().toText();
+  EXPECT_NE(std::string::npos, text.find("# TYPE test_text_us summary\n"));
+  EXPECT_NE(std::string::npos, text.find("test_text_us{quantile=\"0.5\"} 3\n"));
+  EXPECT_NE(std::string::npos, text.find("test_text_us_sum 3\n"));
+  EXPECT_NE(std::string::npos, text.find("test_text_us_count 1\n"));
+}
+} // namespace osquery
@@ -105,6 +105,72 @@ TEST_F(ProcessTests, test_getpid) {
   EXPECT_EQ(process->pid(), pid);
 }
 
+TEST_F(ProcessTests, test_thread_resource_usage) {
+  ResourceUsage r0;
+  ASSERT_TRUE(getThreadResourceUsage(r0).ok());
+  EXPECT_GT(r0.resident_size + r0.peak_resident_size, 0U);
+
+  // Spend some CPU time in this thread.
+  volatile size_t sum = 0;
+  for (size_t i = 0; i < 100000000; ++i) {
+    sum += i;
+  }
+
+  ResourceUsage r1;
+  ASSERT_TRUE(getThreadResourceUsage(r1).ok());
+  EXPECT_GE(r1.user_time, r0.user_time);
+  EXPECT_GT(r1.user_time + r1.system_time, r0.user_time + r0.system_time);
+  EXPECT_GE(r1.peak_resident_size, r0.peak_resident_size);
+}
+
+#if defined(__linux__) || defined(WIN32)
+TEST_F(ProcessTests, test_thread_resource_charge) {
+  auto charge = getThreadResourceCharge();
+  auto charged = charge->user_time + charge->system_time;
+  ResourceUsage r0;
+  ASSERT_TRUE(getThreadResourceUsage(r0).ok());
+
+  // A helper thread charges its CPU time to this thread.
+  std::thread helper([charge]() {
+    ScopedResourceCharge scope(charge);
+    volatile size_t sum = 0;
+    for (size_t i = 0; i < 100000000; ++i) {
+      sum += i;
+    }
+  });
+  helper.join();
+
+  ResourceUsage r1;
+  ASSERT_TRUE(getThreadResourceUsage(r1).ok());
+  charged = charge->user_time + charge->system_time - charged;
+  EXPECT_GT(charged, 0U);
+  EXPECT_GE(r1.user_time + r1.system_time,
+            r0.user_time + r0.system_time + charged);
+
+  // Charging the calling thread itself does not count its time twice.
+  auto before = charge->user_time + charge->system_time;
+  {
+    ScopedResourceCharge scope(charge);
+    volatile size_t sum = 0;
+    for (size_t i = 0; i < 100000000; ++i) {
+      sum += i;
+    }
+  }
+  EXPECT_EQ(before, charge->user_time + charge->system_time);
+}
+#endif
+
+#ifdef __linux__
+TEST_F(ProcessTests, test_process_resource_usage) {
+  ResourceUsage usage;
+  ASSERT_TRUE(getProcessResourceUsage(getpid(), usage).ok());
+  EXPECT_EQ(getppid(), usage.parent);
+  EXPECT_GT(usage.resident_size, 0U);
+
+  EXPECT_FALSE(getProcessResourceUsage(-1, usage).ok());
+}
+#endif
+
 TEST_F(ProcessTests, test_envVar) {
   auto val = getEnvVar("GTEST_OSQUERY");
   EXPECT_FALSE(val);
@@ -0,0 +1,44 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <gtest/gtest.h>
+
+#include "osquery/core/metrics.h"
+#include "osquery/core/startup_profile.h"
+
+namespace osquery {
+
+class StartupProfileTests : public testing::Test {};
+
+TEST_F(StartupProfileTests, test_phases) {
+  auto& profile = StartupProfile::get();
+  auto before = profile.phases().size();
+
+  { StartupProfile::Phase phase("test_first"); }
+  { StartupProfile::Phase phase("test_second"); }
+
+  // Phases are kept in the order they finished.
+  auto phases = profile.phases();
+  ASSERT_EQ(before + 2, phases.size());
+  EXPECT_EQ("test_first", phases[before].name);
+  EXPECT_EQ("test_second", phases[before + 1].name);
+  EXPECT_LE(phases[before].offset_us, phases[before + 1].offset_us);
+
+  // Each phase duration is also a metric.
+  bool found = false;
+  for (const auto& sample : Metrics::get().samples()) {
+    if (sample.name == "osquery_startup_phase_duration_us" &&
+        sample.labels == "phase=\"test_first\"") {
+      found = true;
+    }
+  }
+  EXPECT_TRUE(found);
+}
+} // namespace osquery
@@ -154,6 +154,26 @@ class TestTablePlugin : public TablePlugin {
   }
 };
 
+TEST_F(TablesTests, test_columns_used) {
+  // Without the query plan every column is used.
+  QueryContext ctx;
+  EXPECT_TRUE(ctx.isColumnUsed("path"));
+
+  ctx.colsUsed = UsedColumns({"path", "md5"});
+  EXPECT_TRUE(ctx.isColumnUsed("md5"));
+  EXPECT_FALSE(ctx.isColumnUsed("sha1"));
+  EXPECT_TRUE(ctx.isAnyColumnUsed({"sha1", "path"}));
+  EXPECT_FALSE(ctx.isAnyColumnUsed({"sha1", "sha256"}));
+
+  // Extensions receive the used columns with the constraints.
+  PluginRequest request;
+  TablePlugin::setRequestFromContext(ctx, request);
+  QueryContext extension_ctx;
+  TablePlugin::setContextFromRequest(request, extension_ctx);
+  ASSERT_TRUE(extension_ctx.colsUsed.is_initialized());
+  EXPECT_EQ(*extension_ctx.colsUsed, *ctx.colsUsed);
+}
+
 TEST_F(TablesTests, test_caching) {
   TestTablePlugin test;
   // By default the interval and step is 0, so a step of 5 will not be cached.
@@ -8,6 +8,10 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <fstream>
+
+#include <boost/filesystem.hpp>
+
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
@@ -19,6 +23,8 @@
 
 using namespace testing;
 
+namespace fs = boost::filesystem;
+
 namespace osquery {
 
 DECLARE_uint64(watchdog_delay);
@@ -306,4 +312,114 @@ TEST_F(WatcherTests, test_watcherrunner_unhealthy_delay) {
 
   FLAGS_watchdog_delay = delay;
 }
+
+/// Emulate a cgroup interface file, written by the kernel.
+static void writeCGroupFile(const fs::path& path, const std::string& content) {
+  std::ofstream fd(path.string(), std::ios::out | std::ios::trunc);
+  fd << content;
+}
+
+static std::string readCGroupFile(const fs::path& path) {
+  std::ifstream fd(path.string(), std::ios::in);
+  return std::string(std::istreambuf_iterator<char>(fd),
+                     std::istreambuf_iterator<char>());
+}
+
+class FakeCGroupWatcherRunner : public FakeWatcherRunner {
+ public:
+  FakeCGroupWatcherRunner(int argc, char** argv, bool use_worker)
+      : FakeWatcherRunner(argc, argv, use_worker) {}
+
+  /// The tests record the response level instead of signaling.
+  void signalPressure(const PlatformProcess& child,
+                      WatchdogPressure pressure) const override {
+    pressure_ = pressure;
+  }
+
+  mutable WatchdogPressure pressure_{WatchdogPressure::NONE};
+};
+
+TEST_F(WatcherTests, test_watcherrunner_cgroup) {
+  // A plain directory stands in for a delegated cgroupfs subtree.
+  auto cgroup_path = fs::path(kTestWorkingDirectory) / "watchdog-cgroup";
+  fs::remove_all(cgroup_path);
+
+  FakeCGroupWatcherRunner runner(0, nullptr, true);
+  runner.cgroup_ = std::make_unique<WatchdogCGroup>(cgroup_path.string());
+  ASSERT_TRUE(runner.cgroup_->create().ok());
+  EXPECT_EQ("+cpu +memory",
+            readCGroupFile(cgroup_path / "cgroup.subtree_control"));
+
+  // The test process stands in for the worker.
+  auto& watcher = Watcher::get();
+  auto test_process = PlatformProcess::getCurrentProcess();
+  watcher.setWorker(test_process);
+  watcher.resetWorkerCounters(0);
+  ASSERT_TRUE(runner.cgroup_->attach("worker", test_process->pid()).ok());
+  EXPECT_TRUE(runner.cgroup_->contains("worker", test_process->pid()));
+
+  auto worker_path = cgroup_path / "worker";
+  EXPECT_EQ("max 100000", readCGroupFile(worker_path / "cpu.max"));
+
+  writeCGroupFile(worker_path / "memory.current", "1000\n");
+  writeCGroupFile(worker_path / "cpu.stat",
+                  "usage_usec 2000000\nuser_usec 1000000\n"
+                  "system_usec 1000000\nthrottled_usec 0\n");
+
+  auto delay = FLAGS_watchdog_delay;
+  FLAGS_watchdog_delay = 0;
+
+  // The accounting is read from the leaf.
+  EXPECT_TRUE(runner.isChildSane(*test_process));
+  auto& state = watcher.getState(*test_process);
+  auto iv = std::max(getWorkerLimit(WatchdogLimitType::INTERVAL), 1_sz);
+  EXPECT_EQ(1000U, state.initial_footprint);
+  EXPECT_EQ(100U / iv, state.user_time);
+  EXPECT_EQ(0U, state.pressure);
+
+  // Exceed the memory limit, each check applies the next response.
+  auto limit = getWorkerLimit(WatchdogLimitType::MEMORY_LIMIT) * 1024 * 1024;
+  writeCGroupFile(worker_path / "memory.current",
+                  std::to_string(limit + limit / 2));
+  EXPECT_TRUE(runner.isChildSane(*test_process));
+  EXPECT_EQ(1U, state.pressure);
+  EXPECT_EQ(WatchdogPressure::THROTTLE, runner.pressure_);
+
+  auto quota = getWorkerLimit(WatchdogLimitType::UTILIZATION_LIMIT) * 1000;
+  EXPECT_EQ(std::to_string(quota) + " 100000",
+            readCGroupFile(worker_path / "cpu.max"));
+
+  EXPECT_TRUE(runner.isChildSane(*test_process));
+  EXPECT_EQ(WatchdogPressure::PAUSE_SCHEDULE, runner.pressure_);
+  EXPECT_TRUE(runner.isChildSane(*test_process));
+  EXPECT_EQ(WatchdogPressure::SHED_EVENTS, runner.pressure_);
+
+  // Every response was applied, the worker should be stopped.
+  EXPECT_FALSE(runner.isChildSane(*test_process));
+  EXPECT_EQ(3U, state.pressure);
+
+  // A latency limit of sane intervals steps down one level.
+  writeCGroupFile(worker_path / "memory.current", "1000\n");
+  auto latency = getWorkerLimit(WatchdogLimitType::LATENCY_LIMIT);
+  auto intervals = std::max((latency + iv - 1) / iv, 1_sz);
+  for (size_t i = 1; i < intervals; i++) {
+    EXPECT_TRUE(runner.isChildSane(*test_process));
+    EXPECT_EQ(3U, state.pressure);
+  }
+  EXPECT_TRUE(runner.isChildSane(*test_process));
+  EXPECT_EQ(2U, state.pressure);
+  EXPECT_EQ(WatchdogPressure::PAUSE_SCHEDULE, runner.pressure_);
+  EXPECT_EQ(std::to_string(quota) + " 100000",
+            readCGroupFile(worker_path / "cpu.max"));
+
+  // Memory far beyond the limit stops the worker without a response.
+  writeCGroupFile(worker_path / "memory.current", std::to_string(limit * 3));
+  EXPECT_FALSE(runner.isChildSane(*test_process));
+  EXPECT_EQ(2U, state.pressure);
+
+  FLAGS_watchdog_delay = delay;
+  watcher.setWorker(std::make_shared<PlatformProcess>());
+  watcher.resetWorkerCounters(0);
+  fs::remove_all(cgroup_path);
+}
 } // namespace osquery
@@ -94,12 +94,36 @@ CLI_FLAG(bool,
 
 CLI_FLAG(bool, disable_watchdog, false, "Disable userland watchdog process");
 
+CLI_FLAG(bool,
+         watchdog_cgroup,
+         false,
+         "Place the worker and extensions in a cgroup v2 subtree (Linux)");
+
+CLI_FLAG(string,
+         watchdog_cgroup_path,
+         "",
+         "cgroup v2 directory for the watchdog subtree (default the watcher's)");
+
+/// The cgroup leaf name of the worker process.
+const std::string kWorkerLeaf{"worker"};
+
+/// The graduated response level applied to this process by a watcher.
+static std::atomic<int> kWorkerPressure{0};
+
+#ifdef __linux__
+static void pressureHandler(int /* num */, siginfo_t* info, void* /* ctx */) {
+  kWorkerPressure = info->si_value.sival_int;
+}
+#endif
+
 void Watcher::resetWorkerCounters(size_t respawn_time) {
   // Reset the monitoring counters for the watcher.
   state_.sustained_latency = 0;
   state_.user_time = 0;
   state_.system_time = 0;
   state_.last_respawn_time = respawn_time;
+  state_.pressure = 0;
+  state_.relaxed = 0;
 }
 
 void Watcher::resetExtensionCounters(const std::string& extension,
@@ -110,6 +134,8 @@ void Watcher::resetExtensionCounters(const std::string& extension,
   state.user_time = 0;
   state.system_time = 0;
   state.last_respawn_time = respawn_time;
+  state.pressure = 0;
+  state.relaxed = 0;
 }
 
 std::string Watcher::getExtensionPath(const PlatformProcess& child) {
@@ -197,6 +223,7 @@ void WatcherRunner::start() {
   // Set worker performance counters to an initial state.
   watcher.resetWorkerCounters(0);
   PerformanceState watcher_state;
+  setupCGroup();
 
   // Enter the watch loop.
   do {
@@ -439,11 +466,125 @@ QueryData WatcherRunner::getProcessRow(pid_t pid) const {
 #ifdef WIN32
   p = (pid == ULONG_MAX) ? -1 : pid;
 #endif
+
+  // Prefer sampling the process directly, the processes table generates a
+  // complete row including several reads per process.
+  ResourceUsage usage;
+  if (getProcessResourceUsage(p, usage).ok()) {
+    // The utilization limit is in hundredths of a CPU second per second, the
+    // clock tick unit of the Linux processes table.
+    Row r;
+    r["parent"] = INTEGER(usage.parent);
+    r["user_time"] = BIGINT(usage.user_time / 10);
+    r["system_time"] = BIGINT(usage.system_time / 10);
+    r["resident_size"] = BIGINT(usage.resident_size);
+    return {r};
+  }
   return SQL::selectAllFrom("processes", "pid", EQUALS, INTEGER(p));
 }
 
+QueryData WatcherRunner::getCGroupRow(const std::string& leaf,
+                                     pid_t pid) const {
+  // A child that is not in its leaf is not accounted by the cgroup.
+  CGroupUsage usage;
+  if (!cgroup_->contains(leaf, pid) || !cgroup_->sample(leaf, usage).ok()) {
+    return {};
+  }
+
+  // Report the CPU time in hundredths of a second, as the processes table.
+  Row r;
+  r["parent"] = INTEGER(PlatformProcess::getCurrentProcess()->pid());
+  r["user_time"] = BIGINT(usage.user_usec / 10000);
+  r["system_time"] = BIGINT(usage.system_usec / 10000);
+  r["resident_size"] = BIGINT(usage.memory);
+  return {r};
+}
+
+std::string WatcherRunner::getLeaf(const PlatformProcess& child) const {
+  auto& watcher = Watcher::get();
+  if (child == watcher.getWorker()) {
+    return kWorkerLeaf;
+  }
+  return WatchdogCGroup::getLeaf(watcher.getExtensionPath(child));
+}
+
+Status WatcherRunner::respond(const PlatformProcess& child,
+                              PerformanceState& state,
+                              const PerformanceChange& change,
+                              const Status& status) const {
+  // Only the worker runs a schedule and event subscribers.
+  auto is_worker = (child == Watcher::get().getWorker());
+  auto max_pressure = (is_worker) ? WatchdogPressure::SHED_EVENTS
+                                  : WatchdogPressure::THROTTLE;
+
+  auto apply = [this, &child, &state, is_worker]() {
+    auto percent = (state.pressure > 0)
+                       ? getWorkerLimit(WatchdogLimitType::UTILIZATION_LIMIT)
+                       : 0;
+    cgroup_->throttle(getLeaf(child), percent);
+    if (is_worker) {
+      signalPressure(child, static_cast<WatchdogPressure>(state.pressure));
+    }
+  };
+
+  if (status.ok()) {
+    // Step down one level after a latency limit of sane intervals.
+    if (state.pressure > 0 &&
+        ++state.relaxed * change.iv >=
+            getWorkerLimit(WatchdogLimitType::LATENCY_LIMIT)) {
+      state.relaxed = 0;
+      state.pressure--;
+      apply();
+    }
+    return status;
+  }
+  state.relaxed = 0;
+
+  // A delayed watchdog does not apply responses, as it does not stop a child.
+  if (getUnixTime() < delayedTime()) {
+    return status;
+  }
+
+  // Memory growing far beyond the limit is not given time to recover.
+  auto memory_limit = getWorkerLimit(WatchdogLimitType::MEMORY_LIMIT);
+  if (state.pressure >= static_cast<size_t>(max_pressure) ||
+      change.footprint > 2 * memory_limit * 1024 * 1024) {
+    return status;
+  }
+
+  // Each level is given a latency limit to take effect.
+  state.pressure++;
+  state.sustained_latency = 0;
+  apply();
+
+  std::stringstream warning;
+  warning << "osquery watchdog applying response level " << state.pressure
+          << " to child (" << child.pid() << "): " << status.getMessage();
+  systemLog(warning.str());
+  LOG(WARNING) << warning.str();
+  return Status(0);
+}
+
+void WatcherRunner::signalPressure(const PlatformProcess& child,
+                                   WatchdogPressure pressure) const {
+#ifdef __linux__
+  union sigval value;
+  value.sival_int = static_cast<int>(pressure);
+  ::sigqueue(child.pid(), SIGRTMIN, value);
+#endif
+}
+
 Status WatcherRunner::isChildSane(const PlatformProcess& child) const {
-  auto rows = getProcessRow(child.pid());
+  QueryData rows;
+  if (cgroup_ != nullptr) {
+    WatcherExtensionsLocker locker;
+    rows = getCGroupRow(getLeaf(child), child.pid());
+  }
+
+  if (rows.empty()) {
+    rows = getProcessRow(child.pid());
+  }
+
   if (rows.size() == 0) {
     // Could not find worker process?
     return Status(1, "Cannot find process");
@@ -465,16 +606,25 @@ Status WatcherRunner::isChildSane(const PlatformProcess& child) const {
     return Status(0);
   }
 
+  Status status;
   if (exceededCyclesLimit(change)) {
-    return Status(1,
-                  "Maximum sustainable CPU utilization limit exceeded: " +
-                      std::to_string(change.sustained_latency * change.iv));
+    status = Status(1,
+                    "Maximum sustainable CPU utilization limit exceeded: " +
+                        std::to_string(change.sustained_latency * change.iv));
+  } else if (exceededMemoryLimit(change)) {
+    // Check if the private memory exceeds a memory limit.
+    status = Status(
+        1, "Memory limits exceeded: " + std::to_string(change.footprint));
   }
 
-  // Check if the private memory exceeds a memory limit.
-  if (exceededMemoryLimit(change)) {
-    return Status(
-        1, "Memory limits exceeded: " + std::to_string(change.footprint));
+  // A cgroup allows graduated responses before the child is stopped.
+  if (cgroup_ != nullptr) {
+    WatcherExtensionsLocker locker;
+    status = respond(child, Watcher::get().getState(child), change, status);
+  }
+
+  if (!status.ok()) {
+    return status;
   }
 
   // The worker is sane, no action needed.
@@ -544,6 +694,13 @@ void WatcherRunner::createWorker() {
     return;
   }
 
+  if (cgroup_ != nullptr) {
+    auto status = cgroup_->attach(kWorkerLeaf, worker->pid());
+    if (!status.ok()) {
+      LOG(WARNING) << "Cannot place worker in cgroup: " << status.getMessage();
+    }
+  }
+
   watcher.setWorker(worker);
   watcher.resetWorkerCounters(getUnixTime());
   VLOG(1) << "osqueryd watcher (" << PlatformProcess::getCurrentProcess()->pid()
@@ -586,12 +743,47 @@ void WatcherRunner::createExtension(const std::string& extension) {
     Initializer::shutdown(EXIT_FAILURE);
   }
 
+  if (cgroup_ != nullptr) {
+    auto status =
+        cgroup_->attach(WatchdogCGroup::getLeaf(extension), ext_process->pid());
+    if (!status.ok()) {
+      LOG(WARNING) << "Cannot place extension in cgroup: "
+                   << status.getMessage();
+    }
+  }
+
   watcher.setExtension(extension, ext_process);
   watcher.resetExtensionCounters(extension, getUnixTime());
   VLOG(1) << "Created and monitoring extension child (" << ext_process->pid()
           << "): " << extension;
 }
 
+void WatcherRunner::setupCGroup() {
+  if (!FLAGS_watchdog_cgroup || !isPlatform(PlatformType::TYPE_LINUX)) {
+    return;
+  }
+
+  auto path = FLAGS_watchdog_cgroup_path;
+  if (path.empty()) {
+    auto status = WatchdogCGroup::getProcessPath(path);
+    if (!status.ok()) {
+      LOG(WARNING) << "Cannot use a watchdog cgroup: " << status.getMessage();
+      return;
+    }
+  }
+
+  // Controllers can only be enabled in a delegated (writable) subtree.
+  auto cgroup = std::make_unique<WatchdogCGroup>(path);
+  auto status = cgroup->create();
+  if (!status.ok()) {
+    LOG(WARNING) << "Cannot use a watchdog cgroup: " << status.getMessage();
+    return;
+  }
+
+  VLOG(1) << "osqueryd watcher using cgroup: " << path;
+  cgroup_ = std::move(cgroup);
+}
+
 void WatcherWatcherRunner::start() {
   while (!interrupted()) {
     if (isLauncherProcessDead(*watcher_)) {
@@ -633,4 +825,24 @@ size_t getWorkerLimit(WatchdogLimitType name) {
   }
   return kWatchdogLimits.at(name).normal;
 }
+
+void initWorkerPressure() {
+#ifdef __linux__
+  // The watcher queues the response level with a real-time signal.
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = pressureHandler;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGRTMIN, &action, nullptr);
+#endif
+}
+
+WatchdogPressure getWorkerPressure() {
+  return static_cast<WatchdogPressure>(kWorkerPressure.load());
+}
+
+void setWorkerPressure(WatchdogPressure pressure) {
+  kWorkerPressure = static_cast<int>(pressure);
+}
 } // namespace osquery
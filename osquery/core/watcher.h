@@ -23,6 +23,7 @@
 #include <osquery/dispatcher.h>
 #include <osquery/flags.h>
 
+#include "osquery/core/cgroup.h"
 #include "osquery/core/process.h"
 
 namespace osquery {
@@ -33,6 +34,7 @@ DECLARE_bool(disable_watchdog);
 DECLARE_int32(watchdog_level);
 
 class WatcherRunner;
+struct PerformanceChange;
 
 /**
  * @brief Categories of process performance limitations.
@@ -51,6 +53,20 @@ enum class WatchdogLimitType {
   INTERVAL,
 };
 
+/**
+ * @brief Graduated responses applied before a worker is stopped.
+ *
+ * When the watchdog manages a cgroup v2 subtree, a worker exceeding its limits
+ * is first throttled with cpu.max, then asked to pause the schedule, then asked
+ * to drop new events. Each level applies the previous levels as well.
+ */
+enum class WatchdogPressure {
+  NONE = 0,
+  THROTTLE = 1,
+  PAUSE_SCHEDULE = 2,
+  SHED_EVENTS = 3,
+};
+
 /**
  * @brief A performance state structure for an autoloaded extension or worker.
  *
@@ -70,12 +86,20 @@ struct PerformanceState {
   /// The initial (or as close as possible) process image footprint.
   size_t initial_footprint;
 
+  /// The graduated response level applied to the process.
+  size_t pressure;
+
+  /// A counter of how many intervals the process was sane under pressure.
+  size_t relaxed;
+
   PerformanceState() {
     sustained_latency = 0;
     user_time = 0;
     system_time = 0;
     last_respawn_time = 0;
     initial_footprint = 0;
+    pressure = 0;
+    relaxed = 0;
   }
 };
 
@@ -244,6 +268,7 @@ class Watcher : private boost::noncopyable {
 
  private:
   friend class WatcherRunner;
+  FRIEND_TEST(WatcherTests, test_watcherrunner_cgroup);
 };
 
 /**
@@ -310,9 +335,33 @@ class WatcherRunner : public InternalRunnable {
   virtual Status isWatcherHealthy(const PlatformProcess& watcher,
                                   PerformanceState& watcher_state) const;
 
-  /// Get row data from the processes table for a given pid.
+  /// Get resource usage for a given pid, formatted as a processes table row.
   virtual QueryData getProcessRow(pid_t pid) const;
 
+  /// Get resource usage for a cgroup leaf, formatted as a processes table row.
+  QueryData getCGroupRow(const std::string& leaf, pid_t pid) const;
+
+  /// The cgroup leaf name of a worker or extension.
+  std::string getLeaf(const PlatformProcess& child) const;
+
+  /**
+   * @brief Apply a graduated response to a child exceeding its limits.
+   *
+   * @param child The worker or extension.
+   * @param state The child's performance state.
+   * @param change The most recent performance change.
+   * @param status The result of the limit checks.
+   * @return A failed status if the child should be stopped.
+   */
+  Status respond(const PlatformProcess& child,
+                 PerformanceState& state,
+                 const PerformanceChange& change,
+                 const Status& status) const;
+
+  /// Inform the worker of the response level, the worker owns the schedule.
+  virtual void signalPressure(const PlatformProcess& child,
+                              WatchdogPressure pressure) const;
+
  private:
   /// Fork and execute a worker process.
   virtual void createWorker();
@@ -326,6 +375,9 @@ class WatcherRunner : public InternalRunnable {
   /// Return the time the watchdog is delayed until (from start of watcher).
   size_t delayedTime() const;
 
+  /// Create the cgroup v2 subtree for the worker and extensions if requested.
+  void setupCGroup();
+
  private:
   /// For testing only, ask the WatcherRunner to run a start loop once.
   void runOnce() {
@@ -348,6 +400,9 @@ class WatcherRunner : public InternalRunnable {
   /// Similarly to the uncontrolled worker restarted, count each extension.
   std::map<std::string, size_t> extension_restarts_;
 
+  /// The cgroup v2 subtree, if the watchdog manages one.
+  std::unique_ptr<WatchdogCGroup> cgroup_;
+
  private:
   FRIEND_TEST(WatcherTests, test_watcherrunner_watch);
   FRIEND_TEST(WatcherTests, test_watcherrunner_stop);
@@ -356,6 +411,7 @@ class WatcherRunner : public InternalRunnable {
   FRIEND_TEST(WatcherTests, test_watcherrunner_loop_disabled);
   FRIEND_TEST(WatcherTests, test_watcherrunner_watcherhealth);
   FRIEND_TEST(WatcherTests, test_watcherrunner_unhealthy_delay);
+  FRIEND_TEST(WatcherTests, test_watcherrunner_cgroup);
 };
 
 /// The WatcherWatcher is spawned within the worker and watches the watcher.
@@ -374,4 +430,13 @@ class WatcherWatcherRunner : public InternalRunnable {
 
 /// Get a performance limit by name and optional level.
 size_t getWorkerLimit(WatchdogLimitType limit);
+
+/// Accept graduated responses signaled by the watcher, called by the worker.
+void initWorkerPressure();
+
+/// The graduated response level the watcher applies to this worker.
+WatchdogPressure getWorkerPressure();
+
+/// Set the response level, used when the watcher signals the worker.
+void setWorkerPressure(WatchdogPressure pressure);
 }
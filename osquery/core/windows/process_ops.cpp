@@ -8,6 +8,8 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <psapi.h>
+
 #include "osquery/core/windows/process_ops.h"
 #include "osquery/core/conversions.h"
 
@@ -238,4 +240,60 @@ int platformGetPid() {
 int platformGetTid() {
   return static_cast<int>(GetCurrentThreadId());
 }
+
+/// FILETIME durations are in 100-nanosecond units.
+static uint64_t toMilliseconds(const FILETIME& ft) {
+  ULARGE_INTEGER value;
+  value.LowPart = ft.dwLowDateTime;
+  value.HighPart = ft.dwHighDateTime;
+  return value.QuadPart / 10000;
+}
+
+static Status getMemoryUsage(HANDLE process, ResourceUsage& usage) {
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(process, &counters, sizeof(counters))) {
+    return Status(1, "Cannot read process memory counters");
+  }
+  usage.resident_size = counters.WorkingSetSize;
+  usage.peak_resident_size = counters.PeakWorkingSetSize;
+  return Status(0);
+}
+
+ResourceChargeRef getThreadResourceCharge() {
+  static thread_local auto charge = std::make_shared<ResourceCharge>();
+  return charge;
+}
+
+ScopedResourceCharge::ScopedResourceCharge(ResourceChargeRef charge) {
+  if (charge != nullptr && charge != getThreadResourceCharge() &&
+      getThreadResourceUsage(start_).ok()) {
+    charge_ = std::move(charge);
+  }
+}
+
+ScopedResourceCharge::~ScopedResourceCharge() {
+  ResourceUsage end;
+  if (charge_ != nullptr && getThreadResourceUsage(end).ok()) {
+    charge_->user_time += end.user_time - start_.user_time;
+    charge_->system_time += end.system_time - start_.system_time;
+  }
+}
+
+Status getThreadResourceUsage(ResourceUsage& usage) {
+  FILETIME create, exit, kernel, user;
+  if (!GetThreadTimes(GetCurrentThread(), &create, &exit, &kernel, &user)) {
+    return Status(1, "Cannot read thread times");
+  }
+  const auto& charge = *getThreadResourceCharge();
+  usage.user_time = toMilliseconds(user) + charge.user_time;
+  usage.system_time = toMilliseconds(kernel) + charge.system_time;
+  return getMemoryUsage(GetCurrentProcess(), usage);
+}
+
+Status getProcessResourceUsage(int pid, ResourceUsage& usage) {
+  // The parent process is not available without a process snapshot.
+  (void)pid;
+  (void)usage;
+  return Status(1, "Not supported");
+}
 }
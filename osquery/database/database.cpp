@@ -13,6 +13,8 @@
 #include <osquery/logger.h>
 #include <osquery/registry.h>
 
+#include "osquery/sql/query_profile.h"
+
 namespace osquery {
 
 /// Generate a specific-use registry for database access abstraction.
@@ -34,9 +36,10 @@ const std::string kQueries = "queries";
 const std::string kEvents = "events";
 const std::string kCarves = "carves";
 const std::string kLogs = "logs";
+const std::string kHashes = "hashes";
 
 const std::vector<std::string> kDomains = {
-    kPersistentSettings, kQueries, kEvents, kLogs, kCarves};
+    kPersistentSettings, kQueries, kEvents, kLogs, kCarves, kHashes};
 
 std::atomic<bool> DatabasePlugin::kDBAllowOpen(false);
 std::atomic<bool> DatabasePlugin::kDBRequireWrite(false);
@@ -203,7 +206,11 @@ Status getDatabaseValue(const std::string& domain,
     throw std::runtime_error("Cannot get database value: " + key);
   } else {
     auto plugin = getDatabasePlugin();
-    return plugin->get(domain, key, value);
+    auto status = plugin->get(domain, key, value);
+    if (auto profile = QueryProfiler::current()) {
+      profile->database_read_bytes += value.size();
+    }
+    return status;
   }
 }
 
@@ -227,6 +234,9 @@ Status setDatabaseValue(const std::string& domain,
     throw std::runtime_error("Cannot set database value: " + key);
   } else {
     auto plugin = getDatabasePlugin();
+    if (auto profile = QueryProfiler::current()) {
+      profile->database_write_bytes += value.size();
+    }
     return plugin->put(domain, key, value);
   }
 }
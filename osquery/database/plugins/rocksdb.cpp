@@ -10,13 +10,17 @@
 
 #include <sys/stat.h>
 
+#include <mutex>
+
 #include <rocksdb/db.h>
 #include <rocksdb/env.h>
 #include <rocksdb/options.h>
 
 #include <osquery/filesystem.h>
 #include <osquery/logger.h>
+#include <osquery/registry.h>
 
+#include "osquery/core/metrics.h"
 #include "osquery/database/plugins/rocksdb.h"
 #include "osquery/filesystem/fileops.h"
 
@@ -118,6 +122,11 @@ Status RocksDBDatabasePlugin::setUp() {
       column_families_.push_back(
           rocksdb::ColumnFamilyDescriptor(cf_name, options_));
     }
+
+    static std::once_flag collector;
+    std::call_once(collector, []() {
+      Metrics::get().addCollector(&RocksDBDatabasePlugin::collectMetrics);
+    });
   }
 
   // Consume the current settings.
@@ -221,6 +230,45 @@ void RocksDBDatabasePlugin::repairDB() {
   LOG(WARNING) << "Destroying RocksDB database due to corruption";
 }
 
+void RocksDBDatabasePlugin::collectMetrics() {
+  auto& rf = RegistryFactory::get();
+  if (rf.getActive("database") != "rocksdb") {
+    return;
+  }
+
+  auto plugin = std::dynamic_pointer_cast<RocksDBDatabasePlugin>(
+      rf.plugin("database", "rocksdb"));
+  if (plugin == nullptr) {
+    return;
+  }
+
+  ReadLock lock(plugin->close_mutex_);
+  if (plugin->db_ == nullptr) {
+    return;
+  }
+
+  // Integer properties summed over every column family.
+  const std::vector<std::pair<std::string, std::string>> kProperties = {
+      {"rocksdb.estimate-num-keys", "osquery_rocksdb_estimated_keys"},
+      {"rocksdb.cur-size-all-mem-tables", "osquery_rocksdb_memtable_bytes"},
+      {"rocksdb.estimate-live-data-size", "osquery_rocksdb_live_data_bytes"},
+      {"rocksdb.num-running-compactions", "osquery_rocksdb_compactions"},
+  };
+
+  for (const auto& property : kProperties) {
+    uint64_t total = 0;
+    for (auto handle : plugin->handles_) {
+      uint64_t value = 0;
+      if (plugin->db_->GetIntProperty(handle, property.first, &value)) {
+        total += value;
+      }
+    }
+    Metrics::get()
+        .gauge(property.second, "RocksDB property " + property.first)
+        .set(static_cast<int64_t>(total));
+  }
+}
+
 rocksdb::DB* RocksDBDatabasePlugin::getDB() const {
   return db_;
 }
@@ -99,6 +99,9 @@ class RocksDBDatabasePlugin : public DatabasePlugin {
   /// Flush memtables and trigger compaction.
   void flush();
 
+  /// Export RocksDB properties of the active database plugin as gauges.
+  static void collectMetrics();
+
  private:
   /**
    * @brief Mark the RocksDB database as corrupted.
@@ -128,6 +128,27 @@ TEST_F(ResultsTests, test_serialize_query_log_item) {
   EXPECT_EQ(results.first.doc(), doc.doc());
 }
 
+TEST_F(ResultsTests, test_serialize_truncated_query_log_item) {
+  auto results = getSerializedQueryLogItem();
+  auto doc = JSON::newObject();
+  ASSERT_TRUE(serializeQueryLogItem(results.second, doc).ok());
+  EXPECT_FALSE(doc.doc().HasMember("truncated"));
+
+  // Results cut short by an output budget are marked.
+  results.second.truncated = "Query exceeded its row budget";
+  doc = JSON::newObject();
+  ASSERT_TRUE(serializeQueryLogItem(results.second, doc).ok());
+  ASSERT_TRUE(doc.doc().HasMember("truncated"));
+  EXPECT_EQ(std::string("Query exceeded its row budget"),
+            doc.doc()["truncated"].GetString());
+
+  std::string json;
+  ASSERT_TRUE(serializeQueryLogItemJSON(results.second, json).ok());
+  QueryLogItem output;
+  ASSERT_TRUE(deserializeQueryLogItemJSON(json, output).ok());
+  EXPECT_EQ(results.second.truncated, output.truncated);
+}
+
 TEST_F(ResultsTests, test_serialize_query_log_item_json) {
   auto results = getSerializedQueryLogItemJSON();
   std::string json;
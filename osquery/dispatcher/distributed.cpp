@@ -32,9 +32,9 @@ void DistributedRunner::start() {
   auto dist = Distributed();
   while (!interrupted()) {
     dist.pullUpdates();
-    if (dist.getPendingQueryCount() > 0) {
-      dist.runQueries();
-    }
+
+    // Results kept by an earlier run are flushed even without new queries.
+    dist.runQueries();
 
     std::string str_acu = "0";
     Status database = getDatabaseValue(
@@ -0,0 +1,246 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#ifndef WIN32
+#include <sys/stat.h>
+#endif
+
+#include <boost/filesystem.hpp>
+
+#include <osquery/logger.h>
+
+#include "osquery/core/metrics.h"
+#include "osquery/dispatcher/metrics_exporter.h"
+
+namespace asio = boost::asio;
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+FLAG(uint32,
+     metrics_port,
+     0,
+     "Serve internal metrics on this localhost TCP port (0 = disabled)");
+
+FLAG(string,
+     metrics_socket,
+     "",
+     "Serve internal metrics on this UNIX domain socket path");
+
+/// Largest accepted request header.
+const size_t kMetricsRequestMax{8192};
+
+/**
+ * @brief A single request and response, the connection is closed afterwards.
+ *
+ * A client that does not finish within the timeout is disconnected, so idle
+ * connections do not hold sessions open.
+ */
+template <typename Socket>
+class MetricsSession
+    : public std::enable_shared_from_this<MetricsSession<Socket>> {
+ public:
+  MetricsSession(asio::io_service& io_service, size_t timeout)
+      : socket_(io_service),
+        timer_(io_service),
+        timeout_(timeout),
+        request_(kMetricsRequestMax) {}
+
+  Socket& socket() {
+    return socket_;
+  }
+
+  void start() {
+    auto self = this->shared_from_this();
+    timer_.expires_from_now(boost::posix_time::milliseconds(timeout_));
+    timer_.async_wait([self](const boost::system::error_code& ec) {
+      if (ec != asio::error::operation_aborted) {
+        // Closing the socket cancels the pending read or write.
+        boost::system::error_code ignored;
+        self->socket_.close(ignored);
+      }
+    });
+
+    asio::async_read_until(
+        socket_,
+        request_,
+        "\r\n\r\n",
+        [self](const boost::system::error_code& ec, size_t /* length */) {
+          if (!ec) {
+            self->respond();
+          } else {
+            boost::system::error_code ignored;
+            self->timer_.cancel(ignored);
+          }
+        });
+  }
+
+ private:
+  void respond() {
+    auto body = Metrics::get().toText();
+    response_ = "HTTP/1.1 200 OK\r\n";
+    response_ += "Content-Type: text/plain; version=0.0.4\r\n";
+    response_ += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    response_ += "Connection: close\r\n\r\n";
+    response_ += body;
+
+    auto self = this->shared_from_this();
+    asio::async_write(
+        socket_,
+        asio::buffer(response_),
+        [self](const boost::system::error_code& /* ec */, size_t /* length */) {
+          boost::system::error_code ignored;
+          self->timer_.cancel(ignored);
+          self->socket_.close(ignored);
+        });
+  }
+
+ private:
+  Socket socket_;
+  asio::deadline_timer timer_;
+  size_t timeout_;
+  asio::streambuf request_;
+  std::string response_;
+};
+
+MetricsExporterRunner::MetricsExporterRunner(size_t request_timeout)
+    : InternalRunnable("MetricsExporterRunner"),
+      request_timeout_(request_timeout),
+      tcp_acceptor_(io_service_)
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+      ,
+      local_acceptor_(io_service_)
+#endif
+{
+}
+
+Status MetricsExporterRunner::listen(unsigned short port) {
+  asio::ip::tcp::endpoint endpoint(asio::ip::address_v4::loopback(), port);
+
+  boost::system::error_code ec;
+  tcp_acceptor_.open(endpoint.protocol(), ec);
+  if (!ec) {
+    tcp_acceptor_.set_option(asio::ip::tcp::acceptor::reuse_address(true), ec);
+  }
+  if (!ec) {
+    tcp_acceptor_.bind(endpoint, ec);
+  }
+  if (!ec) {
+    tcp_acceptor_.listen(asio::socket_base::max_connections, ec);
+  }
+  if (ec) {
+    return Status(1, "Cannot listen on metrics port: " + ec.message());
+  }
+
+  accept(tcp_acceptor_);
+  return Status(0);
+}
+
+Status MetricsExporterRunner::listen(const std::string& path) {
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+  boost::system::error_code ec;
+  fs::remove(path, ec);
+
+  asio::local::stream_protocol::endpoint endpoint(path);
+  local_acceptor_.open(endpoint.protocol(), ec);
+  if (!ec) {
+    // The socket exposes process internals, it is created owner-only so it
+    // is never accessible to others, even briefly.
+    auto mask = ::umask(S_IRWXG | S_IRWXO);
+    local_acceptor_.bind(endpoint, ec);
+    ::umask(mask);
+  }
+  if (!ec) {
+    local_acceptor_.listen(asio::socket_base::max_connections, ec);
+  }
+  if (ec) {
+    return Status(1, "Cannot listen on metrics socket: " + ec.message());
+  }
+
+  accept(local_acceptor_);
+  return Status(0);
+#else
+  return Status(1, "UNIX domain sockets are not supported");
+#endif
+}
+
+unsigned short MetricsExporterRunner::port() const {
+  boost::system::error_code ec;
+  if (!tcp_acceptor_.is_open()) {
+    return 0;
+  }
+  return tcp_acceptor_.local_endpoint(ec).port();
+}
+
+template <typename Acceptor>
+void MetricsExporterRunner::accept(Acceptor& acceptor) {
+  using Socket = typename Acceptor::protocol_type::socket;
+  auto session =
+      std::make_shared<MetricsSession<Socket>>(io_service_, request_timeout_);
+  acceptor.async_accept(
+      session->socket(),
+      [this, &acceptor, session](const boost::system::error_code& ec) {
+        if (ec == asio::error::operation_aborted) {
+          return;
+        }
+
+        if (!ec) {
+          session->start();
+        }
+        accept(acceptor);
+      });
+}
+
+void MetricsExporterRunner::start() {
+  for (;;) {
+    try {
+      io_service_.run();
+      return;
+    } catch (const std::exception& e) {
+      LOG(WARNING) << "MetricsExporterRunner: handler exception: " << e.what();
+    }
+  }
+}
+
+void MetricsExporterRunner::stop() {
+  io_service_.stop();
+}
+
+Status startMetricsExporter() {
+  if (FLAGS_metrics_port == 0 && FLAGS_metrics_socket.empty()) {
+    return Status(1, "Metrics exporter is not enabled");
+  }
+
+  if (FLAGS_metrics_port > 65535) {
+    return Status(1,
+                  "Invalid metrics port: " +
+                      std::to_string(FLAGS_metrics_port));
+  }
+
+  auto runner = std::make_shared<MetricsExporterRunner>();
+  if (FLAGS_metrics_port != 0) {
+    auto status =
+        runner->listen(static_cast<unsigned short>(FLAGS_metrics_port));
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  if (!FLAGS_metrics_socket.empty()) {
+    auto status = runner->listen(FLAGS_metrics_socket);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  Dispatcher::addService(runner);
+  return Status(0);
+}
+} // namespace osquery
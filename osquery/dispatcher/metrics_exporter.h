@@ -0,0 +1,82 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <boost/asio.hpp>
+
+#include <osquery/dispatcher.h>
+#include <osquery/flags.h>
+
+namespace osquery {
+
+/// The localhost TCP port serving metrics, 0 to disable.
+DECLARE_uint32(metrics_port);
+
+/// A UNIX domain socket path serving metrics, empty to disable.
+DECLARE_string(metrics_socket);
+
+/**
+ * @brief A Dispatcher service serving internal metrics over HTTP.
+ *
+ * Every request is answered with the Prometheus text exposition of the
+ * process metrics and the connection is closed. The exporter only listens on
+ * the loopback interface or a UNIX domain socket, scraping is local.
+ */
+class MetricsExporterRunner : public InternalRunnable {
+ public:
+  /**
+   * @brief Create an exporter, not yet listening.
+   *
+   * @param request_timeout milliseconds a connection may take to send its
+   * request and read the response before it is closed.
+   */
+  explicit MetricsExporterRunner(size_t request_timeout = 5000);
+
+  /// Listen on a loopback TCP port, 0 selects an ephemeral port.
+  Status listen(unsigned short port);
+
+  /// Listen on a UNIX domain socket, replacing an existing socket file.
+  Status listen(const std::string& path);
+
+  /// The bound TCP port, 0 if not listening on TCP.
+  unsigned short port() const;
+
+ public:
+  /// The Dispatcher thread entry point.
+  void start() override;
+
+  /// The Dispatcher interrupt point.
+  void stop() override;
+
+ private:
+  /// Accept the next connection on an acceptor.
+  template <typename Acceptor>
+  void accept(Acceptor& acceptor);
+
+ private:
+  boost::asio::io_service io_service_;
+
+  /// Milliseconds before an unfinished connection is closed.
+  size_t request_timeout_;
+
+  boost::asio::ip::tcp::acceptor tcp_acceptor_;
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+  boost::asio::local::stream_protocol::acceptor local_acceptor_;
+#endif
+};
+
+/// Start the metrics exporter if a port or socket is configured.
+Status startMetricsExporter();
+} // namespace osquery
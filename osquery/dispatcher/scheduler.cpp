@@ -8,7 +8,12 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
 #include <ctime>
+#include <limits>
+#include <set>
 
 #include <osquery/config.h>
 #include <osquery/core.h>
@@ -20,8 +25,11 @@
 
 #include "osquery/config/parsers/decorators.h"
 #include "osquery/core/process.h"
+#include "osquery/core/watcher.h"
 #include "osquery/dispatcher/scheduler.h"
+#include "osquery/sql/query_profile.h"
 #include "osquery/sql/sqlite_util.h"
+#include "osquery/sql/table_snapshot.h"
 
 namespace osquery {
 
@@ -34,6 +42,32 @@ FLAG(uint64,
 
 FLAG(uint64, schedule_epoch, 0, "Epoch for scheduled queries");
 
+FLAG(uint64,
+     schedule_cpu_budget,
+     500,
+     "Milliseconds of expected query CPU time to start each second, 0 for no "
+     "limit");
+
+FLAG(bool,
+     schedule_batch,
+     true,
+     "Run queries scheduled for the same second with shared table scans");
+
+FLAG(uint64,
+     schedule_degrade_rows,
+     1000,
+     "Row limit of reduced queries without fallback SQL");
+
+FLAG(uint64,
+     schedule_max_rows,
+     0,
+     "Maximum rows of a scheduled query execution (default 0, unlimited)");
+
+FLAG(uint64,
+     schedule_max_bytes,
+     0,
+     "Maximum bytes of a scheduled query execution (default 0, unlimited)");
+
 HIDDEN_FLAG(bool, enable_monitor, true, "Enable the schedule monitor");
 
 HIDDEN_FLAG(bool,
@@ -44,39 +78,138 @@ HIDDEN_FLAG(bool,
 /// Used to bypass (optimize-out) the set-differential of query results.
 DECLARE_bool(events_optimize);
 
-SQLInternal monitor(const std::string& name, const ScheduledQuery& query) {
-  // Snapshot the performance and times for the worker before running.
-  auto pid = std::to_string(PlatformProcess::getCurrentProcess()->pid());
-  auto r0 = SQL::selectAllFrom("processes", "pid", EQUALS, pid);
-  auto t0 = getUnixTime();
+/// A cost-based delay is limited to the splay of the query interval.
+DECLARE_uint64(schedule_splay_percent);
+
+/// Seconds between comparisons of the timer wheel and the config's schedule.
+const size_t kScheduleReconcileInterval{60};
+
+/// Interval multiplier of degraded queries.
+const size_t kScheduleDegradeFactor{4};
+
+std::string getScheduledSQL(const ScheduledQuery& query) {
+  if (query.degradation < QueryDegradation::REDUCED) {
+    return query.query;
+  }
+
+  if (!query.fallback.empty()) {
+    return query.fallback;
+  }
+
+  // Without a pack-provided fallback, keep the first rows of the query.
+  auto sql = query.query;
+  while (!sql.empty() && (sql.back() == ';' || std::isspace(sql.back()))) {
+    sql.pop_back();
+  }
+  return "SELECT * FROM (" + sql + ") LIMIT " +
+         std::to_string(FLAGS_schedule_degrade_rows);
+}
+
+size_t getScheduledInterval(const ScheduledQuery& query) {
+  if (query.degradation < QueryDegradation::INTERVAL) {
+    return query.splayed_interval;
+  }
+  return query.splayed_interval * kScheduleDegradeFactor;
+}
+
+/// True if the stored results of a query were collected by the SQL of
+/// another degradation level.
+static bool isDegradationChange(const std::string& name,
+                                const ScheduledQuery& query,
+                                const std::string& sql) {
+  for (auto level : {QueryDegradation::NONE, QueryDegradation::REDUCED}) {
+    ScheduledQuery other;
+    other.query = query.query;
+    other.fallback = query.fallback;
+    other.degradation = level;
+
+    ScheduledQuery stored;
+    stored.query = getScheduledSQL(other);
+    if (stored.query != sql && !Query(name, stored).isNewQuery()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+QueryBudget getScheduledBudget(const ScheduledQuery& query) {
+  QueryBudget budget;
+  budget.max_rows = (query.max_rows > 0) ? query.max_rows
+                                         : FLAGS_schedule_max_rows;
+  budget.max_bytes = (query.max_bytes > 0) ? query.max_bytes
+                                           : FLAGS_schedule_max_bytes;
+  return budget;
+}
+
+SQLInternal monitor(const std::string& name,
+                    const ScheduledQuery& query,
+                    size_t delay) {
+  // Snapshot the resource usage of the scheduler thread before running.
+  // This samples the OS directly, the processes table is too expensive to
+  // query around every scheduled query. Worker threads hashing, traversing,
+  // or scanning for the query charge their CPU time to this thread.
+  ResourceUsage r0;
+  auto sampled = getThreadResourceUsage(r0);
   Config::get().recordQueryStart(name);
-  SQLInternal sql(query.query, true);
+  auto t0 = std::chrono::steady_clock::now();
+  // An execution exceeding its budget is aborted within the SQLite step loop,
+  // the time and resources spent before the abort are still recorded.
+  SQLInternal sql(getScheduledSQL(query), true, getScheduledBudget(query));
   // Snapshot the performance after, and compare.
-  auto t1 = getUnixTime();
-  auto r1 = SQL::selectAllFrom("processes", "pid", EQUALS, pid);
-  if (r0.size() > 0 && r1.size() > 0) {
-    // Calculate a size as the expected byte output of results.
-    // This does not dedup result differentials and is not aware of snapshots.
-    size_t size = 0;
-    for (const auto& row : sql.rows()) {
-      for (const auto& column : row) {
-        size += column.first.size();
-        size += column.second.size();
-      }
+  auto t1 = std::chrono::steady_clock::now();
+  if (auto profile = QueryProfiler::current()) {
+    profile->query_time_ns +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+    profile->rows += sql.rows().size();
+  }
+
+  QueryExecution execution;
+  execution.delay = delay;
+  execution.wall_time_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+  ResourceUsage r1;
+  if (sampled.ok() && getThreadResourceUsage(r1).ok()) {
+    execution.user_time = r1.user_time - r0.user_time;
+    execution.system_time = r1.system_time - r0.system_time;
+    execution.memory = static_cast<long long int>(r1.resident_size) -
+                       static_cast<long long int>(r0.resident_size);
+    if (r1.peak_resident_size > r0.peak_resident_size) {
+      execution.peak_memory = r1.peak_resident_size - r0.peak_resident_size;
     }
-    // Always called while processes table is working.
-    Config::get().recordQueryPerformance(name, t1 - t0, size, r0[0], r1[0]);
   }
+
+  // Calculate a size as the expected byte output of results.
+  // This does not dedup result differentials and is not aware of snapshots.
+  for (const auto& row : sql.rows()) {
+    for (const auto& column : row) {
+      execution.output_size += column.first.size();
+      execution.output_size += column.second.size();
+    }
+  }
+  execution.output_rows = sql.rows().size();
+  execution.truncated = (sql.getStatus().getCode() == kQueryBudgetExceeded);
+  Config::get().recordQueryPerformance(name, execution);
   return sql;
 }
 
-inline void launchQuery(const std::string& name, const ScheduledQuery& query) {
+void launchQuery(const std::string& name,
+                 const ScheduledQuery& query,
+                 size_t delay) {
   // Execute the scheduled query and create a named query object.
-  LOG(INFO) << "Executing scheduled query " << name << ": " << query.query;
+  auto sql_text = getScheduledSQL(query);
+  LOG(INFO) << "Executing scheduled query " << name << ": " << sql_text;
   runDecorators(DECORATE_ALWAYS);
 
-  auto sql = monitor(name, query);
-  if (!sql.ok()) {
+  // Profile the query, differential, and logging when requested.
+  QueryProfiler::Scope profile(name, sql_text);
+
+  auto sql = monitor(name, query, delay);
+  bool truncated = (sql.getStatus().getCode() == kQueryBudgetExceeded);
+  if (truncated) {
+    // The rows collected before the abort are logged and marked truncated.
+    LOG(WARNING) << "Scheduled query " << name
+                 << " truncated: " << sql.getMessageString();
+  } else if (!sql.ok()) {
     LOG(ERROR) << "Error executing scheduled query " << name << ": "
                << sql.getMessageString();
     return;
@@ -95,6 +228,9 @@ inline void launchQuery(const std::string& name, const ScheduledQuery& query) {
   item.epoch = FLAGS_schedule_epoch;
   item.calendar_time = osquery::getAsciiTime();
   getDecorations(item.decorations);
+  if (truncated) {
+    item.truncated = sql.getMessageString();
+  }
 
   if (query.options.count("snapshot") && query.options.at("snapshot")) {
     // This is a snapshot query, emit results with a differential or state.
@@ -103,19 +239,55 @@ inline void launchQuery(const std::string& name, const ScheduledQuery& query) {
     return;
   }
 
-  // Create a database-backed set of query results.
-  auto dbQuery = Query(name, query);
+  // Create a database-backed set of query results, keyed by the executed SQL.
+  ScheduledQuery executed;
+  executed.query = sql_text;
+  auto dbQuery = Query(name, executed);
   // Comparisons and stores must include escaped data.
   sql.escapeResults();
 
+  // Results of another degradation level are not comparable, the first
+  // execution after a level change replaces them without a differential.
+  bool level_changed = dbQuery.isQueryNameInDatabase() &&
+                       dbQuery.isNewQuery() &&
+                       isDegradationChange(name, query, sql_text);
+  if (level_changed) {
+    LOG(INFO) << "Scheduled query " << name
+              << " changed degradation level, replacing its stored results";
+  }
+
   Status status;
   DiffResults& diff_results = item.results;
   // Add this execution's set of results to the database-tracked named query.
   // We can then ask for a differential from the last time this named query
   // was executed by exact matching each row.
-  if (!FLAGS_events_optimize || !sql.eventBased()) {
-    status = dbQuery.addNewResults(
-        std::move(sql.rows()), item.epoch, item.counter, diff_results);
+  if (truncated && level_changed) {
+    // Neither the stored nor the truncated results are a baseline.
+    return;
+  } else if (truncated && (!FLAGS_events_optimize || !sql.eventBased())) {
+    // A truncated execution is not stored, the next complete execution is
+    // compared with the last complete results. Only rows missing from those
+    // results are logged.
+    QueryProfiler::Timer timer(&QueryProfile::diff_time_ns);
+    QueryDataSet previous;
+    if (dbQuery.isQueryNameInDatabase() &&
+        dbQuery.getPreviousEpoch() == item.epoch && !dbQuery.isNewQuery() &&
+        dbQuery.getPreviousQueryResults(previous).ok()) {
+      diff_results = diff(previous, sql.rows());
+      item.counter = dbQuery.getQueryCounter(false);
+    } else {
+      diff_results.added = std::move(sql.rows());
+    }
+  } else if (!FLAGS_events_optimize || !sql.eventBased()) {
+    QueryProfiler::Timer timer(&QueryProfile::diff_time_ns);
+    status = dbQuery.addNewResults(std::move(sql.rows()),
+                                   item.epoch,
+                                   item.counter,
+                                   diff_results,
+                                   !level_changed);
+    if (level_changed) {
+      diff_results = DiffResults();
+    }
     if (!status.ok()) {
       std::string line =
           "Error adding new results to database: " + status.what();
@@ -128,7 +300,9 @@ inline void launchQuery(const std::string& name, const ScheduledQuery& query) {
     diff_results.added = std::move(sql.rows());
   }
 
-  if (query.options.count("removed") && !query.options.at("removed")) {
+  // Rows beyond the budget of a truncated execution were not removed.
+  if ((query.options.count("removed") && !query.options.at("removed")) ||
+      truncated) {
     diff_results.removed.clear();
   }
 
@@ -149,18 +323,169 @@ inline void launchQuery(const std::string& name, const ScheduledQuery& query) {
   }
 }
 
+void SchedulerRunner::plan(const std::string& name, ScheduleEntry& entry) {
+  entry.cost = 0;
+  Config::get().getPerformanceStats(
+      name, [&entry](const QueryPerformance& perf) {
+        if (perf.executions > 0) {
+          entry.cost = (perf.user_time + perf.system_time) / perf.executions;
+        }
+      });
+
+  // Find the first second within the splay that has room for the query.
+  // Otherwise use the least loaded second.
+  entry.due = entry.base;
+  if (FLAGS_schedule_cpu_budget > 0 && entry.cost > 0) {
+    auto limit = entry.splayed_interval * FLAGS_schedule_splay_percent / 100;
+    limit = std::min(limit, entry.splayed_interval - 1);
+    size_t least = std::numeric_limits<size_t>::max();
+    for (auto second = entry.base; second <= entry.base + limit; ++second) {
+      auto it = load_.find(second);
+      size_t load = (it == load_.end()) ? 0 : it->second;
+      if (load + entry.cost <= FLAGS_schedule_cpu_budget) {
+        entry.due = second;
+        break;
+      }
+      if (load < least) {
+        least = load;
+        entry.due = second;
+      }
+    }
+  }
+
+  if (entry.cost > 0) {
+    load_[entry.due] += entry.cost;
+  }
+  wheel_.add(name, entry.due);
+}
+
+void SchedulerRunner::unplan(const ScheduleEntry& entry) {
+  auto it = load_.find(entry.due);
+  if (it != load_.end()) {
+    it->second -= std::min(it->second, entry.cost);
+    if (it->second == 0) {
+      load_.erase(it);
+    }
+  }
+}
+
+void SchedulerRunner::reconcile(size_t i) {
+  std::set<std::string> scheduled;
+  Config::get().scheduledQueries(
+      ([this, i, &scheduled](const std::string& name,
+                             const ScheduledQuery& query) {
+        if (query.splayed_interval == 0) {
+          return;
+        }
+
+        // A degraded query runs at a lengthened interval.
+        auto interval = getScheduledInterval(query);
+        scheduled.insert(name);
+        auto it = entries_.find(name);
+        if (it != entries_.end()) {
+          if (it->second.query == query.query &&
+              it->second.splayed_interval == interval) {
+            return;
+          }
+          // The previous timer is ignored when it expires.
+          unplan(it->second);
+        }
+
+        // Queries run when the time is a multiple of the splayed interval.
+        auto& entry = entries_[name];
+        entry.query = query.query;
+        entry.splayed_interval = interval;
+        entry.base = i + (interval - i % interval) % interval;
+        plan(name, entry);
+      }));
+
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (scheduled.count(it->first) == 0) {
+      unplan(it->second);
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  reconciled_ = i;
+}
+
+void SchedulerRunner::schedule(size_t i) {
+  if (entries_.empty() || i >= reconciled_ + kScheduleReconcileInterval) {
+    reconcile(i);
+  }
+
+  std::vector<TimerWheel::Timer> expired;
+  wheel_.advance(i, expired);
+  load_.erase(load_.begin(), load_.upper_bound(i));
+
+  // Timers from replaced or removed entries are ignored.
+  std::map<std::string, size_t> due;
+  for (const auto& timer : expired) {
+    auto it = entries_.find(timer.first);
+    if (it != entries_.end() && it->second.due == timer.second) {
+      due[timer.first] = timer.second;
+    }
+  }
+
+  if (due.empty()) {
+    return;
+  }
+
+  // A watchdog responding to worker pressure may pause the schedule, due
+  // queries skip this execution and are planned for their next interval.
+  auto paused = (getWorkerPressure() >= WatchdogPressure::PAUSE_SCHEDULE);
+
+  // Queries due together read the same table snapshots.
+  std::unique_ptr<TableSnapshotCache::Batch> batch;
+  if (FLAGS_schedule_batch && due.size() > 1 && !paused) {
+    batch = std::make_unique<TableSnapshotCache::Batch>();
+  }
+
+  Config::get().scheduledQueries(
+      ([this, i, paused, &due](const std::string& name,
+                               const ScheduledQuery& query) {
+        auto timer = due.find(name);
+        if (timer == due.end()) {
+          return;
+        }
+
+        if (paused) {
+          VLOG(1) << "Scheduled query paused by the watchdog: " << name;
+        } else {
+          // Queries that start after their planned second missed a deadline.
+          auto now = osquery::getUnixTime();
+          auto delay = (now > timer->second) ? now - timer->second : 0;
+          TablePlugin::kCacheInterval = getScheduledInterval(query);
+          TablePlugin::kCacheStep = i;
+          launchQuery(name, query, delay);
+        }
+        due.erase(timer);
+
+        // Plan the next execution, skipping any intervals that were missed.
+        auto& entry = entries_[name];
+        entry.query = query.query;
+        entry.splayed_interval = getScheduledInterval(query);
+        entry.base += entry.splayed_interval;
+        if (entry.base <= i) {
+          entry.base = i + entry.splayed_interval - i % entry.splayed_interval;
+        }
+        plan(name, entry);
+      }));
+
+  // The remaining due queries are no longer in the schedule.
+  for (const auto& timer : due) {
+    entries_.erase(timer.first);
+  }
+}
+
 void SchedulerRunner::start() {
   // Start the counter at the second.
   auto i = osquery::getUnixTime();
-  for (; (timeout_ == 0) || (i <= timeout_); ++i) {
-    Config::get().scheduledQueries(
-        ([&i](const std::string& name, const ScheduledQuery& query) {
-          if (query.splayed_interval > 0 && i % query.splayed_interval == 0) {
-            TablePlugin::kCacheInterval = query.splayed_interval;
-            TablePlugin::kCacheStep = i;
-            launchQuery(name, query);
-          }
-        }));
+  wheel_.reset(i);
+  for (; (timeout_ == 0) || (i <= timeout_); i += interval_) {
+    schedule(i);
+
     // Configuration decorators run on 60 second intervals only.
     if ((i % 60) == 0) {
       runDecorators(DECORATE_INTERVAL, i);
@@ -178,7 +503,11 @@ void SchedulerRunner::start() {
     }
 
     // Put the thread into an interruptible sleep without a config instance.
-    pauseMilli(interval_ * 1000);
+    // A step that ran past the next step continues without sleeping.
+    auto now = osquery::getUnixTime();
+    if (now < i + interval_) {
+      pauseMilli((i + interval_ - now) * 1000);
+    }
     if (interrupted()) {
       break;
     }
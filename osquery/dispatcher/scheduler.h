@@ -11,14 +11,24 @@
 #pragma once
 
 #include <map>
+#include <string>
 
 #include <osquery/dispatcher.h>
 
+#include "osquery/dispatcher/timer_wheel.h"
 #include "osquery/sql/sqlite_util.h"
 
 namespace osquery {
 
-/// A Dispatcher service thread that watches an ExtensionManagerHandler.
+/**
+ * @brief A Dispatcher service thread that runs the scheduled queries.
+ *
+ * Each query is kept in a timer wheel keyed by its next execution time, so a
+ * scheduler step only inspects the queries that are due. A query runs when
+ * the UNIX time is a multiple of its splayed interval. If the expected CPU
+ * time of the queries planned for that second exceeds the schedule budget,
+ * the query is moved to a later, less loaded, second within its splay.
+ */
 class SchedulerRunner : public InternalRunnable {
  public:
   SchedulerRunner(unsigned long int timeout, size_t interval)
@@ -34,8 +44,46 @@ class SchedulerRunner : public InternalRunnable {
   void stop() override {}
 
  protected:
-  /// The UNIX domain socket path for the ExtensionManager.
-  std::map<std::string, size_t> splay_;
+  /// Run the scheduled queries due at or before a time.
+  void schedule(size_t i);
+
+  /// A scheduled query known to the timer wheel.
+  struct ScheduleEntry {
+    /// The query and interval used to detect schedule changes.
+    std::string query;
+    size_t splayed_interval{0};
+
+    /// The execution time before any cost-based delay.
+    size_t base{0};
+
+    /// The planned execution time, the expiration in the timer wheel.
+    size_t due{0};
+
+    /// The expected CPU time in milliseconds.
+    size_t cost{0};
+  };
+
+  /// Add, replace, or remove entries to match the config's schedule.
+  void reconcile(size_t i);
+
+  /// Choose the execution second for an entry and add it to the wheel.
+  void plan(const std::string& name, ScheduleEntry& entry);
+
+  /// Remove the expected cost of an entry from its planned second.
+  void unplan(const ScheduleEntry& entry);
+
+ protected:
+  /// Scheduled queries by name.
+  std::map<std::string, ScheduleEntry> entries_;
+
+  /// Scheduled queries by next execution time.
+  TimerWheel wheel_;
+
+  /// Expected CPU time in milliseconds planned for each second.
+  std::map<size_t, size_t> load_;
+
+  /// Time the entries were last compared with the config's schedule.
+  size_t reconciled_{0};
 
   /// Interval in seconds between schedule steps.
   size_t interval_;
@@ -44,7 +92,36 @@ class SchedulerRunner : public InternalRunnable {
   unsigned long int timeout_;
 };
 
-SQLInternal monitor(const std::string& name, const ScheduledQuery& query);
+/**
+ * @brief Run a scheduled query and record its performance.
+ *
+ * @param name The scheduled query name.
+ * @param query The scheduled query.
+ * @param delay Seconds the query started after its planned execution time.
+ */
+SQLInternal monitor(const std::string& name,
+                    const ScheduledQuery& query,
+                    size_t delay = 0);
+
+/**
+ * @brief Run a scheduled query and log its results.
+ *
+ * Results are compared with the last complete execution. An execution
+ * truncated by its budget is logged, marked truncated, but is not stored as
+ * the results later executions are compared with.
+ */
+void launchQuery(const std::string& name,
+                 const ScheduledQuery& query,
+                 size_t delay = 0);
+
+/// The SQL a scheduled query runs, a reduced query runs its fallback.
+std::string getScheduledSQL(const ScheduledQuery& query);
+
+/// The interval of a scheduled query, lengthened if the query is degraded.
+size_t getScheduledInterval(const ScheduledQuery& query);
+
+/// The output limits of a scheduled query, the query's or the flags'.
+QueryBudget getScheduledBudget(const ScheduledQuery& query);
 
 /// Start querying according to the config's schedule
 void startScheduler();
@@ -0,0 +1,114 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <thread>
+
+#ifndef WIN32
+#include <sys/stat.h>
+#endif
+
+#include <gtest/gtest.h>
+
+#include "osquery/core/metrics.h"
+#include "osquery/dispatcher/metrics_exporter.h"
+#include "osquery/tests/test_util.h"
+
+namespace asio = boost::asio;
+
+namespace osquery {
+
+class MetricsExporterTests : public testing::Test {};
+
+/// Send a request and read the response until the exporter closes.
+template <typename Socket>
+static std::string scrape(Socket& socket) {
+  std::string request = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+  asio::write(socket, asio::buffer(request));
+
+  asio::streambuf response;
+  boost::system::error_code ec;
+  asio::read(socket, response, ec);
+  EXPECT_EQ(asio::error::eof, ec);
+  return std::string(asio::buffers_begin(response.data()),
+                     asio::buffers_end(response.data()));
+}
+
+TEST_F(MetricsExporterTests, test_scrape_tcp) {
+  Metrics::get().counter("test_scrape_total", "Scrape test").increment(3);
+
+  auto runner = std::make_shared<MetricsExporterRunner>();
+  ASSERT_TRUE(runner->listen(static_cast<unsigned short>(0)).ok());
+  ASSERT_NE(0U, runner->port());
+  std::thread thread([runner]() { runner->start(); });
+
+  asio::io_service io_service;
+  asio::ip::tcp::socket socket(io_service);
+  socket.connect(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(),
+                                         runner->port()));
+  auto response = scrape(socket);
+
+  runner->stop();
+  thread.join();
+
+  EXPECT_EQ(0U, response.find("HTTP/1.1 200 OK\r\n"));
+  EXPECT_NE(std::string::npos,
+            response.find("Content-Type: text/plain; version=0.0.4\r\n"));
+  EXPECT_NE(std::string::npos,
+            response.find("# TYPE test_scrape_total counter\n"));
+  EXPECT_NE(std::string::npos, response.find("\ntest_scrape_total 3\n"));
+}
+
+TEST_F(MetricsExporterTests, test_idle_timeout) {
+  auto runner = std::make_shared<MetricsExporterRunner>(100);
+  ASSERT_TRUE(runner->listen(static_cast<unsigned short>(0)).ok());
+  std::thread thread([runner]() { runner->start(); });
+
+  // A client that never sends a request is disconnected.
+  asio::io_service io_service;
+  asio::ip::tcp::socket socket(io_service);
+  socket.connect(asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(),
+                                         runner->port()));
+  asio::streambuf response;
+  boost::system::error_code ec;
+  asio::read(socket, response, ec);
+  EXPECT_EQ(asio::error::eof, ec);
+  EXPECT_EQ(0U, response.size());
+
+  runner->stop();
+  thread.join();
+}
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+TEST_F(MetricsExporterTests, test_scrape_socket) {
+  Metrics::get().gauge("test_scrape_socket", "Scrape test").set(5);
+
+  auto path = kTestWorkingDirectory + "metrics.sock";
+  auto runner = std::make_shared<MetricsExporterRunner>();
+  ASSERT_TRUE(runner->listen(path).ok());
+  EXPECT_EQ(0U, runner->port());
+
+  // The socket is created accessible to its owner only.
+  struct stat st;
+  ASSERT_EQ(0, ::stat(path.c_str(), &st));
+  EXPECT_EQ(0U, st.st_mode & (S_IRWXG | S_IRWXO));
+  std::thread thread([runner]() { runner->start(); });
+
+  asio::io_service io_service;
+  asio::local::stream_protocol::socket socket(io_service);
+  socket.connect(asio::local::stream_protocol::endpoint(path));
+  auto response = scrape(socket);
+
+  runner->stop();
+  thread.join();
+
+  EXPECT_NE(std::string::npos, response.find("\ntest_scrape_socket 5\n"));
+}
+#endif
+} // namespace osquery
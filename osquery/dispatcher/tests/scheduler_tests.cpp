@@ -13,6 +13,7 @@
 #include <osquery/logger.h>
 #include <osquery/system.h>
 
+#include "osquery/core/watcher.h"
 #include "osquery/dispatcher/scheduler.h"
 #include "osquery/sql/sqlite_util.h"
 #include "osquery/tests/test_util.h"
@@ -21,6 +22,8 @@ namespace osquery {
 
 DECLARE_bool(disable_logging);
 DECLARE_uint64(schedule_reload);
+DECLARE_uint64(schedule_cpu_budget);
+DECLARE_uint64(schedule_max_rows);
 
 class SchedulerTests : public testing::Test {
   void SetUp() override {
@@ -63,6 +66,8 @@ TEST_F(SchedulerTests, test_monitor) {
   // performance stats are tracked independently.
   EXPECT_EQ(perf.executions, 1U);
   EXPECT_GT(perf.output_size, 0U);
+  EXPECT_EQ(perf.output_rows, 1U);
+  EXPECT_GT(perf.wall_time_ns, 0U);
 
   // A bit more testing, potentially redundant, check the database results.
   // Since we are only monitoring, no 'actual' results are stored.
@@ -76,6 +81,247 @@ TEST_F(SchedulerTests, test_monitor) {
   EXPECT_FALSE(timestamp.empty());
 }
 
+TEST_F(SchedulerTests, test_monitor_missed_deadline) {
+  std::string name = "pack_test_late_query";
+  ScheduledQuery query;
+  query.interval = 10;
+  query.splayed_interval = 10;
+  query.query = "select * from time";
+  monitor(name, query);
+  monitor(name, query, 2);
+
+  QueryPerformance perf;
+  Config::get().getPerformanceStats(
+      name, ([&perf](const QueryPerformance& r) { perf = r; }));
+  EXPECT_EQ(perf.executions, 2U);
+  EXPECT_EQ(perf.missed_deadlines, 1U);
+}
+
+TEST_F(SchedulerTests, test_monitor_budget) {
+  std::string name = "pack_test_budget_query";
+  ScheduledQuery query;
+  query.interval = 10;
+  query.splayed_interval = 10;
+  query.query =
+      "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c) "
+      "SELECT x FROM c LIMIT 100";
+
+  // The query limit takes precedence over the flag.
+  auto backup_max_rows = FLAGS_schedule_max_rows;
+  FLAGS_schedule_max_rows = 20;
+  EXPECT_EQ(20U, getScheduledBudget(query).max_rows);
+  query.max_rows = 10;
+  EXPECT_EQ(10U, getScheduledBudget(query).max_rows);
+  FLAGS_schedule_max_rows = backup_max_rows;
+
+  // The rows collected before the abort are kept.
+  auto sql = monitor(name, query);
+  EXPECT_EQ(sql.getStatus().getCode(), kQueryBudgetExceeded);
+  EXPECT_EQ(10U, sql.rows().size());
+
+  // The aborted execution is accounted.
+  QueryPerformance perf;
+  Config::get().getPerformanceStats(
+      name, ([&perf](const QueryPerformance& r) { perf = r; }));
+  EXPECT_EQ(perf.executions, 1U);
+  EXPECT_EQ(perf.output_rows, 10U);
+  EXPECT_EQ(perf.truncations, 1U);
+  EXPECT_GT(perf.wall_time_ns, 0U);
+}
+
+TEST_F(SchedulerTests, test_timer_wheel) {
+  TimerWheel wheel(1000);
+  wheel.add("now", 1000);
+  wheel.add("soon", 1010);
+  wheel.add("minute", 1100);
+  wheel.add("hour", 1000 + 3600);
+  wheel.add("day", 1000 + 86400);
+  wheel.add("year", 1000 + 86400 * 365);
+  EXPECT_EQ(wheel.size(), 6U);
+
+  std::vector<TimerWheel::Timer> expired;
+  wheel.advance(1000, expired);
+  ASSERT_EQ(expired.size(), 1U);
+  EXPECT_EQ(expired[0].first, "now");
+
+  // Advancing processes each second, timers expire in order.
+  expired.clear();
+  wheel.advance(1000 + 86400, expired);
+  ASSERT_EQ(expired.size(), 4U);
+  EXPECT_EQ(expired[0], TimerWheel::Timer("soon", 1010));
+  EXPECT_EQ(expired[1], TimerWheel::Timer("minute", 1100));
+  EXPECT_EQ(expired[2], TimerWheel::Timer("hour", 1000 + 3600));
+  EXPECT_EQ(expired[3], TimerWheel::Timer("day", 1000 + 86400));
+  EXPECT_EQ(wheel.size(), 1U);
+
+  // A timer added in the past expires on the next advance.
+  expired.clear();
+  wheel.add("past", 10);
+  wheel.advance(wheel.next(), expired);
+  ASSERT_EQ(expired.size(), 1U);
+  EXPECT_EQ(expired[0].first, "past");
+
+  expired.clear();
+  wheel.advance(1000 + 86400 * 365, expired);
+  ASSERT_EQ(expired.size(), 1U);
+  EXPECT_EQ(expired[0].first, "year");
+  EXPECT_EQ(wheel.size(), 0U);
+}
+
+class PlanningSchedulerRunner : public SchedulerRunner {
+ public:
+  PlanningSchedulerRunner() : SchedulerRunner(0, 1) {}
+
+  size_t plan(const std::string& name, size_t base, size_t interval) {
+    auto& entry = entries_[name];
+    entry.base = base;
+    entry.splayed_interval = interval;
+    SchedulerRunner::plan(name, entry);
+    return entry.due;
+  }
+};
+
+TEST_F(SchedulerTests, test_cost_splay) {
+  auto budget = FLAGS_schedule_cpu_budget;
+  FLAGS_schedule_cpu_budget = 500;
+
+  // Each query previously used 300ms of CPU.
+  QueryExecution execution;
+  execution.user_time = 200;
+  execution.system_time = 100;
+  for (const auto& name : {"heavy1", "heavy2", "heavy3"}) {
+    Config::get().recordQueryPerformance(name, execution);
+  }
+
+  // Queries without a recorded cost run at their planned time.
+  PlanningSchedulerRunner runner;
+  EXPECT_EQ(runner.plan("unknown", 3600, 3600), 3600U);
+
+  // A second heavy query at the same time is moved to a later second.
+  EXPECT_EQ(runner.plan("heavy1", 3600, 3600), 3600U);
+  EXPECT_EQ(runner.plan("heavy2", 3600, 3600), 3601U);
+  EXPECT_EQ(runner.plan("heavy3", 3600, 3600), 3602U);
+
+  // Without a budget queries are not moved.
+  FLAGS_schedule_cpu_budget = 0;
+  EXPECT_EQ(runner.plan("heavy3", 7200, 3600), 7200U);
+  FLAGS_schedule_cpu_budget = budget;
+}
+
+/// Keep the result lines of scheduled queries.
+class SchedulerTestLoggerPlugin : public LoggerPlugin {
+ public:
+  Status logString(const std::string& s) override {
+    lines.push_back(s);
+    return Status(0);
+  }
+
+  Status logStatus(const std::vector<StatusLogLine>& log) override {
+    return Status(0);
+  }
+
+ protected:
+  void init(const std::string& binary_name,
+            const std::vector<StatusLogLine>& log) override {}
+
+ public:
+  std::vector<std::string> lines;
+};
+
+TEST_F(SchedulerTests, test_truncated_results) {
+  auto& rf = RegistryFactory::get();
+  auto logger = std::make_shared<SchedulerTestLoggerPlugin>();
+  rf.registry("logger")->add("scheduler_test", logger);
+  auto active = rf.getActive("logger");
+  ASSERT_TRUE(rf.setActive("logger", "scheduler_test").ok());
+  FLAGS_disable_logging = false;
+
+  auto backup_max_rows = FLAGS_schedule_max_rows;
+  FLAGS_schedule_max_rows = 0;
+
+  std::string name = "pack_test_truncated_query";
+  ScheduledQuery query;
+  query.interval = 10;
+  query.splayed_interval = 10;
+  query.query =
+      "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c) "
+      "SELECT x FROM c LIMIT 5";
+
+  // A truncated first execution is logged but not stored.
+  query.max_rows = 2;
+  launchQuery(name, query);
+  ASSERT_EQ(2U, logger->lines.size());
+  EXPECT_NE(std::string::npos, logger->lines[0].find("\"truncated\""));
+  EXPECT_FALSE(Query(name, query).isQueryNameInDatabase());
+
+  // The complete execution adds every row.
+  logger->lines.clear();
+  query.max_rows = 0;
+  launchQuery(name, query);
+  EXPECT_EQ(5U, logger->lines.size());
+
+  // Rows of a truncated execution are compared with the complete results.
+  logger->lines.clear();
+  query.max_rows = 2;
+  launchQuery(name, query);
+  EXPECT_TRUE(logger->lines.empty());
+
+  QueryDataSet previous;
+  ASSERT_TRUE(Query(name, query).getPreviousQueryResults(previous).ok());
+  EXPECT_EQ(5U, previous.size());
+
+  // The rows cut off by the budget are not added again.
+  query.max_rows = 0;
+  launchQuery(name, query);
+  EXPECT_TRUE(logger->lines.empty());
+
+  FLAGS_schedule_max_rows = backup_max_rows;
+  rf.setActive("logger", active);
+  rf.registry("logger")->remove("scheduler_test");
+}
+
+TEST_F(SchedulerTests, test_degraded_results) {
+  auto& rf = RegistryFactory::get();
+  auto logger = std::make_shared<SchedulerTestLoggerPlugin>();
+  rf.registry("logger")->add("scheduler_test", logger);
+  auto active = rf.getActive("logger");
+  ASSERT_TRUE(rf.setActive("logger", "scheduler_test").ok());
+  FLAGS_disable_logging = false;
+
+  std::string name = "pack_test_degraded_query";
+  ScheduledQuery query;
+  query.interval = 10;
+  query.splayed_interval = 10;
+  query.query =
+      "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c) "
+      "SELECT x FROM c LIMIT 5";
+  query.fallback = "SELECT 1 AS x";
+  launchQuery(name, query);
+  EXPECT_EQ(5U, logger->lines.size());
+
+  // Changing the level replaces the stored results without a differential.
+  logger->lines.clear();
+  query.degradation = QueryDegradation::REDUCED;
+  launchQuery(name, query);
+  EXPECT_TRUE(logger->lines.empty());
+
+  QueryDataSet previous;
+  ASSERT_TRUE(Query(name, query).getPreviousQueryResults(previous).ok());
+  EXPECT_EQ(1U, previous.size());
+
+  query.degradation = QueryDegradation::NONE;
+  launchQuery(name, query);
+  EXPECT_TRUE(logger->lines.empty());
+
+  // A changed query is still compared with its stored results.
+  query.query = "SELECT 1 AS x";
+  launchQuery(name, query);
+  EXPECT_EQ(4U, logger->lines.size());
+
+  rf.setActive("logger", active);
+  rf.registry("logger")->remove("scheduler_test");
+}
+
 TEST_F(SchedulerTests, test_config_results_purge) {
   // Set a query time for now (time is only important relative to a week ago).
   auto query_time = osquery::getUnixTime();
@@ -173,6 +419,56 @@ TEST_F(SchedulerTests, test_scheduler) {
   TablePlugin::kCacheInterval = backup_interval;
 }
 
+TEST_F(SchedulerTests, test_scheduler_paused) {
+  auto backup_step = TablePlugin::kCacheStep;
+  auto backup_interval = TablePlugin::kCacheInterval;
+
+  auto now = osquery::getUnixTime();
+  TablePlugin::kCacheStep = now;
+
+  std::string config =
+      "{\"schedule\":{\"1\":{"
+      "\"query\":\"select * from osquery_info\", \"interval\":1}}}";
+  Config::get().update({{"data", config}});
+
+  // The watchdog asked the worker to pause the schedule.
+  setWorkerPressure(WatchdogPressure::PAUSE_SCHEDULE);
+  SchedulerRunner runner(static_cast<unsigned long int>(now + 1), 1);
+  runner.start();
+  setWorkerPressure(WatchdogPressure::NONE);
+
+  // No query was executed, the cache step was not advanced.
+  EXPECT_EQ(TablePlugin::kCacheStep, now);
+
+  TablePlugin::kCacheStep = backup_step;
+  TablePlugin::kCacheInterval = backup_interval;
+}
+
+TEST_F(SchedulerTests, test_degraded_query) {
+  ScheduledQuery query;
+  query.query = "select * from time; ";
+  query.splayed_interval = 10;
+  EXPECT_EQ("select * from time; ", getScheduledSQL(query));
+  EXPECT_EQ(10U, getScheduledInterval(query));
+
+  // The first degradation only lengthens the interval.
+  query.degradation = QueryDegradation::INTERVAL;
+  EXPECT_EQ("select * from time; ", getScheduledSQL(query));
+  EXPECT_GT(getScheduledInterval(query), 10U);
+
+  // A reduced query without fallback SQL keeps its first rows.
+  query.degradation = QueryDegradation::REDUCED;
+  EXPECT_EQ("SELECT * FROM (select * from time) LIMIT 1000",
+            getScheduledSQL(query));
+  auto sql = monitor("degraded", query);
+  EXPECT_TRUE(sql.ok());
+  EXPECT_EQ(1U, sql.rows().size());
+
+  query.fallback = "select 1 as one";
+  EXPECT_EQ("select 1 as one", getScheduledSQL(query));
+  EXPECT_GT(getScheduledInterval(query), 10U);
+}
+
 TEST_F(SchedulerTests, test_scheduler_reload) {
   std::string config =
       "{\"schedule\":{\"1\":{"
@@ -0,0 +1,80 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include "osquery/dispatcher/timer_wheel.h"
+
+namespace osquery {
+
+void TimerWheel::reset(size_t now) {
+  for (auto& level : slots_) {
+    for (auto& slot : level) {
+      slot.clear();
+    }
+  }
+  next_ = now;
+  size_ = 0;
+}
+
+void TimerWheel::add(const std::string& name, size_t due) {
+  place(std::make_pair(name, due));
+  size_++;
+}
+
+void TimerWheel::place(Timer timer) {
+  size_t due = (timer.second < next_) ? next_ : timer.second;
+  size_t delta = due - next_;
+
+  size_t level = 0;
+  while (level < kLevels - 1 && delta >= (1ULL << (kSlotBits * (level + 1)))) {
+    level++;
+  }
+
+  // Timers beyond the top level use its furthest slot and are placed again.
+  size_t span = 1ULL << (kSlotBits * kLevels);
+  if (delta >= span) {
+    due = next_ + span - 1;
+  }
+
+  auto slot = (due >> (kSlotBits * level)) & (kSlots - 1);
+  slots_[level][slot].push_back(std::move(timer));
+}
+
+void TimerWheel::cascade(size_t level, size_t slot) {
+  std::vector<Timer> timers;
+  timers.swap(slots_[level][slot]);
+  for (auto& timer : timers) {
+    place(std::move(timer));
+  }
+}
+
+void TimerWheel::advance(size_t now, std::vector<Timer>& expired) {
+  for (; next_ <= now; ++next_) {
+    // Cascade higher levels when the lower level wraps.
+    for (size_t level = 1; level < kLevels; level++) {
+      if ((next_ & ((1ULL << (kSlotBits * level)) - 1)) != 0) {
+        break;
+      }
+      cascade(level, (next_ >> (kSlotBits * level)) & (kSlots - 1));
+    }
+
+    std::vector<Timer> timers;
+    timers.swap(slots_[0][next_ & (kSlots - 1)]);
+    for (auto& timer : timers) {
+      if (timer.second > next_) {
+        // A timer placed beyond the span of the wheel.
+        place(std::move(timer));
+        continue;
+      }
+      size_--;
+      expired.push_back(std::move(timer));
+    }
+  }
+}
+} // namespace osquery
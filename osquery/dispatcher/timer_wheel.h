@@ -0,0 +1,97 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace osquery {
+
+/**
+ * @brief A hierarchical timer wheel with a one second resolution.
+ *
+ * Timers are named and expire at an absolute UNIX time. Adding a timer and
+ * advancing the wheel by one second are constant time operations, so the
+ * cost of a scheduler step depends on the timers that expire rather than the
+ * size of the schedule.
+ *
+ * The wheel has four levels of 64 slots. The first level holds timers that
+ * expire within 64 seconds, and each higher level covers 64 times the span of
+ * the previous one. Timers cascade to a lower level as their slot is reached.
+ * Timers further away than the top level are kept in the top level and are
+ * placed again each time the top level cascades.
+ *
+ * Timers cannot be removed, a caller ignores expired timers it no longer
+ * wants.
+ */
+class TimerWheel {
+ public:
+  /// An expired timer: name and expiration time.
+  using Timer = std::pair<std::string, size_t>;
+
+ public:
+  explicit TimerWheel(size_t now = 0) {
+    reset(now);
+  }
+
+  /// Remove every timer, the next advance starts at now.
+  void reset(size_t now);
+
+  /**
+   * @brief Add a named timer.
+   *
+   * A timer that expires at or before the current time expires on the next
+   * advance.
+   */
+  void add(const std::string& name, size_t due);
+
+  /**
+   * @brief Advance the wheel through each second until now.
+   *
+   * @param now The last second to process.
+   * @param expired Output, the expired timers in expiration order.
+   */
+  void advance(size_t now, std::vector<Timer>& expired);
+
+  /// The next second to be processed.
+  size_t next() const {
+    return next_;
+  }
+
+  /// The number of timers in the wheel.
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  /// Place a timer in the slot for its expiration relative to next_.
+  void place(Timer timer);
+
+  /// Place the timers from a slot again, at a lower level if possible.
+  void cascade(size_t level, size_t slot);
+
+ private:
+  static const size_t kLevels = 4;
+  static const size_t kSlotBits = 6;
+  static const size_t kSlots = 1 << kSlotBits;
+
+  /// Timer slots for each level.
+  std::array<std::array<std::vector<Timer>, kSlots>, kLevels> slots_;
+
+  /// The next second to be processed.
+  size_t next_{0};
+
+  /// The number of timers in the wheel.
+  size_t size_{0};
+};
+} // namespace osquery
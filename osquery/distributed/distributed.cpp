@@ -8,7 +8,12 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <sstream>
+#include <thread>
 #include <utility>
 
 #include <osquery/database.h>
@@ -19,6 +24,7 @@
 
 #include "osquery/core/conversions.h"
 #include "osquery/core/json.h"
+#include "osquery/sql/query_profile.h"
 
 namespace rj = rapidjson;
 
@@ -33,9 +39,35 @@ FLAG(bool,
      true,
      "Disable distributed queries (default true)");
 
+FLAG(uint32,
+     distributed_concurrency,
+     4,
+     "Number of distributed queries executed concurrently (default 4)");
+
+FLAG(uint32,
+     distributed_timeout,
+     0,
+     "Seconds a distributed query may execute (default 0, unlimited)");
+
+FLAG(uint64,
+     distributed_max_rows,
+     0,
+     "Maximum rows returned by a distributed query (default 0, unlimited)");
+
+FLAG(uint64,
+     distributed_max_bytes,
+     0,
+     "Maximum bytes returned by a distributed query (default 0, unlimited)");
+
 const std::string kDistributedQueryPrefix{"distributed."};
 
-std::string Distributed::currentRequestId_{""};
+/// Queries that are executing, removed when their result is flushed.
+const std::string kDistributedRunningPrefix{"distributed_running."};
+
+/// Serialized results that could not be flushed.
+const std::string kDistributedResultPrefix{"distributed_result."};
+
+thread_local std::string Distributed::currentRequestId_{""};
 
 Status DistributedPlugin::call(const PluginRequest& request,
                                PluginResponse& response) {
@@ -93,6 +125,8 @@ Status Distributed::serializeResults(std::string& json) {
   auto doc = JSON::newObject();
   auto queries_obj = doc.getObject();
   auto statuses_obj = doc.getObject();
+  auto messages_obj = doc.getObject();
+  auto profiles_obj = doc.getObject();
   for (const auto& result : results_) {
     auto arr = doc.getArray();
     auto s = serializeQueryData(result.results, result.columns, doc, arr);
@@ -101,37 +135,171 @@ Status Distributed::serializeResults(std::string& json) {
     }
     doc.add(result.request.id, arr, queries_obj);
     doc.add(result.request.id, result.status.getCode(), statuses_obj);
+    if (!result.status.ok()) {
+      doc.addCopy(result.request.id, result.status.getMessage(), messages_obj);
+    }
+
+    QueryProfile profile;
+    if (FLAGS_query_profile &&
+        QueryProfiler::get().getProfile(result.request.id, profile)) {
+      auto profile_obj = doc.getObject();
+      serializeQueryProfile(profile, doc, profile_obj);
+      doc.add(result.request.id, profile_obj, profiles_obj);
+    }
   }
 
   doc.add("queries", queries_obj);
   doc.add("statuses", statuses_obj);
+  doc.add("messages", messages_obj);
+  if (FLAGS_query_profile) {
+    doc.add("profiles", profiles_obj);
+  }
   return doc.toString(json);
 }
 
-void Distributed::addResult(const DistributedQueryResult& result) {
-  results_.push_back(result);
+void Distributed::addResult(DistributedQueryResult result) {
+  results_.push_back(std::move(result));
+}
+
+DistributedQueryResult Distributed::runQuery(
+    const DistributedQueryRequest& request) {
+  LOG(INFO) << "Executing distributed query: " << request.id << ": "
+            << request.query;
+
+  // Keep track of the request executing on this thread
+  Distributed::setCurrentRequestId(request.id);
+
+  QueryBudget budget;
+  budget.max_rows = FLAGS_distributed_max_rows;
+  budget.max_bytes = FLAGS_distributed_max_bytes;
+  budget.timeout = static_cast<size_t>(FLAGS_distributed_timeout) * 1000;
+
+  DistributedQueryResult result;
+  result.request = request;
+
+  QueryProfiler::Scope profile(request.id, request.query);
+  TableColumns columns;
+  result.status = getQueryColumns(request.query, columns);
+  if (result.status.ok()) {
+    for (const auto& column : columns) {
+      result.columns.push_back(std::get<0>(column));
+    }
+
+    QueryProfiler::Timer timer(&QueryProfile::query_time_ns);
+    result.status = query(request.query, result.results, budget);
+    if (profile.profile() != nullptr) {
+      profile.profile()->rows = result.results.size();
+    }
+  }
+
+  if (result.status.getCode() == kQueryBudgetExceeded) {
+    LOG(WARNING) << "Distributed query " << request.id
+                 << " truncated: " << result.status.getMessage();
+  } else if (!result.status.ok()) {
+    LOG(ERROR) << "Error executing distributed query: " << request.id << ": "
+               << result.status.getMessage();
+  }
+
+  Distributed::setCurrentRequestId("");
+  return result;
+}
+
+void Distributed::recoverQueries() {
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kQueries, keys, kDistributedResultPrefix);
+  for (const auto& key : keys) {
+    std::string json;
+    DistributedQueryResult result;
+    if (getDatabaseValue(kQueries, key, json).ok() &&
+        deserializeDistributedQueryResultJSON(json, result).ok()) {
+      addResult(std::move(result));
+    } else {
+      deleteDatabaseValue(kQueries, key);
+    }
+  }
+
+  // A query left executing may have caused the process to stop, do not retry.
+  keys.clear();
+  scanDatabaseKeys(kQueries, keys, kDistributedRunningPrefix);
+  for (const auto& key : keys) {
+    DistributedQueryRequest request;
+    request.id = key.substr(kDistributedRunningPrefix.size());
+    getDatabaseValue(kQueries, key, request.query);
+    LOG(WARNING) << "Distributed query did not complete: " << request.id;
+    addResult(DistributedQueryResult(
+        request,
+        {},
+        {},
+        Status(1, "Distributed query did not complete before osquery stopped")));
+  }
 }
 
 Status Distributed::runQueries() {
+  recoverQueries();
+
+  std::deque<DistributedQueryRequest> requests;
   while (getPendingQueryCount() > 0) {
-    auto request = popRequest();
-    LOG(INFO) << "Executing distributed query: " << request.id << ": "
-              << request.query;
+    requests.push_back(popRequest());
+  }
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::deque<DistributedQueryResult> completed;
+  auto worker = [this, &mutex, &condition, &requests, &completed]() {
+    while (true) {
+      DistributedQueryRequest request;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (requests.empty()) {
+          return;
+        }
+        request = std::move(requests.front());
+        requests.pop_front();
+      }
+
+      auto result = runQuery(request);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        completed.push_back(std::move(result));
+      }
+      condition.notify_one();
+    }
+  };
+
+  auto remaining = requests.size();
+  auto concurrency = std::min<size_t>(
+      std::max<uint32_t>(FLAGS_distributed_concurrency, 1), remaining);
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < concurrency; i++) {
+    workers.emplace_back(worker);
+  }
 
-    // Keep track of the currently executing request
-    Distributed::setCurrentRequestId(request.id);
+  // Flush results as they complete, a slow query does not delay the others.
+  Status status;
+  while (remaining > 0) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      condition.wait(lock, [&completed]() { return !completed.empty(); });
+      while (!completed.empty()) {
+        addResult(std::move(completed.front()));
+        completed.pop_front();
+        remaining--;
+      }
+    }
 
-    SQL sql(request.query);
-    if (!sql.getStatus().ok()) {
-      LOG(ERROR) << "Error executing distributed query: " << request.id << ": "
-                 << sql.getMessageString();
+    auto s = flushCompleted();
+    if (!s.ok()) {
+      status = s;
     }
+  }
 
-    DistributedQueryResult result(
-        request, sql.rows(), sql.columns(), sql.getStatus());
-    addResult(result);
+  for (auto& thread : workers) {
+    thread.join();
   }
-  return flushCompleted();
+
+  // Flush recovered results when no queries were executed.
+  auto s = flushCompleted();
+  return (s.ok()) ? status : s;
 }
 
 Status Distributed::flushCompleted() {
@@ -139,24 +307,37 @@ Status Distributed::flushCompleted() {
     return Status(0, "OK");
   }
 
+  auto s = Status(0, "OK");
   auto distributed_plugin = RegistryFactory::get().getActive("distributed");
   if (!RegistryFactory::get().exists("distributed", distributed_plugin)) {
-    return Status(1, "Missing distributed plugin " + distributed_plugin);
+    s = Status(1, "Missing distributed plugin " + distributed_plugin);
   }
 
-  std::string results;
-  auto s = serializeResults(results);
-  if (!s.ok()) {
-    return s;
+  if (s.ok()) {
+    std::string results;
+    s = serializeResults(results);
+    if (s.ok()) {
+      PluginResponse response;
+      s = Registry::call("distributed",
+                         {{"action", "writeResults"}, {"results", results}},
+                         response);
+    }
   }
 
-  PluginResponse response;
-  s = Registry::call("distributed",
-                     {{"action", "writeResults"}, {"results", results}},
-                     response);
-  if (s.ok()) {
-    results_.clear();
+  for (const auto& result : results_) {
+    if (!s.ok()) {
+      // Keep the result for a later run instead of executing the query again.
+      std::string json;
+      if (serializeDistributedQueryResultJSON(result, json).ok()) {
+        setDatabaseValue(
+            kQueries, kDistributedResultPrefix + result.request.id, json);
+      }
+    } else {
+      deleteDatabaseValue(kQueries, kDistributedResultPrefix + result.request.id);
+    }
+    deleteDatabaseValue(kQueries, kDistributedRunningPrefix + result.request.id);
   }
+  results_.clear();
   return s;
 }
 
@@ -248,6 +429,10 @@ DistributedQueryRequest Distributed::popRequest() {
   const auto& next = queries.front();
   request.id = next.substr(kDistributedQueryPrefix.size());
   getDatabaseValue(kQueries, next, request.query);
+
+  // The request is kept until its result is flushed or persisted.
+  setDatabaseValue(
+      kQueries, kDistributedRunningPrefix + request.id, request.query);
   deleteDatabaseValue(kQueries, next);
   return request;
 }
@@ -318,6 +503,10 @@ Status serializeDistributedQueryResult(const DistributedQueryResult& r,
 
   doc.add("request", request_obj);
   doc.add("results", results_arr);
+  doc.add("status", r.status.getCode());
+  if (!r.status.ok()) {
+    doc.addCopy("message", r.status.getMessage());
+  }
   return Status();
 }
 
@@ -349,6 +538,13 @@ Status deserializeDistributedQueryResult(const rj::Value& obj,
   r.request = request;
   r.results = results;
 
+  if (obj.HasMember("status") && obj["status"].IsInt()) {
+    std::string message;
+    if (obj.HasMember("message") && obj["message"].IsString()) {
+      message = obj["message"].GetString();
+    }
+    r.status = Status(obj["status"].GetInt(), message);
+  }
   return Status();
 }
 
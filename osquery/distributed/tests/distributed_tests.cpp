@@ -8,6 +8,7 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <algorithm>
 #include <iostream>
 
 #include <boost/property_tree/ptree.hpp>
@@ -15,6 +16,7 @@
 #include <gtest/gtest.h>
 
 #include <osquery/core.h>
+#include <osquery/database.h>
 #include <osquery/distributed.h>
 #include <osquery/enroll.h>
 #include <osquery/sql.h>
@@ -31,9 +33,50 @@ DECLARE_string(distributed_tls_write_endpoint);
 
 namespace osquery {
 
+DECLARE_uint32(distributed_concurrency);
+DECLARE_uint64(distributed_max_rows);
+
+class MockDistributedPlugin : public DistributedPlugin {
+ public:
+  Status getQueries(std::string& json) override {
+    json = "{}";
+    return Status();
+  }
+
+  Status writeResults(const std::string& json) override {
+    if (fail_) {
+      return Status(1, "Cannot write results");
+    }
+
+    auto doc = JSON::newObject();
+    if (!doc.fromString(json) || !doc.doc().IsObject()) {
+      return Status(1, "Cannot parse results");
+    }
+
+    for (const auto& status : doc.doc()["statuses"].GetObject()) {
+      auto id = std::string(status.name.GetString());
+      statuses[id] = status.value.GetInt();
+      rows[id] = doc.doc()["queries"][id.c_str()].Size();
+    }
+    writes++;
+    return Status();
+  }
+
+ public:
+  bool fail_{false};
+  size_t writes{0};
+  std::map<std::string, int> statuses;
+  std::map<std::string, size_t> rows;
+};
+
 class DistributedTests : public testing::Test {
  protected:
   void TearDown() override {
+    if (mock_ != nullptr) {
+      RegistryFactory::get().registry("distributed")->remove("mock");
+      RegistryFactory::get().setActive("distributed", active_);
+    }
+
     if (server_started_) {
       TLSServerRunner::stop();
       TLSServerRunner::unsetClientConfig();
@@ -63,7 +106,17 @@ class DistributedTests : public testing::Test {
     server_started_ = true;
   }
 
+  void useMockPlugin() {
+    auto& rf = RegistryFactory::get();
+    active_ = rf.getActive("distributed");
+    mock_ = std::make_shared<MockDistributedPlugin>();
+    rf.registry("distributed")->add("mock", mock_);
+    rf.setActive("distributed", "mock");
+  }
+
  protected:
+  std::shared_ptr<MockDistributedPlugin> mock_{nullptr};
+  std::string active_;
   std::string distributed_tls_read_endpoint_;
   std::string distributed_tls_write_endpoint_;
 
@@ -198,4 +251,71 @@ TEST_F(DistributedTests, test_workflow) {
   EXPECT_EQ(dist.getPendingQueryCount(), 0U);
   EXPECT_EQ(dist.results_.size(), 0U);
 }
+
+TEST_F(DistributedTests, test_run_queries_budget) {
+  useMockPlugin();
+  auto concurrency = FLAGS_distributed_concurrency;
+  auto max_rows = FLAGS_distributed_max_rows;
+  FLAGS_distributed_concurrency = 2;
+  FLAGS_distributed_max_rows = 2;
+
+  setDatabaseValue(kQueries,
+                   "distributed.many",
+                   "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 "
+                   "FROM c LIMIT 10) SELECT x FROM c");
+  setDatabaseValue(kQueries, "distributed.one", "SELECT 1 AS one");
+  setDatabaseValue(kQueries, "distributed.invalid", "SELECT * FROM no_table");
+
+  auto dist = Distributed();
+  auto s = dist.runQueries();
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(dist.getPendingQueryCount(), 0U);
+  EXPECT_EQ(dist.results_.size(), 0U);
+  EXPECT_GE(mock_->writes, 1U);
+
+  // The row limit truncates the result and is reported in the status.
+  ASSERT_EQ(mock_->statuses.size(), 3U);
+  EXPECT_EQ(mock_->statuses["many"], kQueryBudgetExceeded);
+  EXPECT_EQ(mock_->rows["many"], 2U);
+  EXPECT_EQ(mock_->statuses["one"], 0);
+  EXPECT_EQ(mock_->rows["one"], 1U);
+  EXPECT_NE(mock_->statuses["invalid"], 0);
+
+  FLAGS_distributed_concurrency = concurrency;
+  FLAGS_distributed_max_rows = max_rows;
+}
+
+TEST_F(DistributedTests, test_recover_queries) {
+  useMockPlugin();
+  mock_->fail_ = true;
+
+  // A query left executing by a previous process.
+  setDatabaseValue(kQueries, "distributed_running.stopped", "SELECT 1");
+  setDatabaseValue(kQueries, "distributed.next", "SELECT 1 AS one");
+
+  auto dist = Distributed();
+  auto s = dist.runQueries();
+  EXPECT_FALSE(s.ok());
+  EXPECT_EQ(mock_->writes, 0U);
+
+  // Neither query is executed again, both results are kept for the next run.
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kQueries, keys, "distributed");
+  std::sort(keys.begin(), keys.end());
+  ASSERT_EQ(keys.size(), 2U);
+  EXPECT_EQ(keys[0], "distributed_result.next");
+  EXPECT_EQ(keys[1], "distributed_result.stopped");
+
+  mock_->fail_ = false;
+  s = dist.runQueries();
+  EXPECT_TRUE(s.ok());
+  EXPECT_EQ(mock_->writes, 1U);
+  EXPECT_EQ(mock_->statuses["stopped"], 1);
+  EXPECT_EQ(mock_->statuses["next"], 0);
+  EXPECT_EQ(mock_->rows["next"], 1U);
+
+  keys.clear();
+  scanDatabaseKeys(kQueries, keys, "distributed");
+  EXPECT_TRUE(keys.empty());
+}
 }
@@ -10,6 +10,7 @@
 
 #include <chrono>
 #include <exception>
+#include <future>
 #include <thread>
 
 #include <boost/algorithm/string.hpp>
@@ -25,6 +26,8 @@
 #include <osquery/system.h>
 
 #include "osquery/core/conversions.h"
+#include "osquery/core/metrics.h"
+#include "osquery/core/watcher.h"
 
 namespace osquery {
 
@@ -36,6 +39,11 @@ CREATE_REGISTRY(EventSubscriberPlugin, "event_subscriber");
 
 FLAG(bool, disable_events, false, "Disable osquery publish/subscribe system");
 
+FLAG(bool,
+     events_lazy_start,
+     true,
+     "Start event publishers when a subscriber subscribes");
+
 FLAG(bool,
      events_optimize,
      true,
@@ -558,6 +566,16 @@ void EventSubscriberPlugin::get(RowYield& yield,
 }
 
 Status EventSubscriberPlugin::add(Row& r, EventTime event_time) {
+  // A watchdog responding to worker pressure may shed new events.
+  if (getWorkerPressure() >= WatchdogPressure::SHED_EVENTS) {
+    Metrics::get()
+        .counter("osquery_events_dropped_total",
+                 "Events dropped by a subscriber under watchdog pressure",
+                 {{"subscriber", getName()}})
+        .increment();
+    return Status(1, "Event dropped by the watchdog");
+  }
+
   // Get and increment the EID for this module.
   const std::string eid = getEventID();
   // Without encouraging a missing event time, do not support a 0-time.
@@ -594,6 +612,9 @@ Status EventSubscriberPlugin::add(Row& r, EventTime event_time) {
   // Record the event in the indexing bins, using the index time.
   recordEvent(eid, event_time);
   event_count_++;
+  if (added_counter_ != nullptr) {
+    added_counter_->increment();
+  }
   return status;
 }
 
@@ -618,15 +639,39 @@ void EventFactory::delay() {
     return;
   }
 
-  // Create a thread for each event publisher.
   auto& ef = EventFactory::getInstance();
-  for (const auto& publisher : EventFactory::getInstance().event_pubs_) {
+  {
+    WriteLock lock(ef.factory_lock_);
+    ef.delayed_ = true;
+  }
+  startPublishers();
+}
+
+void EventFactory::startPublishers() {
+  auto& ef = EventFactory::getInstance();
+  WriteLock lock(ef.factory_lock_);
+  if (!ef.delayed_) {
+    // The initializer has not allowed run loops to start.
+    return;
+  }
+
+  // Create a thread for each event publisher.
+  for (const auto& publisher : ef.event_pubs_) {
     // Publishers that did not set up correctly are put into an ending state.
-    if (!publisher.second->isEnding()) {
-      auto thread_ = std::make_shared<std::thread>(
-          boost::bind(&EventFactory::run, publisher.first));
-      ef.threads_.push_back(thread_);
+    if (publisher.second->isEnding() || ef.started_.count(publisher.first)) {
+      continue;
     }
+
+    // A publisher without subscriptions would fire events to no subscriber.
+    if (FLAGS_events_lazy_start && publisher.second->numSubscriptions() == 0) {
+      VLOG(1) << "Event publisher has no subscriptions: " << publisher.first;
+      continue;
+    }
+
+    auto thread_ = std::make_shared<std::thread>(
+        boost::bind(&EventFactory::run, publisher.first));
+    ef.threads_.push_back(thread_);
+    ef.started_.insert(publisher.first);
   }
 }
 
@@ -718,6 +763,9 @@ void EventFactory::configUpdate() {
   if (!FLAGS_disable_events) {
     RegistryFactory::get().registry("event_subscriber")->configure();
     RegistryFactory::get().registry("event_publisher")->configure();
+
+    // Configured subscribers may have subscribed to a publisher not started.
+    startPublishers();
   }
 }
 
@@ -882,6 +930,12 @@ Status EventFactory::registerEventSubscriber(const PluginRef& sub) {
     specialized_sub->tearDown();
   }
 
+  // Events are frequent, the subscriber's counter is found once.
+  specialized_sub->added_counter_ =
+      &Metrics::get().counter("osquery_events_added_total",
+                              "Events added by a subscriber",
+                              {{"subscriber", name}});
+
   // Allow subscribers a configure-time setup to determine if they should run.
   auto status = specialized_sub->setUp();
   if (!status) {
@@ -904,6 +958,9 @@ Status EventFactory::registerEventSubscriber(const PluginRef& sub) {
     ef.event_subs_[name] = specialized_sub;
   }
 
+  // A late subscriber may be the first to subscribe to a publisher.
+  startPublishers();
+
   // Set state of subscriber.
   if (!status.ok()) {
     specialized_sub->state(EventState::EVENT_FAILED);
@@ -1056,13 +1113,23 @@ void EventFactory::end(bool join) {
     // Threads may still be executing, when they finish, release publishers.
     ef.event_pubs_.clear();
     ef.event_subs_.clear();
+    ef.started_.clear();
+    ef.delayed_ = false;
   }
 }
 
 void attachEvents() {
+  // Publishers set up independent OS resources, set up each concurrently.
+  // Every publisher must be set up before a subscriber subscribes.
   const auto& publishers = RegistryFactory::get().plugins("event_publisher");
+  std::vector<std::future<Status>> setups;
   for (const auto& publisher : publishers) {
-    EventFactory::registerEventPublisher(publisher.second);
+    setups.push_back(std::async(std::launch::async,
+                                &EventFactory::registerEventPublisher,
+                                publisher.second));
+  }
+  for (auto& setup : setups) {
+    setup.wait();
   }
 
   const auto& subscribers = RegistryFactory::get().plugins("event_subscriber");
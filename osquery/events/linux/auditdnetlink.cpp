@@ -22,6 +22,7 @@
 #include <osquery/logger.h>
 
 #include "osquery/core/conversions.h"
+#include "osquery/core/metrics.h"
 #include "osquery/events/linux/auditdnetlink.h"
 #include "osquery/tables/events/linux/process_events.h"
 #include "osquery/tables/events/linux/process_file_events.h"
@@ -103,6 +104,22 @@ AuditdNetlink::AuditdNetlink() {
   }
 }
 
+/// Records read from the netlink socket and waiting for the parser.
+static MetricGauge& getUnprocessedGauge() {
+  static auto& gauge =
+      Metrics::get().gauge("osquery_auditd_unprocessed_records",
+                           "Audit records waiting for the netlink parser");
+  return gauge;
+}
+
+/// Parsed records waiting for the audit publisher.
+static MetricGauge& getProcessedGauge() {
+  static auto& gauge =
+      Metrics::get().gauge("osquery_auditd_processed_events",
+                           "Parsed audit records waiting for the publisher");
+  return gauge;
+}
+
 std::vector<AuditEventRecord> AuditdNetlink::getEvents() noexcept {
   std::vector<AuditEventRecord> record_list;
 
@@ -115,6 +132,7 @@ std::vector<AuditEventRecord> AuditdNetlink::getEvents() noexcept {
         std::cv_status::no_timeout) {
       record_list = std::move(auditd_context_->processed_events);
       auditd_context_->processed_events.clear();
+      getProcessedGauge().set(0);
     }
   }
 
@@ -269,6 +287,8 @@ bool AuditdNetlinkReader::acquireMessages() noexcept {
         auditd_context_->unprocessed_records.end(),
         read_buffer_.begin(),
         std::next(read_buffer_.begin(), events_received));
+    getUnprocessedGauge().set(
+        static_cast<int64_t>(auditd_context_->unprocessed_records.size()));
 
     auditd_context_->unprocessed_records_cv.notify_all();
   }
@@ -662,6 +682,7 @@ void AuditdNetlinkParser::start() {
 
       queue = std::move(auditd_context_->unprocessed_records);
       auditd_context_->unprocessed_records.clear();
+      getUnprocessedGauge().set(0);
     }
 
     std::vector<AuditEventRecord> audit_event_record_queue;
@@ -720,6 +741,8 @@ void AuditdNetlinkParser::start() {
           auditd_context_->processed_events.end(),
           audit_event_record_queue.begin(),
           audit_event_record_queue.end());
+      getProcessedGauge().set(
+          static_cast<int64_t>(auditd_context_->processed_events.size()));
 
       auditd_context_->processed_records_cv.notify_all();
     }
@@ -189,6 +189,31 @@ TEST_F(EventsTests, test_create_subscription) {
   EXPECT_TRUE(status.ok());
 }
 
+TEST_F(EventsTests, test_event_publisher_lazy_start) {
+  std::string lazy_publisher_type = "LazyPublisher";
+
+  auto pub = std::make_shared<BasicEventPublisher>();
+  pub->setName(lazy_publisher_type);
+  EventFactory::registerEventPublisher(pub);
+
+  // A publisher without subscriptions is not started.
+  EventFactory::delay();
+  auto& ef = EventFactory::getInstance();
+  EXPECT_EQ(ef.started_.count(lazy_publisher_type), 0U);
+
+  // The publisher starts once a subscriber subscribes.
+  auto subscription = Subscription::create("subscriber");
+  auto status =
+      EventFactory::addSubscription(lazy_publisher_type, subscription);
+  EXPECT_TRUE(status.ok());
+  EventFactory::startPublishers();
+  EXPECT_EQ(ef.started_.count(lazy_publisher_type), 1U);
+
+  // A started publisher is not started again.
+  EventFactory::startPublishers();
+  EXPECT_EQ(ef.threads_.size(), 1U);
+}
+
 TEST_F(EventsTests, test_multiple_subscriptions) {
   std::string basic_publisher_type = "BasicPublisher";
 
@@ -230,6 +230,9 @@ class PlatformFile : private boost::noncopyable {
   /// Write a number of bytes from a buffer.
   ssize_t write(const void* buf, size_t nbyte);
 
+  /// Flush written data to the underlying storage device.
+  bool sync();
+
   /// Use the platform-specific seek.
   off_t seek(off_t offset, SeekMode mode);
 
@@ -32,6 +32,10 @@
 #include "osquery/core/json.h"
 #include "osquery/filesystem/fileops.h"
 
+#ifndef WIN32
+#include "osquery/filesystem/traverse.h"
+#endif
+
 namespace pt = boost::property_tree;
 namespace fs = boost::filesystem;
 namespace errc = boost::system::errc;
@@ -296,11 +300,34 @@ static bool checkForLoops(std::set<int>& dsym_inos, std::string path) {
   return false;
 }
 
+/// Check if a path is a directory by its trailing separator.
+static bool isGlobDirectory(const std::string& path) {
+  return !path.empty() && (path.back() == '/' || path.back() == '\\');
+}
+
+static const std::string& getGlobPath(const std::string& found) {
+  return found;
+}
+
+static const std::string& getGlobPath(const ResolvedPath& found) {
+  return found.path;
+}
+
+/// Remove results that do not match the requested glob limitations.
+template <typename T>
+static void pruneGlobs(std::vector<T>& results, GlobLimits limits) {
+  auto end = std::remove_if(
+      results.begin(), results.end(), [limits](const T& found) {
+        bool directory = isGlobDirectory(getGlobPath(found));
+        return !((directory && limits & GLOB_FOLDERS) ||
+                 (!directory && limits & GLOB_FILES));
+      });
+  results.erase(end, results.end());
+}
+
 static void genGlobs(std::string path,
                      std::vector<std::string>& results,
                      GlobLimits limits) {
-  // Use our helped escape/replace for wildcards.
-  replaceGlobWildcards(path, limits);
   // inodes of directory symlinks for loop detection
   std::set<int> dsym_inos;
 
@@ -328,16 +355,66 @@ static void genGlobs(std::string path,
   }
 
   // Prune results based on settings/requested glob limitations.
-  auto end = std::remove_if(
-      results.begin(), results.end(), [limits](const std::string& found) {
-        return !(((found[found.length() - 1] == '/' ||
-                   found[found.length() - 1] == '\\') &&
-                  limits & GLOB_FOLDERS) ||
-                 ((found[found.length() - 1] != '/' &&
-                   found[found.length() - 1] != '\\') &&
-                  limits & GLOB_FILES));
-      });
-  results.erase(end, results.end());
+  pruneGlobs(results, limits);
+}
+
+#ifndef WIN32
+/**
+ * @brief Walk the directories matching a pattern ending in a double star.
+ *
+ * Globbing each level again re-reads every directory above it. Instead the
+ * base pattern is globbed once and each matching directory is traversed,
+ * concurrently and with a stat of every entry.
+ */
+static bool genRecursiveGlobs(const std::string& path,
+                              std::vector<ResolvedPath>& results) {
+  if (path.size() < 3 || path.compare(path.size() - 3, 3, "/**") != 0) {
+    return false;
+  }
+
+  auto base = path.substr(0, path.size() - 2);
+  std::vector<std::string> roots;
+  if (base.find_first_of("*?[{~") == std::string::npos) {
+    roots.push_back(base);
+  } else {
+    for (auto& root : platformGlob(base)) {
+      if (isGlobDirectory(root)) {
+        roots.push_back(std::move(root));
+      }
+    }
+  }
+
+  auto status = traverseDirectories(roots, getTraversalLimits(), results);
+  if (!status.ok()) {
+    LOG(WARNING) << "Incomplete results for " << path << ": "
+                 << status.getMessage();
+  }
+  return true;
+}
+#endif
+
+static void genResolvedGlobs(std::string path,
+                             std::vector<ResolvedPath>& results,
+                             GlobLimits limits) {
+  // Use our helped escape/replace for wildcards.
+  replaceGlobWildcards(path, limits);
+
+#ifndef WIN32
+  std::vector<ResolvedPath> walked;
+  if (genRecursiveGlobs(path, walked)) {
+    pruneGlobs(walked, limits);
+    results.reserve(results.size() + walked.size());
+    std::move(walked.begin(), walked.end(), std::back_inserter(results));
+    return;
+  }
+#endif
+
+  std::vector<std::string> paths;
+  genGlobs(path, paths, limits);
+  results.reserve(results.size() + paths.size());
+  for (auto& found : paths) {
+    results.emplace_back(std::move(found));
+  }
 }
 
 Status resolveFilePattern(const fs::path& fs_path,
@@ -348,7 +425,19 @@ Status resolveFilePattern(const fs::path& fs_path,
 Status resolveFilePattern(const fs::path& fs_path,
                           std::vector<std::string>& results,
                           GlobLimits setting) {
-  genGlobs(fs_path.string(), results, setting);
+  std::vector<ResolvedPath> resolved;
+  genResolvedGlobs(fs_path.string(), resolved, setting);
+  results.reserve(results.size() + resolved.size());
+  for (auto& found : resolved) {
+    results.push_back(std::move(found.path));
+  }
+  return Status(0, "OK");
+}
+
+Status resolveFilePattern(const fs::path& fs_path,
+                          std::vector<ResolvedPath>& results,
+                          GlobLimits setting) {
+  genResolvedGlobs(fs_path.string(), results, setting);
   return Status(0, "OK");
 }
 
@@ -406,8 +495,7 @@ inline Status listInAbsoluteDirectory(const fs::path& path,
     return Status(1, "Path not a directory: " + path.parent_path().string());
   }
 
-  genGlobs(path.string(), results, limits);
-  return Status(0, "OK");
+  return resolveFilePattern(path, results, limits);
 }
 
 Status listFilesInDirectory(const fs::path& path,
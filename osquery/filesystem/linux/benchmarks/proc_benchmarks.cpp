@@ -0,0 +1,114 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <fstream>
+
+#include <benchmark/benchmark.h>
+
+#include <boost/filesystem.hpp>
+
+#include <osquery/filesystem.h>
+
+#include "osquery/core/conversions.h"
+#include "osquery/filesystem/linux/proc.h"
+#include "osquery/tests/test_util.h"
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+const std::string kProcBenchmarkStat =
+    "4242 (osqueryd) S 1 4242 4242 0 -1 4194560 1024 0 0 0 150 70 0 0 20 0 "
+    "12 0 98765 123456789 4567 18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 "
+    "17 3 0 0 0 0 0\n";
+
+const std::string kProcBenchmarkStatus =
+    "Name:\tosqueryd\nUmask:\t0022\nState:\tS (sleeping)\nTgid:\t4242\n"
+    "Ngid:\t0\nPid:\t4242\nPPid:\t1\nTracerPid:\t0\n"
+    "Uid:\t0\t0\t0\t0\nGid:\t0\t0\t0\t0\nFDSize:\t64\nGroups:\t\n"
+    "NStgid:\t4242\nNSpid:\t4242\nNSpgid:\t4242\nNSsid:\t4242\n"
+    "VmPeak:\t  123456 kB\nVmSize:\t  123456 kB\nVmLck:\t       0 kB\n"
+    "VmPin:\t       0 kB\nVmHWM:\t   20480 kB\nVmRSS:\t   18268 kB\n"
+    "RssAnon:\t    9000 kB\nRssFile:\t    9268 kB\nThreads:\t12\n";
+
+/// Create a synthetic /proc tree with a number of processes.
+static std::string createProcTree(size_t processes) {
+  auto root = kTestWorkingDirectory + "proc-benchmark-" +
+              std::to_string(processes) + "/";
+  if (fs::exists(root)) {
+    return root;
+  }
+
+  for (size_t i = 1; i <= processes; i++) {
+    auto process = root + std::to_string(i) + "/";
+    fs::create_directories(process);
+    std::ofstream(process + "stat") << kProcBenchmarkStat;
+    std::ofstream(process + "status") << kProcBenchmarkStatus;
+  }
+  return root;
+}
+
+static void PROC_parse_stat(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    ProcStat stat;
+    procParseStat(kProcBenchmarkStat.data(), kProcBenchmarkStat.size(), stat);
+  }
+}
+
+BENCHMARK(PROC_parse_stat);
+
+static void PROC_parse_status(benchmark::State& state) {
+  while (state.KeepRunning()) {
+    ProcStatus status;
+    procParseStatus(
+        kProcBenchmarkStatus.data(), kProcBenchmarkStatus.size(), status);
+  }
+}
+
+BENCHMARK(PROC_parse_status);
+
+static void PROC_snapshot_tree(benchmark::State& state) {
+  auto root = createProcTree(state.range(0));
+  while (state.KeepRunning()) {
+    ProcessSnapshot snapshot(root);
+    for (const auto& pid : snapshot.pids()) {
+      ProcStat stat;
+      ProcStatus status;
+      snapshot.stat(pid, stat);
+      snapshot.status(pid, status);
+    }
+  }
+}
+
+BENCHMARK(PROC_snapshot_tree)->Arg(100)->Arg(1000);
+
+static void PROC_read_split_tree(benchmark::State& state) {
+  // Read and split each file as the process tables did before snapshots.
+  auto root = createProcTree(state.range(0));
+  while (state.KeepRunning()) {
+    std::set<std::string> pids;
+    for (fs::directory_iterator it(root), end; it != end; ++it) {
+      pids.insert(it->path().filename().string());
+    }
+
+    for (const auto& pid : pids) {
+      std::string content;
+      readFile(root + pid + "/stat", content);
+      auto details = split(content.substr(content.find_last_of(')') + 2), " ");
+      readFile(root + pid + "/status", content);
+      for (const auto& line : split(content, "\n")) {
+        auto detail = split(line, ":", 1);
+      }
+    }
+  }
+}
+
+BENCHMARK(PROC_read_split_tree)->Arg(100)->Arg(1000);
+}
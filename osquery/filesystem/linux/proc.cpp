@@ -8,18 +8,40 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <linux/limits.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <chrono>
+
+#include <boost/algorithm/string/trim.hpp>
 #include <boost/filesystem.hpp>
 
 #include <osquery/filesystem.h>
+#include <osquery/flags.h>
 #include <osquery/logger.h>
 
 #include "osquery/core/conversions.h"
 #include "osquery/filesystem/linux/proc.h"
 
 namespace osquery {
+
+FLAG(uint64,
+     process_snapshot_ttl,
+     1000,
+     "Milliseconds a snapshot of /proc is shared by process tables");
+
+/// Bytes read from /proc/<pid>/stat, more than the fields parsed.
+#define PROC_STAT_SIZE 1024
+
+/// Bytes read from /proc/<pid>/status, the fields parsed come first.
+#define PROC_STATUS_SIZE 4096
+
 const std::vector<std::string> kUserNamespaceList = {
     "cgroup", "ipc", "mnt", "net", "pid", "user", "uts"};
 
@@ -198,4 +220,413 @@ Status procReadDescriptor(const std::string& process,
   }
   return Status(1, "Could not read path");
 }
+
+/// Parse an unsigned decimal, and a leading '-', advancing the cursor.
+static bool parseProcInteger(const char*& cursor,
+                             const char* end,
+                             int64_t& value) {
+  while (cursor < end && (*cursor == ' ' || *cursor == '\t')) {
+    cursor++;
+  }
+
+  bool negative = (cursor < end && *cursor == '-');
+  if (negative) {
+    cursor++;
+  }
+
+  if (cursor >= end || *cursor < '0' || *cursor > '9') {
+    return false;
+  }
+
+  uint64_t parsed = 0;
+  while (cursor < end && *cursor >= '0' && *cursor <= '9') {
+    parsed = parsed * 10 + static_cast<uint64_t>(*cursor - '0');
+    cursor++;
+  }
+  value = (negative) ? -static_cast<int64_t>(parsed)
+                     : static_cast<int64_t>(parsed);
+  return true;
+}
+
+Status procParseStat(const char* content, size_t size, ProcStat& stat) {
+  // The process name may contain spaces and ')', fields follow the last ')'.
+  const char* end = content + size;
+  const char* cursor = end;
+  while (cursor > content && *(cursor - 1) != ')') {
+    cursor--;
+  }
+
+  if (cursor == content || end - cursor < 3 || *cursor != ' ') {
+    return Status(1, "Invalid /proc/stat header");
+  }
+  stat.state = *(cursor + 1);
+  cursor += 2;
+
+  // Fields are numbered from the state, which is field 0.
+  int64_t fields[22] = {0};
+  for (size_t field = 1; field < 22; field++) {
+    if (!parseProcInteger(cursor, end, fields[field])) {
+      return Status(1, "Invalid /proc/stat content");
+    }
+  }
+
+  stat.parent = fields[1];
+  stat.group = fields[2];
+  stat.user_time = static_cast<uint64_t>(fields[11]);
+  stat.system_time = static_cast<uint64_t>(fields[12]);
+  stat.nice = fields[16];
+  stat.threads = fields[17];
+  stat.start_time = static_cast<uint64_t>(fields[19]);
+  stat.resident_pages = static_cast<uint64_t>(fields[21]);
+  return Status(0, "OK");
+}
+
+/// Match a status line key, advancing the cursor to its value.
+static bool matchStatusKey(const char*& cursor,
+                           const char* end,
+                           const char* key,
+                           size_t length) {
+  if (static_cast<size_t>(end - cursor) <= length ||
+      ::strncmp(cursor, key, length) != 0 || cursor[length] != ':') {
+    return false;
+  }
+  cursor += length + 1;
+  return true;
+}
+
+/// Parse the real, effective, and saved ids of a Uid or Gid line.
+static void parseStatusIds(const char* cursor,
+                           const char* end,
+                           int64_t& real,
+                           int64_t& effective,
+                           int64_t& saved) {
+  int64_t ids[3] = {-1, -1, -1};
+  for (auto& id : ids) {
+    if (!parseProcInteger(cursor, end, id)) {
+      return;
+    }
+  }
+  real = ids[0];
+  effective = ids[1];
+  saved = ids[2];
+}
+
+Status procParseStatus(const char* content, size_t size, ProcStatus& status) {
+  const char* end = content + size;
+  const char* line = content;
+  bool named = false;
+  while (line < end) {
+    const char* line_end = line;
+    while (line_end < end && *line_end != '\n') {
+      line_end++;
+    }
+
+    const char* cursor = line;
+    if (matchStatusKey(cursor, line_end, "Name", 4)) {
+      while (cursor < line_end && (*cursor == ' ' || *cursor == '\t')) {
+        cursor++;
+      }
+      auto length = std::min(static_cast<size_t>(line_end - cursor),
+                              sizeof(status.name) - 1);
+      ::memcpy(status.name, cursor, length);
+      while (length > 0 && status.name[length - 1] == ' ') {
+        length--;
+      }
+      status.name[length] = '\0';
+      named = true;
+    } else if (matchStatusKey(cursor, line_end, "Uid", 3)) {
+      parseStatusIds(cursor,
+                     line_end,
+                     status.real_uid,
+                     status.effective_uid,
+                     status.saved_uid);
+    } else if (matchStatusKey(cursor, line_end, "Gid", 3)) {
+      parseStatusIds(cursor,
+                     line_end,
+                     status.real_gid,
+                     status.effective_gid,
+                     status.saved_gid);
+    } else if (matchStatusKey(cursor, line_end, "VmSize", 6)) {
+      parseProcInteger(cursor, line_end, status.total_size);
+    } else if (matchStatusKey(cursor, line_end, "VmRSS", 5)) {
+      // The remaining fields follow the memory sizes.
+      parseProcInteger(cursor, line_end, status.resident_size);
+      break;
+    }
+    line = line_end + 1;
+  }
+
+  if (!named) {
+    return Status(1, "Invalid /proc/status content");
+  }
+  return Status(0, "OK");
+}
+
+/// Build the path of a process file relative to /proc.
+static bool getProcFilePath(const std::string& process_id,
+                            const char* name,
+                            char* path,
+                            size_t size) {
+  auto length = ::snprintf(path, size, "%s/%s", process_id.c_str(), name);
+  return length > 0 && static_cast<size_t>(length) < size;
+}
+
+/// Read up to size bytes of a process file into a buffer, -1 on error.
+static ssize_t readProcFile(int proc_fd,
+                            const std::string& process_id,
+                            const char* name,
+                            char* buffer,
+                            size_t size) {
+  char path[PATH_MAX];
+  if (!getProcFilePath(process_id, name, path, sizeof(path))) {
+    return -1;
+  }
+
+  int fd = ::openat(proc_fd, path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return -1;
+  }
+
+  size_t total = 0;
+  while (total < size) {
+    auto bytes = ::read(fd, buffer + total, size - total);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    } else if (bytes < 0) {
+      ::close(fd);
+      return -1;
+    } else if (bytes == 0) {
+      break;
+    }
+    total += static_cast<size_t>(bytes);
+  }
+  ::close(fd);
+  return static_cast<ssize_t>(total);
+}
+
+Status procReadStat(int proc_fd,
+                    const std::string& process_id,
+                    ProcStat& stat) {
+  char content[PROC_STAT_SIZE];
+  auto bytes =
+      readProcFile(proc_fd, process_id, "stat", content, sizeof(content));
+  if (bytes < 0) {
+    return Status(1, "Cannot read /proc/stat");
+  }
+  return procParseStat(content, static_cast<size_t>(bytes), stat);
+}
+
+std::shared_ptr<ProcessSnapshot> ProcessSnapshot::get() {
+  static Mutex mutex;
+  static std::shared_ptr<ProcessSnapshot> snapshot;
+  static std::chrono::steady_clock::time_point taken;
+
+  WriteLock lock(mutex);
+  auto now = std::chrono::steady_clock::now();
+  auto age = std::chrono::duration_cast<std::chrono::milliseconds>(now - taken);
+  if (snapshot == nullptr ||
+      static_cast<uint64_t>(age.count()) >= FLAGS_process_snapshot_ttl) {
+    snapshot = std::make_shared<ProcessSnapshot>();
+    taken = now;
+  }
+  return snapshot;
+}
+
+ProcessSnapshot::ProcessSnapshot(const std::string& root) {
+  fd_ = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd_ < 0) {
+    VLOG(1) << "Cannot open the process directory: " << root;
+  }
+}
+
+ProcessSnapshot::~ProcessSnapshot() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+/// Process identifiers are positive decimals.
+static bool isProcessId(const std::string& process_id) {
+  if (process_id.empty() || process_id.size() > 10 || process_id[0] == '0') {
+    return false;
+  }
+  return std::all_of(process_id.begin(), process_id.end(), [](char c) {
+    return c >= '0' && c <= '9';
+  });
+}
+
+const std::set<std::string>& ProcessSnapshot::pids() {
+  WriteLock lock(mutex_);
+  if (pids_loaded_ || fd_ < 0) {
+    return pids_;
+  }
+  pids_loaded_ = true;
+
+  // The directory stream owns a duplicate, the snapshot keeps its descriptor.
+  int list_fd = ::openat(fd_, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  auto dir = (list_fd >= 0) ? ::fdopendir(list_fd) : nullptr;
+  if (dir == nullptr) {
+    if (list_fd >= 0) {
+      ::close(list_fd);
+    }
+    VLOG(1) << "Cannot list the process directory";
+    return pids_;
+  }
+
+  struct dirent* entry = nullptr;
+  while ((entry = ::readdir(dir)) != nullptr) {
+    std::string process_id(entry->d_name);
+    if ((entry->d_type == DT_DIR || entry->d_type == DT_UNKNOWN) &&
+        isProcessId(process_id)) {
+      pids_.insert(std::move(process_id));
+    }
+  }
+  ::closedir(dir);
+  return pids_;
+}
+
+bool ProcessSnapshot::exists(const std::string& process_id) const {
+  struct stat st;
+  return fd_ >= 0 && isProcessId(process_id) &&
+         ::fstatat(fd_, process_id.c_str(), &st, 0) == 0 &&
+         S_ISDIR(st.st_mode);
+}
+
+Status ProcessSnapshot::stat(const std::string& process_id, ProcStat& stat) {
+  {
+    WriteLock lock(mutex_);
+    auto& entry = entries_[process_id];
+    if (entry.stat_loaded) {
+      stat = entry.stat;
+      return entry.stat_status;
+    }
+  }
+
+  ProcStat loaded;
+  auto status = (isProcessId(process_id))
+                    ? procReadStat(fd_, process_id, loaded)
+                    : Status(1, "Invalid process identifier");
+
+  WriteLock lock(mutex_);
+  auto& entry = entries_[process_id];
+  entry.stat = loaded;
+  entry.stat_status = status;
+  entry.stat_loaded = true;
+  stat = loaded;
+  return status;
+}
+
+Status ProcessSnapshot::status(const std::string& process_id,
+                               ProcStatus& status) {
+  {
+    WriteLock lock(mutex_);
+    auto& entry = entries_[process_id];
+    if (entry.status_loaded) {
+      status = entry.status;
+      return entry.status_status;
+    }
+  }
+
+  ProcStatus loaded;
+  char content[PROC_STATUS_SIZE];
+  auto bytes = (isProcessId(process_id))
+                   ? readProcFile(
+                         fd_, process_id, "status", content, sizeof(content))
+                   : -1;
+  // /proc/N/status may be not available, or readable by this user.
+  auto result =
+      (bytes < 0)
+          ? Status(1, "Cannot read /proc/status")
+          : procParseStatus(content, static_cast<size_t>(bytes), loaded);
+
+  WriteLock lock(mutex_);
+  auto& entry = entries_[process_id];
+  entry.status = loaded;
+  entry.status_status = result;
+  entry.status_loaded = true;
+  status = loaded;
+  return result;
+}
+
+std::string ProcessSnapshot::cmdline(const std::string& process_id) {
+  {
+    WriteLock lock(mutex_);
+    auto& entry = entries_[process_id];
+    if (entry.cmdline_loaded) {
+      return entry.cmdline;
+    }
+  }
+
+  std::string content;
+  read(process_id, "cmdline", content);
+  // Remove \0 delimiters.
+  std::replace(content.begin(), content.end(), '\0', ' ');
+  // Remove trailing delimiter.
+  boost::algorithm::trim(content);
+
+  WriteLock lock(mutex_);
+  auto& entry = entries_[process_id];
+  entry.cmdline = content;
+  entry.cmdline_loaded = true;
+  return content;
+}
+
+std::string ProcessSnapshot::link(const std::string& process_id,
+                                  const std::string& name) {
+  {
+    WriteLock lock(mutex_);
+    auto& links = entries_[process_id].links;
+    auto item = links.find(name);
+    if (item != links.end()) {
+      return item->second;
+    }
+  }
+
+  char path[PATH_MAX];
+  char target[PATH_MAX] = {0};
+  std::string result;
+  if (isProcessId(process_id) &&
+      getProcFilePath(process_id, name.c_str(), path, sizeof(path))) {
+    auto length = ::readlinkat(fd_, path, target, sizeof(target) - 1);
+    if (length > 0) {
+      result.assign(target, static_cast<size_t>(length));
+    }
+  }
+
+  WriteLock lock(mutex_);
+  entries_[process_id].links[name] = result;
+  return result;
+}
+
+Status ProcessSnapshot::read(const std::string& process_id,
+                             const std::string& name,
+                             std::string& content) const {
+  content.clear();
+  char path[PATH_MAX];
+  if (!isProcessId(process_id) ||
+      !getProcFilePath(process_id, name.c_str(), path, sizeof(path))) {
+    return Status(1, "Invalid process file");
+  }
+
+  int fd = ::openat(fd_, path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return Status(1, "Cannot open process file: " + name);
+  }
+
+  char buffer[4096];
+  while (true) {
+    auto bytes = ::read(fd, buffer, sizeof(buffer));
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    } else if (bytes < 0) {
+      ::close(fd);
+      return Status(1, "Cannot read process file: " + name);
+    } else if (bytes == 0) {
+      break;
+    }
+    content.append(buffer, static_cast<size_t>(bytes));
+  }
+  ::close(fd);
+  return Status(0, "OK");
+}
 } // namespace osquery
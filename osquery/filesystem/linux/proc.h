@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <memory>
+#include <set>
 #include <unordered_map>
 
 #include <arpa/inet.h>
@@ -18,6 +20,9 @@
 
 #include <boost/filesystem.hpp>
 
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core.h>
 #include <osquery/filesystem.h>
 #include <osquery/logger.h>
 
@@ -26,6 +31,121 @@
 namespace osquery {
 const std::string kLinuxProcPath = "/proc";
 
+/// Fields parsed from /proc/<pid>/stat, times are in clock ticks.
+struct ProcStat final {
+  char state{0};
+  int64_t parent{0};
+  int64_t group{0};
+  uint64_t user_time{0};
+  uint64_t system_time{0};
+  int64_t nice{0};
+  int64_t threads{0};
+  uint64_t start_time{0};
+  uint64_t resident_pages{0};
+};
+
+/// Fields parsed from /proc/<pid>/status, -1 if not reported.
+struct ProcStatus final {
+  char name[64]{0};
+  int64_t real_uid{-1};
+  int64_t effective_uid{-1};
+  int64_t saved_uid{-1};
+  int64_t real_gid{-1};
+  int64_t effective_gid{-1};
+  int64_t saved_gid{-1};
+
+  /// Virtual memory size in kB.
+  int64_t total_size{-1};
+
+  /// Resident set size in kB.
+  int64_t resident_size{-1};
+};
+
+/// Parse the content of /proc/<pid>/stat without allocating.
+Status procParseStat(const char* content, size_t size, ProcStat& stat);
+
+/// Parse the content of /proc/<pid>/status without allocating.
+Status procParseStatus(const char* content, size_t size, ProcStatus& status);
+
+/**
+ * @brief Read and parse /proc/<pid>/stat relative to a /proc descriptor.
+ *
+ * The file is read into a stack buffer, used by the watcher to sample
+ * processes without allocating.
+ */
+Status procReadStat(int proc_fd, const std::string& process_id, ProcStat& stat);
+
+/**
+ * @brief A snapshot of the processes in /proc, shared by the process tables.
+ *
+ * Files are opened relative to a descriptor of the /proc directory. The
+ * process list is read once, when first used, and the attributes of each
+ * process are read when first requested and then kept. A table only reads
+ * the attributes of the columns used by its query.
+ *
+ * Snapshots are shared by queries for process_snapshot_ttl milliseconds, so
+ * tables joined or scheduled together walk /proc once.
+ */
+class ProcessSnapshot : private boost::noncopyable {
+ public:
+  /// Return the shared snapshot, a new one if it expired.
+  static std::shared_ptr<ProcessSnapshot> get();
+
+  /// Take a snapshot of a /proc directory, a synthetic tree for tests.
+  explicit ProcessSnapshot(const std::string& root = kLinuxProcPath);
+
+  ~ProcessSnapshot();
+
+  /// The process identifiers, listed when first requested.
+  const std::set<std::string>& pids();
+
+  /// True if the identifier names a process directory.
+  bool exists(const std::string& process_id) const;
+
+  Status stat(const std::string& process_id, ProcStat& stat);
+
+  Status status(const std::string& process_id, ProcStatus& status);
+
+  /// The command line, arguments are delimited by spaces.
+  std::string cmdline(const std::string& process_id);
+
+  /// The target of a link such as exe, cwd, or root, empty on error.
+  std::string link(const std::string& process_id, const std::string& name);
+
+  /// Read a file of a process, not kept by the snapshot.
+  Status read(const std::string& process_id,
+              const std::string& name,
+              std::string& content) const;
+
+ private:
+  struct Entry {
+    Status stat_status{1, "Not read"};
+    ProcStat stat;
+    bool stat_loaded{false};
+
+    Status status_status{1, "Not read"};
+    ProcStatus status;
+    bool status_loaded{false};
+
+    std::string cmdline;
+    bool cmdline_loaded{false};
+
+    std::map<std::string, std::string> links;
+  };
+
+ private:
+  /// The /proc directory descriptor.
+  int fd_{-1};
+
+  std::set<std::string> pids_;
+  bool pids_loaded_{false};
+
+  std::unordered_map<std::string, Entry> entries_;
+
+  /// Protects the process list and entries, not held while reading.
+  Mutex mutex_;
+};
+
 struct ProcessSocket final {
   std::string socket;
   int family{0};
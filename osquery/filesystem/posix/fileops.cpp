@@ -232,6 +232,14 @@ ssize_t PlatformFile::write(const void* buf, size_t nbyte) {
   return ret;
 }
 
+bool PlatformFile::sync() {
+  if (!isValid()) {
+    return false;
+  }
+
+  return (::fsync(handle_) == 0);
+}
+
 off_t PlatformFile::seek(off_t offset, SeekMode mode) {
   if (!isValid()) {
     return -1;
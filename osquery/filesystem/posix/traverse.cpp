@@ -0,0 +1,395 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/flags.h>
+
+#include "osquery/core/process.h"
+#include "osquery/filesystem/traverse.h"
+
+namespace osquery {
+
+FLAG(uint64,
+     glob_workers,
+     4,
+     "Threads walking the directories of a recursive pattern");
+
+FLAG(uint64,
+     glob_max_depth,
+     64,
+     "Levels of directories walked by a recursive pattern (default 64)");
+
+FLAG(uint64,
+     glob_max_entries,
+     0,
+     "Maximum paths resolved by a recursive pattern, 0 is unlimited");
+
+FLAG(uint64,
+     glob_timeout,
+     0,
+     "Milliseconds to resolve a recursive pattern, 0 is unlimited");
+
+/// Bytes of directory entries read by each getdents64.
+#define TRAVERSE_BUFFER_SIZE (32 * 1024)
+
+TraversalLimits getTraversalLimits() {
+  TraversalLimits limits;
+  limits.max_depth = FLAGS_glob_max_depth;
+  limits.max_entries = FLAGS_glob_max_entries;
+  limits.timeout = FLAGS_glob_timeout;
+  limits.workers = FLAGS_glob_workers;
+  return limits;
+}
+
+#ifdef __linux__
+/// The record returned by getdents64, which glibc does not declare.
+struct LinuxDirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[1];
+};
+#endif
+
+/// Call a function with the name of each entry of an open directory.
+template <typename Function>
+static void readDirectory(int fd, Function func) {
+#ifdef __linux__
+  // Tables yielding rows walk directories on a coroutine's small stack.
+  std::unique_ptr<uint64_t[]> records(
+      new uint64_t[TRAVERSE_BUFFER_SIZE / sizeof(uint64_t)]);
+  auto buffer = reinterpret_cast<char*>(records.get());
+  while (true) {
+    auto bytes = syscall(SYS_getdents64, fd, buffer, TRAVERSE_BUFFER_SIZE);
+    if (bytes <= 0) {
+      break;
+    }
+
+    for (long offset = 0; offset < bytes;) {
+      auto entry = reinterpret_cast<struct LinuxDirent64*>(buffer + offset);
+      offset += entry->d_reclen;
+      func(entry->d_name);
+    }
+  }
+#else
+  int dir_fd = dup(fd);
+  DIR* dir = (dir_fd < 0) ? nullptr : fdopendir(dir_fd);
+  if (dir == nullptr) {
+    if (dir_fd >= 0) {
+      close(dir_fd);
+    }
+    return;
+  }
+
+  struct dirent* entry = nullptr;
+  while ((entry = readdir(dir)) != nullptr) {
+    func(entry->d_name);
+  }
+  closedir(dir);
+#endif
+}
+
+namespace {
+
+/// A directory waiting to be read, its path ends with a '/'.
+struct TraversalDirectory {
+  std::string path;
+  size_t depth{0};
+};
+
+class Traversal : private boost::noncopyable {
+ public:
+  explicit Traversal(const TraversalLimits& limits)
+      : limits_(limits),
+        queues_(std::max<size_t>(limits.workers, 1)),
+        results_(queues_.size()),
+        start_(std::chrono::steady_clock::now()) {}
+
+  /// Queue a root directory, roots that are not directories are skipped.
+  void addRoot(std::string root);
+
+  /// Walk the queued directories, the calling thread is one of the workers.
+  void run();
+
+  /// Move the sorted results, failing if a limit stopped the traversal.
+  Status collect(std::vector<ResolvedPath>& results);
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<TraversalDirectory> directories;
+  };
+
+  void work(size_t worker);
+  bool pop(size_t worker, TraversalDirectory& directory);
+  void push(size_t worker, TraversalDirectory directory);
+  void walk(size_t worker, const TraversalDirectory& directory);
+
+  /// Record a directory, return false if it was walked before.
+  bool visit(const struct stat& dir_stat);
+
+  /// Stop every worker, keeping the first reason.
+  void stop(const std::string& reason);
+
+ private:
+  const TraversalLimits limits_;
+
+  /// One queue of directories per worker.
+  std::vector<Queue> queues_;
+
+  /// Entries found by each worker.
+  std::vector<std::vector<ResolvedPath>> results_;
+
+  /// Directories queued or being read, the walk ends when none are left.
+  std::atomic<size_t> pending_{0};
+
+  /// Directories queued and not yet taken by a worker.
+  std::atomic<size_t> queued_{0};
+
+  /// Entries found by all workers.
+  std::atomic<size_t> entries_{0};
+
+  std::atomic<bool> stopped_{false};
+  std::string reason_;
+
+  /// Idle workers wait for a directory to be queued or the walk to end.
+  std::mutex idle_mutex_;
+  std::condition_variable idle_;
+
+  /// Device and inode of each directory walked.
+  std::mutex visited_mutex_;
+  std::set<std::pair<dev_t, ino_t>> visited_;
+
+  std::chrono::steady_clock::time_point start_;
+  size_t next_root_{0};
+};
+
+void Traversal::addRoot(std::string root) {
+  struct stat root_stat;
+  if (root.empty() || ::stat(root.c_str(), &root_stat) != 0 ||
+      !S_ISDIR(root_stat.st_mode) || !visit(root_stat)) {
+    return;
+  }
+
+  if (root.back() != '/') {
+    root += '/';
+  }
+  push(next_root_++ % queues_.size(), {std::move(root), 0});
+}
+
+void Traversal::run() {
+  if (pending_ == 0) {
+    return;
+  }
+
+  // The calling thread is charged for the CPU time of the others.
+  auto charge = getThreadResourceCharge();
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < queues_.size(); ++i) {
+    threads.emplace_back([this, i, charge]() {
+      ScopedResourceCharge scope(charge);
+      work(i);
+    });
+  }
+  work(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+Status Traversal::collect(std::vector<ResolvedPath>& results) {
+  size_t count = 0;
+  for (const auto& found : results_) {
+    count += found.size();
+  }
+
+  std::vector<ResolvedPath> sorted;
+  sorted.reserve(count);
+  for (auto& found : results_) {
+    std::move(found.begin(), found.end(), std::back_inserter(sorted));
+    found.clear();
+  }
+  std::sort(sorted.begin(),
+            sorted.end(),
+            [](const ResolvedPath& a, const ResolvedPath& b) {
+              return a.path < b.path;
+            });
+  std::move(sorted.begin(), sorted.end(), std::back_inserter(results));
+
+  if (stopped_) {
+    return Status(1, reason_);
+  }
+  return Status(0, "OK");
+}
+
+void Traversal::work(size_t worker) {
+  while (true) {
+    TraversalDirectory directory;
+    if (pop(worker, directory)) {
+      walk(worker, directory);
+      if (--pending_ == 0) {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        idle_.notify_all();
+      }
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    idle_.wait(lock, [this]() {
+      return queued_ > 0 || pending_ == 0 || stopped_;
+    });
+    if (pending_ == 0 || (stopped_ && queued_ == 0)) {
+      return;
+    }
+  }
+}
+
+bool Traversal::pop(size_t worker, TraversalDirectory& directory) {
+  // Take the newest directory of this worker, for locality, or steal the
+  // oldest directory of another, which is likely a large subtree.
+  for (size_t i = 0; i < queues_.size(); ++i) {
+    auto& queue = queues_[(worker + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.directories.empty()) {
+      continue;
+    }
+
+    if (i == 0) {
+      directory = std::move(queue.directories.back());
+      queue.directories.pop_back();
+    } else {
+      directory = std::move(queue.directories.front());
+      queue.directories.pop_front();
+    }
+    queued_--;
+    return true;
+  }
+  return false;
+}
+
+void Traversal::push(size_t worker, TraversalDirectory directory) {
+  pending_++;
+  {
+    std::lock_guard<std::mutex> lock(queues_[worker].mutex);
+    queues_[worker].directories.push_back(std::move(directory));
+    queued_++;
+  }
+
+  std::lock_guard<std::mutex> lock(idle_mutex_);
+  idle_.notify_one();
+}
+
+bool Traversal::visit(const struct stat& dir_stat) {
+  std::lock_guard<std::mutex> lock(visited_mutex_);
+  return visited_.emplace(dir_stat.st_dev, dir_stat.st_ino).second;
+}
+
+void Traversal::stop(const std::string& reason) {
+  std::lock_guard<std::mutex> lock(idle_mutex_);
+  if (!stopped_) {
+    reason_ = reason;
+    stopped_ = true;
+  }
+  idle_.notify_all();
+}
+
+void Traversal::walk(size_t worker, const TraversalDirectory& directory) {
+  if (stopped_) {
+    return;
+  }
+
+  if (limits_.timeout > 0 &&
+      std::chrono::steady_clock::now() - start_ >
+          std::chrono::milliseconds(limits_.timeout)) {
+    stop("Traversal timed out after " + std::to_string(limits_.timeout) +
+         "ms");
+    return;
+  }
+
+  int fd = ::open(directory.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+
+  auto depth = directory.depth + 1;
+  bool descend = limits_.max_depth == 0 || depth < limits_.max_depth;
+  auto& results = results_[worker];
+  readDirectory(fd, [&](const char* name) {
+    if (stopped_ || name[0] == '\0' || (name[0] == '.' && !limits_.hidden) ||
+        strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
+      return;
+    }
+
+    if (limits_.max_entries > 0 && ++entries_ > limits_.max_entries) {
+      stop("Traversal exceeded " + std::to_string(limits_.max_entries) +
+           " entries");
+      return;
+    }
+
+    ResolvedPath entry(directory.path + name);
+    if (::fstatat(fd, name, &entry.file_stat, AT_SYMLINK_NOFOLLOW) == 0) {
+      entry.has_stat = true;
+      if (S_ISLNK(entry.file_stat.st_mode)) {
+        entry.symlink = true;
+        struct stat target_stat;
+        if (::fstatat(fd, name, &target_stat, 0) == 0) {
+          entry.file_stat = target_stat;
+        }
+      }
+    }
+
+    if (entry.has_stat && S_ISDIR(entry.file_stat.st_mode)) {
+      entry.path += '/';
+      if (descend && (!entry.symlink || limits_.follow_symlinks) &&
+          visit(entry.file_stat)) {
+        push(worker, {entry.path, depth});
+      }
+    }
+    results.push_back(std::move(entry));
+  });
+  ::close(fd);
+}
+} // namespace
+
+Status traverseDirectories(const std::vector<std::string>& roots,
+                           const TraversalLimits& limits,
+                           std::vector<ResolvedPath>& results) {
+  Traversal traversal(limits);
+  for (const auto& root : roots) {
+    traversal.addRoot(root);
+  }
+
+  traversal.run();
+  return traversal.collect(results);
+}
+} // namespace osquery
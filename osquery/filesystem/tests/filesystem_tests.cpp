@@ -25,6 +25,10 @@
 #include "osquery/core/process.h"
 #include "osquery/tests/test_util.h"
 
+#ifndef WIN32
+#include "osquery/filesystem/traverse.h"
+#endif
+
 // Some proc* functions are only compiled when building on linux
 #ifdef __linux__
 #include "osquery/filesystem/linux/proc.h"
@@ -327,6 +331,24 @@ TEST_F(FilesystemTests, test_wildcard_double_folders) {
                            .string()));
 }
 
+TEST_F(FilesystemTests, test_wildcard_double_status) {
+  std::vector<ResolvedPath> results;
+  auto status =
+      resolveFilePattern(kFakeDirectory + "/%%", results, GLOB_FILES);
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(results.size(), 10U);
+
+  if (!isPlatform(PlatformType::TYPE_WINDOWS)) {
+    // Walked paths include the status of each file, and of symlink targets.
+    for (const auto& file : results) {
+      ASSERT_TRUE(file.has_stat);
+      EXPECT_TRUE(S_ISREG(file.file_stat.st_mode));
+      auto symlink = file.path.find("root2.txt") != std::string::npos;
+      EXPECT_EQ(file.symlink, symlink);
+    }
+  }
+}
+
 TEST_F(FilesystemTests, test_wildcard_end_last_component) {
   std::vector<std::string> results;
   auto status = resolveFilePattern(kFakeDirectory + "/%11/%sh", results);
@@ -450,6 +472,87 @@ TEST_F(FilesystemTests, test_user_namespace_parser) {
   removePath(temp_path);
   EXPECT_EQ(namespace_inode, static_cast<ino_t>(112233));
 }
+
+TEST_F(FilesystemTests, test_proc_stat_parser) {
+  // The process name may contain spaces and parentheses.
+  std::string content =
+      "1234 (a) b (c) S 1 1234 1234 0 -1 4194560 100 0 0 0 15 7 0 0 20 -5 3 "
+      "0 98765 12345678 456 18446744073709551615 1 1 0 0 0 0 0 0 0\n";
+  ProcStat stat;
+  ASSERT_TRUE(procParseStat(content.data(), content.size(), stat).ok());
+  EXPECT_EQ('S', stat.state);
+  EXPECT_EQ(1, stat.parent);
+  EXPECT_EQ(1234, stat.group);
+  EXPECT_EQ(15U, stat.user_time);
+  EXPECT_EQ(7U, stat.system_time);
+  EXPECT_EQ(-5, stat.nice);
+  EXPECT_EQ(3, stat.threads);
+  EXPECT_EQ(98765U, stat.start_time);
+  EXPECT_EQ(456U, stat.resident_pages);
+
+  content = "1234 (a) S 1 1234";
+  EXPECT_FALSE(procParseStat(content.data(), content.size(), stat).ok());
+
+  content =
+      "Name:\tosqueryd\nUmask:\t0022\nState:\tS (sleeping)\n"
+      "Uid:\t1000\t1001\t1002\t1003\nGid:\t100\t101\t102\t103\n"
+      "VmSize:\t  123456 kB\nVmRSS:\t   7890 kB\nThreads:\t3\n";
+  ProcStatus status;
+  ASSERT_TRUE(procParseStatus(content.data(), content.size(), status).ok());
+  EXPECT_EQ("osqueryd", std::string(status.name));
+  EXPECT_EQ(1000, status.real_uid);
+  EXPECT_EQ(1001, status.effective_uid);
+  EXPECT_EQ(1002, status.saved_uid);
+  EXPECT_EQ(100, status.real_gid);
+  EXPECT_EQ(101, status.effective_gid);
+  EXPECT_EQ(102, status.saved_gid);
+  EXPECT_EQ(123456, status.total_size);
+  EXPECT_EQ(7890, status.resident_size);
+
+  // Kernel threads do not report memory sizes.
+  content = "Name:\tkthreadd\nUid:\t0\t0\t0\t0\n";
+  ProcStatus kernel_status;
+  ASSERT_TRUE(
+      procParseStatus(content.data(), content.size(), kernel_status).ok());
+  EXPECT_EQ(0, kernel_status.real_uid);
+  EXPECT_EQ(-1, kernel_status.resident_size);
+}
+
+TEST_F(FilesystemTests, test_process_snapshot) {
+  auto root = fs::unique_path(kTestWorkingDirectory + "proc-%%%%");
+  fs::create_directories(root / "42");
+  fs::create_directories(root / "self");
+  {
+    std::ofstream stat((root / "42" / "stat").string());
+    stat << "42 (test) R 1 42 42 0 -1 0 0 0 0 0 11 12 0 0 20 0 1 0 500 0 9\n";
+    std::ofstream cmdline((root / "42" / "cmdline").string());
+    cmdline << std::string("/bin/test\0--flag\0", 17);
+  }
+  EXPECT_EQ(symlink("/bin/test", (root / "42" / "exe").c_str()), 0);
+
+  ProcessSnapshot snapshot(root.string());
+  EXPECT_EQ(std::set<std::string>({"42"}), snapshot.pids());
+  EXPECT_TRUE(snapshot.exists("42"));
+  EXPECT_FALSE(snapshot.exists("self"));
+  EXPECT_FALSE(snapshot.exists("../42"));
+
+  ProcStat stat;
+  ASSERT_TRUE(snapshot.stat("42", stat).ok());
+  EXPECT_EQ('R', stat.state);
+  EXPECT_EQ(11U, stat.user_time);
+  EXPECT_EQ("/bin/test --flag", snapshot.cmdline("42"));
+  EXPECT_EQ("/bin/test", snapshot.link("42", "exe"));
+
+  ProcStatus status;
+  EXPECT_FALSE(snapshot.status("42", status).ok());
+
+  // Attributes are kept for the lifetime of the snapshot.
+  removePath(root.string());
+  ASSERT_TRUE(snapshot.stat("42", stat).ok());
+  EXPECT_EQ(500U, stat.start_time);
+  EXPECT_EQ("/bin/test --flag", snapshot.cmdline("42"));
+  EXPECT_EQ(ProcessSnapshot::get(), ProcessSnapshot::get());
+}
 #endif
 
 TEST_F(FilesystemTests, test_read_proc) {
@@ -494,4 +597,64 @@ TEST_F(FilesystemTests, test_read_urandom) {
     EXPECT_NE(first, second);
   }
 }
+
+#ifndef WIN32
+TEST_F(FilesystemTests, test_traverse_directories) {
+  TraversalLimits limits;
+  limits.workers = 4;
+
+  std::vector<ResolvedPath> results;
+  auto status = traverseDirectories({kFakeDirectory}, limits, results);
+  EXPECT_TRUE(status.ok());
+  ASSERT_EQ(results.size(), 20U);
+  EXPECT_TRUE(std::is_sorted(results.begin(),
+                             results.end(),
+                             [](const ResolvedPath& a, const ResolvedPath& b) {
+                               return a.path < b.path;
+                             }));
+
+  // Limit the walk to the entries of the roots.
+  results.clear();
+  limits.max_depth = 1;
+  status = traverseDirectories({kFakeDirectory}, limits, results);
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(results.size(), 7U);
+  EXPECT_EQ(results[0].path, kFakeDirectory + "/deep1/");
+
+  // Limits on entries stop the walk with partial results.
+  results.clear();
+  limits.max_depth = 0;
+  limits.max_entries = 3;
+  status = traverseDirectories({kFakeDirectory}, limits, results);
+  EXPECT_FALSE(status.ok());
+  EXPECT_LE(results.size(), 3U);
+}
+
+TEST_F(FilesystemTests, test_traverse_symlinks) {
+  auto link = kFakeDirectory + "/toplevel/link";
+  ASSERT_EQ(symlink((kFakeDirectory + "/deep11").c_str(), link.c_str()), 0);
+  auto hidden = kFakeDirectory + "/.hidden";
+  ASSERT_TRUE(writeTextFile(hidden, "hidden").ok());
+
+  TraversalLimits limits;
+  std::vector<ResolvedPath> results;
+  traverseDirectories({kFakeDirectory + "/toplevel"}, limits, results);
+  ASSERT_EQ(results.size(), 5U);
+  EXPECT_EQ(results[0].path, link + "/");
+  EXPECT_TRUE(results[0].symlink);
+  EXPECT_TRUE(S_ISDIR(results[0].file_stat.st_mode));
+
+  // Symlinked directories are walked once, even if reached twice.
+  results.clear();
+  limits.follow_symlinks = true;
+  limits.hidden = true;
+  traverseDirectories({kFakeDirectory}, limits, results);
+  EXPECT_EQ(results.size(), 22U);
+  auto found = std::find_if(
+      results.begin(), results.end(), [&hidden](const ResolvedPath& file) {
+        return file.path == hidden;
+      });
+  EXPECT_NE(found, results.end());
+}
+#endif
 } // namespace osquery
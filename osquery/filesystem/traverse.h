@@ -0,0 +1,71 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <osquery/filesystem.h>
+
+namespace osquery {
+
+/// Limits of a directory traversal, a limit of 0 is unlimited.
+struct TraversalLimits {
+  /// Levels of directories below each root.
+  size_t max_depth{0};
+
+  /// Paths returned by the traversal.
+  size_t max_entries{0};
+
+  /// Milliseconds before the traversal stops.
+  size_t timeout{0};
+
+  /// Threads reading directories.
+  size_t workers{1};
+
+  /// Descend into symlinks to directories, which may leave the roots.
+  bool follow_symlinks{false};
+
+  /// Return entries with names starting with a '.', glob skips them.
+  bool hidden{false};
+};
+
+/// The limits set by the glob_* flags, used when resolving patterns.
+TraversalLimits getTraversalLimits();
+
+/**
+ * @brief Walk every directory below a set of roots.
+ *
+ * Directories are read concurrently by a set of workers. Each worker owns a
+ * queue of directories, takes the newest it queued, and steals the oldest
+ * from another worker when its queue is empty. Every entry is stat-ed
+ * relative to its directory's descriptor without following symlinks. The
+ * target of a symlink is stat-ed too, so the status is that of stat(2).
+ *
+ * Symlinks to directories are returned but only walked if the limits allow,
+ * a link such as /proc/<pid>/root otherwise walks the whole filesystem. Each
+ * directory is walked once, by device and inode, so symlink loops and bind
+ * mounts do not repeat. The roots are not returned. Paths of directories,
+ * including symlinks to directories, end with a '/' and results are sorted
+ * by path.
+ *
+ * This is only implemented on POSIX platforms.
+ *
+ * @param roots directories to walk.
+ * @param limits bounds on the depth, entries, and time of the walk.
+ * @param results output of every entry found.
+ *
+ * @return failure if a limit stopped the traversal, results are partial.
+ */
+Status traverseDirectories(const std::vector<std::string>& roots,
+                           const TraversalLimits& limits,
+                           std::vector<ResolvedPath>& results);
+} // namespace osquery
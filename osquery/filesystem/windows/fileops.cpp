@@ -1073,6 +1073,14 @@ off_t PlatformFile::seek(off_t offset, SeekMode mode) {
   return cursor_;
 }
 
+bool PlatformFile::sync() {
+  if (!isValid()) {
+    return false;
+  }
+
+  return (::FlushFileBuffers(handle_) != 0);
+}
+
 size_t PlatformFile::size() const {
   return ::GetFileSize(handle_, nullptr);
 }
@@ -31,6 +31,7 @@
 
 #include "osquery/core/conversions.h"
 #include "osquery/core/json.h"
+#include "osquery/sql/query_profile.h"
 
 namespace pt = boost::property_tree;
 namespace rj = rapidjson;
@@ -602,6 +603,46 @@ Status logQueryLogItem(const QueryLogItem& results) {
   return logQueryLogItem(results, RegistryFactory::get().getActive("logger"));
 }
 
+/**
+ * @brief Forward a batch of serialized result lines to each receiver.
+ *
+ * Plugins within the core receive the whole batch with one call. Plugins
+ * within extensions receive a registry call per line.
+ */
+static Status logBatch(const std::string& name,
+                       std::vector<std::string>& items,
+                       const std::string& receiver,
+                       bool snapshot) {
+  Status status;
+  auto loggers = osquery::split(receiver, ",");
+  for (size_t i = 0; i < loggers.size(); i++) {
+    const auto& logger = loggers[i];
+    if (FLAGS_logger_secondary_status_only &&
+        !BufferedLogSink::get().isPrimaryLogger(logger)) {
+      continue;
+    }
+
+    if (Registry::get().exists("logger", logger, true)) {
+      auto plugin = Registry::get().plugin("logger", logger);
+      auto logger_plugin = std::dynamic_pointer_cast<LoggerPlugin>(plugin);
+      // Only the last receiver may take ownership of the lines.
+      auto batch = (i + 1 < loggers.size()) ? items : std::move(items);
+      status = (snapshot) ? logger_plugin->logSnapshotBatch(name, batch)
+                          : logger_plugin->logStringBatch(name, batch);
+    } else {
+      for (const auto& item : items) {
+        if (snapshot) {
+          status = Registry::call("logger", logger, {{"snapshot", item}});
+        } else {
+          status = Registry::call(
+              "logger", logger, {{"string", item}, {"category", "event"}});
+        }
+      }
+    }
+  }
+  return status;
+}
+
 Status logQueryLogItem(const QueryLogItem& results,
                        const std::string& receiver) {
   if (FLAGS_disable_logging) {
@@ -610,21 +651,26 @@ Status logQueryLogItem(const QueryLogItem& results,
 
   std::vector<std::string> json_items;
   Status status;
-  if (FLAGS_logger_event_type) {
-    status = serializeQueryLogItemAsEventsJSON(results, json_items);
-  } else {
-    std::string json;
-    status = serializeQueryLogItemJSON(results, json);
-    json_items.emplace_back(json);
+  {
+    QueryProfiler::Timer timer(&QueryProfile::serialize_time_ns);
+    if (FLAGS_logger_event_type) {
+      status = serializeQueryLogItemAsEventsJSON(results, json_items);
+    } else {
+      std::string json;
+      status = serializeQueryLogItemJSON(results, json);
+      json_items.emplace_back(json);
+    }
   }
   if (!status.ok()) {
     return status;
   }
 
-  for (const auto& json : json_items) {
-    status = logString(json, "event", receiver);
+  if (json_items.empty()) {
+    return status;
   }
-  return status;
+
+  QueryProfiler::Timer timer(&QueryProfile::log_time_ns);
+  return logBatch(results.name, json_items, receiver, false);
 }
 
 Status logSnapshotQuery(const QueryLogItem& item) {
@@ -634,36 +680,29 @@ Status logSnapshotQuery(const QueryLogItem& item) {
 
   std::vector<std::string> json_items;
   Status status;
-  if (FLAGS_logger_snapshot_event_type) {
-    status = serializeQueryLogItemAsEventsJSON(item, json_items);
-  } else {
-    std::string json;
-    status = serializeQueryLogItemJSON(item, json);
-    json_items.emplace_back(json);
+  {
+    QueryProfiler::Timer timer(&QueryProfile::serialize_time_ns);
+    if (FLAGS_logger_snapshot_event_type) {
+      status = serializeQueryLogItemAsEventsJSON(item, json_items);
+    } else {
+      std::string json;
+      status = serializeQueryLogItemJSON(item, json);
+      json_items.emplace_back(json);
+    }
   }
   if (!status.ok()) {
     return status;
   }
 
-  for (const auto& json : json_items) {
-    auto receiver = RegistryFactory::get().getActive("logger");
-    for (const auto& logger : osquery::split(receiver, ",")) {
-      if (FLAGS_logger_secondary_status_only &&
-          !BufferedLogSink::get().isPrimaryLogger(logger)) {
-        continue;
-      }
-
-      if (Registry::get().exists("logger", logger, true)) {
-        auto plugin = Registry::get().plugin("logger", logger);
-        auto logger_plugin = std::dynamic_pointer_cast<LoggerPlugin>(plugin);
-        status = logger_plugin->logSnapshot(json);
-      } else {
-        status = Registry::call("logger", logger, {{"snapshot", json}});
-      }
-    }
+  if (json_items.empty()) {
+    return status;
   }
 
-  return status;
+  QueryProfiler::Timer timer(&QueryProfile::log_time_ns);
+  return logBatch(item.name,
+                  json_items,
+                  RegistryFactory::get().getActive("logger"),
+                  true);
 }
 
 size_t queuedStatuses() {
@@ -21,6 +21,7 @@
 
 #include "osquery/config/parsers/decorators.h"
 #include "osquery/core/json.h"
+#include "osquery/core/metrics.h"
 #include "osquery/logger/plugins/buffered.h"
 
 namespace pt = boost::property_tree;
@@ -36,6 +37,17 @@ const std::chrono::seconds BufferedLogForwarder::kLogPeriod{
     std::chrono::seconds(4)};
 const size_t BufferedLogForwarder::kMaxLogLines{1024};
 
+void BufferedLogForwarder::setBufferedGauge() {
+  // The gauge is resolved once per forwarder, metric references are stable.
+  if (buffered_gauge_ == nullptr) {
+    buffered_gauge_ = &Metrics::get().gauge(
+        "osquery_buffered_logs",
+        "Logs buffered by a forwarding logger plugin",
+        {{"logger", index_name_}});
+  }
+  buffered_gauge_->set(static_cast<int64_t>(buffer_count_));
+}
+
 Status BufferedLogForwarder::setUp() {
   // initialize buffer_count_ by scanning the DB
   std::vector<std::string> indexes;
@@ -47,6 +59,7 @@ Status BufferedLogForwarder::setUp() {
 
   RecursiveLock lock(count_mutex_);
   buffer_count_ = indexes.size();
+  setBufferedGauge();
   return Status(0);
 }
 
@@ -270,6 +283,7 @@ Status BufferedLogForwarder::addValueWithCount(const std::string& domain,
   if (status.ok()) {
     RecursiveLock lock(count_mutex_);
     buffer_count_++;
+    setBufferedGauge();
   }
   return status;
 }
@@ -282,6 +296,7 @@ Status BufferedLogForwarder::deleteValueWithCount(const std::string& domain,
     if (buffer_count_ > 0) {
       buffer_count_--;
     }
+    setBufferedGauge();
   }
   return status;
 }
@@ -22,6 +22,8 @@
 
 namespace osquery {
 
+class MetricGauge;
+
 /// Iterate through a vector, yielding during high utilization
 inline void iterate(std::vector<std::string>& input,
                     std::function<void(std::string&)> predicate) {
@@ -187,6 +189,9 @@ class BufferedLogForwarder : public InternalRunnable {
   Status deleteValueWithCount(const std::string& domain,
                               const std::string& key);
 
+  /// Export the count of buffered logs, the count mutex must be held
+  void setBufferedGauge();
+
  protected:
   /// Seconds between flushing logs
   std::chrono::seconds log_period_;
@@ -210,6 +215,9 @@ class BufferedLogForwarder : public InternalRunnable {
   /// Stores the count of buffered logs
   size_t buffer_count_{0};
 
+  /// Exports the count of buffered logs, resolved on first use
+  MetricGauge* buffered_gauge_{nullptr};
+
   /// Protects the count of buffered logs
   RecursiveMutex count_mutex_;
 };
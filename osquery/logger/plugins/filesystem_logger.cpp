@@ -14,6 +14,9 @@
 #include <osquery/flags.h>
 #include <osquery/logger.h>
 
+#include "osquery/filesystem/fileops.h"
+#include "osquery/logger/plugins/filesystem_logger.h"
+
 namespace fs = boost::filesystem;
 
 /**
@@ -33,9 +36,39 @@ FLAG_ALIAS(std::string, osquery_log_dir, logger_path);
 
 FLAG(int32, logger_mode, 0640, "Decimal mode for log files (default '0640')");
 
+FLAG(bool,
+     logger_fs_async,
+     false,
+     "Write filesystem results and snapshots from a dedicated thread");
+
+FLAG(uint64,
+     logger_fs_async_queue_size,
+     64 * 1024 * 1024,
+     "Bytes of results queued for the filesystem writer thread");
+
+FLAG(uint64,
+     logger_fs_sync_interval,
+     0,
+     "Seconds between fsyncs of filesystem results (0 leaves it to the OS)");
+
+FLAG(bool, logger_rotate, false, "Rotate filesystem results and snapshots");
+
+FLAG(uint64,
+     logger_rotate_size,
+     25 * 1024 * 1024,
+     "Size in bytes at which filesystem results logs are rotated");
+
+FLAG(uint64,
+     logger_rotate_max_files,
+     25,
+     "Number of rotated filesystem results logs to keep");
+
 const std::string kFilesystemLoggerFilename = "osqueryd.results.log";
 const std::string kFilesystemLoggerSnapshots = "osqueryd.snapshots.log";
 
+/// Lines are coalesced into writes of at most this many bytes.
+const size_t kFilesystemLoggerWriteSize = 1024 * 1024;
+
 class FilesystemLoggerPlugin : public LoggerPlugin {
  public:
   Status setUp() override;
@@ -43,9 +76,17 @@ class FilesystemLoggerPlugin : public LoggerPlugin {
   /// Log results (differential) to a distinct path.
   Status logString(const std::string& s) override;
 
+  /// Log a batch of results with a single file write.
+  Status logStringBatch(const std::string& name,
+                        std::vector<std::string>& items) override;
+
   /// Log snapshot data to a distinct path.
   Status logSnapshot(const std::string& s) override;
 
+  /// Log a batch of snapshot data with a single file write.
+  Status logSnapshotBatch(const std::string& name,
+                          std::vector<std::string>& items) override;
+
   /**
    * @brief Initialize the logger plugin after osquery has begun.
    *
@@ -65,12 +106,20 @@ class FilesystemLoggerPlugin : public LoggerPlugin {
                          const std::string& filename,
                          bool empty = false);
 
+  /// Write, or queue for the writer thread, a batch of lines.
+  Status logLinesToFile(std::vector<std::string>& lines,
+                        const std::string& filename);
+
  private:
   /// The folder where Glog and the result/snapshot files are written.
   fs::path log_path_;
 
-  /// Filesystem writer mutex.
-  Mutex mutex_;
+  /// The file writer shared with the optional writer thread.
+  std::shared_ptr<FilesystemLogFileWriter> file_writer_{
+      std::make_shared<FilesystemLogFileWriter>()};
+
+  /// The optional writer thread, used when logger_fs_async is set.
+  std::shared_ptr<FilesystemLogWriterRunner> runner_{nullptr};
 
  private:
   FRIEND_TEST(FilesystemLoggerTests, test_filesystem_init);
@@ -78,6 +127,181 @@ class FilesystemLoggerPlugin : public LoggerPlugin {
 
 REGISTER(FilesystemLoggerPlugin, "logger", "filesystem");
 
+Status FilesystemLogFileWriter::write(const fs::path& path,
+                                      const std::vector<std::string>& lines) {
+  WriteLock lock(mutex_);
+
+  size_t bytes = 0;
+  for (const auto& line : lines) {
+    bytes += line.size() + 1;
+  }
+
+  auto mode = PF_OPEN_ALWAYS | PF_WRITE | PF_APPEND;
+  auto output_fd = std::make_unique<PlatformFile>(path, mode, FLAGS_logger_mode);
+  if (!output_fd->isValid()) {
+    return Status(1, "Could not create file: " + path.string());
+  }
+
+  if (FLAGS_logger_rotate && output_fd->size() > 0 &&
+      output_fd->size() + bytes > FLAGS_logger_rotate_size) {
+    output_fd.reset();
+    rotate(path);
+    output_fd = std::make_unique<PlatformFile>(path, mode, FLAGS_logger_mode);
+    if (!output_fd->isValid()) {
+      return Status(1, "Could not create file: " + path.string());
+    }
+  }
+
+  // If the file existed with different permissions before our open
+  // they must be restricted.
+  if (!platformChmod(path.string(), FLAGS_logger_mode)) {
+    return Status(1, "Failed to change permissions for file: " + path.string());
+  }
+
+  std::string buffer;
+  buffer.reserve(std::min(bytes, kFilesystemLoggerWriteSize));
+  auto flush = [&output_fd, &buffer]() {
+    auto written = output_fd->write(buffer.data(), buffer.size());
+    bool ok = (static_cast<size_t>(written) == buffer.size());
+    buffer.clear();
+    return ok;
+  };
+
+  for (const auto& line : lines) {
+    if (!buffer.empty() &&
+        buffer.size() + line.size() + 1 > kFilesystemLoggerWriteSize) {
+      if (!flush()) {
+        return Status(1, "Failed to write contents to file: " + path.string());
+      }
+    }
+    buffer.append(line);
+    buffer.push_back('\n');
+  }
+
+  if (!buffer.empty() && !flush()) {
+    return Status(1, "Failed to write contents to file: " + path.string());
+  }
+
+  if (FLAGS_logger_fs_sync_interval > 0 && bytes > 0) {
+    auto now = std::chrono::steady_clock::now();
+    auto& last = syncs_[path.string()];
+    if (now - last >= std::chrono::seconds(FLAGS_logger_fs_sync_interval)) {
+      output_fd->sync();
+      last = now;
+    }
+  }
+
+  return Status(0, "OK");
+}
+
+void FilesystemLogFileWriter::rotate(const fs::path& path) {
+  auto rotated = [&path](size_t index) {
+    return fs::path(path.string() + "." + std::to_string(index));
+  };
+
+  boost::system::error_code ec;
+  if (FLAGS_logger_rotate_max_files == 0) {
+    fs::remove(path, ec);
+    return;
+  }
+
+  fs::remove(rotated(FLAGS_logger_rotate_max_files), ec);
+  for (size_t i = FLAGS_logger_rotate_max_files - 1; i > 0; i--) {
+    if (fs::exists(rotated(i), ec)) {
+      fs::rename(rotated(i), rotated(i + 1), ec);
+    }
+  }
+  fs::rename(path, rotated(1), ec);
+  if (ec) {
+    VLOG(1) << "Cannot rotate results log " << path.string() << ": "
+            << ec.message();
+  }
+  syncs_.erase(path.string());
+}
+
+void FilesystemLogWriterRunner::start() {
+  while (!interrupted()) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait_for(lock, std::chrono::seconds(1), [this]() {
+        return stopping_ || !pending_.empty();
+      });
+    }
+    drain();
+  }
+
+  // Write anything queued before the stop request.
+  drain();
+}
+
+void FilesystemLogWriterRunner::stop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  stopping_ = true;
+  condition_.notify_all();
+  drained_.notify_all();
+}
+
+bool FilesystemLogWriterRunner::enqueue(const fs::path& path,
+                                        std::vector<std::string>& lines) {
+  size_t bytes = 0;
+  for (const auto& line : lines) {
+    bytes += line.size() + 1;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  drained_.wait(lock, [this, bytes]() {
+    return stopping_ || pending_bytes_ == 0 ||
+           pending_bytes_ + bytes <= FLAGS_logger_fs_async_queue_size;
+  });
+  if (stopping_) {
+    return false;
+  }
+
+  auto& queue = pending_[path.string()];
+  if (queue.empty()) {
+    queue = std::move(lines);
+  } else {
+    queue.reserve(queue.size() + lines.size());
+    std::move(lines.begin(), lines.end(), std::back_inserter(queue));
+  }
+  pending_bytes_ += bytes;
+  condition_.notify_one();
+  return true;
+}
+
+void FilesystemLogWriterRunner::drain() {
+  std::map<std::string, std::vector<std::string>> pending;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    pending.swap(pending_);
+  }
+
+  for (const auto& file : pending) {
+    size_t bytes = 0;
+    for (const auto& line : file.second) {
+      bytes += line.size() + 1;
+    }
+
+    Status status;
+    try {
+      status = writer_->write(file.first, file.second);
+    } catch (const std::exception& e) {
+      status = Status(1, e.what());
+    }
+    if (!status.ok()) {
+      LOG(ERROR) << "Filesystem logger dropped " << file.second.size()
+                 << " lines: " << status.getMessage();
+    }
+
+    // The bytes are released once written, producers may queue more.
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      pending_bytes_ -= bytes;
+    }
+    drained_.notify_all();
+  }
+}
+
 Status FilesystemLoggerPlugin::setUp() {
   log_path_ = fs::path(FLAGS_logger_path);
 
@@ -85,6 +309,14 @@ Status FilesystemLoggerPlugin::setUp() {
   // Glog 0.3.4 does not support a logfile mode.
   // FLAGS_logfile_mode = FLAGS_logger_mode;
 
+  if (FLAGS_logger_fs_async && runner_ == nullptr) {
+    runner_ = std::make_shared<FilesystemLogWriterRunner>(file_writer_);
+    if (!Dispatcher::addService(runner_).ok()) {
+      // Fall back to writing from the calling thread.
+      runner_ = nullptr;
+    }
+  }
+
   // Ensure that we create the results log here.
   return logStringToFile("", kFilesystemLoggerFilename, true);
 }
@@ -93,20 +325,33 @@ Status FilesystemLoggerPlugin::logString(const std::string& s) {
   return logStringToFile(s, kFilesystemLoggerFilename);
 }
 
+Status FilesystemLoggerPlugin::logStringBatch(const std::string& name,
+                                              std::vector<std::string>& items) {
+  return logLinesToFile(items, kFilesystemLoggerFilename);
+}
+
 Status FilesystemLoggerPlugin::logStringToFile(const std::string& s,
                                                const std::string& filename,
                                                bool empty) {
-  WriteLock lock(mutex_);
-  Status status;
+  std::vector<std::string> lines;
+  if (!empty) {
+    lines.push_back(s);
+  }
+  return logLinesToFile(lines, filename);
+}
+
+Status FilesystemLoggerPlugin::logLinesToFile(std::vector<std::string>& lines,
+                                              const std::string& filename) {
+  auto path = log_path_ / filename;
+  if (runner_ != nullptr && !lines.empty() && runner_->enqueue(path, lines)) {
+    return Status(0, "OK");
+  }
+
   try {
-    status = writeTextFile((log_path_ / filename).string(),
-                           (empty) ? "" : s + '\n',
-                           FLAGS_logger_mode,
-                           true);
+    return file_writer_->write(path, lines);
   } catch (const std::exception& e) {
     return Status(1, e.what());
   }
-  return status;
 }
 
 Status FilesystemLoggerPlugin::logStatus(
@@ -128,6 +373,11 @@ Status FilesystemLoggerPlugin::logSnapshot(const std::string& s) {
   return logStringToFile(s, kFilesystemLoggerSnapshots);
 }
 
+Status FilesystemLoggerPlugin::logSnapshotBatch(
+    const std::string& name, std::vector<std::string>& items) {
+  return logLinesToFile(items, kFilesystemLoggerSnapshots);
+}
+
 void FilesystemLoggerPlugin::init(const std::string& name,
                                   const std::vector<StatusLogLine>& log) {
   // Stop the internal Glog facilities.
@@ -0,0 +1,112 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core.h>
+#include <osquery/dispatcher.h>
+
+namespace osquery {
+
+/**
+ * @brief Append batches of lines to the results and snapshot files.
+ *
+ * A batch is opened once, coalesced into large writes, and the file is
+ * rotated before the write if it would exceed the rotation size. The file
+ * is reopened for each batch such that external log rotation still works.
+ */
+class FilesystemLogFileWriter : private boost::noncopyable {
+ public:
+  /// Append each line, followed by a newline, to the file at path.
+  Status write(const boost::filesystem::path& path,
+               const std::vector<std::string>& lines);
+
+ private:
+  /// Shift path.N to path.N+1 and move path to path.1.
+  void rotate(const boost::filesystem::path& path);
+
+ private:
+  /// The last fsync time for each file path.
+  std::map<std::string, std::chrono::steady_clock::time_point> syncs_;
+
+  /// Serialize writes and rotations.
+  Mutex mutex_;
+};
+
+/**
+ * @brief A writer thread that drains queued batches to the filesystem.
+ *
+ * Producers move their lines into a per-file queue and return immediately.
+ * The file writes, fsyncs and rotations happen on this thread. The queued
+ * and in-progress bytes are bounded by logger_fs_async_queue_size, a
+ * producer waits for the writer when the queue is full.
+ */
+class FilesystemLogWriterRunner : public InternalRunnable {
+ public:
+  explicit FilesystemLogWriterRunner(
+      std::shared_ptr<FilesystemLogFileWriter> writer)
+      : InternalRunnable("FilesystemLogWriterRunner"),
+        writer_(std::move(writer)) {}
+
+  /// Drain the queue until interrupted.
+  void start() override;
+
+  /// Wake the thread so it can drain and exit.
+  void stop() override;
+
+  /**
+   * @brief Queue lines for the file at path.
+   *
+   * Waits while the queue is full, a batch larger than the queue is queued
+   * once the queue is empty.
+   *
+   * @return false if the writer is stopping and the caller must write.
+   */
+  bool enqueue(const boost::filesystem::path& path,
+               std::vector<std::string>& lines);
+
+ private:
+  /// Write every queued batch.
+  void drain();
+
+ private:
+  /// The shared file writer.
+  std::shared_ptr<FilesystemLogFileWriter> writer_;
+
+  /// Lines pending for each file path.
+  std::map<std::string, std::vector<std::string>> pending_;
+
+  /// Bytes of lines queued or being written.
+  size_t pending_bytes_{0};
+
+  /// Set when the runner is asked to stop.
+  bool stopping_{false};
+
+  /// Protect the pending queue and stopping state.
+  std::mutex mutex_;
+
+  /// Signal the writer thread that work is pending.
+  std::condition_variable condition_;
+
+  /// Signal producers that queued bytes were written.
+  std::condition_variable drained_;
+};
+} // namespace osquery
@@ -11,6 +11,9 @@
 
 #include <unistd.h>
 
+#include <algorithm>
+#include <thread>
+
 #include <boost/algorithm/string/find.hpp>
 
 #include <osquery/config.h>
@@ -20,6 +23,7 @@
 #include <osquery/system.h>
 
 #include "osquery/config/parsers/kafka_topics.h"
+#include "osquery/core/metrics.h"
 #include "osquery/logger/plugins/kafka_producer.h"
 #include "osquery/remote/transports/tls.h"
 
@@ -46,6 +50,32 @@ FLAG(string,
 /// How often to poll Kafka broker for publish results.
 const std::chrono::seconds kKafkaPollDuration = std::chrono::seconds(5);
 
+/// How often to poll while messages are waiting for delivery.
+const std::chrono::milliseconds kKafkaBusyPollDuration =
+    std::chrono::milliseconds(1000);
+
+/// The shortest interval between background polls.
+const std::chrono::milliseconds kKafkaMinPollDuration =
+    std::chrono::milliseconds(50);
+
+/// The busy poll interval is divided for each step of queued messages.
+const size_t kKafkaPollQueueStep = 1000;
+
+/// Attempts to produce a message while the producer queue is full.
+const size_t kKafkaQueueFullRetries = 3;
+
+/// How long to wait for the queue to drain between attempts.
+const std::chrono::milliseconds kKafkaQueueFullBackoff =
+    std::chrono::milliseconds(100);
+
+/// Count a produce attempt rejected by a full producer queue.
+static void countQueueFull() {
+  static auto& counter =
+      Metrics::get().counter("osquery_kafka_queue_full_total",
+                             "Kafka produce attempts retried on a full queue");
+  counter.increment();
+}
+
 /// Default Kafka topic to publish to if payload name is not found.
 const std::string kKafkaBaseTopic("base_topic");
 
@@ -112,18 +142,50 @@ inline std::string getMsgName(const std::string& payload) {
   return payload.substr(first + 1, last - first - 1);
 }
 
+std::chrono::milliseconds getKafkaPollInterval(size_t depth) {
+  if (depth == 0) {
+    return kKafkaPollDuration;
+  }
+
+  auto steps = static_cast<std::chrono::milliseconds::rep>(
+      1 + depth / kKafkaPollQueueStep);
+  return std::max(kKafkaBusyPollDuration / steps, kKafkaMinPollDuration);
+}
+
 /**
  * @brief callback for status of message delivery
  *
- * Logs an error message for failed deliveries; does nothing if successful.
+ * The opaque is the owning plugin, set when the producer is configured.
  * Callback is invoked by rd_kafka_poll.
  */
 void onMsgDelivery(rd_kafka_t* rk,
                    const rd_kafka_message_t* rkmessage,
                    void* opaque) {
-  if (rkmessage->err != RD_KAFKA_RESP_ERR_NO_ERROR) {
-    LOG(ERROR) << "Kafka message delivery failed: "
-               << rd_kafka_err2str(rkmessage->err);
+  auto plugin = static_cast<KafkaProducerPlugin*>(opaque);
+  if (plugin != nullptr) {
+    plugin->onDelivery(rkmessage);
+  }
+}
+
+void KafkaProducerPlugin::onDelivery(const rd_kafka_message_t* message) {
+  // The payload was moved into librdkafka when produced.
+  delete static_cast<std::string*>(message->_private);
+
+  countDelivery(message->err == RD_KAFKA_RESP_ERR_NO_ERROR);
+  if (message->err != RD_KAFKA_RESP_ERR_NO_ERROR) {
+    VLOG(1) << "Kafka message delivery failed: "
+            << rd_kafka_err2str(message->err);
+  }
+}
+
+void KafkaProducerPlugin::countDelivery(bool delivered) {
+  static MetricCounterFamily counters("osquery_kafka_deliveries_total",
+                                      "Kafka messages by delivery report",
+                                      "result",
+                                      {"delivered", "failed"});
+  counters.get((delivered) ? "delivered" : "failed").increment();
+  if (!delivered) {
+    delivery_errors_++;
   }
 }
 
@@ -137,13 +199,30 @@ void KafkaProducerPlugin::pollKafka() {
   rd_kafka_poll(producer_.get(), 0 /*non-blocking*/);
 }
 
+size_t KafkaProducerPlugin::queueDepth() {
+  WriteLock lock(producerMutex_);
+  if (producer_ == nullptr) {
+    return 0;
+  }
+  return static_cast<size_t>(rd_kafka_outq_len(producer_.get()));
+}
+
 void KafkaProducerPlugin::start() {
   while (!interrupted() && running_.load()) {
-    pauseMilli(kKafkaPollDuration);
+    pauseMilli(getKafkaPollInterval(queueDepth()));
     if (interrupted()) {
       return;
     }
     pollKafka();
+
+    // Summarize delivery failures rather than logging each message.
+    size_t errors = delivery_errors_;
+    if (errors > reported_errors_) {
+      LOG(ERROR) << "Kafka message delivery failed for "
+                 << (errors - reported_errors_) << " messages ("
+                 << queue_full_errors_ << " queue full errors in total)";
+      reported_errors_ = errors;
+    }
   }
 }
 
@@ -158,10 +237,11 @@ void KafkaProducerPlugin::stop() {
 
 void KafkaProducerPlugin::init(const std::string& name,
                                const std::vector<StatusLogLine>& log) {
-  // Get local hostname to use as client id and Kafka msg key.
+  // Get local hostname to use as client id.
   std::string hostname(getHostname());
 
-  msgKey_ = hostname + "_" + name;
+  // Key messages by host such that a host's results share a partition.
+  msgKey_ = getHostIdentifier();
 
   // Configure Kafka producer.
   char errstr[512] = {0};
@@ -193,7 +273,8 @@ void KafkaProducerPlugin::init(const std::string& name,
     return;
   }
 
-  // Register send callback.
+  // Register send callback, the callback releases payloads.
+  rd_kafka_conf_set_opaque(conf, this);
   rd_kafka_conf_set_dr_msg_cb(conf, onMsgDelivery);
 
   // Create producer handle.
@@ -223,6 +304,16 @@ void KafkaProducerPlugin::init(const std::string& name,
       this, [](KafkaProducerPlugin* k) { k->stop(); }));
 }
 
+rd_kafka_topic_t* KafkaProducerPlugin::getTopic(const std::string& name) {
+  auto it = queryToTopics_.find(name);
+  if (it != queryToTopics_.end()) {
+    return it->second;
+  }
+
+  it = queryToTopics_.find(kKafkaBaseTopic);
+  return (it != queryToTopics_.end()) ? it->second : nullptr;
+}
+
 Status KafkaProducerPlugin::logString(const std::string& payload) {
   if (!running_.load()) {
     return Status(
@@ -230,14 +321,44 @@ Status KafkaProducerPlugin::logString(const std::string& payload) {
   }
 
   std::string name(getMsgName(payload));
+  auto topic = getTopic(name);
+  if (topic == nullptr) {
+    std::string errMsg(
+        "Could not publish message: Topic not configured for message name '" +
+        name + "'");
+    LOG(ERROR) << errMsg;
+    return Status(2, errMsg);
+  }
 
-  rd_kafka_topic_t* topic = nullptr;
-  try {
-    topic = queryToTopics_.at(name);
-  } catch (const std::out_of_range& _) {
-    topic = queryToTopics_[kKafkaBaseTopic];
+  Status status = publishWithRetry(topic, std::string(payload));
+  if (!status.ok()) {
+    LOG(ERROR) << "Could not publish message: " << status.getMessage();
   }
 
+  // Poll after every produce attempt.
+  pollKafka();
+
+  return status;
+}
+
+Status KafkaProducerPlugin::logStringBatch(const std::string& name,
+                                           std::vector<std::string>& items) {
+  return publishBatch(name, items);
+}
+
+Status KafkaProducerPlugin::logSnapshotBatch(const std::string& name,
+                                             std::vector<std::string>& items) {
+  return publishBatch(name, items);
+}
+
+Status KafkaProducerPlugin::publishBatch(const std::string& name,
+                                         std::vector<std::string>& items) {
+  if (!running_.load()) {
+    return Status(
+        1, "Cannot log because Kafka producer did not initiate properly.");
+  }
+
+  auto topic = getTopic(name);
   if (topic == nullptr) {
     std::string errMsg(
         "Could not publish message: Topic not configured for message name '" +
@@ -246,31 +367,65 @@ Status KafkaProducerPlugin::logString(const std::string& payload) {
     return Status(2, errMsg);
   }
 
-  Status status = publishMsg(topic, payload);
+  Status status;
+  for (auto& item : items) {
+    auto publish_status = publishWithRetry(topic, std::move(item));
+    if (!publish_status.ok()) {
+      status = publish_status;
+    }
+  }
+
   if (!status.ok()) {
     LOG(ERROR) << "Could not publish message: " << status.getMessage();
   }
 
-  // Poll after every produce attempt.
+  // Poll once after the batch.
   pollKafka();
 
   return status;
 }
 
+Status KafkaProducerPlugin::publishWithRetry(rd_kafka_topic_t* topic,
+                                             std::string&& payload) {
+  Status status;
+  for (size_t attempt = 0; attempt < kKafkaQueueFullRetries; attempt++) {
+    status = publishMsg(topic, std::move(payload));
+    if (status.getCode() != kKafkaQueueFullCode) {
+      break;
+    }
+
+    // Serve delivery reports and let the queue drain.
+    queue_full_errors_++;
+    countQueueFull();
+    pollKafka();
+    if (attempt + 1 < kKafkaQueueFullRetries) {
+      std::this_thread::sleep_for(kKafkaQueueFullBackoff);
+    }
+  }
+  return status;
+}
+
 Status KafkaProducerPlugin::publishMsg(rd_kafka_topic_t* topic,
-                                       const std::string& payload) {
+                                       std::string&& payload) {
+  // Ownership of the payload moves to librdkafka, see onDelivery.
+  auto owned = new std::string(std::move(payload));
   if (rd_kafka_produce(topic,
                        RD_KAFKA_PARTITION_UA,
-                       RD_KAFKA_MSG_F_COPY,
-                       (char*)payload.c_str(),
-                       payload.length(),
+                       0, // Neither copy nor free, the opaque owns the payload
+                       &(*owned)[0],
+                       owned->length(),
                        msgKey_.c_str(), // Optional key
                        msgKey_.length(), // key length
-                       nullptr) == -1) {
-    return Status(1,
+                       owned) == -1) {
+    auto error = rd_kafka_last_error();
+    payload = std::move(*owned);
+    delete owned;
+
+    return Status((error == RD_KAFKA_RESP_ERR__QUEUE_FULL) ? kKafkaQueueFullCode
+                                                            : 1,
                   "Failed to produce on Kafka topic " +
                       std::string(rd_kafka_topic_name(topic)) + " : " +
-                      rd_kafka_err2str(rd_kafka_last_error()));
+                      rd_kafka_err2str(error));
   }
 
   return Status(0, "OK");
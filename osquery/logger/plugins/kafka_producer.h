@@ -11,6 +11,7 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <mutex>
 
 #include <librdkafka/rdkafka.h>
@@ -28,6 +29,20 @@ extern const std::string kKafkaBaseTopic;
 /// Retrieves log payload field "name".
 std::string getMsgName(const std::string& payload);
 
+/// Status code from publishMsg when the local producer queue is full.
+const int kKafkaQueueFullCode = 3;
+
+/**
+ * @brief Choose how long to wait before the next background poll.
+ *
+ * An idle producer is polled rarely. As the number of messages awaiting
+ * delivery grows the poll interval shrinks, such that delivery reports are
+ * served, and payloads released, promptly.
+ *
+ * @param depth The number of messages waiting in the producer queue.
+ */
+std::chrono::milliseconds getKafkaPollInterval(size_t depth);
+
 class KafkaProducerPlugin : public LoggerPlugin, public InternalRunnable {
  public:
   /*
@@ -38,6 +53,20 @@ class KafkaProducerPlugin : public LoggerPlugin, public InternalRunnable {
    */
   Status logString(const std::string& s) override;
 
+  /**
+   * @brief Logs a batch of results from a single query.
+   *
+   * The topic is resolved once using the query name and each payload is
+   * moved into the Kafka producer without a copy. The producer is polled
+   * once after the batch.
+   */
+  Status logStringBatch(const std::string& name,
+                        std::vector<std::string>& items) override;
+
+  /// See logStringBatch, snapshot results are published the same way.
+  Status logSnapshotBatch(const std::string& name,
+                          std::vector<std::string>& items) override;
+
   /**
    * @brief Initializes the Kafka producer.
    *
@@ -62,6 +91,23 @@ class KafkaProducerPlugin : public LoggerPlugin, public InternalRunnable {
    */
   void stop() override;
 
+  /**
+   * @brief Handle a delivery report from librdkafka.
+   *
+   * Releases the payload owned by librdkafka and counts failures.
+   */
+  void onDelivery(const rd_kafka_message_t* message);
+
+  /// The number of messages the brokers failed to accept.
+  size_t deliveryErrors() const {
+    return delivery_errors_;
+  }
+
+  /// The number of produce attempts rejected by a full producer queue.
+  size_t queueFullErrors() const {
+    return queue_full_errors_;
+  }
+
   KafkaProducerPlugin() : InternalRunnable("kafka_producer"), running_(false) {}
   ~KafkaProducerPlugin() {}
 
@@ -72,13 +118,28 @@ class KafkaProducerPlugin : public LoggerPlugin, public InternalRunnable {
   /**
    * @brief Publishes message to Kafka topic.
    *
+   * The payload is moved into the producer and released when delivery is
+   * reported. If the produce fails the payload is left with the caller.
+   *
    * @param topic Kafka topic to publish to
-   * @param msg message body
+   * @param payload message body
    *
-   * @return Status of publish attempt
+   * @return Status of publish attempt, kKafkaQueueFullCode if the producer
+   * queue is full
    */
-  virtual Status publishMsg(rd_kafka_topic_t* topic,
-                            const std::string& payload);
+  virtual Status publishMsg(rd_kafka_topic_t* topic, std::string&& payload);
+
+  /// Count a delivery report, exported as osquery_kafka_deliveries_total.
+  void countDelivery(bool delivered);
+
+  /// Resolve the configured topic for a query name.
+  rd_kafka_topic_t* getTopic(const std::string& name);
+
+  /// Publish, and retry while the producer queue is full.
+  Status publishWithRetry(rd_kafka_topic_t* topic, std::string&& payload);
+
+  /// Publish each payload from a query to the same topic.
+  Status publishBatch(const std::string& name, std::vector<std::string>& items);
 
   /**
    * @brief Flushes all buffered messages to Kafka, waiting for a maximum of 3
@@ -92,12 +153,21 @@ class KafkaProducerPlugin : public LoggerPlugin, public InternalRunnable {
    */
   virtual void pollKafka();
 
+  /// The number of messages waiting in the producer queue.
+  virtual size_t queueDepth();
+
   /// Boolean representing whether the logger is running.
   std::atomic<bool> running_;
 
   /// Map of query names to Kafka topic.
   std::map<std::string, rd_kafka_topic_t*> queryToTopics_;
 
+  /// Count of failed delivery reports.
+  std::atomic<size_t> delivery_errors_{0};
+
+  /// Count of produce attempts rejected with a full queue.
+  std::atomic<size_t> queue_full_errors_{0};
+
  private:
   /// Configures Kafka topics accordingly.
   bool configureTopics();
@@ -113,9 +183,12 @@ class KafkaProducerPlugin : public LoggerPlugin, public InternalRunnable {
       std::unique_ptr<rd_kafka_topic_t, std::function<void(rd_kafka_topic_t*)>>>
       topics_;
 
-  /// OS hostname and binary name interpolated as the Kafka message key.
+  /// The host identifier, used as the Kafka message key for partitioning.
   std::string msgKey_;
 
+  /// The delivery error count last reported as a status log.
+  size_t reported_errors_{0};
+
   /// Mutex for managing access to the producer_ pointer.
   Mutex producerMutex_;
 
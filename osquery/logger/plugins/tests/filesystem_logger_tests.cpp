@@ -8,6 +8,8 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <thread>
+
 #include <gtest/gtest.h>
 
 #include <boost/filesystem/operations.hpp>
@@ -15,6 +17,7 @@
 #include <osquery/logger.h>
 
 #include "osquery/core/conversions.h"
+#include "osquery/logger/plugins/filesystem_logger.h"
 #include "osquery/tests/test_util.h"
 
 namespace fs = boost::filesystem;
@@ -23,6 +26,10 @@ namespace osquery {
 
 DECLARE_string(logger_path);
 DECLARE_bool(disable_logging);
+DECLARE_bool(logger_event_type);
+DECLARE_bool(logger_rotate);
+DECLARE_uint64(logger_rotate_size);
+DECLARE_uint64(logger_fs_async_queue_size);
 
 class FilesystemLoggerTests : public testing::Test {
  public:
@@ -77,6 +84,94 @@ TEST_F(FilesystemLoggerTests, test_log_string) {
   EXPECT_EQ(content, "{\"json\": true}\n");
 }
 
+TEST_F(FilesystemLoggerTests, test_log_batch) {
+  // Remove the results from previous tests.
+  fs::remove(results_path_);
+
+  auto event_type = FLAGS_logger_event_type;
+  FLAGS_logger_event_type = true;
+
+  QueryLogItem item;
+  item.name = "batch";
+  item.identifier = "test";
+  item.calendar_time = "test";
+  item.results.added.push_back({{"i", "1"}});
+  item.results.added.push_back({{"i", "2"}});
+  item.results.removed.push_back({{"i", "3"}});
+  EXPECT_TRUE(logQueryLogItem(item));
+  FLAGS_logger_event_type = event_type;
+
+  // Each event is written as a line within a single batch.
+  std::string content;
+  EXPECT_TRUE(readFile(results_path_, content));
+  EXPECT_EQ(3U, osquery::split(content, "\n").size());
+  EXPECT_NE(std::string::npos, content.find("\"i\":\"1\""));
+  EXPECT_NE(std::string::npos, content.find("\"i\":\"2\""));
+  EXPECT_NE(std::string::npos, content.find("\"removed\""));
+}
+
+TEST_F(FilesystemLoggerTests, test_log_rotate) {
+  auto rotate = FLAGS_logger_rotate;
+  auto rotate_size = FLAGS_logger_rotate_size;
+  FLAGS_logger_rotate = true;
+  FLAGS_logger_rotate_size = 10;
+
+  auto rotated_path = results_path_ + ".1";
+  fs::remove(rotated_path);
+
+  EXPECT_TRUE(logString("{\"first\": true}", "event"));
+  // The second write would exceed the rotation size.
+  EXPECT_TRUE(logString("{\"second\": true}", "event"));
+
+  FLAGS_logger_rotate = rotate;
+  FLAGS_logger_rotate_size = rotate_size;
+
+  std::string content;
+  EXPECT_TRUE(readFile(results_path_, content));
+  EXPECT_EQ("{\"second\": true}\n", content);
+
+  ASSERT_TRUE(fs::exists(rotated_path));
+  content.clear();
+  EXPECT_TRUE(readFile(rotated_path, content));
+  EXPECT_NE(std::string::npos, content.find("{\"first\": true}\n"));
+}
+
+TEST_F(FilesystemLoggerTests, test_log_async) {
+  fs::remove(results_path_);
+
+  // A small queue makes producers wait for the writer thread.
+  auto queue_size = FLAGS_logger_fs_async_queue_size;
+  FLAGS_logger_fs_async_queue_size = 64;
+
+  auto runner = std::make_shared<FilesystemLogWriterRunner>(
+      std::make_shared<FilesystemLogFileWriter>());
+  std::thread thread([runner]() { runner->start(); });
+
+  for (size_t i = 0; i < 100; i++) {
+    std::vector<std::string> lines;
+    for (size_t j = 0; j < 5; j++) {
+      lines.push_back("{\"line\": " + std::to_string(i * 5 + j) + "}");
+    }
+    EXPECT_TRUE(runner->enqueue(results_path_, lines));
+  }
+
+  runner->interrupt();
+  thread.join();
+  FLAGS_logger_fs_async_queue_size = queue_size;
+
+  // Once stopped the caller writes its own lines.
+  std::vector<std::string> lines = {"{\"line\": 500}"};
+  EXPECT_FALSE(runner->enqueue(results_path_, lines));
+
+  std::string content;
+  EXPECT_TRUE(readFile(results_path_, content));
+  auto written = osquery::split(content, "\n");
+  ASSERT_EQ(500U, written.size());
+  for (size_t i = 0; i < written.size(); i++) {
+    EXPECT_EQ("{\"line\": " + std::to_string(i) + "}", written[i]);
+  }
+}
+
 class FilesystemTestLoggerPlugin : public LoggerPlugin {
  public:
   Status logString(const std::string& s) override {
@@ -12,6 +12,7 @@
 #include <gtest/gtest.h>
 
 #include <atomic>
+#include <functional>
 #include <future>
 #include <iostream>
 
@@ -22,10 +23,95 @@
 #include <osquery/core.h>
 #include <osquery/status.h>
 
+#include "osquery/core/metrics.h"
 #include "osquery/logger/plugins/kafka_producer.h"
 
 namespace osquery {
 
+/**
+ * @brief A local stand-in for a Kafka broker.
+ *
+ * Messages are accepted into a bounded producer queue, as librdkafka would,
+ * and acknowledged (or failed) when the producer polls.
+ */
+class KafkaStandInBroker {
+ public:
+  /// Accept a message, return false if the producer queue is full.
+  bool produce(rd_kafka_topic_t* topic, std::string&& payload) {
+    if (queue_.size() >= capacity) {
+      return false;
+    }
+
+    queue_.push_back(std::make_pair(topic, std::move(payload)));
+    return true;
+  }
+
+  /// Acknowledge every queued message, report each delivery result.
+  void poll(const std::function<void(bool)>& report) {
+    for (auto& message : queue_) {
+      report(!fail_deliveries);
+      if (!fail_deliveries) {
+        delivered[message.first].push_back(std::move(message.second));
+      }
+    }
+    queue_.clear();
+  }
+
+  size_t depth() const {
+    return queue_.size();
+  }
+
+ public:
+  /// The maximum number of messages waiting for delivery.
+  size_t capacity{1000};
+
+  /// Fail every delivery, as if the brokers were unavailable.
+  bool fail_deliveries{false};
+
+  /// The delivered messages for each topic.
+  std::map<rd_kafka_topic_t*, std::vector<std::string>> delivered;
+
+ private:
+  std::vector<std::pair<rd_kafka_topic_t*, std::string>> queue_;
+};
+
+class StandInKafkaProducerPlugin : public KafkaProducerPlugin {
+ public:
+  StandInKafkaProducerPlugin() {
+    running_ = true;
+  }
+
+  void setQueryToTopics(const std::map<std::string, rd_kafka_topic_t*>& m) {
+    queryToTopics_ = m;
+  }
+
+ protected:
+  Status publishMsg(rd_kafka_topic_t* topic, std::string&& payload) override {
+    publishes++;
+    if (!broker.produce(topic, std::move(payload))) {
+      return Status(kKafkaQueueFullCode, "Queue full");
+    }
+    return Status(0, "OK");
+  }
+
+  void flushMessages() override {
+    pollKafka();
+  }
+
+  void pollKafka() override {
+    broker.poll([this](bool delivered) { countDelivery(delivered); });
+  }
+
+  size_t queueDepth() override {
+    return broker.depth();
+  }
+
+ public:
+  KafkaStandInBroker broker;
+
+  size_t publishes{0};
+};
+
 class MockKafkaProducerPlugin : public KafkaProducerPlugin {
  public:
   MockKafkaProducerPlugin() : timesFlushed_(0), timesPolled_(0) {
@@ -41,8 +127,7 @@ class MockKafkaProducerPlugin : public KafkaProducerPlugin {
   }
 
  protected:
-  Status publishMsg(rd_kafka_topic_t* topic,
-                    const std::string& payload) override {
+  Status publishMsg(rd_kafka_topic_t* topic, std::string&& payload) override {
     if (publishedMsgs_.find(topic) == publishedMsgs_.end()) {
       std::vector<std::string> msgs;
       publishedMsgs_[topic] = msgs;
@@ -69,7 +154,23 @@ class MockKafkaProducerPlugin : public KafkaProducerPlugin {
   std::atomic<int> timesPolled_;
 };
 
-class KafkaProducerPluginTest : public ::testing::Test {};
+class KafkaProducerPluginTest : public ::testing::Test {
+ protected:
+  uint64_t countDeliveries(const std::string& result) {
+    return Metrics::get()
+        .counter("osquery_kafka_deliveries_total",
+                 "Kafka messages by delivery report",
+                 {{"result", result}})
+        .value();
+  }
+
+  uint64_t countQueueFull() {
+    return Metrics::get()
+        .counter("osquery_kafka_queue_full_total",
+                 "Kafka produce attempts retried on a full queue")
+        .value();
+  }
+};
 
 TEST_F(KafkaProducerPluginTest, getMsgName_tests) {
   // Key is `input`, Value is `expected`
@@ -233,6 +334,76 @@ TEST_F(KafkaProducerPluginTest, logString_multi_topic_happy_path) {
   EXPECT_TRUE(mkpp.timesPolled_.load() == 8);
 }
 
+TEST_F(KafkaProducerPluginTest, logStringBatch_topic_by_name) {
+  StandInKafkaProducerPlugin plugin;
+
+  rd_kafka_topic_t* topicBase = reinterpret_cast<rd_kafka_topic_t*>(0x692870);
+  rd_kafka_topic_t* topic1 = reinterpret_cast<rd_kafka_topic_t*>(0x692871);
+  plugin.setQueryToTopics({{kKafkaBaseTopic, topicBase}, {"topic1", topic1}});
+
+  // The payloads do not include a name, the batch provides it.
+  std::vector<std::string> msgs = {"{\"row\": 1}", "{\"row\": 2}"};
+  auto expected = msgs;
+  EXPECT_TRUE(plugin.logStringBatch("topic1", msgs));
+  EXPECT_EQ(0U, plugin.broker.delivered[topicBase].size());
+  EXPECT_EQ(expected, plugin.broker.delivered[topic1]);
+
+  // Unknown names use the base topic.
+  msgs = {"{\"row\": 3}"};
+  EXPECT_TRUE(plugin.logSnapshotBatch("unknown", msgs));
+  EXPECT_EQ(1U, plugin.broker.delivered[topicBase].size());
+}
+
+TEST_F(KafkaProducerPluginTest, logStringBatch_queue_full) {
+  StandInKafkaProducerPlugin plugin;
+
+  rd_kafka_topic_t* topic = reinterpret_cast<rd_kafka_topic_t*>(0x692870);
+  plugin.setQueryToTopics({{kKafkaBaseTopic, topic}});
+
+  auto delivered = countDeliveries("delivered");
+  auto queue_full = countQueueFull();
+
+  // The producer queue fills after two messages and drains when polled.
+  plugin.broker.capacity = 2;
+  std::vector<std::string> msgs = {"1", "2", "3", "4", "5"};
+  EXPECT_TRUE(plugin.logStringBatch("test", msgs));
+
+  std::vector<std::string> expected = {"1", "2", "3", "4", "5"};
+  EXPECT_EQ(expected, plugin.broker.delivered[topic]);
+  EXPECT_EQ(2U, plugin.queueFullErrors());
+  EXPECT_EQ(7U, plugin.publishes);
+  EXPECT_EQ(0U, plugin.deliveryErrors());
+
+  // The counts are exported as metrics.
+  EXPECT_EQ(delivered + 5, countDeliveries("delivered"));
+  EXPECT_EQ(queue_full + 2, countQueueFull());
+}
+
+TEST_F(KafkaProducerPluginTest, logStringBatch_delivery_errors) {
+  StandInKafkaProducerPlugin plugin;
+
+  rd_kafka_topic_t* topic = reinterpret_cast<rd_kafka_topic_t*>(0x692870);
+  plugin.setQueryToTopics({{kKafkaBaseTopic, topic}});
+
+  auto failed = countDeliveries("failed");
+  plugin.broker.fail_deliveries = true;
+  std::vector<std::string> msgs = {"1", "2", "3"};
+  EXPECT_TRUE(plugin.logStringBatch("test", msgs));
+  EXPECT_EQ(3U, plugin.deliveryErrors());
+  EXPECT_EQ(failed + 3, countDeliveries("failed"));
+  EXPECT_EQ(0U, plugin.broker.delivered[topic].size());
+}
+
+TEST_F(KafkaProducerPluginTest, poll_interval) {
+  auto idle = getKafkaPollInterval(0);
+  auto busy = getKafkaPollInterval(10);
+  auto busier = getKafkaPollInterval(100000);
+
+  EXPECT_LT(busy, idle);
+  EXPECT_LT(busier, busy);
+  EXPECT_GT(busier.count(), 0);
+}
+
 TEST_F(KafkaProducerPluginTest, flush_on_stop) {
   MockKafkaProducerPlugin mkpp;
 
@@ -32,6 +32,7 @@
 #include "osquery/devtools/devtools.h"
 #include "osquery/dispatcher/distributed.h"
 #include "osquery/dispatcher/io_service.h"
+#include "osquery/dispatcher/metrics_exporter.h"
 #include "osquery/dispatcher/scheduler.h"
 #include "osquery/filesystem/fileops.h"
 #include "osquery/main/main.h"
@@ -107,6 +108,12 @@ int startDaemon(Initializer& runner) {
     VLOG(1) << "Not starting the distributed query service: " << s.toString();
   }
 
+  // Conditionally serve internal metrics to a local scraper.
+  s = startMetricsExporter();
+  if (!s.ok()) {
+    VLOG(1) << "Not starting the metrics exporter: " << s.toString();
+  }
+
   // Begin the schedule runloop.
   startScheduler();
 
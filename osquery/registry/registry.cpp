@@ -21,6 +21,7 @@
 
 #include "osquery/core/conversions.h"
 #include "osquery/core/json.h"
+#include "osquery/core/metrics.h"
 #include "osquery/core/process.h"
 
 namespace pt = boost::property_tree;
@@ -123,17 +124,41 @@ RegistryRoutes RegistryInterface::getRoutes() const {
   return route_table;
 }
 
+RegistryInterface::RegistryInterface(std::string name, bool auto_setup)
+    : name_(std::move(name)), auto_setup_(auto_setup) {
+  resolveMetrics();
+}
+
+void RegistryInterface::setName(const std::string& name) {
+  name_ = name;
+  resolveMetrics();
+}
+
+void RegistryInterface::resolveMetrics() {
+  // Calls are frequent, the histograms are found once per registry name.
+  call_histogram_ = &Metrics::get().histogram(
+      "osquery_registry_call_duration_us",
+      "Microseconds spent in registry plugin calls",
+      {{"registry", name_}});
+  extension_call_histogram_ =
+      &Metrics::get().histogram("osquery_extension_call_duration_us",
+                                "Microseconds spent in extension calls",
+                                {{"registry", name_}});
+}
+
 Status RegistryInterface::call(const std::string& item_name,
                                const PluginRequest& request,
                                PluginResponse& response) {
   // Search local plugins (items) for the plugin.
   if (items_.count(item_name) > 0) {
+    MetricHistogram::Timer timer(*call_histogram_);
     return items_.at(item_name)->call(request, response);
   }
 
   // Check if the item was broadcasted as a plugin within an extension.
   if (external_.count(item_name) > 0) {
     // The item is a registered extension, call the extension by UUID.
+    MetricHistogram::Timer timer(*extension_call_histogram_);
     return callExtension(
         external_.at(item_name), name_, item_name, request, response);
   } else if (routes_.count(item_name) > 0) {
@@ -142,6 +167,7 @@ Status RegistryInterface::call(const std::string& item_name,
     return Status(0, "Route only");
   } else if (RegistryFactory::get().external()) {
     // If this is an extension's registry forward unknown calls to the core.
+    MetricHistogram::Timer timer(*extension_call_histogram_);
     return callExtension(0, name_, item_name, request, response);
   }
 
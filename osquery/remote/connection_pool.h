@@ -0,0 +1,199 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core.h>
+#include <osquery/flags.h>
+
+#include "osquery/remote/http_client.h"
+
+namespace osquery {
+
+/// Maximum connections, idle or in use, for each remote endpoint.
+DECLARE_uint32(tls_pool_size);
+
+/// Seconds an idle connection is kept in the pool.
+DECLARE_uint32(tls_pool_idle_timeout);
+
+namespace http {
+
+/**
+ * @brief A keyed pool of HTTP(S) clients shared by all remote plugins.
+ *
+ * The config, logger, distributed, enroll, carver, and YARA TLS requests all
+ * check out a client for their endpoint (scheme, host, and port) and client
+ * options. A returned client keeps its connection open, so the next request
+ * to the same endpoint skips the TCP connect and TLS handshake. When a new
+ * connection is needed the most recent TLS session for the endpoint is
+ * offered for resumption. Clients and sessions are never shared between
+ * different TLS options, such as a pinned server certificate, peer
+ * verification, or a client certificate.
+ *
+ * Each endpoint allows at most `tls_pool_size` clients. A checkout waits for a
+ * client to be returned, and after a short timeout uses a temporary client
+ * that is not pooled. Idle clients are closed after `tls_pool_idle_timeout`
+ * seconds, and any client is retired after `tls_session_timeout` seconds.
+ */
+class ClientPool : private boost::noncopyable {
+ public:
+  /// Counters describing connection reuse, exported by event in the
+  /// osquery_tls_pool_events_total metric.
+  struct Stats {
+    /// Number of client checkouts.
+    size_t checkouts{0};
+
+    /// Number of new connections, each requiring a handshake.
+    size_t handshakes{0};
+
+    /// Number of checkouts that reused an open connection.
+    size_t handshakes_avoided{0};
+
+    /// Number of new TLS connections that resumed a session.
+    size_t sessions_resumed{0};
+
+    /// Number of idle or expired clients closed by the pool.
+    size_t evictions{0};
+
+    /// Number of temporary clients used when an endpoint was at its limit.
+    size_t overflows{0};
+  };
+
+  /**
+   * @brief A checked out client, returned to the pool when destroyed.
+   */
+  class Lease : public only_movable {
+   public:
+    Lease(Lease&& other) noexcept;
+    Lease& operator=(Lease&& other);
+    ~Lease();
+
+    Client* operator->() const {
+      return client_.get();
+    }
+
+    Client& operator*() const {
+      return *client_;
+    }
+
+    /// Close, rather than pool, the client when the lease ends.
+    void discard() {
+      reuse_ = false;
+    }
+
+   private:
+    Lease(ClientPool* pool,
+          std::string key,
+          std::shared_ptr<Client> client,
+          bool pooled);
+
+    /// Return the client to the pool.
+    void release();
+
+   private:
+    ClientPool* pool_{nullptr};
+    std::string key_;
+    std::shared_ptr<Client> client_{nullptr};
+
+    /// The client counts this endpoint's limit.
+    bool pooled_{false};
+
+    /// The client may be reused.
+    bool reuse_{true};
+
+    /// The TLS options of the client at checkout.
+    std::string tls_key_;
+
+    /// Client connection counters at checkout.
+    size_t connections_{0};
+    size_t resumed_{0};
+
+   private:
+    friend class ClientPool;
+  };
+
+ public:
+  /// The pool shared by all remote plugins.
+  static ClientPool& get();
+
+  /// Check out a client, with these options, for the endpoint of a URI.
+  Lease checkout(const std::string& uri,
+                 const Client::Options& options = Client::Options());
+
+  /// Return the pool counters.
+  Stats stats() const;
+
+  /// Close every idle client and forget saved TLS sessions.
+  void clear();
+
+  /// The endpoint of a URI: scheme, host, and port.
+  static std::string getKey(const std::string& uri);
+
+  /// The pool key for a URI and client options.
+  static std::string getKey(const std::string& uri,
+                            const Client::Options& options);
+
+ private:
+  ClientPool() = default;
+
+  /// Return a client and account for its connection reuse.
+  void checkin(Lease& lease);
+
+  /// Add to a pool counter and its exported metric, under the pool lock.
+  void count(size_t& stat, const std::string& event, size_t value = 1);
+
+  /// Close idle and expired clients, the caller holds the pool lock.
+  void evict(std::chrono::steady_clock::time_point now);
+
+ private:
+  struct PooledClient {
+    std::shared_ptr<Client> client;
+    std::chrono::steady_clock::time_point created;
+    std::chrono::steady_clock::time_point used;
+  };
+
+  struct Endpoint {
+    /// Idle clients, the most recently used is last.
+    std::vector<PooledClient> idle;
+
+    /// Creation times of checked out clients.
+    std::map<Client*, std::chrono::steady_clock::time_point> active;
+
+    /// The most recent TLS session for resumption.
+    std::shared_ptr<SSL_SESSION> session{nullptr};
+  };
+
+  /// Pooled clients for each endpoint and options key.
+  std::map<std::string, Endpoint> endpoints_;
+
+  /// Pool counters.
+  Stats stats_;
+
+  /// Protect the endpoints and counters.
+  mutable std::mutex mutex_;
+
+  /// Signal a returned client to waiting checkouts.
+  std::condition_variable condition_;
+
+ private:
+  friend class Lease;
+};
+} // namespace http
+} // namespace osquery
@@ -0,0 +1,240 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <algorithm>
+
+#include <osquery/logger.h>
+
+#include "osquery/core/metrics.h"
+#include "osquery/remote/connection_pool.h"
+
+namespace osquery {
+
+CLI_FLAG(uint32,
+         tls_pool_size,
+         4,
+         "Maximum TLS connections kept for each remote endpoint");
+
+CLI_FLAG(uint32,
+         tls_pool_idle_timeout,
+         60,
+         "Seconds an idle TLS connection is kept open for reuse");
+
+DECLARE_bool(tls_session_reuse);
+DECLARE_uint32(tls_session_timeout);
+
+namespace http {
+
+/// How long a checkout waits for a client when an endpoint is at its limit.
+const std::chrono::seconds kPoolCheckoutTimeout{5};
+
+ClientPool::Lease::Lease(ClientPool* pool,
+                         std::string key,
+                         std::shared_ptr<Client> client,
+                         bool pooled)
+    : pool_(pool),
+      key_(std::move(key)),
+      client_(std::move(client)),
+      pooled_(pooled),
+      tls_key_(client_->options().tlsKey()),
+      connections_(client_->connections()),
+      resumed_(client_->resumedSessions()) {}
+
+ClientPool::Lease::Lease(Lease&& other) noexcept
+    : pool_(other.pool_),
+      key_(std::move(other.key_)),
+      client_(std::move(other.client_)),
+      pooled_(other.pooled_),
+      reuse_(other.reuse_),
+      tls_key_(std::move(other.tls_key_)),
+      connections_(other.connections_),
+      resumed_(other.resumed_) {
+  other.pool_ = nullptr;
+}
+
+ClientPool::Lease& ClientPool::Lease::operator=(Lease&& other) {
+  if (this != &other) {
+    release();
+    pool_ = other.pool_;
+    key_ = std::move(other.key_);
+    client_ = std::move(other.client_);
+    pooled_ = other.pooled_;
+    reuse_ = other.reuse_;
+    tls_key_ = std::move(other.tls_key_);
+    connections_ = other.connections_;
+    resumed_ = other.resumed_;
+    other.pool_ = nullptr;
+  }
+  return *this;
+}
+
+ClientPool::Lease::~Lease() {
+  release();
+}
+
+void ClientPool::Lease::release() {
+  if (pool_ != nullptr && client_ != nullptr) {
+    pool_->checkin(*this);
+  }
+  pool_ = nullptr;
+  client_ = nullptr;
+}
+
+ClientPool& ClientPool::get() {
+  static ClientPool pool;
+  return pool;
+}
+
+std::string ClientPool::getKey(const std::string& uri) {
+  Uri parsed(uri);
+  auto key = parsed.scheme() + "://" + parsed.host();
+  if (parsed.port() > 0) {
+    key += ":" + std::to_string(parsed.port());
+  }
+  return key;
+}
+
+std::string ClientPool::getKey(const std::string& uri,
+                               const Client::Options& options) {
+  return getKey(uri) + " " + options.tlsKey();
+}
+
+ClientPool::Lease ClientPool::checkout(const std::string& uri,
+                                       const Client::Options& options) {
+  auto key = getKey(uri, options);
+  if (!FLAGS_tls_session_reuse) {
+    // Without session reuse every request uses a new connection.
+    std::unique_lock<std::mutex> lock(mutex_);
+    count(stats_.checkouts, "checkout");
+    Lease lease(this, key, std::make_shared<Client>(options), false);
+    lease.discard();
+    return lease;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  count(stats_.checkouts, "checkout");
+  auto now = std::chrono::steady_clock::now();
+  evict(now);
+
+  // Endpoints are never removed, the reference remains valid while waiting.
+  auto& endpoint = endpoints_[key];
+  size_t limit = std::max<size_t>(FLAGS_tls_pool_size, 1);
+  bool available = condition_.wait_for(
+      lock, kPoolCheckoutTimeout, [&endpoint, limit]() {
+        return !endpoint.idle.empty() || endpoint.active.size() < limit;
+      });
+
+  if (!available) {
+    count(stats_.overflows, "overflow");
+    auto client = std::make_shared<Client>(options);
+    client->setSession(endpoint.session);
+    Lease lease(this, key, client, false);
+    lease.discard();
+    return lease;
+  }
+
+  std::shared_ptr<Client> client;
+  std::chrono::steady_clock::time_point created;
+  if (!endpoint.idle.empty()) {
+    client = endpoint.idle.back().client;
+    created = endpoint.idle.back().created;
+    endpoint.idle.pop_back();
+  } else {
+    client = std::make_shared<Client>(options);
+    client->setSession(endpoint.session);
+    created = now;
+  }
+
+  endpoint.active[client.get()] = created;
+  return Lease(this, key, client, true);
+}
+
+void ClientPool::checkin(Lease& lease) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto& client = lease.client_;
+  auto connections = client->connections() - lease.connections_;
+  if (connections == 0) {
+    count(stats_.handshakes_avoided, "handshake_avoided");
+  }
+  count(stats_.handshakes, "handshake", connections);
+  count(stats_.sessions_resumed,
+        "session_resumed",
+        client->resumedSessions() - lease.resumed_);
+
+  // A client given other options after checkout no longer matches its key.
+  bool matches = client->options().tlsKey() == lease.tls_key_;
+  auto& endpoint = endpoints_[lease.key_];
+  if (matches && client->getSession() != nullptr) {
+    endpoint.session = client->getSession();
+  }
+
+  if (!lease.pooled_) {
+    return;
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  auto created = endpoint.active[client.get()];
+  endpoint.active.erase(client.get());
+
+  auto lifetime = std::chrono::seconds(FLAGS_tls_session_timeout);
+  if (lease.reuse_ && matches && FLAGS_tls_session_reuse &&
+      (FLAGS_tls_session_timeout == 0 || now - created < lifetime)) {
+    endpoint.idle.push_back({client, created, now});
+  } else {
+    count(stats_.evictions, "eviction");
+  }
+  condition_.notify_one();
+}
+
+void ClientPool::count(size_t& stat, const std::string& event, size_t value) {
+  static MetricCounterFamily counters("osquery_tls_pool_events_total",
+                                      "Connection reuse by the TLS client pool",
+                                      "event",
+                                      {"checkout",
+                                       "handshake",
+                                       "handshake_avoided",
+                                       "session_resumed",
+                                       "eviction",
+                                       "overflow"});
+  stat += value;
+  counters.get(event).increment(value);
+}
+
+void ClientPool::evict(std::chrono::steady_clock::time_point now) {
+  auto idle_timeout = std::chrono::seconds(FLAGS_tls_pool_idle_timeout);
+  auto lifetime = std::chrono::seconds(FLAGS_tls_session_timeout);
+  for (auto& endpoint : endpoints_) {
+    auto& idle = endpoint.second.idle;
+    auto expired = [&](const PooledClient& pooled) {
+      return (now - pooled.used >= idle_timeout) ||
+             (FLAGS_tls_session_timeout > 0 && now - pooled.created >= lifetime);
+    };
+
+    auto it = std::remove_if(idle.begin(), idle.end(), expired);
+    count(stats_.evictions, "eviction", std::distance(it, idle.end()));
+    idle.erase(it, idle.end());
+  }
+}
+
+ClientPool::Stats ClientPool::stats() const {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void ClientPool::clear() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (auto& endpoint : endpoints_) {
+    count(stats_.evictions, "eviction", endpoint.second.idle.size());
+    endpoint.second.idle.clear();
+    endpoint.second.session = nullptr;
+  }
+}
+} // namespace http
+} // namespace osquery
@@ -42,6 +42,20 @@ class adapted_category : public std::error_category {
   boost::system::error_category const* pc_;
 };
 
+std::string Client::Options::tlsKey() const {
+  // Values are length-prefixed such that no two sets of options collide.
+  auto field = [](const boost::optional<std::string>& value) {
+    return (value) ? std::to_string(value->size()) + ":" + *value + ";"
+                   : std::string("-;");
+  };
+
+  return field(server_certificate_) + field(verify_path_) +
+         field(client_certificate_file_) + field(client_private_key_file_) +
+         field(ciphers_) + field(sni_hostname_) + field(proxy_hostname_) +
+         std::to_string(ssl_options_) + ";" +
+         std::to_string(always_verify_peer_);
+}
+
 void Client::postResponseHandler(boost_system::error_code const& ec) {
   if ((ec.category() == boost_asio::error::ssl_category) &&
       (ec.value() == kSSLShortReadError)) {
@@ -94,6 +108,7 @@ void Client::createConnection() {
           r_.resolve(boost_asio::ip::tcp::resolver::query{connect_host, port}),
           rc);
 
+  connections_++;
   if (rc) {
     std::string error("Failed to connect to ");
     if (client_options_.proxy_hostname_) {
@@ -175,12 +190,33 @@ void Client::encryptConnection() {
                                client_options_.sni_hostname_->c_str());
   }
 
+  if (session_ != nullptr) {
+    // Attempt an abbreviated handshake using a previous session ticket.
+    ::SSL_set_session(ssl_sock_->native_handle(), session_.get());
+  }
+
   boost_system::error_code rc;
   ssl_sock_->handshake(boost_asio::ssl::stream_base::client, rc);
 
   if (rc) {
     throw std::system_error(rc.value(), adapted_category(&rc.category()));
   }
+
+  if (::SSL_session_reused(ssl_sock_->native_handle())) {
+    resumed_sessions_++;
+  }
+}
+
+void Client::saveSession() {
+  if (ssl_sock_ == nullptr) {
+    return;
+  }
+
+  // TLS 1.3 tickets arrive after the handshake, so save after a response.
+  auto session = ::SSL_get1_session(ssl_sock_->native_handle());
+  if (session != nullptr) {
+    session_ = std::shared_ptr<SSL_SESSION>(session, ::SSL_SESSION_free);
+  }
 }
 
 template <typename STREAM_TYPE>
@@ -345,6 +381,7 @@ Response Client::sendHTTPRequest(Request& req) {
 
       if (client_options_.ssl_connection_) {
         sendRequest(*ssl_sock_, req, resp);
+        saveSession();
       } else {
         sendRequest(sock_, req, resp);
       }
@@ -353,7 +390,6 @@ Response Client::sendHTTPRequest(Request& req) {
       case beast_http::status::moved_permanently:
       case beast_http::status::found:
       case beast_http::status::see_other:
-      case beast_http::status::not_modified:
       case beast_http::status::use_proxy:
       case beast_http::status::temporary_redirect:
       case beast_http::status::permanent_redirect: {
@@ -161,6 +161,15 @@ class Client {
       return *this;
     }
 
+    /**
+     * @brief Identify the options that change how a TLS session is
+     * negotiated and verified.
+     *
+     * Connections and sessions are only shared between clients with the same
+     * key, a session is never resumed under weaker verification.
+     */
+    std::string tlsKey() const;
+
     bool operator==(Options const& ropts) {
       return (server_certificate_ == ropts.server_certificate_) &&
              (verify_path_ == ropts.verify_path_) &&
@@ -201,6 +210,8 @@ class Client {
     new_client_options_ = !(client_options_ == opts);
     if (new_client_options_) {
       client_options_ = opts;
+      // A session negotiated under other options is not resumed.
+      session_ = nullptr;
     }
   }
 
@@ -233,6 +244,31 @@ class Client {
   /// HTTP delete_ request method.
   Response delete_(Request& req);
 
+  /// The options used for the next connection.
+  const Options& options() const {
+    return client_options_;
+  }
+
+  /// Offer a TLS session to resume on the next handshake.
+  void setSession(std::shared_ptr<SSL_SESSION> session) {
+    session_ = std::move(session);
+  }
+
+  /// The most recent TLS session negotiated by this client.
+  std::shared_ptr<SSL_SESSION> getSession() const {
+    return session_;
+  }
+
+  /// The number of connections (and TLS handshakes) this client created.
+  size_t connections() const {
+    return connections_;
+  }
+
+  /// The number of TLS handshakes that resumed a previous session.
+  size_t resumedSessions() const {
+    return resumed_sessions_;
+  }
+
   ~Client() {
     closeSocket();
   }
@@ -244,6 +280,9 @@ class Client {
   /// Convert plain socket to TLS socket.
   void encryptConnection();
 
+  /// Keep the negotiated TLS session such that it may be resumed.
+  void saveSession();
+
   template <typename STREAM_TYPE>
   void sendRequest(STREAM_TYPE& stream,
                    Request& req,
@@ -279,6 +318,15 @@ class Client {
   std::shared_ptr<ssl_stream> ssl_sock_;
   boost_system::error_code ec_;
   bool new_client_options_{true};
+
+  /// A TLS session, possibly from another client, to resume.
+  std::shared_ptr<SSL_SESSION> session_{nullptr};
+
+  /// Count of created connections.
+  size_t connections_{0};
+
+  /// Count of TLS handshakes that resumed a session.
+  size_t resumed_sessions_{0};
 };
 
 /**
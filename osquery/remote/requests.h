@@ -96,6 +96,24 @@ class Transport {
     return response_params_;
   }
 
+  /**
+   * @brief Get the entity tag of the response
+   *
+   * Transports supporting conditional requests use the "etag" option to send
+   * the entity tag of a previous response. An unchanged resource returns an
+   * empty response and isResponseNotModified is true.
+   *
+   * @return The entity tag, empty if the response did not include one
+   */
+  const std::string& getResponseETag() const {
+    return response_etag_;
+  }
+
+  /// True if a conditional request found the resource unchanged.
+  bool isResponseNotModified() const {
+    return response_not_modified_;
+  }
+
   template <typename T>
   void setOption(const std::string& name, const T& value) {
     options_.add(name, value);
@@ -119,6 +137,12 @@ class Transport {
   /// storage for response parameters
   JSON response_params_;
 
+  /// storage for the response entity tag
+  std::string response_etag_;
+
+  /// storage for the conditional request result
+  bool response_not_modified_{false};
+
   /// options from request call (use defined by specific transport)
   JSON options_;
 };
@@ -248,6 +272,16 @@ class Request {
     return transport_->getResponseStatus();
   }
 
+  /// Get the response entity tag, see Transport::getResponseETag.
+  const std::string& getResponseETag() const {
+    return transport_->getResponseETag();
+  }
+
+  /// True if a conditional request found the resource unchanged.
+  bool isResponseNotModified() const {
+    return transport_->isResponseNotModified();
+  }
+
   template <typename T>
   void setOption(const std::string& name, const T& value) {
     options_.add(name, value);
@@ -270,6 +304,8 @@ class Request {
  private:
   FRIEND_TEST(TLSTransportsTests, test_call);
   FRIEND_TEST(TLSTransportsTests, test_call_with_params);
+  FRIEND_TEST(TLSTransportsTests, test_call_not_modified);
+  FRIEND_TEST(TLSTransportsTests, test_call_reuse_connection);
   FRIEND_TEST(TLSTransportsTests, test_call_verify_peer);
   FRIEND_TEST(TLSTransportsTests, test_call_server_cert_pinning);
   FRIEND_TEST(TLSTransportsTests, test_call_client_auth);
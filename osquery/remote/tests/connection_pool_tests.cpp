@@ -0,0 +1,163 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <gtest/gtest.h>
+
+#include "osquery/core/metrics.h"
+#include "osquery/remote/connection_pool.h"
+
+namespace osquery {
+
+DECLARE_bool(tls_session_reuse);
+
+namespace http {
+
+class ConnectionPoolTests : public testing::Test {
+ public:
+  void SetUp() override {
+    ClientPool::get().clear();
+    idle_timeout_ = FLAGS_tls_pool_idle_timeout;
+  }
+
+  void TearDown() override {
+    FLAGS_tls_pool_idle_timeout = idle_timeout_;
+    ClientPool::get().clear();
+  }
+
+ private:
+  uint32_t idle_timeout_{0};
+};
+
+TEST_F(ConnectionPoolTests, test_key) {
+  EXPECT_EQ("https://localhost:8080",
+            ClientPool::getKey("https://localhost:8080/config?a=b"));
+  EXPECT_EQ("https://example.com", ClientPool::getKey("https://example.com/"));
+  EXPECT_NE(ClientPool::getKey("https://localhost:8080/config"),
+            ClientPool::getKey("https://localhost:8081/config"));
+}
+
+TEST_F(ConnectionPoolTests, test_reuse) {
+  if (!FLAGS_tls_session_reuse) {
+    return;
+  }
+
+  auto& pool = ClientPool::get();
+  Client* first = nullptr;
+  {
+    auto lease = pool.checkout("https://localhost:1/config");
+    first = &(*lease);
+  }
+
+  // The same endpoint receives the returned client.
+  {
+    auto lease = pool.checkout("https://localhost:1/log");
+    EXPECT_EQ(first, &(*lease));
+
+    // A concurrent checkout receives a different client.
+    auto second = pool.checkout("https://localhost:1/log");
+    EXPECT_NE(first, &(*second));
+  }
+
+  // A different endpoint never receives the client.
+  {
+    auto lease = pool.checkout("https://localhost:2/config");
+    EXPECT_NE(first, &(*lease));
+  }
+
+  // A discarded client is not returned to the pool.
+  {
+    auto lease = pool.checkout("https://localhost:1/config");
+    lease.discard();
+  }
+  {
+    auto lease = pool.checkout("https://localhost:1/config");
+    auto second = pool.checkout("https://localhost:1/config");
+    EXPECT_TRUE(first != &(*lease) || first != &(*second));
+  }
+}
+
+TEST_F(ConnectionPoolTests, test_options) {
+  if (!FLAGS_tls_session_reuse) {
+    return;
+  }
+
+  auto& pool = ClientPool::get();
+  Client::Options weak;
+  weak.always_verify_peer(false);
+  Client::Options strict;
+  strict.always_verify_peer(true).openssl_certificate("pinned.pem");
+  EXPECT_NE(ClientPool::getKey("https://localhost:1/config", weak),
+            ClientPool::getKey("https://localhost:1/config", strict));
+
+  // A session negotiated with the weak options is saved for the endpoint.
+  Client* first = nullptr;
+  auto session =
+      std::shared_ptr<SSL_SESSION>(::SSL_SESSION_new(), ::SSL_SESSION_free);
+  {
+    auto lease = pool.checkout("https://localhost:1/config", weak);
+    first = &(*lease);
+    lease->setSession(session);
+  }
+
+  // Stricter options never receive the client or its session.
+  {
+    auto lease = pool.checkout("https://localhost:1/config", strict);
+    EXPECT_NE(first, &(*lease));
+    EXPECT_EQ(nullptr, lease->getSession());
+  }
+
+  // New clients with the same options are offered the session.
+  {
+    auto lease = pool.checkout("https://localhost:1/config", weak);
+    auto second = pool.checkout("https://localhost:1/config", weak);
+    EXPECT_EQ(first, &(*lease));
+    EXPECT_EQ(session, second->getSession());
+
+    // Changing a client's options forgets the session.
+    second->setOptions(strict);
+    EXPECT_EQ(nullptr, second->getSession());
+
+    // Nor is a session it negotiates saved for the weak options.
+    second->setSession(std::shared_ptr<SSL_SESSION>(::SSL_SESSION_new(),
+                                                    ::SSL_SESSION_free));
+  }
+  {
+    auto lease = pool.checkout("https://localhost:1/config", weak);
+    auto second = pool.checkout("https://localhost:1/config", weak);
+    EXPECT_EQ(session, second->getSession());
+  }
+}
+
+TEST_F(ConnectionPoolTests, test_idle_eviction) {
+  if (!FLAGS_tls_session_reuse) {
+    return;
+  }
+
+  auto& pool = ClientPool::get();
+  FLAGS_tls_pool_idle_timeout = 0;
+
+  auto evictions = pool.stats().evictions;
+  auto& exported = Metrics::get().counter(
+      "osquery_tls_pool_events_total",
+      "Connection reuse by the TLS client pool",
+      {{"event", "eviction"}});
+  auto exported_evictions = exported.value();
+  { auto lease = pool.checkout("https://localhost:1/config"); }
+
+  // The idle client expires immediately and is closed on the next checkout.
+  { auto lease = pool.checkout("https://localhost:1/config"); }
+  EXPECT_GT(pool.stats().evictions, evictions);
+
+  // The counters are exported as metrics.
+  EXPECT_EQ(pool.stats().evictions - evictions,
+            exported.value() - exported_evictions);
+}
+} // namespace http
+} // namespace osquery
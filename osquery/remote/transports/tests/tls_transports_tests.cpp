@@ -14,6 +14,7 @@
 
 #include <osquery/logger.h>
 
+#include "osquery/remote/connection_pool.h"
 #include "osquery/remote/requests.h"
 #include "osquery/remote/serializers/json.h"
 #include "osquery/remote/transports/tls.h"
@@ -24,6 +25,7 @@
 namespace osquery {
 
 DECLARE_string(tls_server_certs);
+DECLARE_bool(tls_session_reuse);
 
 class TLSTransportsTests : public testing::Test {
  public:
@@ -116,6 +118,68 @@ TEST_F(TLSTransportsTests, test_call_with_params) {
   }
 }
 
+TEST_F(TLSTransportsTests, test_call_not_modified) {
+  auto url = "https://localhost:" + port_ + "/config_etag";
+  JSON params;
+  params.add("node_key", "");
+
+  // The first request receives the config and its entity tag.
+  auto t = std::make_shared<TLSTransport>();
+  t->disableVerifyPeer();
+  Request<TLSTransport, JSONSerializer> r1(url, t);
+
+  Status status;
+  ASSERT_NO_THROW(status = r1.call(params));
+  if (!verify(status)) {
+    return;
+  }
+  ASSERT_TRUE(status.ok());
+  EXPECT_FALSE(r1.isResponseNotModified());
+  auto etag = r1.getResponseETag();
+  ASSERT_FALSE(etag.empty());
+
+  // A request with the entity tag is answered with 304 Not Modified, which is
+  // not followed as a redirect.
+  t = std::make_shared<TLSTransport>();
+  t->disableVerifyPeer();
+  Request<TLSTransport, JSONSerializer> r2(url, t);
+  r2.setOption("etag", etag);
+
+  ASSERT_NO_THROW(status = r2.call(params));
+  ASSERT_TRUE(status.ok());
+  EXPECT_TRUE(r2.isResponseNotModified());
+  EXPECT_EQ(etag, r2.getResponseETag());
+
+  JSON recv;
+  EXPECT_TRUE(r2.getResponse(recv).ok());
+  EXPECT_EQ(0U, recv.doc().MemberCount());
+}
+
+TEST_F(TLSTransportsTests, test_call_reuse_connection) {
+  auto& pool = http::ClientPool::get();
+  pool.clear();
+
+  auto url = "https://localhost:" + port_;
+  Status status;
+  for (size_t i = 0; i < 2; i++) {
+    auto t = std::make_shared<TLSTransport>();
+    t->disableVerifyPeer();
+
+    Request<TLSTransport, JSONSerializer> r(url, t);
+    ASSERT_NO_THROW(status = r.call());
+    if (!verify(status)) {
+      return;
+    }
+  }
+
+  // The second request should use the first request's pooled connection.
+  auto stats = pool.stats();
+  if (FLAGS_tls_session_reuse) {
+    EXPECT_GE(stats.handshakes_avoided, 1U);
+  }
+  EXPECT_GE(stats.handshakes, 1U);
+}
+
 TEST_F(TLSTransportsTests, test_call_verify_peer) {
   // Create a default request without a transport that accepts invalid peers.
   auto url = "https://localhost:" + port_;
@@ -11,7 +11,7 @@
 // clang-format off
 // This must be here to prevent a WinSock.h exists error
 #include "osquery/remote/transports/tls.h"
-#include "osquery/dispatcher/io_service.h"
+#include "osquery/remote/connection_pool.h"
 // clang-format on
 
 #include <boost/filesystem.hpp>
@@ -90,6 +90,30 @@ void TLSTransport::decorateRequest(http::Request& r) {
   r << http::Request::Header("Content-Type", serializer_->getContentType());
   r << http::Request::Header("Accept", serializer_->getContentType());
   r << http::Request::Header("User-Agent", kTLSUserAgentBase + kVersion);
+
+  // A conditional request allows the server to skip sending unchanged content.
+  auto it = options_.doc().FindMember("etag");
+  if (it != options_.doc().MemberEnd() && it->value.IsString() &&
+      it->value.GetStringLength() > 0) {
+    r << http::Request::Header("If-None-Match", it->value.GetString());
+  }
+}
+
+void TLSTransport::readResponse() {
+  response_etag_ = response_.headers()["ETag"];
+  response_not_modified_ = (response_.status() == 304);
+  if (response_not_modified_) {
+    // The unchanged resource is not sent again.
+    response_params_.doc().SetObject();
+    response_status_ = Status(0, "Not Modified");
+    return;
+  }
+
+  const auto& response_body = response_.body();
+  if (FLAGS_verbose && FLAGS_tls_dump) {
+    fprintf(stdout, "%s\n", response_body.c_str());
+  }
+  response_status_ = serializer_->deserialize(response_body, response_params_);
 }
 
 http::Client::Options TLSTransport::getOptions() {
@@ -164,32 +188,6 @@ inline bool tlsFailure(const std::string& what) {
   return true;
 }
 
-static auto getClient() {
-  std::shared_ptr<http::Client> client = nullptr;
-  if (FLAGS_tls_session_reuse) {
-    thread_local std::shared_ptr<http::Client> tl_client;
-    client = tl_client;
-
-    if (client.get() == nullptr) {
-      tl_client = client = std::make_shared<http::Client>();
-
-      if (FLAGS_tls_session_timeout > 0) {
-        thread_local boost::asio::deadline_timer tl_timer(IOService::get());
-
-        tl_timer.expires_from_now(
-            boost::posix_time::seconds(FLAGS_tls_session_timeout));
-        auto this_client = &tl_client;
-        tl_timer.async_wait([this_client](boost_system::error_code const&) {
-          (*this_client).reset();
-        });
-      }
-    }
-  } else {
-    client = std::make_shared<http::Client>();
-  }
-  return client;
-}
-
 Status TLSTransport::sendRequest() {
   if (destination_.find("https://") == std::string::npos) {
     return Status(1, "Cannot create TLS request for non-HTTPS protocol URI");
@@ -199,19 +197,15 @@ Status TLSTransport::sendRequest() {
   decorateRequest(r);
 
   VLOG(1) << "TLS/HTTPS GET request to URI: " << destination_;
+  auto options = getOptions();
+  auto client = http::ClientPool::get().checkout(destination_, options);
   try {
-    std::shared_ptr<http::Client> client = getClient();
-
-    client->setOptions(getOptions());
+    client->setOptions(options);
     response_ = client->get(r);
-
-    const auto& response_body = response_.body();
-    if (FLAGS_verbose && FLAGS_tls_dump) {
-      fprintf(stdout, "%s\n", response_body.c_str());
-    }
-    response_status_ =
-        serializer_->deserialize(response_body, response_params_);
+    readResponse();
   } catch (const std::exception& e) {
+    // Do not return a client in an unknown state to the pool.
+    client.discard();
     return Status((tlsFailure(e.what())) ? 2 : 1,
                   std::string("Request error: ") + e.what());
   }
@@ -244,23 +238,20 @@ Status TLSTransport::sendRequest(const std::string& params, bool compress) {
     fprintf(stdout, "%s\n", params.c_str());
   }
 
+  auto options = getOptions();
+  auto client = http::ClientPool::get().checkout(destination_, options);
   try {
-    std::shared_ptr<http::Client> client = getClient();
-    client->setOptions(getOptions());
+    client->setOptions(options);
 
     if (verb == HTTP_POST) {
       response_ = client->post(r, (compress) ? compressString(params) : params);
     } else {
       response_ = client->put(r, (compress) ? compressString(params) : params);
     }
-
-    const auto& response_body = response_.body();
-    if (FLAGS_verbose && FLAGS_tls_dump) {
-      fprintf(stdout, "%s\n", response_body.c_str());
-    }
-    response_status_ =
-        serializer_->deserialize(response_body, response_params_);
+    readResponse();
   } catch (const std::exception& e) {
+    // Do not return a client in an unknown state to the pool.
+    client.discard();
     return Status((tlsFailure(e.what())) ? 2 : 1,
                   std::string("Request error: ") + e.what());
   }
@@ -113,6 +113,9 @@ class TLSTransport : public Transport {
    */
   void decorateRequest(http::Request& r);
 
+  /// Read the response body, entity tag, and conditional request result.
+  void readResponse();
+
  protected:
   /// Storage for the HTTP response object
   http::Response response_;
@@ -120,6 +123,8 @@ class TLSTransport : public Transport {
  private:
   FRIEND_TEST(TLSTransportsTests, test_call);
   FRIEND_TEST(TLSTransportsTests, test_call_with_params);
+  FRIEND_TEST(TLSTransportsTests, test_call_not_modified);
+  FRIEND_TEST(TLSTransportsTests, test_call_reuse_connection);
   FRIEND_TEST(TLSTransportsTests, test_call_verify_peer);
   FRIEND_TEST(TLSTransportsTests, test_call_server_cert_pinning);
   FRIEND_TEST(TLSTransportsTests, test_call_client_auth);
@@ -66,6 +66,10 @@ class TLSRequestHelper : private boost::noncopyable {
   /**
    * @brief Send a TLS request
    *
+   * An optional "_etag" parameter makes the request conditional. After a
+   * successful request "_etag" is replaced with the entity tag of the
+   * response, and "_not_modified" is added if the content did not change.
+   *
    * @param uri is the URI to send the request to
    * @param params is a JSON object containing the params to send to the server.
    * This isn't const because it will be modified to include node_key.
@@ -111,6 +115,15 @@ class TLSRequestHelper : private boost::noncopyable {
       params_doc.RemoveMember("_verb");
     }
 
+    it = params_doc.FindMember("_etag");
+    if (it != params_doc.MemberEnd()) {
+      if (it->value.IsString()) {
+        request.setOption("etag", std::string(it->value.GetString()));
+      }
+      params_doc.RemoveMember("_etag");
+    }
+    params_doc.RemoveMember("_not_modified");
+
     bool use_post = true;
     it = params_doc.FindMember("_get");
     if (it != params_doc.MemberEnd()) {
@@ -139,6 +152,13 @@ class TLSRequestHelper : private boost::noncopyable {
       return status;
     }
 
+    // Report the entity tag for the caller's next conditional request.
+    params.add("_etag", request.getResponseETag());
+    if (request.isResponseNotModified()) {
+      params.add("_not_modified", true);
+      return Status(0, "OK");
+    }
+
     // Receive config or key rejection
     it = output_doc.FindMember("node_invalid");
     if (it != output_doc.MemberEnd()) {
@@ -11,6 +11,7 @@
 #include <benchmark/benchmark.h>
 
 #include <osquery/core.h>
+#include <osquery/flags.h>
 #include <osquery/registry.h>
 #include <osquery/sql.h>
 #include <osquery/tables.h>
@@ -19,6 +20,8 @@
 
 namespace osquery {
 
+DECLARE_bool(table_lazy_attach);
+
 class BenchmarkTablePlugin : public TablePlugin {
  protected:
   TableColumns columns() const {
@@ -284,16 +287,38 @@ BENCHMARK(SQL_virtual_table_internal_wide_yield)
     ->ArgPair(0, 1000);
 
 static void SQL_select_metadata(benchmark::State& state) {
+  // Lazily attached tables have no schema in sqlite_temp_master.
+  auto lazy_attach = FLAGS_table_lazy_attach;
+  FLAGS_table_lazy_attach = false;
   auto dbc = SQLiteDBManager::getUnique();
   while (state.KeepRunning()) {
     QueryData results;
     queryInternal("select count(*) from sqlite_temp_master;", results, dbc);
     dbc->clearAffectedTables();
   }
+  FLAGS_table_lazy_attach = lazy_attach;
 }
 
 BENCHMARK(SQL_select_metadata);
 
+static void SQL_attach_tables(benchmark::State& state) {
+  // Profile opening a connection and querying one table, with the tables
+  // attached eagerly (0) or when a query first uses them (1).
+  auto tables = RegistryFactory::get().registry("table");
+  tables->add("benchmark_attach", std::make_shared<BenchmarkTablePlugin>());
+
+  auto lazy_attach = FLAGS_table_lazy_attach;
+  FLAGS_table_lazy_attach = (state.range_x() == 1);
+  while (state.KeepRunning()) {
+    auto dbc = SQLiteDBManager::getUnique();
+    QueryData results;
+    queryInternal("select count(*) from benchmark_attach;", results, dbc);
+  }
+  FLAGS_table_lazy_attach = lazy_attach;
+}
+
+BENCHMARK(SQL_attach_tables)->Arg(0)->Arg(1);
+
 static void SQL_select_basic(benchmark::State& state) {
   // Profile executing a query against an internal, already attached table.
   while (state.KeepRunning()) {
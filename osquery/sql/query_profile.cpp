@@ -0,0 +1,161 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include "osquery/sql/query_profile.h"
+
+namespace osquery {
+
+FLAG(bool,
+     query_profile,
+     false,
+     "Record table, diff, and logging times of scheduled and distributed "
+     "queries");
+
+/// Maximum number of query names with a kept profile.
+const size_t kQueryProfileMax{1024};
+
+/// The profile of the query executing on this thread.
+static thread_local QueryProfile* kCurrentProfile{nullptr};
+
+static unsigned long long int elapsed(
+    const std::chrono::steady_clock::time_point& start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+QueryProfiler::Scope::Scope(const std::string& name, const std::string& query) {
+  // A nested scope, such as a query run by a table, adds to the outer profile.
+  if (!FLAGS_query_profile || kCurrentProfile != nullptr) {
+    return;
+  }
+
+  profile_ = std::make_unique<QueryProfile>();
+  profile_->name = name;
+  profile_->query = query;
+  profile_->time = getUnixTime();
+  start_ = std::chrono::steady_clock::now();
+  kCurrentProfile = profile_.get();
+}
+
+QueryProfiler::Scope::~Scope() {
+  if (profile_ == nullptr) {
+    return;
+  }
+
+  kCurrentProfile = nullptr;
+  profile_->wall_time_ns = elapsed(start_);
+  QueryProfiler::get().add(std::move(*profile_));
+}
+
+QueryProfiler::Timer::Timer(unsigned long long int QueryProfile::*counter) {
+  if (kCurrentProfile != nullptr) {
+    counter_ = &(kCurrentProfile->*counter);
+    start_ = std::chrono::steady_clock::now();
+  }
+}
+
+QueryProfiler::Timer::Timer(unsigned long long int* counter)
+    : counter_(counter) {
+  if (counter_ != nullptr) {
+    start_ = std::chrono::steady_clock::now();
+  }
+}
+
+QueryProfiler::Timer::~Timer() {
+  if (counter_ != nullptr) {
+    *counter_ += elapsed(start_);
+  }
+}
+
+QueryProfiler& QueryProfiler::get() {
+  static QueryProfiler profiler;
+  return profiler;
+}
+
+QueryProfile* QueryProfiler::current() {
+  return kCurrentProfile;
+}
+
+TableProfile* QueryProfiler::getTable(const std::string& table) {
+  if (kCurrentProfile == nullptr) {
+    return nullptr;
+  }
+  return &kCurrentProfile->tables[table];
+}
+
+void QueryProfiler::add(QueryProfile profile) {
+  WriteLock lock(mutex_);
+  auto name = profile.name;
+  if (profiles_.count(name) > 0) {
+    recent_.remove(name);
+  } else if (profiles_.size() >= kQueryProfileMax) {
+    profiles_.erase(recent_.back());
+    recent_.pop_back();
+  }
+
+  recent_.push_front(name);
+  profiles_[name] = std::move(profile);
+}
+
+std::vector<QueryProfile> QueryProfiler::profiles() const {
+  ReadLock lock(mutex_);
+  std::vector<QueryProfile> profiles;
+  for (const auto& profile : profiles_) {
+    profiles.push_back(profile.second);
+  }
+  return profiles;
+}
+
+bool QueryProfiler::getProfile(const std::string& name,
+                               QueryProfile& profile) const {
+  ReadLock lock(mutex_);
+  auto it = profiles_.find(name);
+  if (it == profiles_.end()) {
+    return false;
+  }
+  profile = it->second;
+  return true;
+}
+
+void QueryProfiler::clear() {
+  WriteLock lock(mutex_);
+  profiles_.clear();
+  recent_.clear();
+}
+
+Status serializeQueryProfile(const QueryProfile& profile,
+                             JSON& doc,
+                             rapidjson::Value& obj) {
+  doc.add("time", static_cast<size_t>(profile.time), obj);
+  doc.add("wall_time_ns", static_cast<size_t>(profile.wall_time_ns), obj);
+  doc.add("query_time_ns", static_cast<size_t>(profile.query_time_ns), obj);
+  doc.add("rows", static_cast<size_t>(profile.rows), obj);
+  doc.add("database_read_bytes",
+          static_cast<size_t>(profile.database_read_bytes),
+          obj);
+  doc.add("database_write_bytes",
+          static_cast<size_t>(profile.database_write_bytes),
+          obj);
+
+  auto tables_obj = doc.getObject();
+  for (const auto& table : profile.tables) {
+    auto table_obj = doc.getObject();
+    doc.add("scans", static_cast<size_t>(table.second.scans), table_obj);
+    doc.add("generate_time_ns",
+            static_cast<size_t>(table.second.generate_time_ns),
+            table_obj);
+    doc.add("rows", static_cast<size_t>(table.second.rows), table_obj);
+    doc.add(table.first, table_obj, tables_obj);
+  }
+  doc.add("tables", tables_obj, obj);
+  return Status(0);
+}
+} // namespace osquery
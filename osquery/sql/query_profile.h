@@ -0,0 +1,113 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core.h>
+#include <osquery/flags.h>
+#include <osquery/query.h>
+
+namespace osquery {
+
+/// Record where the time of scheduled and distributed queries is spent.
+DECLARE_bool(query_profile);
+
+/**
+ * @brief Recent profiles of scheduled and distributed queries.
+ *
+ * A Scope starts a profile for the queries executed by the current thread.
+ * The virtual tables, database, and logger add their counters to the profile
+ * of the current thread, if any, and the profile is kept when the Scope ends.
+ *
+ * The most recent profile of each query name is kept.
+ */
+class QueryProfiler : private boost::noncopyable {
+ public:
+  /// Profile the work of the current thread within this scope.
+  class Scope : private boost::noncopyable {
+   public:
+    Scope(const std::string& name, const std::string& query);
+    ~Scope();
+
+    /// The profile, or nullptr if profiling is disabled.
+    QueryProfile* profile() const {
+      return profile_.get();
+    }
+
+   private:
+    std::unique_ptr<QueryProfile> profile_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  /// Add the nanoseconds spent within this scope to a profile counter.
+  class Timer : private boost::noncopyable {
+   public:
+    /// Use the counter of the current thread's profile.
+    explicit Timer(unsigned long long int QueryProfile::*counter);
+
+    /// Use any counter, nullptr to disable the timer.
+    explicit Timer(unsigned long long int* counter);
+    ~Timer();
+
+   private:
+    unsigned long long int* counter_{nullptr};
+    std::chrono::steady_clock::time_point start_;
+  };
+
+ public:
+  /// The profiler shared by every thread.
+  static QueryProfiler& get();
+
+  /// The profile of the current thread, or nullptr if it is not profiled.
+  static QueryProfile* current();
+
+  /// The counters for a table within the current thread's profile, or nullptr.
+  static TableProfile* getTable(const std::string& table);
+
+  /// The most recent profile of each query.
+  std::vector<QueryProfile> profiles() const;
+
+  /// The most recent profile of a query, if one was kept.
+  bool getProfile(const std::string& name, QueryProfile& profile) const;
+
+  /// Remove every profile.
+  void clear();
+
+ private:
+  QueryProfiler() = default;
+
+  /// Keep a completed profile.
+  void add(QueryProfile profile);
+
+ private:
+  /// Profiles by query name.
+  std::map<std::string, QueryProfile> profiles_;
+
+  /// Query names, the most recently profiled first.
+  std::list<std::string> recent_;
+
+  /// Protect the profiles.
+  mutable Mutex mutex_;
+};
+
+/// Serialize a profile as a JSON object, attached to distributed results.
+Status serializeQueryProfile(const QueryProfile& profile,
+                             JSON& doc,
+                             rapidjson::Value& obj);
+} // namespace osquery
@@ -24,6 +24,8 @@ FLAG(int32, value_max, 512, "Maximum returned row value size");
 
 CREATE_LAZY_REGISTRY(SQLPlugin, "sql");
 
+const int kQueryBudgetExceeded{3};
+
 SQL::SQL(const std::string& query, bool use_cache) {
   TableColumns table_columns;
   status_ = getQueryColumns(query, table_columns);
@@ -121,6 +123,16 @@ QueryData SQL::selectAllFrom(const std::string& table,
   return response;
 }
 
+/// Read an optional QueryBudget limit from a SQL plugin request.
+static size_t getBudgetLimit(const PluginRequest& request,
+                             const std::string& key) {
+  unsigned long long limit = 0;
+  if (request.count(key) > 0) {
+    safeStrtoull(request.at(key), 10, limit);
+  }
+  return static_cast<size_t>(limit);
+}
+
 Status SQLPlugin::call(const PluginRequest& request, PluginResponse& response) {
   response.clear();
   if (request.count("action") == 0) {
@@ -129,6 +141,14 @@ Status SQLPlugin::call(const PluginRequest& request, PluginResponse& response) {
 
   if (request.at("action") == "query") {
     bool use_cache = (request.count("cache") && request.at("cache") == "1");
+    QueryBudget budget;
+    budget.max_rows = getBudgetLimit(request, "max_rows");
+    budget.max_bytes = getBudgetLimit(request, "max_bytes");
+    budget.timeout = getBudgetLimit(request, "timeout");
+    if (budget.limited()) {
+      return this->queryWithBudget(
+          request.at("query"), response, use_cache, budget);
+    }
     return this->query(request.at("query"), response, use_cache);
   } else if (request.at("action") == "columns") {
     TableColumns columns;
@@ -168,6 +188,19 @@ Status query(const std::string& q, QueryData& results, bool use_cache) {
       results);
 }
 
+Status query(const std::string& q,
+             QueryData& results,
+             const QueryBudget& budget) {
+  return Registry::call("sql",
+                        "sql",
+                        {{"action", "query"},
+                         {"query", q},
+                         {"max_rows", std::to_string(budget.max_rows)},
+                         {"max_bytes", std::to_string(budget.max_bytes)},
+                         {"timeout", std::to_string(budget.timeout)}},
+                        results);
+}
+
 Status getQueryColumns(const std::string& q, TableColumns& columns) {
   PluginResponse response;
   auto status = Registry::call(
@@ -8,6 +8,10 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
 #include <osquery/core.h>
 #include <osquery/flags.h>
 #include <osquery/logger.h>
@@ -116,6 +120,12 @@ class SQLiteSQLPlugin : public SQLPlugin {
                QueryData& results,
                bool use_cache) const override;
 
+  /// Execute SQL within a set of resource limits and store results.
+  Status queryWithBudget(const std::string& query,
+                         QueryData& results,
+                         bool use_cache,
+                         const QueryBudget& budget) const override;
+
   /// Introspect, explain, the suspected types selected in an SQL statement.
   Status getQueryColumns(const std::string& query,
                          TableColumns& columns) const override;
@@ -154,6 +164,17 @@ Status SQLiteSQLPlugin::query(const std::string& query,
   return result;
 }
 
+Status SQLiteSQLPlugin::queryWithBudget(const std::string& query,
+                                        QueryData& results,
+                                        bool use_cache,
+                                        const QueryBudget& budget) const {
+  auto dbc = SQLiteDBManager::get();
+  dbc->useCache(use_cache);
+  auto result = queryInternal(query, results, dbc, budget);
+  dbc->clearAffectedTables();
+  return result;
+}
+
 Status SQLiteSQLPlugin::getQueryColumns(const std::string& query,
                                         TableColumns& columns) const {
   auto dbc = SQLiteDBManager::get();
@@ -168,10 +189,15 @@ Status SQLiteSQLPlugin::getQueryTables(const std::string& query,
   return Status(0);
 }
 
-SQLInternal::SQLInternal(const std::string& query, bool use_cache) {
+SQLInternal::SQLInternal(const std::string& query, bool use_cache)
+    : SQLInternal(query, use_cache, QueryBudget()) {}
+
+SQLInternal::SQLInternal(const std::string& query,
+                         bool use_cache,
+                         const QueryBudget& budget) {
   auto dbc = SQLiteDBManager::get();
   dbc->useCache(use_cache);
-  status_ = queryInternal(query, results_, dbc);
+  status_ = queryInternal(query, results_, dbc, budget);
 
   // One of the advantages of using SQLInternal (aside from the Registry-bypass)
   // is the ability to "deep-inspect" the table attributes and actions.
@@ -293,6 +319,7 @@ void SQLiteDBInstance::clearAffectedTables() {
 
   for (const auto& table : affected_tables_) {
     table.second->constraints.clear();
+    table.second->colsUsed.clear();
     table.second->cache.clear();
   }
   // Since the affected tables are cleared, there are no more affected tables.
@@ -448,12 +475,130 @@ int queryDataCallback(void* argument, int argc, char* argv[], char* column[]) {
   return 0;
 }
 
+namespace {
+
+/// The state of a single query execution within a QueryBudget.
+struct QueryBudgetState {
+  QueryBudgetState(QueryData& r, const QueryBudget& b)
+      : results(r), budget(b) {}
+
+  QueryData& results;
+  const QueryBudget& budget;
+
+  /// Accumulated result size.
+  size_t bytes{0};
+
+  /// Time after which the execution is interrupted.
+  std::chrono::steady_clock::time_point deadline;
+
+  /// The name of the exceeded limit.
+  std::string exceeded;
+};
+
+/// Number of SQLite virtual machine instructions between deadline checks.
+const int kQueryBudgetProgressOps{1000};
+
+int queryBudgetCallback(void* argument,
+                        int argc,
+                        char* argv[],
+                        char* column[]) {
+  auto state = static_cast<QueryBudgetState*>(argument);
+  const auto& budget = state->budget;
+  if (budget.max_rows > 0 && state->results.size() >= budget.max_rows) {
+    state->exceeded = "row";
+    return 1;
+  }
+
+  if (budget.max_bytes > 0) {
+    size_t bytes = 0;
+    for (int i = 0; i < argc; i++) {
+      if (column[i] != nullptr) {
+        bytes += std::strlen(column[i]);
+        bytes += (argv[i] != nullptr) ? std::strlen(argv[i])
+                                      : FLAGS_nullvalue.size();
+      }
+    }
+
+    if (state->bytes + bytes > budget.max_bytes) {
+      state->exceeded = "byte";
+      return 1;
+    }
+    state->bytes += bytes;
+  }
+  return queryDataCallback(&state->results, argc, argv, column);
+}
+
+/// The deadline of the budgeted query executing on this thread.
+thread_local std::chrono::steady_clock::time_point kQueryDeadline{
+    std::chrono::steady_clock::time_point::max()};
+
+int queryBudgetProgress(void* argument) {
+  auto state = static_cast<QueryBudgetState*>(argument);
+  if (std::chrono::steady_clock::now() >= state->deadline) {
+    state->exceeded = "time";
+    return 1;
+  }
+  return 0;
+}
+} // namespace
+
+std::chrono::steady_clock::time_point getQueryDeadline() {
+  return kQueryDeadline;
+}
+
 Status queryInternal(const std::string& q,
                      QueryData& results,
                      const SQLiteDBInstanceRef& instance) {
+  return queryInternal(q, results, instance, QueryBudget());
+}
+
+Status queryInternal(const std::string& q,
+                     QueryData& results,
+                     const SQLiteDBInstanceRef& instance,
+                     const QueryBudget& budget) {
   char* err = nullptr;
   auto lock = instance->attachLock();
-  sqlite3_exec(instance->db(), q.c_str(), queryDataCallback, &results, &err);
+  if (!budget.limited()) {
+    sqlite3_exec(instance->db(), q.c_str(), queryDataCallback, &results, &err);
+  } else {
+    QueryBudgetState state(results, budget);
+    auto outer_deadline = kQueryDeadline;
+    if (budget.timeout > 0) {
+      // The deadline is checked as SQLite steps through the generated rows,
+      // and by generators through their QueryContext.
+      state.deadline = std::min(outer_deadline,
+                                std::chrono::steady_clock::now() +
+                                    std::chrono::milliseconds(budget.timeout));
+      kQueryDeadline = state.deadline;
+      sqlite3_progress_handler(instance->db(),
+                               kQueryBudgetProgressOps,
+                               queryBudgetProgress,
+                               &state);
+    }
+
+    sqlite3_exec(instance->db(), q.c_str(), queryBudgetCallback, &state, &err);
+    if (budget.timeout > 0) {
+      sqlite3_progress_handler(instance->db(), 0, nullptr, nullptr);
+      kQueryDeadline = outer_deadline;
+
+      // A generator that stopped at the deadline returned partial rows,
+      // possibly before the progress handler was called.
+      if (state.exceeded.empty() &&
+          std::chrono::steady_clock::now() >= state.deadline) {
+        state.exceeded = "time";
+      }
+    }
+
+    if (!state.exceeded.empty()) {
+      sqlite3_db_release_memory(instance->db());
+      if (err != nullptr) {
+        sqlite3_free(err);
+      }
+      return Status(kQueryBudgetExceeded,
+                    "Query exceeded its " + state.exceeded + " budget");
+    }
+  }
+
   sqlite3_db_release_memory(instance->db());
   if (err != nullptr) {
     auto error_string = std::string(err);
@@ -11,6 +11,7 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <map>
 #include <mutex>
 #include <unordered_set>
@@ -316,6 +317,35 @@ Status queryInternal(const std::string& q,
                      QueryData& results,
                      const SQLiteDBInstanceRef& instance);
 
+/**
+ * @brief SQLite Internal: Execute a query within a set of resource limits
+ *
+ * Rows are collected until the row or byte limit would be exceeded. A SQLite
+ * progress handler interrupts the execution after the timeout, and table
+ * generators may stop early using the deadline in their QueryContext.
+ *
+ * @param q the query to execute
+ * @param results The QueryData struct to emit rows collected within budget.
+ * @param db the SQLite3 database to execute query q against
+ * @param budget the limits applied to the execution
+ *
+ * @return A status indicating SQL query results, kQueryBudgetExceeded if the
+ * query was aborted.
+ */
+Status queryInternal(const std::string& q,
+                     QueryData& results,
+                     const SQLiteDBInstanceRef& instance,
+                     const QueryBudget& budget);
+
+/**
+ * @brief The deadline of the budgeted query executing on this thread.
+ *
+ * Virtual tables pass the deadline to their generators in the QueryContext.
+ *
+ * @return the time after which the query is interrupted, the maximum if none.
+ */
+std::chrono::steady_clock::time_point getQueryDeadline();
+
 /**
  * @brief SQLite Intern: Analyze a query, providing information about the
  * result columns
@@ -348,6 +378,20 @@ class SQLInternal : public SQL {
    */
   explicit SQLInternal(const std::string& query, bool use_cache = false);
 
+  /**
+   * @brief Instantiate an instance of the class with a limited internal query.
+   *
+   * See QueryBudget, the rows collected before a limit is exceeded are kept
+   * and the status uses the kQueryBudgetExceeded code.
+   *
+   * @param query An osquery SQL query.
+   * @param use_cache Set true to use the query cache.
+   * @param budget The limits applied to the execution.
+   */
+  SQLInternal(const std::string& query,
+              bool use_cache,
+              const QueryBudget& budget);
+
  public:
   /**
    * @brief Check if the SQL query's results use event-based tables.
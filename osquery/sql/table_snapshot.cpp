@@ -0,0 +1,167 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include "osquery/sql/table_snapshot.h"
+
+namespace osquery {
+
+FLAG(uint64,
+     table_snapshot_window,
+     5,
+     "Seconds scheduled queries share table results, 0 to disable");
+
+FLAG(uint64,
+     table_snapshot_max_size,
+     32,
+     "Maximum megabytes of shared table results kept in memory");
+
+DECLARE_bool(disable_caching);
+
+/// Estimated bookkeeping bytes for each row and column.
+const size_t kSnapshotRowOverhead{64};
+const size_t kSnapshotColumnOverhead{32};
+
+TableSnapshotCache& TableSnapshotCache::get() {
+  static TableSnapshotCache cache;
+  return cache;
+}
+
+bool TableSnapshotCache::allowed(const VirtualTableContent& content) const {
+  if (FLAGS_disable_caching) {
+    return false;
+  }
+
+  if (FLAGS_table_snapshot_window == 0) {
+    ReadLock lock(mutex_);
+    if (batch_ == 0) {
+      return false;
+    }
+  }
+
+  // Event tables return new rows each scan and utility tables report the
+  // state of osquery, which changes while the schedule runs.
+  auto attributes = TableAttributes::EVENT_BASED | TableAttributes::UTILITY;
+  return (content.attributes & attributes) == 0;
+}
+
+std::string TableSnapshotCache::getKey(const std::string& table,
+                                       const QueryContext& context) {
+  std::string key = table;
+  for (const auto& column : context.constraints) {
+    for (const auto& constraint : column.second.getAll()) {
+      key += '\0' + column.first + '\0' + std::to_string(constraint.op) +
+             '\0' + constraint.expr;
+    }
+  }
+  return key;
+}
+
+std::shared_ptr<const QueryData> TableSnapshotCache::find(
+    const std::string& table, const std::string& key) {
+  WriteLock lock(mutex_);
+  auto& stats = stats_[table];
+  auto it = snapshots_.find(key);
+  if (it != snapshots_.end()) {
+    auto window = std::chrono::seconds(FLAGS_table_snapshot_window);
+    if ((batch_ != 0 && it->second.batch == batch_) ||
+        std::chrono::steady_clock::now() - it->second.created < window) {
+      used_.splice(used_.begin(), used_, it->second.used);
+      it->second.batch = batch_;
+      stats.hits++;
+      return it->second.results;
+    }
+    remove(it);
+  }
+
+  stats.misses++;
+  return nullptr;
+}
+
+void TableSnapshotCache::insert(const std::string& table,
+                                const std::string& key,
+                                std::shared_ptr<const QueryData> results) {
+  size_t size = key.size();
+  for (const auto& row : *results) {
+    size += kSnapshotRowOverhead;
+    for (const auto& column : row) {
+      size += column.first.size() + column.second.size();
+      size += kSnapshotColumnOverhead;
+    }
+  }
+
+  size_t max_size = FLAGS_table_snapshot_max_size * 1024 * 1024;
+  if (size > max_size) {
+    return;
+  }
+
+  WriteLock lock(mutex_);
+  auto existing = snapshots_.find(key);
+  if (existing != snapshots_.end()) {
+    remove(existing);
+  }
+
+  // Snapshots used by the current batch are the most recently used.
+  while (!used_.empty() && size_ + size > max_size) {
+    auto oldest = snapshots_.find(used_.back());
+    if (batch_ != 0 && oldest->second.batch == batch_) {
+      break;
+    }
+    stats_[oldest->second.table].evictions++;
+    remove(oldest);
+  }
+
+  used_.push_front(key);
+  auto& snapshot = snapshots_[key];
+  snapshot.table = table;
+  snapshot.results = std::move(results);
+  snapshot.created = std::chrono::steady_clock::now();
+  snapshot.size = size;
+  snapshot.used = used_.begin();
+  snapshot.batch = batch_;
+
+  size_ += size;
+  auto& stats = stats_[table];
+  stats.snapshots++;
+  stats.size += size;
+}
+
+void TableSnapshotCache::remove(
+    std::unordered_map<std::string, Snapshot>::iterator it) {
+  auto& stats = stats_[it->second.table];
+  stats.snapshots--;
+  stats.size -= it->second.size;
+  size_ -= it->second.size;
+  used_.erase(it->second.used);
+  snapshots_.erase(it);
+}
+
+std::map<std::string, TableSnapshotStats> TableSnapshotCache::stats() const {
+  ReadLock lock(mutex_);
+  return stats_;
+}
+
+void TableSnapshotCache::beginBatch() {
+  WriteLock lock(mutex_);
+  batch_ = ++last_batch_;
+}
+
+void TableSnapshotCache::endBatch() {
+  WriteLock lock(mutex_);
+  batch_ = 0;
+}
+
+void TableSnapshotCache::clear() {
+  WriteLock lock(mutex_);
+  snapshots_.clear();
+  used_.clear();
+  stats_.clear();
+  size_ = 0;
+}
+} // namespace osquery
@@ -0,0 +1,165 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core.h>
+#include <osquery/flags.h>
+#include <osquery/tables.h>
+
+namespace osquery {
+
+/// Seconds a table snapshot is shared by scheduled queries.
+DECLARE_uint64(table_snapshot_window);
+
+/// Megabytes of table snapshots kept in memory.
+DECLARE_uint64(table_snapshot_max_size);
+
+/// Counters for the snapshots of one table.
+struct TableSnapshotStats {
+  /// Scans answered from a snapshot.
+  size_t hits{0};
+
+  /// Scans that generated the table.
+  size_t misses{0};
+
+  /// Snapshots removed to stay within the memory budget.
+  size_t evictions{0};
+
+  /// Snapshots currently kept.
+  size_t snapshots{0};
+
+  /// Estimated bytes of the snapshots currently kept.
+  size_t size{0};
+};
+
+/**
+ * @brief An in-memory cache of table results shared by scheduled queries.
+ *
+ * Several packs often scan the same table within seconds of each other. The
+ * first scheduled query that scans a table with a given set of constraints
+ * stores the generated rows, and queries scanning the same table with the same
+ * constraints within `table_snapshot_window` seconds read the stored rows.
+ *
+ * Snapshots are kept as generated row data, no serialization is involved, and
+ * are shared with readers without a copy. The least recently used snapshots
+ * are evicted when the estimated size exceeds `table_snapshot_max_size`.
+ *
+ * Only queries that allow caching, scheduled queries, use snapshots.
+ *
+ * The scheduler runs the queries due at the same time as a batch. Snapshots
+ * used within a batch stay valid until the batch ends, independent of the
+ * window, and are not evicted. Every query in the batch reads the same rows
+ * from a table, a consistent point-in-time view, and each table is scanned
+ * once per set of constraints.
+ */
+class TableSnapshotCache : private boost::noncopyable {
+ public:
+  /// Share table scans between the scheduled queries run in this scope.
+  class Batch : private boost::noncopyable {
+   public:
+    Batch() {
+      TableSnapshotCache::get().beginBatch();
+    }
+
+    ~Batch() {
+      TableSnapshotCache::get().endBatch();
+    }
+  };
+
+ public:
+  /// The cache shared by every SQLite instance.
+  static TableSnapshotCache& get();
+
+  /// Check if a table's results may be shared.
+  bool allowed(const VirtualTableContent& content) const;
+
+  /// The snapshot key for a table scan: table name and constraints.
+  static std::string getKey(const std::string& table,
+                            const QueryContext& context);
+
+  /**
+   * @brief Find a fresh snapshot.
+   *
+   * @param table The table name, used for counters.
+   * @param key The key from getKey.
+   * @return The snapshot rows, or nullptr if there is no fresh snapshot.
+   */
+  std::shared_ptr<const QueryData> find(const std::string& table,
+                                        const std::string& key);
+
+  /// Store the generated rows of a table scan.
+  void insert(const std::string& table,
+              const std::string& key,
+              std::shared_ptr<const QueryData> results);
+
+  /// Return the counters for each table.
+  std::map<std::string, TableSnapshotStats> stats() const;
+
+  /// Remove every snapshot and reset counters.
+  void clear();
+
+ private:
+  TableSnapshotCache() = default;
+
+  /// Start a batch, snapshots used until the batch ends are kept.
+  void beginBatch();
+
+  /// End the current batch.
+  void endBatch();
+
+  struct Snapshot {
+    std::string table;
+    std::shared_ptr<const QueryData> results;
+    std::chrono::steady_clock::time_point created;
+    size_t size{0};
+
+    /// Position in the recently used list.
+    std::list<std::string>::iterator used;
+
+    /// The last batch that used the snapshot.
+    size_t batch{0};
+  };
+
+  /// Remove a snapshot, the caller holds the lock.
+  void remove(std::unordered_map<std::string, Snapshot>::iterator it);
+
+ private:
+  /// Snapshots by key.
+  std::unordered_map<std::string, Snapshot> snapshots_;
+
+  /// Snapshot keys, the most recently used first.
+  std::list<std::string> used_;
+
+  /// Estimated bytes of all snapshots.
+  size_t size_{0};
+
+  /// Counters by table name.
+  std::map<std::string, TableSnapshotStats> stats_;
+
+  /// The current batch, 0 when no batch is running.
+  size_t batch_{0};
+
+  /// The identifier of the most recent batch.
+  size_t last_batch_{0};
+
+  /// Protect the snapshots and counters.
+  mutable Mutex mutex_;
+};
+} // namespace osquery
@@ -92,6 +92,47 @@ TEST_F(SQLiteUtilTests, test_direct_query_execution) {
   EXPECT_EQ(results, getTestDBExpectedResults());
 }
 
+TEST_F(SQLiteUtilTests, test_query_budget) {
+  auto dbc = getTestDBC();
+  std::string many =
+      "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c) "
+      "SELECT x FROM c LIMIT 100";
+
+  QueryBudget budget;
+  budget.max_rows = 10;
+  QueryData results;
+  auto status = queryInternal(many, results, dbc, budget);
+  EXPECT_EQ(status.getCode(), kQueryBudgetExceeded);
+  EXPECT_EQ(results.size(), 10U);
+
+  // Nine rows of two bytes and one row of three bytes.
+  budget = QueryBudget();
+  budget.max_bytes = 21;
+  results.clear();
+  status = queryInternal(many, results, dbc, budget);
+  EXPECT_EQ(status.getCode(), kQueryBudgetExceeded);
+  EXPECT_EQ(results.size(), 10U);
+
+  // An unbounded recursion is interrupted by the deadline.
+  budget = QueryBudget();
+  budget.timeout = 10;
+  results.clear();
+  status = queryInternal(
+      "WITH RECURSIVE c(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM c) "
+      "SELECT count(*) FROM c",
+      results,
+      dbc,
+      budget);
+  EXPECT_EQ(status.getCode(), kQueryBudgetExceeded);
+
+  // Queries within budget are not affected.
+  budget.max_rows = 1000;
+  results.clear();
+  status = queryInternal(kTestQuery, results, dbc, budget);
+  EXPECT_TRUE(status.ok());
+  EXPECT_EQ(results, getTestDBExpectedResults());
+}
+
 TEST_F(SQLiteUtilTests, test_passing_callback_no_data_param) {
   char* err = nullptr;
   auto dbc = getTestDBC();
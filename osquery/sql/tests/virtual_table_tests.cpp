@@ -8,6 +8,9 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <chrono>
+#include <thread>
+
 #include <gtest/gtest.h>
 
 #include <osquery/core.h>
@@ -15,6 +18,9 @@
 #include <osquery/registry.h>
 #include <osquery/sql.h>
 
+#include "osquery/core/process.h"
+#include "osquery/sql/query_profile.h"
+#include "osquery/sql/table_snapshot.h"
 #include "osquery/sql/virtual_table.h"
 
 namespace osquery {
@@ -192,6 +198,30 @@ TEST_F(VirtualTableTests, test_sqlite3_attach_vtable) {
       results[0]["sql"]);
 }
 
+TEST_F(VirtualTableTests, test_sqlite3_lazy_attach) {
+  auto tables = RegistryFactory::get().registry("table");
+  tables->add("lazy_aliases", std::make_shared<aliasesTablePlugin>());
+
+  // A new connection attaches registered tables without their schema.
+  auto dbc = SQLiteDBManager::getUnique();
+  QueryData results;
+  auto status = queryInternal(
+      "SELECT * FROM sqlite_temp_master WHERE tbl_name = 'lazy_aliases'",
+      results,
+      dbc);
+  EXPECT_TRUE(status.ok());
+  EXPECT_TRUE(results.empty());
+
+  // The schema, including column aliases, is created on first reference.
+  status = queryInternal(
+      "SELECT username, user_name FROM lazy_aliases", results, dbc);
+  EXPECT_TRUE(status.ok());
+
+  // Table aliases are views created with the connection.
+  status = queryInternal("SELECT name FROM aliases1", results, dbc);
+  EXPECT_TRUE(status.ok());
+}
+
 TEST_F(VirtualTableTests, test_sqlite3_table_joins) {
   // Get a database connection.
   auto dbc = SQLiteDBManager::getUnique();
@@ -449,6 +479,56 @@ TEST_F(VirtualTableTests, test_table_cache) {
   ASSERT_EQ(results[0]["data"], "awesome_data");
 }
 
+class columnsUsedTablePlugin : public TablePlugin {
+ public:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("a", TEXT_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("b", TEXT_TYPE, ColumnOptions::DEFAULT),
+        std::make_tuple("c", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  QueryData generate(QueryContext& ctx) override {
+    used_.clear();
+    for (const auto& column : {"a", "b", "c"}) {
+      if (ctx.isColumnUsed(column)) {
+        used_ += column;
+      }
+    }
+    return {{{"a", "1"}, {"b", "2"}, {"c", "3"}}};
+  }
+
+  std::string used_;
+
+ private:
+  FRIEND_TEST(VirtualTableTests, test_columns_used);
+};
+
+TEST_F(VirtualTableTests, test_columns_used) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto table = std::make_shared<columnsUsedTablePlugin>();
+  tables->add("columns_used", table);
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("columns_used", table->columnDefinition(), dbc);
+
+  // Columns selected or filtered are used.
+  QueryData results;
+  queryInternal("SELECT a FROM columns_used WHERE b = '2'", results, dbc);
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(table->used_, "ab");
+
+  results.clear();
+  queryInternal("SELECT count(*) AS n FROM columns_used", results, dbc);
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["n"], "1");
+  EXPECT_EQ(table->used_, "");
+
+  results.clear();
+  queryInternal("SELECT * FROM columns_used", results, dbc);
+  EXPECT_EQ(table->used_, "abc");
+}
+
 class tableCacheTablePlugin : public TablePlugin {
  public:
   TableColumns columns() const override {
@@ -530,6 +610,128 @@ TEST_F(VirtualTableTests, test_table_results_cache) {
   EXPECT_EQ(cache->generates_, 4U);
 }
 
+class snapshotTablePlugin : public TablePlugin {
+ public:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("i", TEXT_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+  QueryData generate(QueryContext& ctx) override {
+    generates_++;
+    return {{{"i", "1"}}, {{"i", "2"}}};
+  }
+
+  size_t generates_{0};
+};
+
+TEST_F(VirtualTableTests, test_table_snapshots) {
+  auto& snapshots = TableSnapshotCache::get();
+  snapshots.clear();
+
+  auto tables = RegistryFactory::get().registry("table");
+  auto table = std::make_shared<snapshotTablePlugin>();
+  tables->add("table_snapshot", table);
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("table_snapshot", table->columnDefinition(), dbc);
+
+  // Queries that do not use the cache always generate.
+  QueryData results;
+  queryInternal("SELECT * from table_snapshot", results, dbc);
+  queryInternal("SELECT * from table_snapshot", results, dbc);
+  EXPECT_EQ(table->generates_, 2U);
+  EXPECT_EQ(snapshots.stats().count("table_snapshot"), 0U);
+
+  // Scheduled queries share the results of the first scan.
+  dbc->useCache(true);
+  results.clear();
+  queryInternal("SELECT * from table_snapshot", results, dbc);
+  EXPECT_EQ(results.size(), 2U);
+  results.clear();
+  queryInternal("SELECT i from table_snapshot where i = '2'", results, dbc);
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["i"], "2");
+  EXPECT_EQ(table->generates_, 4U);
+
+  results.clear();
+  queryInternal("SELECT count(*) as c from table_snapshot", results, dbc);
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["c"], "2");
+  EXPECT_EQ(table->generates_, 4U);
+
+  auto stats = snapshots.stats()["table_snapshot"];
+  EXPECT_EQ(stats.hits, 1U);
+  EXPECT_EQ(stats.misses, 2U);
+  EXPECT_EQ(stats.snapshots, 2U);
+  EXPECT_GT(stats.size, 0U);
+
+  // Snapshots older than the window are not used.
+  auto window = FLAGS_table_snapshot_window;
+  FLAGS_table_snapshot_window = 1;
+  sleepFor(1100);
+  queryInternal("SELECT * from table_snapshot", results, dbc);
+  EXPECT_EQ(table->generates_, 5U);
+  FLAGS_table_snapshot_window = window;
+  dbc->useCache(false);
+
+  // Old snapshots are evicted to stay within the memory limit.
+  snapshots.clear();
+  auto max_size = FLAGS_table_snapshot_max_size;
+  FLAGS_table_snapshot_max_size = 1;
+  auto large = std::make_shared<QueryData>();
+  large->push_back({{"data", std::string(600 * 1024, 'A')}});
+  snapshots.insert("large", "1", large);
+  snapshots.insert("large", "2", large);
+  EXPECT_EQ(snapshots.find("large", "1"), nullptr);
+  EXPECT_NE(snapshots.find("large", "2"), nullptr);
+
+  stats = snapshots.stats()["large"];
+  EXPECT_EQ(stats.evictions, 1U);
+  EXPECT_EQ(stats.snapshots, 1U);
+  FLAGS_table_snapshot_max_size = max_size;
+  snapshots.clear();
+}
+
+TEST_F(VirtualTableTests, test_table_snapshot_batch) {
+  auto& snapshots = TableSnapshotCache::get();
+  snapshots.clear();
+
+  auto tables = RegistryFactory::get().registry("table");
+  auto table = std::make_shared<snapshotTablePlugin>();
+  tables->add("table_snapshot_batch", table);
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("table_snapshot_batch", table->columnDefinition(), dbc);
+  dbc->useCache(true);
+
+  // Without a window, snapshots are only shared within a batch.
+  auto window = FLAGS_table_snapshot_window;
+  FLAGS_table_snapshot_window = 0;
+  QueryData results;
+  queryInternal("SELECT * from table_snapshot_batch", results, dbc);
+  queryInternal("SELECT * from table_snapshot_batch", results, dbc);
+  EXPECT_EQ(table->generates_, 2U);
+
+  {
+    TableSnapshotCache::Batch batch;
+    results.clear();
+    queryInternal("SELECT * from table_snapshot_batch", results, dbc);
+    queryInternal(
+        "SELECT * from table_snapshot_batch t1, table_snapshot_batch t2",
+        results,
+        dbc);
+    EXPECT_EQ(table->generates_, 3U);
+    EXPECT_EQ(results.size(), 4U);
+  }
+
+  // The batch has ended.
+  queryInternal("SELECT * from table_snapshot_batch", results, dbc);
+  EXPECT_EQ(table->generates_, 4U);
+
+  FLAGS_table_snapshot_window = window;
+  snapshots.clear();
+}
+
 class yieldTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
@@ -553,6 +755,9 @@ class yieldTablePlugin : public TablePlugin {
 
  private:
   size_t index_{0};
+
+ private:
+  FRIEND_TEST(VirtualTableTests, test_yield_generator_snapshot);
 };
 
 TEST_F(VirtualTableTests, test_yield_generator) {
@@ -575,6 +780,184 @@ TEST_F(VirtualTableTests, test_yield_generator) {
   EXPECT_EQ(results[0]["index"], "10");
 }
 
+TEST_F(VirtualTableTests, test_yield_generator_snapshot) {
+  auto& snapshots = TableSnapshotCache::get();
+  snapshots.clear();
+
+  auto table = std::make_shared<yieldTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("yield_snapshot", table);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("yield_snapshot", table->columnDefinition(), dbc);
+
+  // Scheduled queries share the rows collected from the generator.
+  dbc->useCache(true);
+  QueryData results;
+  queryInternal("SELECT * from yield_snapshot", results, dbc);
+  ASSERT_EQ(results.size(), 10U);
+  EXPECT_EQ(results[0]["index"], "0");
+
+  results.clear();
+  queryInternal("SELECT * from yield_snapshot", results, dbc);
+  ASSERT_EQ(results.size(), 10U);
+  EXPECT_EQ(results[0]["index"], "0");
+  EXPECT_EQ(snapshots.stats()["yield_snapshot"].hits, 1U);
+  dbc->useCache(false);
+
+  // Other queries read from the generator.
+  results.clear();
+  queryInternal("SELECT * from yield_snapshot", results, dbc);
+  ASSERT_EQ(results.size(), 10U);
+  EXPECT_EQ(results[0]["index"], "10");
+  snapshots.clear();
+}
+
+TEST_F(VirtualTableTests, test_yield_generator_limit) {
+  auto table = std::make_shared<yieldTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("yield_limit", table);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("yield_limit", table->columnDefinition(), dbc);
+
+  // The generator is not resumed after the limit is reached.
+  QueryData results;
+  queryInternal("SELECT * from yield_limit LIMIT 2", results, dbc);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(results.size(), 2U);
+
+  results.clear();
+  queryInternal("SELECT * from yield_limit", results, dbc);
+  dbc->clearAffectedTables();
+  ASSERT_EQ(results.size(), 10U);
+  EXPECT_LE(std::stoul(results[0]["index"]), 3U);
+
+  // The generate action collects every row yielded.
+  PluginResponse response;
+  EXPECT_TRUE(table->call({{"action", "generate"}}, response).ok());
+  EXPECT_EQ(response.size(), 10U);
+}
+
+class deadlineTablePlugin : public TablePlugin {
+ private:
+  TableColumns columns() const override {
+    return {
+        std::make_tuple("index", INTEGER_TYPE, ColumnOptions::DEFAULT),
+    };
+  }
+
+ public:
+  QueryData generate(QueryContext& context) override {
+    QueryData results;
+    for (size_t i = 0; i < 1000 && !context.expired(); i++) {
+      results.push_back({{"index", std::to_string(i)}});
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return results;
+  }
+
+ private:
+  FRIEND_TEST(VirtualTableTests, test_generate_deadline);
+};
+
+TEST_F(VirtualTableTests, test_generate_deadline) {
+  auto table = std::make_shared<deadlineTablePlugin>();
+  auto table_registry = RegistryFactory::get().registry("table");
+  table_registry->add("deadline", table);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("deadline", table->columnDefinition(), dbc);
+
+  // Without a budget the table is generated completely.
+  QueryData results;
+  auto status =
+      queryInternal("SELECT count(*) AS c from deadline", results, dbc);
+  dbc->clearAffectedTables();
+  EXPECT_TRUE(status.ok());
+  ASSERT_EQ(results.size(), 1U);
+  EXPECT_EQ(results[0]["c"], "1000");
+
+  // The generator stops at the query deadline.
+  QueryBudget budget;
+  budget.timeout = 20;
+  results.clear();
+  status = queryInternal("SELECT * from deadline", results, dbc, budget);
+  dbc->clearAffectedTables();
+  EXPECT_EQ(status.getCode(), kQueryBudgetExceeded);
+  EXPECT_LT(results.size(), 1000U);
+
+  // The deadline does not leak into later queries.
+  EXPECT_EQ(getQueryDeadline(), std::chrono::steady_clock::time_point::max());
+}
+
+TEST_F(VirtualTableTests, test_query_profile) {
+  auto tables = RegistryFactory::get().registry("table");
+  auto table = std::make_shared<snapshotTablePlugin>();
+  tables->add("table_profile", table);
+  auto generator = std::make_shared<yieldTablePlugin>();
+  tables->add("yield_profile", generator);
+
+  auto dbc = SQLiteDBManager::getUnique();
+  attachTableInternal("table_profile", table->columnDefinition(), dbc);
+  attachTableInternal("yield_profile", generator->columnDefinition(), dbc);
+
+  auto& profiler = QueryProfiler::get();
+  profiler.clear();
+
+  // Without the flag nothing is recorded.
+  QueryData results;
+  {
+    QueryProfiler::Scope scope("profile", "");
+    EXPECT_EQ(scope.profile(), nullptr);
+    EXPECT_EQ(QueryProfiler::current(), nullptr);
+    queryInternal("SELECT * from table_profile", results, dbc);
+  }
+  EXPECT_TRUE(profiler.profiles().empty());
+
+  auto query_profile = FLAGS_query_profile;
+  FLAGS_query_profile = true;
+  {
+    QueryProfiler::Scope scope("profile", "SELECT 1");
+    ASSERT_NE(scope.profile(), nullptr);
+    EXPECT_EQ(QueryProfiler::current(), scope.profile());
+
+    // A nested scope adds to the outer profile.
+    QueryProfiler::Scope nested("nested", "");
+    EXPECT_EQ(nested.profile(), nullptr);
+
+    results.clear();
+    queryInternal("SELECT * from table_profile", results, dbc);
+    queryInternal("SELECT * from yield_profile", results, dbc);
+    EXPECT_EQ(results.size(), 12U);
+  }
+  FLAGS_query_profile = query_profile;
+
+  QueryProfile profile;
+  ASSERT_TRUE(profiler.getProfile("profile", profile));
+  EXPECT_FALSE(profiler.getProfile("nested", profile));
+  EXPECT_EQ(profile.query, "SELECT 1");
+  EXPECT_GT(profile.time, 0U);
+  EXPECT_GT(profile.wall_time_ns, 0U);
+  ASSERT_EQ(profile.tables.count("table_profile"), 1U);
+  ASSERT_EQ(profile.tables.count("yield_profile"), 1U);
+
+  // Rows are counted as generated, and as yielded by generators.
+  EXPECT_EQ(profile.tables["table_profile"].scans, 1U);
+  EXPECT_EQ(profile.tables["table_profile"].rows, 2U);
+  EXPECT_EQ(profile.tables["yield_profile"].scans, 1U);
+  EXPECT_EQ(profile.tables["yield_profile"].rows, 10U);
+  EXPECT_GT(profile.tables["yield_profile"].generate_time_ns, 0U);
+
+  // Profiles are attached to distributed results as JSON.
+  auto doc = JSON::newObject();
+  auto obj = doc.getObject();
+  EXPECT_TRUE(serializeQueryProfile(profile, doc, obj).ok());
+  EXPECT_TRUE(obj.HasMember("tables"));
+  EXPECT_TRUE(obj["tables"].HasMember("table_profile"));
+  profiler.clear();
+}
+
 class likeTablePlugin : public TablePlugin {
  private:
   TableColumns columns() const override {
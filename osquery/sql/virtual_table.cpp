@@ -16,6 +16,8 @@
 #include <osquery/system.h>
 
 #include "osquery/core/process.h"
+#include "osquery/sql/query_profile.h"
+#include "osquery/sql/table_snapshot.h"
 #include "osquery/sql/virtual_table.h"
 
 namespace osquery {
@@ -27,6 +29,11 @@ FLAG(uint64,
      0,
      "Add an optional microsecond delay between table scans");
 
+FLAG(bool,
+     table_lazy_attach,
+     true,
+     "Create internal table schemas when a query first uses them");
+
 SHELL_FLAG(bool, planner, false, "Enable osquery runtime planner output");
 
 DECLARE_bool(disable_events);
@@ -134,9 +141,16 @@ int xDestroy(sqlite3_vtab* p) {
 int xNext(sqlite3_vtab_cursor* cur) {
   BaseCursor* pCur = (BaseCursor*)cur;
   if (pCur->uses_generator) {
+    // Generators produce rows as they are read.
+    QueryProfiler::Timer timer((pCur->profile != nullptr)
+                                   ? &pCur->profile->generate_time_ns
+                                   : nullptr);
     pCur->generator->operator()();
     if (*pCur->generator) {
       pCur->current = pCur->generator->get();
+      if (pCur->profile != nullptr) {
+        pCur->profile->rows++;
+      }
     }
   }
   pCur->row++;
@@ -192,7 +206,11 @@ int xCreate(sqlite3* db,
   }
 
   // Tables may request aliases as views.
+  // Eponymous tables are connected while a query is prepared, their views
+  // were created when the module was attached.
   std::set<std::string> views;
+  bool eponymous = (argc > 1 && argv[1] != nullptr &&
+                    std::string(argv[1]) == "main");
 
   // Keep a local copy of the column details in the VirtualTableContent struct.
   // This allows introspection into the column type without additional calls.
@@ -210,7 +228,8 @@ int xCreate(sqlite3* db,
           column.at("name"),
           columnTypeName(column.at("type")),
           (ColumnOptions)AS_LITERAL(INTEGER_LITERAL, column.at("op"))));
-    } else if (column.at("id") == "alias" && column.count("alias")) {
+    } else if (column.at("id") == "alias" && column.count("alias") &&
+               !eponymous) {
       // Create associated views for table aliases.
       views.insert(column.at("alias"));
     } else if (column.at("id") == "columnAlias" && column.count("name") &&
@@ -253,7 +272,8 @@ int xColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col) {
     // Requested column index greater than column set size.
     return SQLITE_ERROR;
   }
-  if (!pCur->uses_generator && pCur->row >= pCur->data.size()) {
+  const auto& rows = (pCur->snapshot != nullptr) ? *pCur->snapshot : pCur->data;
+  if (!pCur->uses_generator && pCur->row >= rows.size()) {
     // Request row index greater than row set size.
     return SQLITE_ERROR;
   }
@@ -268,20 +288,22 @@ int xColumn(sqlite3_vtab_cursor* cur, sqlite3_context* ctx, int col) {
         pVtab->content->columns[pVtab->content->aliases.at(column_name)]);
   }
 
-  Row* row = nullptr;
+  const Row* row = nullptr;
   if (pCur->uses_generator) {
     row = &pCur->current;
   } else {
-    row = &pCur->data[pCur->row];
+    row = &rows[pCur->row];
   }
 
+  // Rows may be shared between cursors and are not modified, a missing
+  // column is read as an empty value.
+  static const std::string kMissingColumn;
+  auto column = row->find(column_name);
+  const auto& value =
+      (column == row->end()) ? kMissingColumn : column->second;
+
   // Attempt to cast each xFilter-populated row/column to the SQLite type.
-  const auto& value = (*row)[column_name];
-  if (row->count(column_name) == 0) {
-    // Missing content.
-    VLOG(1) << "Error " << column_name << " is empty";
-    sqlite3_result_null(ctx);
-  } else if (type == TEXT_TYPE) {
+  if (type == TEXT_TYPE) {
     sqlite3_result_text(
         ctx, value.c_str(), static_cast<int>(value.size()), SQLITE_STATIC);
   } else if (type == INTEGER_TYPE) {
@@ -427,6 +449,9 @@ static int xBestIndex(sqlite3_vtab* tab, sqlite3_index_info* pIdxInfo) {
 #endif
   // Add the constraint set to the table's tracked constraints.
   pVtab->content->constraints[pIdxInfo->idxNum] = std::move(constraints);
+  // Remember the columns this plan reads, tables may skip the others.
+  pVtab->content->colsUsed[pIdxInfo->idxNum] =
+      static_cast<uint64_t>(pIdxInfo->colUsed);
   pIdxInfo->estimatedCost = cost;
   return SQLITE_OK;
 }
@@ -451,6 +476,7 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
 
   // The SQLite instance communicates to the TablePlugin via the context.
   context.useCache(pVtab->instance->useCache());
+  context.setDeadline(getQueryDeadline());
 
   // Track required columns, this is different than the requirements check
   // that occurs within BestIndex because this scan includes a cursor.
@@ -550,15 +576,69 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
                  << table_doc(pVtab->content->name);
   }
 
+  // SQLite reports the columns used by the plan, the highest bit represents
+  // every column beyond the bitmask.
+  auto used = content->colsUsed.find(static_cast<size_t>(idxNum));
+  if (used != content->colsUsed.end() && (used->second & (1ULL << 63)) == 0) {
+    UsedColumns columns;
+    for (size_t i = 0; i < content->columns.size() && i < 63; ++i) {
+      if ((used->second & (1ULL << i)) == 0) {
+        continue;
+      }
+      const auto& column_name = std::get<0>(content->columns[i]);
+      columns.insert(column_name);
+      // A column alias reads the column it targets.
+      auto alias = content->aliases.find(column_name);
+      if (alias != content->aliases.end()) {
+        columns.insert(std::get<0>(content->columns[alias->second]));
+      }
+    }
+    context.colsUsed = std::move(columns);
+  }
+
   // Reset the virtual table contents.
   pCur->data.clear();
+  pCur->snapshot = nullptr;
+  pCur->uses_generator = false;
+  pCur->generator = nullptr;
   options.clear();
 
   // Generate the row data set.
   plan("Scanning rows for cursor (" + std::to_string(pCur->id) + ")");
+  pCur->profile = QueryProfiler::getTable(content->name);
+  QueryProfiler::Timer timer(
+      (pCur->profile != nullptr) ? &pCur->profile->generate_time_ns : nullptr);
+  if (pCur->profile != nullptr) {
+    pCur->profile->scans++;
+  }
+
   if (Registry::get().exists("table", pVtab->content->name, true)) {
     auto plugin = Registry::get().plugin("table", pVtab->content->name);
     auto table = std::dynamic_pointer_cast<TablePlugin>(plugin);
+
+    // Scheduled queries share recent results of the same table scan.
+    // The rows of a generator are collected into the snapshot.
+    auto& snapshots = TableSnapshotCache::get();
+    if (context.useCache() && snapshots.allowed(*content)) {
+      // A snapshot is shared by queries using other columns.
+      context.colsUsed = boost::none;
+      auto key = TableSnapshotCache::getKey(content->name, context);
+      pCur->snapshot = snapshots.find(content->name, key);
+      if (pCur->snapshot == nullptr) {
+        pCur->snapshot =
+            std::make_shared<const QueryData>(table->generate(context));
+        // Rows cut short by the query deadline are not shared.
+        if (!context.expired()) {
+          snapshots.insert(content->name, key, pCur->snapshot);
+        }
+      }
+      pCur->n = pCur->snapshot->size();
+      if (pCur->profile != nullptr) {
+        pCur->profile->rows += pCur->n;
+      }
+      return SQLITE_OK;
+    }
+
     if (table->usesGenerator()) {
       pCur->uses_generator = true;
       pCur->generator = std::make_unique<RowGenerator::pull_type>(
@@ -568,6 +648,9 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
                     std::move(context)));
       if (*pCur->generator) {
         pCur->current = pCur->generator->get();
+        if (pCur->profile != nullptr) {
+          pCur->profile->rows++;
+        }
       }
       return SQLITE_OK;
     }
@@ -580,11 +663,77 @@ static int xFilter(sqlite3_vtab_cursor* pVtabCursor,
 
   // Set the number of rows.
   pCur->n = pCur->data.size();
+  if (pCur->profile != nullptr) {
+    pCur->profile->rows += pCur->n;
+  }
   return SQLITE_OK;
 }
 }
 }
 
+namespace {
+
+// A static module structure does not need specific logic per-table.
+// The module's xConnect is its xCreate, which makes each table eponymous.
+// clang-format off
+sqlite3_module module = {
+    0,
+    tables::sqlite::xCreate,
+    tables::sqlite::xCreate,
+    tables::sqlite::xBestIndex,
+    tables::sqlite::xDestroy,
+    tables::sqlite::xDestroy,
+    tables::sqlite::xOpen,
+    tables::sqlite::xClose,
+    tables::sqlite::xFilter,
+    tables::sqlite::xNext,
+    tables::sqlite::xEof,
+    tables::sqlite::xColumn,
+    tables::sqlite::xRowid,
+    nullptr, /* Update */
+    nullptr, /* Begin */
+    nullptr, /* Sync */
+    nullptr, /* Commit */
+    nullptr, /* Rollback */
+    nullptr, /* FindFunction */
+    nullptr, /* Rename */
+    nullptr, /* Savepoint */
+    nullptr, /* Release */
+    nullptr, /* RollbackTo */
+};
+// clang-format on
+
+/**
+ * @brief Attach a table that is created when a query first uses it.
+ *
+ * The module is registered without a CREATE VIRTUAL TABLE statement, SQLite
+ * connects the eponymous table while preparing the first query that uses the
+ * table name. Aliases are views of the table name and are created up front.
+ */
+Status attachTableLazy(const std::string& name,
+                       const std::vector<std::string>& aliases,
+                       const SQLiteDBInstanceRef& instance) {
+  if (SQLiteDBManager::isDisabled(name)) {
+    VLOG(1) << "Table " << name << " is disabled, not attaching";
+    return Status(0, getStringForSQLiteReturnCode(0));
+  }
+
+  auto lock(instance->attachLock());
+  int rc = sqlite3_create_module(
+      instance->db(), name.c_str(), &module, (void*)&(*instance));
+  if (rc != SQLITE_OK && rc != SQLITE_MISUSE) {
+    LOG(ERROR) << "Error attaching table: " << name << " (" << rc << ")";
+    return Status(rc, getStringForSQLiteReturnCode(rc));
+  }
+
+  for (const auto& alias : aliases) {
+    auto statement = "CREATE VIEW " + alias + " AS SELECT * FROM " + name;
+    sqlite3_exec(instance->db(), statement.c_str(), nullptr, nullptr, nullptr);
+  }
+  return Status(0, getStringForSQLiteReturnCode(0));
+}
+} // namespace
+
 Status attachTableInternal(const std::string& name,
                            const std::string& statement,
                            const SQLiteDBInstanceRef& instance) {
@@ -593,35 +742,6 @@ Status attachTableInternal(const std::string& name,
     return Status(0, getStringForSQLiteReturnCode(0));
   }
 
-  // A static module structure does not need specific logic per-table.
-  // clang-format off
-  static sqlite3_module module = {
-      0,
-      tables::sqlite::xCreate,
-      tables::sqlite::xCreate,
-      tables::sqlite::xBestIndex,
-      tables::sqlite::xDestroy,
-      tables::sqlite::xDestroy,
-      tables::sqlite::xOpen,
-      tables::sqlite::xClose,
-      tables::sqlite::xFilter,
-      tables::sqlite::xNext,
-      tables::sqlite::xEof,
-      tables::sqlite::xColumn,
-      tables::sqlite::xRowid,
-      nullptr, /* Update */
-      nullptr, /* Begin */
-      nullptr, /* Sync */
-      nullptr, /* Commit */
-      nullptr, /* Rollback */
-      nullptr, /* FindFunction */
-      nullptr, /* Rename */
-      nullptr, /* Savepoint */
-      nullptr, /* Release */
-      nullptr, /* RollbackTo */
-  };
-  // clang-format on
-
   // Note, if the clientData API is used then this will save a registry call
   // within xCreate.
   auto lock(instance->attachLock());
@@ -678,8 +798,20 @@ void attachVirtualTables(const SQLiteDBInstanceRef& instance) {
 #endif
   }
 
+  auto& rf = RegistryFactory::get();
   PluginResponse response;
-  for (const auto& name : RegistryFactory::get().names("table")) {
+  for (const auto& name : rf.names("table")) {
+    if (FLAGS_table_lazy_attach) {
+      // Internal tables do not need their columns until a query uses them.
+      // Extension tables are routed and are attached with their columns.
+      auto plugin =
+          std::dynamic_pointer_cast<TablePlugin>(rf.plugin("table", name));
+      if (plugin != nullptr) {
+        attachTableLazy(name, plugin->aliases(), instance);
+        continue;
+      }
+    }
+
     // Column information is nice for virtual table create call.
     auto status =
         Registry::call("table", name, {{"action", "columns"}}, response);
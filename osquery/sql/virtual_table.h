@@ -45,6 +45,9 @@ struct BaseCursor : private boost::noncopyable {
   /// Table data generated from last access.
   QueryData data;
 
+  /// Table data shared with other cursors, used instead of data when set.
+  std::shared_ptr<const QueryData> snapshot{nullptr};
+
   /// Callable generator.
   std::unique_ptr<RowGenerator::pull_type> generator{nullptr};
 
@@ -59,6 +62,9 @@ struct BaseCursor : private boost::noncopyable {
 
   /// Total number of rows.
   size_t n{0};
+
+  /// Counters of the table within the query profile, if the query is profiled.
+  TableProfile* profile{nullptr};
 };
 
 /**
@@ -11,25 +11,19 @@
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
-#include <regex>
 
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/algorithm/string/split.hpp>
 
-#include <boost/asio.hpp>
 #include <boost/foreach.hpp>
 
-#if !defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
-#error Boost error: Local sockets not available
-#endif
-
 #include <osquery/flags.h>
 #include <osquery/logger.h>
 #include <osquery/tables.h>
 
 #include "osquery/core/conversions.h"
-#include "osquery/core/json.h"
+#include "osquery/tables/applications/posix/docker_api.h"
 
 // When building on linux, the extended schema of docker_containers will
 // add some additional columns to support user namespaces
@@ -38,80 +32,20 @@
 #endif
 
 namespace pt = boost::property_tree;
-namespace local = boost::asio::local;
 
 namespace osquery {
-
-/**
- * @brief Docker UNIX domain socket path.
- *
- * By default docker creates UNIX domain socket at /var/run/docker.sock. If
- * docker domain is configured to use a different path specify that path.
- */
-FLAG(string,
-     docker_socket,
-     "/var/run/docker.sock",
-     "Docker UNIX domain socket path");
-
 namespace tables {
 
 /**
  * @brief Makes API calls to the docker UNIX socket.
  *
  * @param uri Relative URI to invoke GET HTTP method.
- * @param tree Property tree where JSON result is stored.
+ * @param tree Shared property tree where JSON result is stored.
  * @return Status with 0 code on success. Non-negative status with error
  *         message.
  */
-Status dockerApi(const std::string& uri, pt::ptree& tree) {
-  static const std::regex httpOkRegex("HTTP/1\\.(0|1) 200 OK\\\r");
-
-  try {
-    local::stream_protocol::endpoint ep(FLAGS_docker_socket);
-    local::stream_protocol::iostream stream(ep);
-    if (!stream) {
-      return Status(
-          1, "Error connecting to docker sock: " + stream.error().message());
-    }
-
-    // Since keep-alive connections are not used, use HTTP/1.0
-    stream << "GET " << uri
-           << " HTTP/1.0\r\nAccept: */*\r\nConnection: close\r\n\r\n"
-           << std::flush;
-    if (stream.eof()) {
-      stream.close();
-      return Status(1, "Empty docker API response for: " + uri);
-    }
-
-    // All status responses are expected to be 200
-    std::string str;
-    getline(stream, str);
-
-    std::smatch match;
-    if (!std::regex_match(str, match, httpOkRegex)) {
-      stream.close();
-      return Status(1, "Invalid docker API response for " + uri + ": " + str);
-    }
-
-    // Skip empty line between header and body
-    while (!stream.eof() && str != "\r") {
-      getline(stream, str);
-    }
-
-    try {
-      pt::read_json(stream, tree);
-    } catch (const pt::ptree_error& e) {
-      stream.close();
-      return Status(
-          1, "Error reading docker API response for " + uri + ": " + e.what());
-    }
-
-    stream.close();
-  } catch (const std::exception& e) {
-    return Status(1, std::string("Error calling docker API: ") + e.what());
-  }
-
-  return Status(0);
+Status dockerApi(const std::string& uri, DockerTree& tree) {
+  return DockerClient::get().request(uri, tree);
 }
 
 /**
@@ -119,13 +53,15 @@ Status dockerApi(const std::string& uri, pt::ptree& tree) {
  */
 QueryData genVersion(QueryContext& context) {
   QueryData results;
-  pt::ptree tree;
-  Status s = dockerApi("/version", tree);
+  DockerTree response;
+  Status s = dockerApi("/version", response);
   if (!s.ok()) {
     VLOG(1) << "Error getting docker version: " << s.what();
     return results;
   }
 
+  const pt::ptree& tree = *response;
+
   Row r;
   r["version"] = tree.get<std::string>("Version", "");
   r["api_version"] = tree.get<std::string>("ApiVersion", "");
@@ -146,13 +82,15 @@ QueryData genVersion(QueryContext& context) {
  */
 QueryData genInfo(QueryContext& context) {
   QueryData results;
-  pt::ptree tree;
-  Status s = dockerApi("/info", tree);
+  DockerTree response;
+  Status s = dockerApi("/info", response);
   if (!s.ok()) {
     VLOG(1) << "Error getting docker info: " << s.what();
     return results;
   }
 
+  const pt::ptree& tree = *response;
+
   Row r;
   r["id"] = tree.get<std::string>("ID", "");
   r["containers"] = INTEGER(tree.get<int>("Containers", 0));
@@ -322,14 +260,16 @@ QueryData getLabels(QueryContext& context,
   getQuery(context, column, query, items, add_all);
 
   QueryData results;
-  pt::ptree tree;
+  DockerTree response;
   const std::string& url_qs = filter ? (url + query) : url;
-  Status s = dockerApi(url_qs, tree);
+  Status s = dockerApi(url_qs, response);
   if (!s.ok()) {
     VLOG(1) << "Error getting docker " << type << ": " << s.what();
     return results;
   }
 
+  const pt::ptree& tree = *response;
+
   try {
     const pt::ptree& array = path.empty() ? tree : tree.get_child(path);
     for (const auto& entry : array) {
@@ -357,7 +297,7 @@ QueryData getLabels(QueryContext& context,
  */
 Status getContainers(QueryContext& context,
                      std::set<std::string>& ids,
-                     pt::ptree& containers) {
+                     DockerTree& containers) {
   std::string query;
   getQuery(context, "id", query, ids, true);
 
@@ -369,19 +309,56 @@ Status getContainers(QueryContext& context,
   return Status(0);
 }
 
+/**
+ * @brief Utility method to add the inspect details of a container to its row.
+ */
+void getContainerDetails(const pt::ptree& container_details, Row& r) {
+  r["pid"] = BIGINT(container_details.get_child("State").get<pid_t>("Pid", -1));
+  r["started_at"] =
+      container_details.get_child("State").get<std::string>("StartedAt", "");
+  r["finished_at"] =
+      container_details.get_child("State").get<std::string>("FinishedAt", "");
+  r["privileged"] =
+      container_details.get_child("HostConfig").get<bool>("Privileged", false)
+          ? INTEGER(1)
+          : INTEGER(0);
+  r["path"] = container_details.get<std::string>("Path", "");
+
+  std::vector<std::string> entry_pts;
+  for (const auto& ent_pt : container_details.get_child("Config.Entrypoint")) {
+    entry_pts.push_back(ent_pt.second.data());
+  }
+  r["config_entrypoint"] = osquery::join(entry_pts, ", ");
+
+  std::vector<std::string> sec_opts;
+  for (const auto& sec_opt :
+       container_details.get_child("HostConfig.SecurityOpt")) {
+    sec_opts.push_back(sec_opt.second.data());
+  }
+  r["security_options"] = osquery::join(sec_opts, ", ");
+
+  std::vector<std::string> env_vars;
+  for (const auto& env_var : container_details.get_child("Config.Env")) {
+    env_vars.push_back(env_var.second.data());
+  }
+  r["env_variables"] = osquery::join(env_vars, ", ");
+}
+
 /**
  * @brief Entry point for docker_containers table.
  */
 QueryData genContainers(QueryContext& context) {
   QueryData results;
   std::set<std::string> ids;
-  pt::ptree containers;
+  DockerTree containers;
   auto s = getContainers(context, ids, containers);
   if (!s.ok()) {
     return results;
   }
 
-  for (const auto& entry : containers) {
+  // Containers are inspected concurrently, once every row is listed.
+  std::vector<std::string> uris;
+  for (const auto& entry : *containers) {
     const pt::ptree& container = entry.second;
     Row r;
     r["id"] = getValue(container, ids, "Id");
@@ -401,43 +378,16 @@ QueryData genContainers(QueryContext& context) {
     r["created"] = BIGINT(container.get<uint64_t>("Created", 0));
     r["state"] = container.get<std::string>("State", "");
     r["status"] = container.get<std::string>("Status", "");
+    uris.push_back("/containers/" + r["id"] + "/json?stream=false");
+    results.push_back(std::move(r));
+  }
 
-    pt::ptree container_details;
-    s = dockerApi("/containers/" + r["id"] + "/json?stream=false",
-                  container_details);
-    if (s.ok()) {
-      r["pid"] =
-          BIGINT(container_details.get_child("State").get<pid_t>("Pid", -1));
-      r["started_at"] = container_details.get_child("State").get<std::string>(
-          "StartedAt", "");
-      r["finished_at"] = container_details.get_child("State").get<std::string>(
-          "FinishedAt", "");
-      r["privileged"] = container_details.get_child("HostConfig")
-                                .get<bool>("Privileged", false)
-                            ? INTEGER(1)
-                            : INTEGER(0);
-      r["path"] = container_details.get<std::string>("Path", "");
-
-      std::vector<std::string> entry_pts;
-      for (const auto& ent_pt :
-           container_details.get_child("Config.Entrypoint")) {
-        entry_pts.push_back(ent_pt.second.data());
-      }
-      r["config_entrypoint"] = osquery::join(entry_pts, ", ");
-
-      std::vector<std::string> sec_opts;
-      for (const auto& sec_opt :
-           container_details.get_child("HostConfig.SecurityOpt")) {
-        sec_opts.push_back(sec_opt.second.data());
-      }
-      r["security_options"] = osquery::join(sec_opts, ", ");
-
-      std::vector<std::string> env_vars;
-      for (const auto& env_var : container_details.get_child("Config.Env")) {
-        env_vars.push_back(env_var.second.data());
-      }
-      r["env_variables"] = osquery::join(env_vars, ", ");
-
+  std::vector<DockerTree> details;
+  auto statuses = DockerClient::get().requestAll(uris, details);
+  for (size_t i = 0; i < results.size(); ++i) {
+    auto& r = results[i];
+    if (statuses[i].ok()) {
+      getContainerDetails(*details[i], r);
     } else {
       VLOG(1) << "Failed to retrieve the inspect data for container "
               << r["id"];
@@ -459,8 +409,6 @@ QueryData genContainers(QueryContext& context) {
       }
     }
 #endif
-
-    results.push_back(r);
   }
 
   return results;
@@ -486,13 +434,13 @@ QueryData genContainerLabels(QueryContext& context) {
 QueryData genContainerMounts(QueryContext& context) {
   QueryData results;
   std::set<std::string> ids;
-  pt::ptree containers;
+  DockerTree containers;
   Status s = getContainers(context, ids, containers);
   if (!s.ok()) {
     return results;
   }
 
-  for (const auto& entry : containers) {
+  for (const auto& entry : *containers) {
     const pt::ptree& container = entry.second;
     try {
       for (const auto& node : container.get_child("Mounts")) {
@@ -523,13 +471,13 @@ QueryData genContainerMounts(QueryContext& context) {
 QueryData genContainerNetworks(QueryContext& context) {
   QueryData results;
   std::set<std::string> ids;
-  pt::ptree containers;
+  DockerTree containers;
   Status s = getContainers(context, ids, containers);
   if (!s.ok()) {
     return results;
   }
 
-  for (const auto& entry : containers) {
+  for (const auto& entry : *containers) {
     const pt::ptree& container = entry.second;
     try {
       for (const auto& node : container.get_child("NetworkSettings.Networks")) {
@@ -563,13 +511,13 @@ QueryData genContainerNetworks(QueryContext& context) {
 QueryData genContainerPorts(QueryContext& context) {
   QueryData results;
   std::set<std::string> ids;
-  pt::ptree containers;
+  DockerTree containers;
   Status s = getContainers(context, ids, containers);
   if (!s.ok()) {
     return results;
   }
 
-  for (const auto& entry : containers) {
+  for (const auto& entry : *containers) {
     const pt::ptree& container = entry.second;
     try {
       for (const auto& node : container.get_child("Ports")) {
@@ -597,37 +545,43 @@ QueryData genContainerProcesses(QueryContext& context) {
   QueryData results;
   std::string ps_args;
 
-  for (const auto& id : context.constraints["id"].getAll(EQUALS)) {
-    if (!checkConstraintValue(id)) {
-      continue;
-    }
+  if (isPlatform(PlatformType::TYPE_OSX)) {
+    // osx: 19 fields
+    // currently OS X Docker API will only return
+    // "PID","USER","TIME","COMMAND" fields
+    ps_args =
+        "pid,state,uid,gid,svuid,svgid,rss,vsz,etime,ppid,pgid,wq,nice,user,"
+        "time,pcpu,pmem,comm,command";
+  } else if (isPlatform(PlatformType::TYPE_LINUX)) {
+    // linux: 21 fields
+    ps_args =
+        "pid,state,uid,gid,euid,egid,suid,sgid,rss,vsz,etime,ppid,pgrp,nlwp,"
+        "nice,user,time,pcpu,pmem,comm,cmd";
+  } else {
+    return results;
+  }
 
-    pt::ptree container;
-
-    if (isPlatform(PlatformType::TYPE_OSX)) {
-      // osx: 19 fields
-      // currently OS X Docker API will only return
-      // "PID","USER","TIME","COMMAND" fields
-      ps_args =
-          "pid,state,uid,gid,svuid,svgid,rss,vsz,etime,ppid,pgid,wq,nice,user,"
-          "time,pcpu,pmem,comm,command";
-    } else if (isPlatform(PlatformType::TYPE_LINUX)) {
-      // linux: 21 fields
-      ps_args =
-          "pid,state,uid,gid,euid,egid,suid,sgid,rss,vsz,etime,ppid,pgrp,nlwp,"
-          "nice,user,time,pcpu,pmem,comm,cmd";
-    } else {
-      continue;
+  // The processes of each container are requested concurrently.
+  std::vector<std::string> ids;
+  std::vector<std::string> uris;
+  for (const auto& id : context.constraints["id"].getAll(EQUALS)) {
+    if (checkConstraintValue(id)) {
+      ids.push_back(id);
+      uris.push_back("/containers/" + id + "/top?ps_args=axwwo%20" + ps_args);
     }
+  }
 
-    auto s = dockerApi("/containers/" + id + "/top?ps_args=axwwo%20" + ps_args,
-                       container);
-
+  std::vector<DockerTree> containers;
+  auto statuses = DockerClient::get().requestAll(uris, containers);
+  for (size_t i = 0; i < ids.size(); ++i) {
+    const auto& id = ids[i];
+    const auto& s = statuses[i];
     if (!s.ok()) {
       VLOG(1) << "Error getting docker container " << id << ": " << s.what();
       continue;
     }
 
+    const pt::ptree& container = *containers[i];
     try {
       for (const auto& processes : container.get_child("Processes")) {
         std::vector<std::string> vector;
@@ -779,24 +733,34 @@ std::string getNetworkBytes(const pt::ptree& tree, const std::string& key) {
  */
 QueryData genContainerStats(QueryContext& context) {
   QueryData results;
+
+  // The engine samples the stats of a container for a second before it
+  // responds, the stats of each container are requested concurrently.
+  std::vector<std::string> ids;
+  std::vector<std::string> uris;
   for (const auto& id : context.constraints["id"].getAll(EQUALS)) {
-    if (!checkConstraintValue(id)) {
-      continue;
+    if (checkConstraintValue(id)) {
+      ids.push_back(id);
+      uris.push_back("/containers/" + id + "/stats?stream=false");
     }
+  }
 
-    pt::ptree container;
-    Status s =
-        dockerApi("/containers/" + id + "/stats?stream=false", container);
+  std::vector<DockerTree> containers;
+  auto statuses = DockerClient::get().requestAll(uris, containers);
+  for (size_t i = 0; i < ids.size(); ++i) {
+    const auto& id = ids[i];
+    const auto& s = statuses[i];
     if (!s.ok()) {
       VLOG(1) << "Error getting docker container " << id << ": " << s.what();
       continue;
     }
 
+    const pt::ptree& container = *containers[i];
     try {
       Row r;
       r["id"] = id;
       r["name"] = container.get<std::string>("name", "");
-      r["pids"] = container.get<int>("pids_stats.current", 0);
+      r["pids"] = INTEGER(container.get<int>("pids_stats.current", 0));
       const std::string& read = container.get<std::string>("read", "");
       long read_unix_time = getUnixTime(read, false);
       r["read"] = BIGINT(read_unix_time);
@@ -862,13 +826,15 @@ QueryData genNetworks(QueryContext& context) {
   getQuery(context, "id", query, ids, false);
 
   QueryData results;
-  pt::ptree tree;
-  Status s = dockerApi("/networks" + query, tree);
+  DockerTree response;
+  Status s = dockerApi("/networks" + query, response);
   if (!s.ok()) {
     VLOG(1) << "Error getting docker networks: " << s.what();
     return results;
   }
 
+  const pt::ptree& tree = *response;
+
   for (const auto& entry : tree) {
     try {
       const pt::ptree& node = entry.second;
@@ -918,13 +884,15 @@ QueryData genVolumes(QueryContext& context) {
   getQuery(context, "name", query, names, false);
 
   QueryData results;
-  pt::ptree tree;
-  Status s = dockerApi("/volumes" + query, tree);
+  DockerTree response;
+  Status s = dockerApi("/volumes" + query, response);
   if (!s.ok()) {
     VLOG(1) << "Error getting docker volumes: " << s.what();
     return results;
   }
 
+  const pt::ptree& tree = *response;
+
   for (const auto& entry : tree.get_child("Volumes")) {
     try {
       const pt::ptree& node = entry.second;
@@ -961,13 +929,15 @@ QueryData genVolumeLabels(QueryContext& context) {
  */
 QueryData genImages(QueryContext& context) {
   QueryData results;
-  pt::ptree tree;
-  Status s = dockerApi("/images/json", tree);
+  DockerTree response;
+  Status s = dockerApi("/images/json", response);
   if (!s.ok()) {
     VLOG(1) << "Error getting docker images: " << s.what();
     return results;
   }
 
+  const pt::ptree& tree = *response;
+
   for (const auto& entry : tree) {
     try {
       const pt::ptree& node = entry.second;
@@ -0,0 +1,443 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/asio.hpp>
+
+#if !defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+#error Boost error: Local sockets not available
+#endif
+
+#include <osquery/flags.h>
+
+#include "osquery/core/json.h"
+#include "osquery/core/metrics.h"
+#include "osquery/core/process.h"
+#include "osquery/tables/applications/posix/docker_api.h"
+
+namespace asio = boost::asio;
+namespace pt = boost::property_tree;
+namespace rj = rapidjson;
+
+namespace osquery {
+
+/**
+ * @brief Docker UNIX domain socket path.
+ *
+ * By default docker creates UNIX domain socket at /var/run/docker.sock. If
+ * docker domain is configured to use a different path specify that path.
+ */
+FLAG(string,
+     docker_socket,
+     "/var/run/docker.sock",
+     "Docker UNIX domain socket path");
+
+FLAG(uint64,
+     docker_workers,
+     8,
+     "Concurrent requests to the docker API, and idle connections kept");
+
+FLAG(uint64,
+     docker_cache_ttl,
+     1000,
+     "Milliseconds docker API responses are shared between tables");
+
+namespace tables {
+
+/// The engine closed an idle connection before responding.
+const int kDockerClosedCode{2};
+
+/// Count a docker API request by how it was served.
+static void countRequest(const std::string& result) {
+  static MetricCounterFamily counters(
+      "osquery_docker_requests_total",
+      "Requests to the docker API",
+      "result",
+      {"cached", "reused", "connected", "failed"});
+  counters.get(result).increment();
+}
+
+namespace {
+
+/// Build a property tree from the events of a rapidjson reader.
+class DockerTreeHandler
+    : public rj::BaseReaderHandler<rj::UTF8<>, DockerTreeHandler> {
+ public:
+  explicit DockerTreeHandler(pt::ptree& root) : root_(root) {}
+
+  bool Null() {
+    return value("null");
+  }
+
+  bool Bool(bool b) {
+    return value(b ? "true" : "false");
+  }
+
+  bool RawNumber(const char* str, rj::SizeType length, bool /* copy */) {
+    return value(std::string(str, length));
+  }
+
+  bool String(const char* str, rj::SizeType length, bool /* copy */) {
+    return value(std::string(str, length));
+  }
+
+  bool Key(const char* str, rj::SizeType length, bool /* copy */) {
+    key_.assign(str, length);
+    return true;
+  }
+
+  bool StartObject() {
+    return start();
+  }
+
+  bool EndObject(rj::SizeType /* count */) {
+    stack_.pop_back();
+    return true;
+  }
+
+  bool StartArray() {
+    return start();
+  }
+
+  bool EndArray(rj::SizeType /* count */) {
+    stack_.pop_back();
+    return true;
+  }
+
+ private:
+  /// Add an object or array, members of an array have an empty key.
+  bool start() {
+    if (stack_.empty()) {
+      stack_.push_back(&root_);
+      return true;
+    }
+
+    auto child = stack_.back()->push_back(std::make_pair(key_, pt::ptree()));
+    key_.clear();
+    stack_.push_back(&child->second);
+    return true;
+  }
+
+  bool value(std::string data) {
+    if (stack_.empty()) {
+      root_.data() = std::move(data);
+      return true;
+    }
+
+    stack_.back()->push_back(std::make_pair(key_, pt::ptree(std::move(data))));
+    key_.clear();
+    return true;
+  }
+
+ private:
+  pt::ptree& root_;
+
+  /// The objects and arrays being read, children are stable in a ptree.
+  std::vector<pt::ptree*> stack_;
+
+  /// The key of the next member of an object.
+  std::string key_;
+};
+} // namespace
+
+Status parseDockerJSON(const std::string& json, pt::ptree& tree) {
+  tree.clear();
+  DockerTreeHandler handler(tree);
+  rj::Reader reader;
+  rj::StringStream stream(json.c_str());
+  auto result = reader.Parse<rj::kParseNumbersAsStringsFlag>(stream, handler);
+  if (result.IsError()) {
+    return Status(1,
+                  std::string(rj::GetParseError_En(result.Code())) +
+                      " at offset " + std::to_string(result.Offset()));
+  }
+  return Status(0);
+}
+
+/// Move bytes from the front of a buffer to a string.
+static void takeBytes(asio::streambuf& buffer, size_t size, std::string& out) {
+  auto begin = asio::buffers_begin(buffer.data());
+  out.append(begin, begin + size);
+  buffer.consume(size);
+}
+
+/// Read a line ending with CRLF, without the CRLF.
+template <typename Socket>
+static bool readLine(Socket& socket,
+                     asio::streambuf& buffer,
+                     std::string& line) {
+  boost::system::error_code ec;
+  auto size = asio::read_until(socket, buffer, "\r\n", ec);
+  if (ec) {
+    return false;
+  }
+
+  line.clear();
+  takeBytes(buffer, size, line);
+  line.resize(line.size() - 2);
+  return true;
+}
+
+/// Read until a buffer holds at least size bytes.
+template <typename Socket>
+static bool readBytes(Socket& socket, asio::streambuf& buffer, size_t size) {
+  if (buffer.size() >= size) {
+    return true;
+  }
+
+  boost::system::error_code ec;
+  asio::read(socket, buffer, asio::transfer_exactly(size - buffer.size()), ec);
+  return !ec;
+}
+
+DockerClient& DockerClient::get() {
+  static DockerClient client;
+  return client;
+}
+
+Status DockerClient::request(const std::string& uri, DockerTree& tree) {
+  auto now = std::chrono::steady_clock::now();
+  if (FLAGS_docker_cache_ttl > 0) {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    auto cached = cache_.find(uri);
+    if (cached != cache_.end() && cached->second.expires > now) {
+      countRequest("cached");
+      tree = cached->second.tree;
+      return Status(0);
+    }
+  }
+
+  std::string body;
+  auto s = send(uri, body);
+  if (!s.ok()) {
+    countRequest("failed");
+    return s;
+  }
+
+  auto parsed = std::make_shared<pt::ptree>();
+  s = parseDockerJSON(body, *parsed);
+  if (!s.ok()) {
+    return Status(
+        1, "Error reading docker API response for " + uri + ": " + s.what());
+  }
+  tree = std::move(parsed);
+
+  if (FLAGS_docker_cache_ttl > 0) {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    for (auto it = cache_.begin(); it != cache_.end();) {
+      it = (it->second.expires <= now) ? cache_.erase(it) : std::next(it);
+    }
+
+    auto& cached = cache_[uri];
+    cached.expires = now + std::chrono::milliseconds(FLAGS_docker_cache_ttl);
+    cached.tree = tree;
+  }
+  return Status(0);
+}
+
+std::vector<Status> DockerClient::requestAll(
+    const std::vector<std::string>& uris, std::vector<DockerTree>& trees) {
+  std::vector<Status> statuses(uris.size());
+  trees.assign(uris.size(), nullptr);
+
+  size_t workers = std::max<size_t>(FLAGS_docker_workers, 1);
+  workers = std::min(workers, uris.size());
+  std::atomic<size_t> next{0};
+  auto work = [this, &next, &uris, &trees, &statuses]() {
+    for (size_t i = next++; i < uris.size(); i = next++) {
+      statuses[i] = request(uris[i], trees[i]);
+    }
+  };
+
+  // The calling thread is one of the workers, and is charged for the others.
+  auto charge = getThreadResourceCharge();
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < workers; ++i) {
+    threads.emplace_back([work, charge]() {
+      ScopedResourceCharge scope(charge);
+      work();
+    });
+  }
+  work();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return statuses;
+}
+
+void DockerClient::reset() {
+  {
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+    idle_.clear();
+  }
+
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  cache_.clear();
+}
+
+Status DockerClient::send(const std::string& uri, std::string& body) {
+  for (bool reuse : {true, false}) {
+    ConnectionRef connection;
+    bool reused = false;
+    auto s = connect(connection, reuse, reused);
+    if (!s.ok()) {
+      return s;
+    }
+
+    bool keep_alive = false;
+    body.clear();
+    s = exchange(*connection, uri, body, keep_alive);
+    if (s.ok() && keep_alive) {
+      release(std::move(connection));
+    }
+
+    // The engine closes idle connections, the others are likely closed too.
+    if (s.getCode() == kDockerClosedCode && reused) {
+      std::lock_guard<std::mutex> lock(idle_mutex_);
+      idle_.clear();
+      continue;
+    }
+    return s;
+  }
+  return Status(1, "Cannot send docker API request for: " + uri);
+}
+
+Status DockerClient::exchange(Connection& connection,
+                              const std::string& uri,
+                              std::string& body,
+                              bool& keep_alive) {
+  keep_alive = false;
+  auto& socket = connection.socket;
+  auto& buffer = connection.buffer;
+
+  std::string request = "GET " + uri +
+                        " HTTP/1.1\r\nHost: docker\r\nAccept: */*\r\n\r\n";
+  boost::system::error_code ec;
+  asio::write(socket, asio::buffer(request), ec);
+  std::string line;
+  if (ec || !readLine(socket, buffer, line)) {
+    return Status(kDockerClosedCode, "Empty docker API response for: " + uri);
+  }
+
+  // All status responses are expected to be 200
+  if (!boost::starts_with(line, "HTTP/1.") || line.size() < 12 ||
+      line.compare(9, 3, "200") != 0) {
+    return Status(1, "Invalid docker API response for " + uri + ": " + line);
+  }
+  keep_alive = boost::starts_with(line, "HTTP/1.1");
+
+  bool chunked = false;
+  bool has_length = false;
+  size_t length = 0;
+  while (true) {
+    if (!readLine(socket, buffer, line)) {
+      return Status(1, "Incomplete docker API response for: " + uri);
+    }
+    if (line.empty()) {
+      break;
+    }
+
+    auto colon = line.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    auto name = line.substr(0, colon);
+    auto value = boost::trim_copy(line.substr(colon + 1));
+    if (boost::iequals(name, "Content-Length")) {
+      has_length = true;
+      length = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (boost::iequals(name, "Transfer-Encoding")) {
+      chunked = boost::icontains(value, "chunked");
+    } else if (boost::iequals(name, "Connection")) {
+      keep_alive = !boost::iequals(value, "close");
+    }
+  }
+
+  if (chunked) {
+    while (true) {
+      if (!readLine(socket, buffer, line)) {
+        return Status(1, "Incomplete docker API response for: " + uri);
+      }
+
+      // Chunk extensions after the size are ignored.
+      auto size = std::strtoull(line.c_str(), nullptr, 16);
+      if (size == 0) {
+        break;
+      }
+      if (!readBytes(socket, buffer, size + 2)) {
+        return Status(1, "Incomplete docker API response for: " + uri);
+      }
+      takeBytes(buffer, size, body);
+      buffer.consume(2);
+    }
+
+    // Skip the trailer, which ends with an empty line.
+    do {
+      if (!readLine(socket, buffer, line)) {
+        return Status(1, "Incomplete docker API response for: " + uri);
+      }
+    } while (!line.empty());
+  } else if (has_length) {
+    if (!readBytes(socket, buffer, length)) {
+      return Status(1, "Incomplete docker API response for: " + uri);
+    }
+    takeBytes(buffer, length, body);
+  } else {
+    // The body ends when the engine closes the connection.
+    keep_alive = false;
+    asio::read(socket, buffer, asio::transfer_all(), ec);
+    if (ec != asio::error::eof) {
+      return Status(1, "Incomplete docker API response for: " + uri);
+    }
+    takeBytes(buffer, buffer.size(), body);
+  }
+  return Status(0);
+}
+
+Status DockerClient::connect(ConnectionRef& connection,
+                             bool reuse,
+                             bool& reused) {
+  reused = false;
+  if (reuse) {
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+    if (!idle_.empty()) {
+      connection = std::move(idle_.back());
+      idle_.pop_back();
+      reused = true;
+      countRequest("reused");
+      return Status(0);
+    }
+  }
+
+  connection = std::make_unique<Connection>(io_service_);
+  boost::system::error_code ec;
+  connection->socket.connect(
+      asio::local::stream_protocol::endpoint(FLAGS_docker_socket), ec);
+  if (ec) {
+    return Status(1, "Error connecting to docker sock: " + ec.message());
+  }
+  countRequest("connected");
+  return Status(0);
+}
+
+void DockerClient::release(ConnectionRef connection) {
+  std::lock_guard<std::mutex> lock(idle_mutex_);
+  if (idle_.size() < std::max<size_t>(FLAGS_docker_workers, 1)) {
+    idle_.push_back(std::move(connection));
+  }
+}
+} // namespace tables
+} // namespace osquery
@@ -0,0 +1,124 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <osquery/status.h>
+
+namespace osquery {
+namespace tables {
+
+/// A parsed docker API response, shared by the tables reading it.
+using DockerTree = std::shared_ptr<const boost::property_tree::ptree>;
+
+/**
+ * @brief Parse a JSON document into a property tree.
+ *
+ * The tree is built from the events of a rapidjson reader, without an
+ * intermediate document. Values keep their JSON text as read_json does.
+ */
+Status parseDockerJSON(const std::string& json,
+                       boost::property_tree::ptree& tree);
+
+/**
+ * @brief A client of the docker engine API on its UNIX domain socket.
+ *
+ * Requests use HTTP/1.1 and connections are kept open between requests, at
+ * most docker_workers idle connections are kept. A connection closed by the
+ * engine while idle is replaced and the request is sent again.
+ *
+ * Responses are shared for docker_cache_ttl milliseconds, so the docker_*
+ * tables of a query, and queries scheduled together, read each URI once.
+ */
+class DockerClient : private boost::noncopyable {
+ public:
+  static DockerClient& get();
+
+  /**
+   * @brief Request a URI and parse the JSON response.
+   *
+   * @param uri Relative URI to invoke GET HTTP method.
+   * @param tree Output of the parsed response.
+   * @return Status with 0 code on success. Non-negative status with error
+   *         message.
+   */
+  Status request(const std::string& uri, DockerTree& tree);
+
+  /**
+   * @brief Request URIs concurrently, at most docker_workers at once.
+   *
+   * @param uris Relative URIs to invoke GET HTTP method.
+   * @param trees Output of the parsed response of each URI.
+   * @return The status of the request of each URI.
+   */
+  std::vector<Status> requestAll(const std::vector<std::string>& uris,
+                                 std::vector<DockerTree>& trees);
+
+  /// Close the idle connections and forget every response.
+  void reset();
+
+ private:
+  DockerClient() = default;
+
+  /// A connection with the bytes read past the last response.
+  struct Connection {
+    explicit Connection(boost::asio::io_service& io_service)
+        : socket(io_service) {}
+
+    boost::asio::local::stream_protocol::socket socket;
+    boost::asio::streambuf buffer;
+  };
+
+  using ConnectionRef = std::unique_ptr<Connection>;
+
+  struct CachedResponse {
+    std::chrono::steady_clock::time_point expires;
+    DockerTree tree;
+  };
+
+  /// Send a request and read the response body on a pooled connection.
+  Status send(const std::string& uri, std::string& body);
+
+  /// Send a request on a connection, the connection may be kept open.
+  Status exchange(Connection& connection,
+                  const std::string& uri,
+                  std::string& body,
+                  bool& keep_alive);
+
+  /// Take an idle connection if reuse is set, or open a new one.
+  Status connect(ConnectionRef& connection, bool reuse, bool& reused);
+
+  /// Return a connection to the idle connections.
+  void release(ConnectionRef connection);
+
+ private:
+  boost::asio::io_service io_service_;
+
+  /// Connections waiting for a request.
+  std::vector<ConnectionRef> idle_;
+  std::mutex idle_mutex_;
+
+  /// Recent responses by URI.
+  std::map<std::string, CachedResponse> cache_;
+  std::mutex cache_mutex_;
+};
+} // namespace tables
+} // namespace osquery
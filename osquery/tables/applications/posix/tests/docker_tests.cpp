@@ -0,0 +1,355 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <atomic>
+#include <sstream>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/property_tree/json_parser.hpp>
+
+#include <osquery/flags.h>
+
+#include "osquery/tables/applications/posix/docker_api.h"
+#include "osquery/tests/test_util.h"
+
+namespace asio = boost::asio;
+namespace pt = boost::property_tree;
+
+namespace osquery {
+
+DECLARE_string(docker_socket);
+DECLARE_uint64(docker_workers);
+DECLARE_uint64(docker_cache_ttl);
+
+namespace tables {
+
+/// A response of the fake engine.
+struct FakeResponse {
+  std::string body;
+
+  /// Send the body in chunks rather than with a Content-Length.
+  bool chunked{false};
+
+  /// Send a Connection: close header and close the connection.
+  bool close{false};
+
+  /// Close the connection after the response without a header, as the engine
+  /// does with an idle connection.
+  bool drop{false};
+
+  std::string status{"200 OK"};
+};
+
+/// A docker engine serving fixed responses on a UNIX domain socket.
+class FakeDockerd {
+ public:
+  explicit FakeDockerd(const std::string& path)
+      : path_(path), acceptor_(io_service_) {
+    boost::filesystem::remove(path_);
+    acceptor_.open(asio::local::stream_protocol());
+    acceptor_.bind(asio::local::stream_protocol::endpoint(path_));
+    acceptor_.listen();
+    thread_ = std::thread([this]() { accept(); });
+  }
+
+  ~FakeDockerd() {
+    stopping_ = true;
+
+    // Wake the acceptor with a connection.
+    asio::local::stream_protocol::socket socket(io_service_);
+    boost::system::error_code ec;
+    socket.connect(asio::local::stream_protocol::endpoint(path_), ec);
+    thread_.join();
+    socket.close();
+
+    for (auto& connection : connections_) {
+      connection.join();
+    }
+    boost::filesystem::remove(path_);
+  }
+
+  void add(const std::string& uri, FakeResponse response) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    responses_[uri] = std::move(response);
+  }
+
+  /// Milliseconds each response is delayed.
+  std::atomic<size_t> delay{0};
+
+  std::atomic<size_t> accepted{0};
+  std::atomic<size_t> requests{0};
+
+  /// The most requests served at once.
+  std::atomic<size_t> max_active{0};
+
+ private:
+  void accept() {
+    while (true) {
+      auto socket =
+          std::make_shared<asio::local::stream_protocol::socket>(io_service_);
+      boost::system::error_code ec;
+      acceptor_.accept(*socket, ec);
+      if (ec || stopping_) {
+        break;
+      }
+      accepted++;
+      connections_.emplace_back([this, socket]() { serve(*socket); });
+    }
+  }
+
+  void serve(asio::local::stream_protocol::socket& socket) {
+    asio::streambuf buffer;
+    while (true) {
+      boost::system::error_code ec;
+      auto size = asio::read_until(socket, buffer, "\r\n\r\n", ec);
+      if (ec) {
+        break;
+      }
+
+      auto begin = asio::buffers_begin(buffer.data());
+      std::string head(begin, begin + size);
+      buffer.consume(size);
+      auto uri = head.substr(4, head.find(' ', 4) - 4);
+
+      auto current = ++active_;
+      auto max = max_active.load();
+      while (current > max && !max_active.compare_exchange_weak(max, current)) {
+      }
+      requests++;
+      std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+      active_--;
+
+      FakeResponse response;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = responses_.find(uri);
+        if (it == responses_.end()) {
+          response.status = "404 Not Found";
+        } else {
+          response = it->second;
+        }
+      }
+
+      std::stringstream out;
+      out << "HTTP/1.1 " << response.status << "\r\n"
+          << "Content-Type: application/json\r\n";
+      if (response.close) {
+        out << "Connection: close\r\n";
+      }
+      if (response.chunked) {
+        out << "Transfer-Encoding: chunked\r\n\r\n";
+        for (size_t i = 0; i < response.body.size(); i += 7) {
+          auto chunk = response.body.substr(i, 7);
+          out << std::hex << chunk.size() << std::dec << "\r\n"
+              << chunk << "\r\n";
+        }
+        out << "0\r\n\r\n";
+      } else {
+        out << "Content-Length: " << response.body.size() << "\r\n\r\n"
+            << response.body;
+      }
+
+      asio::write(socket, asio::buffer(out.str()), ec);
+      if (ec || response.close || response.drop) {
+        break;
+      }
+    }
+    socket.close();
+  }
+
+ private:
+  std::string path_;
+  asio::io_service io_service_;
+  asio::local::stream_protocol::acceptor acceptor_;
+  std::thread thread_;
+  std::vector<std::thread> connections_;
+  std::atomic<bool> stopping_{false};
+  std::atomic<size_t> active_{0};
+
+  std::map<std::string, FakeResponse> responses_;
+  std::mutex mutex_;
+};
+
+class DockerTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    socket_ = FLAGS_docker_socket;
+    workers_ = FLAGS_docker_workers;
+    cache_ttl_ = FLAGS_docker_cache_ttl;
+
+    FLAGS_docker_socket = kTestWorkingDirectory + "docker.sock";
+    DockerClient::get().reset();
+    dockerd_ = std::make_unique<FakeDockerd>(FLAGS_docker_socket);
+  }
+
+  void TearDown() override {
+    // Close the idle connections so the engine's connections end.
+    DockerClient::get().reset();
+    dockerd_.reset();
+
+    FLAGS_docker_socket = socket_;
+    FLAGS_docker_workers = workers_;
+    FLAGS_docker_cache_ttl = cache_ttl_;
+  }
+
+ protected:
+  std::unique_ptr<FakeDockerd> dockerd_;
+
+ private:
+  std::string socket_;
+  uint64_t workers_;
+  uint64_t cache_ttl_;
+};
+
+TEST_F(DockerTests, test_parse_json) {
+  std::string json =
+      "{\"Id\": \"abc\", \"State\": {\"Pid\": 42, \"Running\": true, "
+      "\"Error\": null, \"Ratio\": -1.5e3}, \"Names\": [\"/a\", \"/b\"], "
+      "\"Ports\": [{\"PrivatePort\": 80}, {}], \"Labels\": {}, "
+      "\"Escaped\": \"a\\\"b\\\\c\\n\\u00e9\"}";
+
+  pt::ptree tree;
+  ASSERT_TRUE(parseDockerJSON(json, tree).ok());
+
+  pt::ptree expected;
+  std::stringstream stream(json);
+  pt::read_json(stream, expected);
+  EXPECT_EQ(expected, tree);
+
+  EXPECT_EQ("42", tree.get<std::string>("State.Pid"));
+  EXPECT_EQ("true", tree.get<std::string>("State.Running"));
+  EXPECT_EQ("-1.5e3", tree.get<std::string>("State.Ratio"));
+  EXPECT_EQ(2U, tree.get_child("Names").size());
+
+  ASSERT_TRUE(parseDockerJSON("[{\"Id\": \"a\"}, {\"Id\": \"b\"}]", tree).ok());
+  ASSERT_EQ(2U, tree.size());
+  EXPECT_EQ("", tree.front().first);
+  EXPECT_EQ("b", tree.back().second.get<std::string>("Id"));
+
+  EXPECT_FALSE(parseDockerJSON("{\"Id\": ", tree).ok());
+  EXPECT_FALSE(parseDockerJSON("{} {}", tree).ok());
+}
+
+TEST_F(DockerTests, test_keep_alive) {
+  dockerd_->add("/version", {"{\"Version\": \"1\"}"});
+  dockerd_->add("/info", {"{\"ID\": \"x\"}"});
+
+  DockerTree tree;
+  ASSERT_TRUE(DockerClient::get().request("/version", tree).ok());
+  EXPECT_EQ("1", tree->get<std::string>("Version"));
+  ASSERT_TRUE(DockerClient::get().request("/info", tree).ok());
+  EXPECT_EQ("x", tree->get<std::string>("ID"));
+
+  EXPECT_EQ(1U, dockerd_->accepted);
+  EXPECT_EQ(2U, dockerd_->requests);
+}
+
+TEST_F(DockerTests, test_response_cache) {
+  dockerd_->add("/version", {"{\"Version\": \"1\"}"});
+
+  DockerTree first;
+  DockerTree second;
+  ASSERT_TRUE(DockerClient::get().request("/version", first).ok());
+  ASSERT_TRUE(DockerClient::get().request("/version", second).ok());
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(1U, dockerd_->requests);
+
+  DockerClient::get().reset();
+  ASSERT_TRUE(DockerClient::get().request("/version", second).ok());
+  EXPECT_NE(first, second);
+  EXPECT_EQ(2U, dockerd_->requests);
+
+  FLAGS_docker_cache_ttl = 0;
+  ASSERT_TRUE(DockerClient::get().request("/version", second).ok());
+  EXPECT_EQ(3U, dockerd_->requests);
+}
+
+TEST_F(DockerTests, test_chunked_and_close) {
+  FakeResponse chunked{"{\"Containers\": [\"a\", \"b\", \"c\"]}"};
+  chunked.chunked = true;
+  dockerd_->add("/chunked", chunked);
+
+  FakeResponse close{"{\"Closed\": true}"};
+  close.close = true;
+  dockerd_->add("/close", close);
+
+  FLAGS_docker_cache_ttl = 0;
+  DockerTree tree;
+  ASSERT_TRUE(DockerClient::get().request("/chunked", tree).ok());
+  EXPECT_EQ(3U, tree->get_child("Containers").size());
+  ASSERT_TRUE(DockerClient::get().request("/chunked", tree).ok());
+  EXPECT_EQ(1U, dockerd_->accepted);
+
+  // The connection is not reused after a Connection: close.
+  ASSERT_TRUE(DockerClient::get().request("/close", tree).ok());
+  EXPECT_EQ("true", tree->get<std::string>("Closed"));
+  ASSERT_TRUE(DockerClient::get().request("/chunked", tree).ok());
+  EXPECT_EQ(2U, dockerd_->accepted);
+}
+
+TEST_F(DockerTests, test_closed_connection) {
+  FakeResponse drop{"{\"Dropped\": true}"};
+  drop.drop = true;
+  dockerd_->add("/drop", drop);
+  dockerd_->add("/version", {"{\"Version\": \"1\"}"});
+
+  // The engine closes the idle connection, the request is sent again.
+  DockerTree tree;
+  ASSERT_TRUE(DockerClient::get().request("/drop", tree).ok());
+  ASSERT_TRUE(DockerClient::get().request("/version", tree).ok());
+  EXPECT_EQ("1", tree->get<std::string>("Version"));
+  EXPECT_EQ(2U, dockerd_->accepted);
+  EXPECT_EQ(2U, dockerd_->requests);
+}
+
+TEST_F(DockerTests, test_errors) {
+  DockerTree tree;
+  auto s = DockerClient::get().request("/missing", tree);
+  EXPECT_FALSE(s.ok());
+  EXPECT_NE(std::string::npos, s.getMessage().find("404"));
+
+  dockerd_->add("/invalid", {"{\"Version\": "});
+  EXPECT_FALSE(DockerClient::get().request("/invalid", tree).ok());
+
+  DockerClient::get().reset();
+  dockerd_.reset();
+  EXPECT_FALSE(DockerClient::get().request("/version", tree).ok());
+}
+
+TEST_F(DockerTests, test_request_all) {
+  std::vector<std::string> uris;
+  for (size_t i = 0; i < 12; ++i) {
+    auto uri = "/containers/" + std::to_string(i) + "/json";
+    dockerd_->add(uri, {"{\"Id\": \"" + std::to_string(i) + "\"}"});
+    uris.push_back(uri);
+  }
+  uris.push_back("/missing");
+
+  FLAGS_docker_workers = 3;
+  dockerd_->delay = 20;
+  std::vector<DockerTree> trees;
+  auto statuses = DockerClient::get().requestAll(uris, trees);
+  ASSERT_EQ(uris.size(), statuses.size());
+  ASSERT_EQ(uris.size(), trees.size());
+  for (size_t i = 0; i < 12; ++i) {
+    ASSERT_TRUE(statuses[i].ok());
+    EXPECT_EQ(std::to_string(i), trees[i]->get<std::string>("Id"));
+  }
+  EXPECT_FALSE(statuses.back().ok());
+  EXPECT_EQ(nullptr, trees.back());
+
+  EXPECT_EQ(3U, dockerd_->max_active);
+  EXPECT_LE(dockerd_->accepted, 3U);
+}
+} // namespace tables
+} // namespace osquery
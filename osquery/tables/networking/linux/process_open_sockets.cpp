@@ -10,50 +10,101 @@
 
 #include <osquery/core.h>
 #include <osquery/filesystem.h>
+#include <osquery/flags.h>
 #include <osquery/tables.h>
 
 #include "osquery/core/conversions.h"
 #include "osquery/filesystem/linux/proc.h"
+#include "osquery/tables/networking/linux/sock_diag.h"
 
 namespace osquery {
+
+FLAG(bool,
+     disable_sock_diag,
+     false,
+     "Read process sockets from /proc instead of netlink sock_diag");
+
 namespace tables {
+
+/// A process and the inodes of its socket descriptors.
+struct NamespaceProcess final {
+  std::string process_id;
+  std::unordered_map<std::string, std::string> inode_to_fd_map;
+};
+
+/**
+ * @brief Read every socket of a network namespace once.
+ *
+ * Sockets are dumped with NETLINK_SOCK_DIAG, /proc/<pid>/net of a process in
+ * the namespace is parsed for the protocols sock_diag does not support or if
+ * the dump fails. Only sockets in inodes are kept from /proc.
+ */
+static void genNamespaceSockets(
+    const std::string& process_id,
+    bool own_namespace,
+    std::unordered_map<std::string, std::string>& inodes,
+    SocketInodeMap& sockets) {
+  int fd = -1;
+  if (!FLAGS_disable_sock_diag) {
+    auto status = sockDiagOpen((own_namespace) ? "" : process_id, fd);
+    if (!status.ok()) {
+      VLOG(1) << "Reading the sockets of process " << process_id
+              << " from /proc: " << status.getMessage();
+    }
+  }
+
+  auto L_genSocketsFromProcCallback = [](const ProcessSocket& proc_socket,
+                                         SocketInodeMap& sockets) -> bool {
+    sockets[proc_socket.socket] = proc_socket;
+    return true;
+  };
+
+  auto genSockets = [&](int protocol, int family) {
+    if (fd >= 0 && sockDiagSupported(protocol, family)) {
+      auto status = sockDiagDump(fd, protocol, family, sockets);
+      if (status.ok()) {
+        return;
+      }
+      VLOG(1) << "Reading the sockets of process " << process_id
+              << " from /proc: " << status.getMessage();
+    }
+
+    auto status = procProcessSockets<SocketInodeMap&>(
+        L_genSocketsFromProcCallback,
+        sockets,
+        process_id,
+        protocol,
+        family,
+        &inodes);
+    if (!status.ok()) {
+      VLOG(1) << "The process_open_sockets may be showing partial results. "
+                 "Error: "
+              << status.getMessage();
+    }
+  };
+
+  for (const auto& pair : kLinuxProtocolNames) {
+    genSockets(pair.first, AF_INET);
+    genSockets(pair.first, AF_INET6);
+  }
+  genSockets(IPPROTO_IP, AF_UNIX);
+
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
 QueryData genOpenSockets(QueryContext& context) {
   // If a pid is given then set that as the only item in processes.
   std::set<std::string> pids;
   if (context.constraints["pid"].exists(EQUALS)) {
     pids = context.constraints["pid"].getAll(EQUALS);
   } else {
-    osquery::procProcesses(pids);
+    pids = ProcessSnapshot::get()->pids();
   }
 
-  struct CallbackData final {
-    QueryData results;
-    std::string process_id;
-    ino_t current_network_namespace;
-  };
-
-  auto L_genSocketsFromProcCallback = [](const ProcessSocket& proc_socket,
-                                         CallbackData& data) -> bool {
-    Row r;
-    r["socket"] = proc_socket.socket;
-    r["family"] = std::to_string(proc_socket.family);
-    r["protocol"] = std::to_string(proc_socket.protocol);
-    r["local_address"] = proc_socket.local_address;
-    r["local_port"] = std::to_string(proc_socket.local_port);
-    r["remote_address"] = proc_socket.remote_address;
-    r["remote_port"] = std::to_string(proc_socket.remote_port);
-    r["path"] = proc_socket.unix_socket_path;
-    r["fd"] = std::to_string(proc_socket.fd);
-    r["pid"] = data.process_id;
-    r["net_namespace"] = std::to_string(data.current_network_namespace);
-    r["state"] = proc_socket.state;
-
-    data.results.push_back(std::move(r));
-    return true;
-  };
-
-  CallbackData callback_data = {};
-
+  // Processes are grouped by network namespace, whose sockets are read once.
+  std::map<ino_t, std::vector<NamespaceProcess>> namespaces;
   for (const auto& process_id : pids) {
     // We are only interested in the 'net' namespace, so we will be filtering
     // out everything else
@@ -67,11 +118,9 @@ QueryData genOpenSockets(QueryContext& context) {
       continue;
     }
 
-    callback_data.process_id = process_id;
-    callback_data.current_network_namespace = process_namespaces["net"];
-
-    std::unordered_map<std::string, std::string> inode_to_fd_map;
-    status = procSocketInodeToFdMap(process_id, inode_to_fd_map);
+    NamespaceProcess process;
+    process.process_id = process_id;
+    status = procSocketInodeToFdMap(process_id, process.inode_to_fd_map);
     if (!status.ok()) {
       VLOG(1) << "The process_open_sockets may be showing partial results. "
                  "Error: Failed to enumerate the fd map for the following "
@@ -79,49 +128,56 @@ QueryData genOpenSockets(QueryContext& context) {
               << process_id;
     }
 
-    for (const auto& pair : kLinuxProtocolNames) {
-      int protocol = pair.first;
-
-      std::vector<ProcessSocket> socket_list;
-      status = procProcessSockets<CallbackData&>(L_genSocketsFromProcCallback,
-                                                 callback_data,
-                                                 process_id,
-                                                 protocol,
-                                                 AF_INET,
-                                                 &inode_to_fd_map);
-      if (!status.ok()) {
-        VLOG(1) << "The process_open_sockets may be showing partial results. "
-                   "Error: "
-                << status.getMessage();
-      }
+    if (!process.inode_to_fd_map.empty()) {
+      namespaces[process_namespaces["net"]].push_back(std::move(process));
+    }
+  }
 
-      status = procProcessSockets<CallbackData&>(L_genSocketsFromProcCallback,
-                                                 callback_data,
-                                                 process_id,
-                                                 protocol,
-                                                 AF_INET6,
-                                                 &inode_to_fd_map);
-      if (!status.ok()) {
-        VLOG(1) << "The process_open_sockets may be showing partial results. "
-                   "Error: "
-                << status.getMessage();
-      }
+  ino_t own_namespace = 0;
+  procGetNamespaceInode(own_namespace, "net", kLinuxProcPath + "/self/ns");
+
+  QueryData results;
+  for (const auto& network_namespace : namespaces) {
+    const auto& processes = network_namespace.second;
+    std::unordered_map<std::string, std::string> inodes;
+    for (const auto& process : processes) {
+      inodes.insert(process.inode_to_fd_map.begin(),
+                    process.inode_to_fd_map.end());
     }
 
-    status = procProcessSockets<CallbackData&>(L_genSocketsFromProcCallback,
-                                               callback_data,
-                                               process_id,
-                                               IPPROTO_IP,
-                                               AF_UNIX,
-                                               &inode_to_fd_map);
-    if (!status.ok()) {
-      VLOG(1) << "The process_open_sockets may be showing partial results. "
-                 "Error: "
-              << status.getMessage();
+    SocketInodeMap sockets;
+    genNamespaceSockets(processes.front().process_id,
+                        network_namespace.first == own_namespace,
+                        inodes,
+                        sockets);
+
+    for (const auto& process : processes) {
+      for (const auto& descriptor : process.inode_to_fd_map) {
+        auto socket = sockets.find(descriptor.first);
+        if (socket == sockets.end()) {
+          continue;
+        }
+
+        const auto& proc_socket = socket->second;
+        Row r;
+        r["socket"] = proc_socket.socket;
+        r["family"] = std::to_string(proc_socket.family);
+        r["protocol"] = std::to_string(proc_socket.protocol);
+        r["local_address"] = proc_socket.local_address;
+        r["local_port"] = std::to_string(proc_socket.local_port);
+        r["remote_address"] = proc_socket.remote_address;
+        r["remote_port"] = std::to_string(proc_socket.remote_port);
+        r["path"] = proc_socket.unix_socket_path;
+        r["fd"] = descriptor.second;
+        r["pid"] = process.process_id;
+        r["net_namespace"] = std::to_string(network_namespace.first);
+        r["state"] = proc_socket.state;
+        results.push_back(std::move(r));
+      }
     }
   }
 
-  return callback_data.results;
+  return results;
 }
 } // namespace tables
 } // namespace osquery
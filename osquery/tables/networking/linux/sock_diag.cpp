@@ -0,0 +1,263 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// clang-format off
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include "osquery/tables/networking/linux/inet_diag.h"
+#include <linux/sock_diag.h>
+#include <linux/unix_diag.h>
+// clang-format on
+
+#include "osquery/tables/networking/linux/sock_diag.h"
+
+namespace osquery {
+namespace tables {
+
+/// Receive buffer, larger than any datagram of a netlink dump.
+#define SOCK_DIAG_BUFFER_SIZE (64 * 1024)
+
+/// Seconds to wait for each datagram of a dump.
+#define SOCK_DIAG_TIMEOUT 5
+
+/// Kernel TCP states of sockets that never have an inode.
+#define SOCK_DIAG_TCP_SYN_RECV 3
+#define SOCK_DIAG_TCP_TIME_WAIT 6
+#define SOCK_DIAG_TCP_NEW_SYN_RECV 12
+
+/// Sequence numbers tell a dump apart from leftovers of a failed dump.
+static std::atomic<unsigned int> kSockDiagSequence{0};
+
+bool sockDiagSupported(int protocol, int family) {
+  if (family == AF_UNIX) {
+    return protocol == IPPROTO_IP;
+  }
+
+  return (family == AF_INET || family == AF_INET6) &&
+         (protocol == IPPROTO_TCP || protocol == IPPROTO_UDP ||
+          protocol == IPPROTO_UDPLITE);
+}
+
+static int openSockDiagSocket() {
+  return socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+}
+
+Status sockDiagOpen(const std::string& process_id, int& fd) {
+  fd = -1;
+  if (process_id.empty()) {
+    fd = openSockDiagSocket();
+  } else {
+    auto namespace_path = kLinuxProcPath + "/" + process_id + "/ns/net";
+    int namespace_fd = open(namespace_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (namespace_fd < 0) {
+      return Status(1, "Cannot open network namespace " + namespace_path);
+    }
+
+    // The thread exits in the namespace, the socket stays bound to it.
+    std::thread([namespace_fd, &fd]() {
+      if (setns(namespace_fd, CLONE_NEWNET) == 0) {
+        fd = openSockDiagSocket();
+      }
+    }).join();
+    close(namespace_fd);
+  }
+
+  if (fd < 0) {
+    return Status(1, "Cannot open a NETLINK_SOCK_DIAG socket");
+  }
+
+  struct timeval timeout = {SOCK_DIAG_TIMEOUT, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  return Status(0, "OK");
+}
+
+static std::string getDiagAddress(int family, const void* address) {
+  char buffer[INET6_ADDRSTRLEN] = {0};
+  inet_ntop(family, address, buffer, INET6_ADDRSTRLEN);
+  return std::string(buffer);
+}
+
+static void parseInetDiag(const struct nlmsghdr* header,
+                          int protocol,
+                          SocketInodeMap& sockets) {
+  if (header->nlmsg_len < NLMSG_LENGTH(sizeof(struct inet_diag_msg))) {
+    return;
+  }
+
+  auto message = static_cast<const struct inet_diag_msg*>(NLMSG_DATA(header));
+  if (message->idiag_inode == 0) {
+    // Sockets without an inode cannot be owned by a descriptor.
+    return;
+  }
+
+  ProcessSocket proc_socket = {};
+  proc_socket.socket = std::to_string(message->idiag_inode);
+  proc_socket.family = message->idiag_family;
+  proc_socket.protocol = protocol;
+  proc_socket.local_address =
+      getDiagAddress(proc_socket.family, message->id.idiag_src);
+  proc_socket.local_port = ntohs(message->id.idiag_sport);
+  proc_socket.remote_address =
+      getDiagAddress(proc_socket.family, message->id.idiag_dst);
+  proc_socket.remote_port = ntohs(message->id.idiag_dport);
+
+  if (protocol == IPPROTO_TCP) {
+    auto state = static_cast<size_t>(message->idiag_state);
+    proc_socket.state = (state == 0 || state >= tcp_states.size())
+                            ? "UNKNOWN"
+                            : tcp_states[state];
+  }
+
+  sockets[proc_socket.socket] = std::move(proc_socket);
+}
+
+static void parseUnixDiag(const struct nlmsghdr* header,
+                          SocketInodeMap& sockets) {
+  if (header->nlmsg_len < NLMSG_LENGTH(sizeof(struct unix_diag_msg))) {
+    return;
+  }
+
+  auto message = static_cast<const struct unix_diag_msg*>(NLMSG_DATA(header));
+  ProcessSocket proc_socket = {};
+  proc_socket.socket = std::to_string(message->udiag_ino);
+  proc_socket.family = AF_UNIX;
+  proc_socket.protocol = IPPROTO_IP;
+
+  auto attribute = reinterpret_cast<struct rtattr*>(
+      const_cast<struct unix_diag_msg*>(message) + 1);
+  int length = header->nlmsg_len - NLMSG_LENGTH(sizeof(*message));
+  for (; RTA_OK(attribute, length); attribute = RTA_NEXT(attribute, length)) {
+    if (attribute->rta_type != UNIX_DIAG_NAME) {
+      continue;
+    }
+
+    // Format the path as /proc/net/unix does, abstract names start with '@'.
+    std::string path(static_cast<const char*>(RTA_DATA(attribute)),
+                     RTA_PAYLOAD(attribute));
+    if (!path.empty() && path[0] != '\0') {
+      path = std::string(path.c_str());
+    } else {
+      std::replace(path.begin(), path.end(), '\0', '@');
+    }
+    proc_socket.unix_socket_path = std::move(path);
+  }
+
+  sockets[proc_socket.socket] = std::move(proc_socket);
+}
+
+static Status sendSockDiagRequest(int fd,
+                                  int protocol,
+                                  int family,
+                                  unsigned int sequence) {
+  struct nlmsghdr header = {};
+  header.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+  header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  header.nlmsg_seq = sequence;
+
+  struct inet_diag_req_v2 inet_request = {};
+  struct unix_diag_req unix_request = {};
+  struct iovec iov[2];
+  iov[0].iov_base = &header;
+  iov[0].iov_len = sizeof(header);
+  if (family == AF_UNIX) {
+    unix_request.sdiag_family = AF_UNIX;
+    unix_request.udiag_states = ~0U;
+    unix_request.udiag_show = UDIAG_SHOW_NAME;
+    iov[1].iov_base = &unix_request;
+    iov[1].iov_len = sizeof(unix_request);
+  } else {
+    inet_request.sdiag_family = family;
+    inet_request.sdiag_protocol = protocol;
+    inet_request.idiag_states = ~0U;
+    if (protocol == IPPROTO_TCP) {
+      // Skip requests and TIME_WAIT sockets, busy servers have many.
+      inet_request.idiag_states &= ~((1U << SOCK_DIAG_TCP_SYN_RECV) |
+                                     (1U << SOCK_DIAG_TCP_TIME_WAIT) |
+                                     (1U << SOCK_DIAG_TCP_NEW_SYN_RECV));
+    }
+    iov[1].iov_base = &inet_request;
+    iov[1].iov_len = sizeof(inet_request);
+  }
+  header.nlmsg_len = NLMSG_LENGTH(iov[1].iov_len);
+
+  struct sockaddr_nl kernel = {};
+  kernel.nl_family = AF_NETLINK;
+  struct msghdr request = {};
+  request.msg_name = &kernel;
+  request.msg_namelen = sizeof(kernel);
+  request.msg_iov = iov;
+  request.msg_iovlen = 2;
+  if (sendmsg(fd, &request, 0) < 0) {
+    return Status(1, "Could not write to NETLINK_SOCK_DIAG");
+  }
+  return Status(0, "OK");
+}
+
+Status sockDiagDump(int fd, int protocol, int family, SocketInodeMap& sockets) {
+  if (!sockDiagSupported(protocol, family)) {
+    return Status(1, "The protocol and family cannot be dumped by sock_diag");
+  }
+
+  auto sequence = ++kSockDiagSequence;
+  auto status = sendSockDiagRequest(fd, protocol, family, sequence);
+  if (!status.ok()) {
+    return status;
+  }
+
+  std::vector<char> buffer(SOCK_DIAG_BUFFER_SIZE);
+  while (true) {
+    auto bytes = recv(fd, buffer.data(), buffer.size(), 0);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    } else if (bytes <= 0) {
+      return Status(1, "Could not read from NETLINK_SOCK_DIAG");
+    }
+
+    auto header = reinterpret_cast<struct nlmsghdr*>(buffer.data());
+    auto length = static_cast<int>(bytes);
+    for (; NLMSG_OK(header, length); header = NLMSG_NEXT(header, length)) {
+      if (header->nlmsg_seq != sequence) {
+        continue;
+      }
+
+      if (header->nlmsg_type == NLMSG_DONE) {
+        return Status(0, "OK");
+      } else if (header->nlmsg_type == NLMSG_ERROR) {
+        auto error = static_cast<struct nlmsgerr*>(NLMSG_DATA(header));
+        return Status(1,
+                      std::string("NETLINK_SOCK_DIAG error: ") +
+                          strerror(-error->error));
+      } else if (header->nlmsg_type != SOCK_DIAG_BY_FAMILY) {
+        continue;
+      }
+
+      if (family == AF_UNIX) {
+        parseUnixDiag(header, sockets);
+      } else {
+        parseInetDiag(header, protocol, sockets);
+      }
+    }
+  }
+}
+} // namespace tables
+} // namespace osquery
@@ -0,0 +1,58 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include <osquery/core.h>
+
+#include "osquery/filesystem/linux/proc.h"
+
+namespace osquery {
+namespace tables {
+
+/// The sockets of a network namespace, keyed by their inode.
+using SocketInodeMap = std::unordered_map<std::string, ProcessSocket>;
+
+/**
+ * @brief True if NETLINK_SOCK_DIAG can dump sockets of a protocol and family.
+ *
+ * TCP, UDP, and UDP-Lite sockets are dumped by inet_diag and UNIX sockets by
+ * unix_diag. ICMP and raw sockets are read from /proc.
+ */
+bool sockDiagSupported(int protocol, int family);
+
+/**
+ * @brief Open a NETLINK_SOCK_DIAG socket in the network namespace of a process.
+ *
+ * A netlink socket dumps the namespace it was created in. The namespace is
+ * entered from a short-lived thread, so no other thread changes namespace.
+ * Entering the namespace of another process requires CAP_SYS_ADMIN.
+ *
+ * @param process_id the process owning the namespace, empty for osquery's own.
+ * @param fd stores the opened socket, which the caller closes.
+ */
+Status sockDiagOpen(const std::string& process_id, int& fd);
+
+/**
+ * @brief Dump every socket of a protocol and family into a map.
+ *
+ * Sockets are reported as by procProcessSockets, without the fd.
+ *
+ * @param fd a socket opened with sockDiagOpen.
+ * @param protocol the protocol, IPPROTO_IP for UNIX sockets.
+ * @param family AF_INET, AF_INET6, or AF_UNIX.
+ * @param sockets stores the sockets by inode.
+ */
+Status sockDiagDump(int fd, int protocol, int family, SocketInodeMap& sockets);
+} // namespace tables
+} // namespace osquery
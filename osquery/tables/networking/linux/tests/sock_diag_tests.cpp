@@ -0,0 +1,139 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <boost/filesystem.hpp>
+
+#include "osquery/tables/networking/linux/sock_diag.h"
+#include "osquery/tests/test_util.h"
+
+namespace osquery {
+namespace tables {
+
+class SockDiagTests : public testing::Test {
+ protected:
+  void TearDown() override {
+    for (auto fd : fds_) {
+      close(fd);
+    }
+  }
+
+  /// Keep a socket open until the end of the test, return its inode.
+  std::string keep(int fd) {
+    fds_.push_back(fd);
+    struct stat st;
+    EXPECT_EQ(0, fstat(fd, &st));
+    return std::to_string(st.st_ino);
+  }
+
+ private:
+  std::vector<int> fds_;
+};
+
+TEST_F(SockDiagTests, test_supported) {
+  EXPECT_TRUE(sockDiagSupported(IPPROTO_TCP, AF_INET));
+  EXPECT_TRUE(sockDiagSupported(IPPROTO_UDP, AF_INET6));
+  EXPECT_TRUE(sockDiagSupported(IPPROTO_IP, AF_UNIX));
+  EXPECT_FALSE(sockDiagSupported(IPPROTO_ICMP, AF_INET));
+  EXPECT_FALSE(sockDiagSupported(IPPROTO_RAW, AF_INET));
+
+  int fd = -1;
+  ASSERT_TRUE(sockDiagOpen("", fd).ok());
+  keep(fd);
+
+  SocketInodeMap sockets;
+  EXPECT_FALSE(sockDiagDump(fd, IPPROTO_ICMP, AF_INET, sockets).ok());
+}
+
+TEST_F(SockDiagTests, test_dump_tcp) {
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  ASSERT_GE(listener, 0);
+  auto inode = keep(listener);
+
+  struct sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t length = sizeof(address);
+  ASSERT_EQ(0, bind(listener, (struct sockaddr*)&address, length));
+  ASSERT_EQ(0, listen(listener, 1));
+  ASSERT_EQ(0, getsockname(listener, (struct sockaddr*)&address, &length));
+
+  int fd = -1;
+  ASSERT_TRUE(sockDiagOpen("", fd).ok());
+  keep(fd);
+
+  SocketInodeMap sockets;
+  ASSERT_TRUE(sockDiagDump(fd, IPPROTO_TCP, AF_INET, sockets).ok());
+  ASSERT_EQ(1U, sockets.count(inode));
+
+  const auto& proc_socket = sockets.at(inode);
+  EXPECT_EQ(AF_INET, proc_socket.family);
+  EXPECT_EQ(IPPROTO_TCP, proc_socket.protocol);
+  EXPECT_EQ("127.0.0.1", proc_socket.local_address);
+  EXPECT_EQ(ntohs(address.sin_port), proc_socket.local_port);
+  EXPECT_EQ("0.0.0.0", proc_socket.remote_address);
+  EXPECT_EQ(0U, proc_socket.remote_port);
+  EXPECT_EQ("LISTEN", proc_socket.state);
+
+  // The same socket is reported from /proc.
+  std::unordered_map<std::string, std::string> inodes = {{inode, "0"}};
+  SocketInodeMap proc_sockets;
+  auto status = procProcessSockets<SocketInodeMap&>(
+      [](const ProcessSocket& proc_socket, SocketInodeMap& sockets) -> bool {
+        sockets[proc_socket.socket] = proc_socket;
+        return true;
+      },
+      proc_sockets,
+      std::to_string(getpid()),
+      IPPROTO_TCP,
+      AF_INET,
+      &inodes);
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(1U, proc_sockets.count(inode));
+  EXPECT_EQ(proc_socket.local_address, proc_sockets[inode].local_address);
+  EXPECT_EQ(proc_socket.local_port, proc_sockets[inode].local_port);
+  EXPECT_EQ(proc_socket.state, proc_sockets[inode].state);
+}
+
+TEST_F(SockDiagTests, test_dump_unix) {
+  auto path = (boost::filesystem::path(kTestWorkingDirectory) / "sock_diag")
+                  .string();
+  unlink(path.c_str());
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  ASSERT_GE(listener, 0);
+  auto inode = keep(listener);
+
+  struct sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+  ASSERT_LT(path.size(), sizeof(address.sun_path));
+  strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+  ASSERT_EQ(0, bind(listener, (struct sockaddr*)&address, sizeof(address)));
+  ASSERT_EQ(0, listen(listener, 1));
+
+  int fd = -1;
+  ASSERT_TRUE(sockDiagOpen("", fd).ok());
+  keep(fd);
+
+  SocketInodeMap sockets;
+  ASSERT_TRUE(sockDiagDump(fd, IPPROTO_IP, AF_UNIX, sockets).ok());
+  ASSERT_EQ(1U, sockets.count(inode));
+  EXPECT_EQ(AF_UNIX, sockets[inode].family);
+  EXPECT_EQ(path, sockets[inode].unix_socket_path);
+  unlink(path.c_str());
+}
+} // namespace tables
+} // namespace osquery
@@ -0,0 +1,97 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <boost/filesystem.hpp>
+
+#include <osquery/filesystem.h>
+#include <osquery/flags.h>
+
+#include "osquery/tables/system/hash.h"
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+
+DECLARE_uint32(hash_workers);
+
+/// Every digest supported by the hash table.
+const int kAllHashes = HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256;
+
+/// A synthetic directory of files, removed when the benchmark completes.
+class HashBenchmarkTree {
+ public:
+  HashBenchmarkTree(size_t count, size_t size) {
+    root_ = fs::temp_directory_path() /
+            fs::unique_path("osquery-hash-benchmark-%%%%-%%%%");
+    fs::create_directories(root_);
+
+    std::string content(size, '\0');
+    for (size_t i = 0; i < size; i++) {
+      content[i] = static_cast<char>(i % 251);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      auto path = root_ / ("file" + std::to_string(i));
+      writeTextFile(path, content);
+      paths.push_back(path.string());
+    }
+  }
+
+  ~HashBenchmarkTree() {
+    boost::system::error_code ec;
+    fs::remove_all(root_, ec);
+  }
+
+ public:
+  std::vector<std::string> paths;
+
+ private:
+  fs::path root_;
+};
+
+static void HASH_file_all_digests(benchmark::State& state) {
+  HashBenchmarkTree tree(1, state.range(0));
+  while (state.KeepRunning()) {
+    auto hashes = hashMultiFromFile(kAllHashes, tree.paths[0]);
+    benchmark::DoNotOptimize(hashes);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(HASH_file_all_digests)->Arg(4096)->Arg(1 << 20)->Arg(16 << 20);
+
+static void HASH_file_one_digest(benchmark::State& state) {
+  HashBenchmarkTree tree(1, state.range(0));
+  while (state.KeepRunning()) {
+    auto hashes = hashMultiFromFile(HASH_TYPE_SHA256, tree.paths[0]);
+    benchmark::DoNotOptimize(hashes);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+
+BENCHMARK(HASH_file_one_digest)->Arg(4096)->Arg(1 << 20)->Arg(16 << 20);
+
+static void HASH_tree_workers(benchmark::State& state) {
+  const size_t size = 256 * 1024;
+  HashBenchmarkTree tree(256, size);
+  auto workers = FLAGS_hash_workers;
+  FLAGS_hash_workers = static_cast<uint32_t>(state.range(0));
+  while (state.KeepRunning()) {
+    auto hashes = hashMultiFromFiles(kAllHashes, tree.paths);
+    benchmark::DoNotOptimize(hashes);
+  }
+  FLAGS_hash_workers = workers;
+  state.SetBytesProcessed(state.iterations() * tree.paths.size() * size);
+}
+
+BENCHMARK(HASH_tree_workers)->Arg(1)->Arg(2)->Arg(4)->Arg(8);
+}
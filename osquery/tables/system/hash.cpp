@@ -9,27 +9,20 @@
  */
 
 #include <algorithm>
-#include <iomanip>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <set>
-#include <sstream>
 #include <thread>
-#include <unordered_map>
 #include <vector>
 
-#include <errno.h>
-#include <string.h>
-
-// clang-format off
-#include <sys/types.h>
-#include <sys/stat.h>
-// clang-format on
-
 #ifndef WIN32
+#include <fcntl.h>
 #include <unistd.h>
 #endif
 
-#include <openssl/md5.h>
-#include <openssl/sha.h>
+#include <openssl/evp.h>
 
 #include <boost/filesystem.hpp>
 
@@ -39,7 +32,13 @@
 #include <osquery/logger.h>
 #include <osquery/tables.h>
 
+#include "osquery/core/process.h"
+#include "osquery/filesystem/fileops.h"
+#ifndef WIN32
+#include "osquery/filesystem/traverse.h"
+#endif
 #include "osquery/tables/system/hash.h"
+#include "osquery/tables/system/hash_cache.h"
 
 namespace osquery {
 
@@ -48,72 +47,147 @@ FLAG(bool,
      false,
      "Cache calculated file hashes, re-calculate only if inode times change");
 
-FLAG(uint32, hash_cache_max, 500, "Size of LRU file hash cache");
+FLAG(uint32, hash_workers, 4, "Number of threads hashing files for a query");
+
+FLAG(uint64,
+     hash_io_budget,
+     0,
+     "Bytes per second file hashing may read, 0 for unlimited");
 
 HIDDEN_FLAG(uint32,
             hash_delay,
             20,
             "Number of milliseconds to delay after hashing");
 
-/// Clear this amount of rows every time cache eviction is triggered.
-#define HASH_CACHE_EVICT_SIZE 5
+DECLARE_uint64(read_max);
+DECLARE_bool(disable_forensic);
+
+/// The largest buffer read size from file IO to hashing structures.
+#define HASH_CHUNK_SIZE (1024 * 1024)
+
+/// The smallest buffer read size, used for special files.
+#define HASH_MIN_CHUNK_SIZE 4096
+
+/**
+ * @brief Paces the file reads of hashing to the hash_io_budget.
+ *
+ * The budget is shared by every hashing thread. Reads may burst for up to a
+ * second of the budget, then wait for the budget to refill.
+ */
+class HashIOBudget : private boost::noncopyable {
+ public:
+  static HashIOBudget& get() {
+    static HashIOBudget budget;
+    return budget;
+  }
+
+  /// Account for bytes read, waiting if the budget is spent.
+  void consume(size_t bytes) {
+    auto rate = FLAGS_hash_io_budget;
+    if (rate == 0) {
+      return;
+    }
+
+    using namespace std::chrono;
+    steady_clock::time_point until;
+    {
+      WriteLock lock(mutex_);
+      auto now = steady_clock::now();
+      if (next_ < now) {
+        next_ = now;
+      }
+      next_ += microseconds(static_cast<uint64_t>(bytes) * 1000000 / rate);
+      until = next_ - seconds(1);
+    }
+    std::this_thread::sleep_until(until);
+  }
+
+ private:
+  /// The time at which the budget would be completely refilled.
+  std::chrono::steady_clock::time_point next_;
 
-/// The buffer read size from file IO to hashing structures.
-#define HASH_CHUNK_SIZE 4096
+  Mutex mutex_;
+};
+
+/// Files hashed by each worker before a batch of rows is yielded.
+const size_t kHashBatchFiles{4};
+
+/// Apply a function to each index using at most hash_workers threads.
+static void forEachConcurrently(size_t count,
+                                const std::function<void(size_t)>& func) {
+  size_t workers = std::max<size_t>(FLAGS_hash_workers, 1);
+  workers = std::min(workers, count);
+  if (workers <= 1) {
+    for (size_t i = 0; i < count; ++i) {
+      func(i);
+    }
+    return;
+  }
+
+  std::atomic<size_t> next{0};
+  auto work = [&next, &func, count]() {
+    for (size_t i = next++; i < count; i = next++) {
+      func(i);
+    }
+  };
+
+  // The calling thread is one of the workers, and is charged for the others.
+  auto charge = getThreadResourceCharge();
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < workers; ++i) {
+    threads.emplace_back([work, charge]() {
+      ScopedResourceCharge scope(charge);
+      work();
+    });
+  }
+  work();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
 
 Hash::~Hash() {
   if (ctx_ != nullptr) {
-    free(ctx_);
+    EVP_MD_CTX_destroy(static_cast<EVP_MD_CTX*>(ctx_));
   }
 }
 
 Hash::Hash(HashType algorithm) : algorithm_(algorithm) {
+  // The EVP interface selects the fastest implementation for the CPU.
+  const EVP_MD* md = nullptr;
   if (algorithm_ == HASH_TYPE_MD5) {
-    length_ = MD5_DIGEST_LENGTH;
-    ctx_ = static_cast<MD5_CTX*>(malloc(sizeof(MD5_CTX)));
-    MD5_Init(static_cast<MD5_CTX*>(ctx_));
+    md = EVP_md5();
   } else if (algorithm_ == HASH_TYPE_SHA1) {
-    length_ = SHA_DIGEST_LENGTH;
-    ctx_ = static_cast<SHA_CTX*>(malloc(sizeof(SHA_CTX)));
-    SHA1_Init(static_cast<SHA_CTX*>(ctx_));
+    md = EVP_sha1();
   } else if (algorithm_ == HASH_TYPE_SHA256) {
-    length_ = SHA256_DIGEST_LENGTH;
-    ctx_ = static_cast<SHA256_CTX*>(malloc(sizeof(SHA256_CTX)));
-    SHA256_Init(static_cast<SHA256_CTX*>(ctx_));
+    md = EVP_sha256();
   } else {
     throw std::domain_error("Unknown hash function");
   }
+
+  length_ = static_cast<size_t>(EVP_MD_size(md));
+  auto ctx = EVP_MD_CTX_create();
+  EVP_DigestInit_ex(ctx, md, nullptr);
+  ctx_ = ctx;
 }
 
 void Hash::update(const void* buffer, size_t size) {
-  if (algorithm_ == HASH_TYPE_MD5) {
-    MD5_Update(static_cast<MD5_CTX*>(ctx_), buffer, size);
-  } else if (algorithm_ == HASH_TYPE_SHA1) {
-    SHA1_Update(static_cast<SHA_CTX*>(ctx_), buffer, size);
-  } else if (algorithm_ == HASH_TYPE_SHA256) {
-    SHA256_Update(static_cast<SHA256_CTX*>(ctx_), buffer, size);
-  }
+  EVP_DigestUpdate(static_cast<EVP_MD_CTX*>(ctx_), buffer, size);
 }
 
 std::string Hash::digest() {
   std::vector<unsigned char> hash;
   hash.assign(length_, '\0');
-
-  if (algorithm_ == HASH_TYPE_MD5) {
-    MD5_Final(hash.data(), static_cast<MD5_CTX*>(ctx_));
-  } else if (algorithm_ == HASH_TYPE_SHA1) {
-    SHA1_Final(hash.data(), static_cast<SHA_CTX*>(ctx_));
-  } else if (algorithm_ == HASH_TYPE_SHA256) {
-    SHA256_Final(hash.data(), static_cast<SHA256_CTX*>(ctx_));
-  }
+  EVP_DigestFinal_ex(static_cast<EVP_MD_CTX*>(ctx_), hash.data(), nullptr);
 
   // The hash value is only relevant as a hex digest.
-  std::stringstream digest;
+  static const char kHexDigits[] = "0123456789abcdef";
+  std::string digest(length_ * 2, '0');
   for (size_t i = 0; i < length_; i++) {
-    digest << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
+    digest[i * 2] = kHexDigits[hash[i] >> 4];
+    digest[i * 2 + 1] = kHexDigits[hash[i] & 0x0f];
   }
-
-  return digest.str();
+  return digest;
 }
 
 std::string hashFromBuffer(HashType hash_type,
@@ -125,210 +199,118 @@ std::string hashFromBuffer(HashType hash_type,
 }
 
 MultiHashes hashMultiFromFile(int mask, const std::string& path) {
-  std::map<HashType, std::shared_ptr<Hash>> hashes = {
-      {HASH_TYPE_MD5, std::make_shared<Hash>(HASH_TYPE_MD5)},
-      {HASH_TYPE_SHA1, std::make_shared<Hash>(HASH_TYPE_SHA1)},
-      {HASH_TYPE_SHA256, std::make_shared<Hash>(HASH_TYPE_SHA256)},
-  };
-
-  auto s = readFile(path,
-                    0,
-                    HASH_CHUNK_SIZE,
-                    false,
-                    true,
-                    ([&hashes, &mask](std::string& buffer, size_t size) {
-                      for (auto& hash : hashes) {
-                        if (mask & hash.first) {
-                          hash.second->update(&buffer[0], size);
-                        }
-                      }
-                    }),
-                    true);
-
   MultiHashes mh = {};
-  if (!s.ok()) {
-    return mh;
-  }
 
-  mh.mask = mask;
-  if (mask & HASH_TYPE_MD5) {
-    mh.md5 = hashes.at(HASH_TYPE_MD5)->digest();
-  }
-  if (mask & HASH_TYPE_SHA1) {
-    mh.sha1 = hashes.at(HASH_TYPE_SHA1)->digest();
+  // Only the requested algorithms are updated with the content.
+  std::vector<std::pair<HashType, std::unique_ptr<Hash>>> hashes;
+  for (auto type : {HASH_TYPE_MD5, HASH_TYPE_SHA1, HASH_TYPE_SHA256}) {
+    if (mask & type) {
+      hashes.emplace_back(type, std::make_unique<Hash>(type));
+    }
   }
-  if (mask & HASH_TYPE_SHA256) {
-    mh.sha256 = hashes.at(HASH_TYPE_SHA256)->digest();
+  if (hashes.empty()) {
+    return mh;
   }
-  return mh;
-}
 
-std::string hashFromFile(HashType hash_type, const std::string& path) {
-  auto hashes = hashMultiFromFile(hash_type, path);
-  if (hash_type == HASH_TYPE_MD5) {
-    return hashes.md5;
-  } else if (hash_type == HASH_TYPE_SHA1) {
-    return hashes.sha1;
-  } else {
-    return hashes.sha256;
+  PlatformFile fd(path, PF_OPEN_EXISTING | PF_READ);
+  if (!fd.isValid()) {
+    return mh;
   }
-}
-
-/**
- * @brief Implements persistent in-memory caching of files' hashes.
- *
- * This cache has LRU eviction policy. The hash is recalculated
- * every time the mtime or size of the file changes.
- */
-struct FileHashCache {
-  /// The file's modification time, changes with a touch.
-  time_t file_mtime;
-
-  /// The file's serial or information number (inode).
-  ino_t file_inode;
 
-  /// The file's size.
-  off_t file_size;
-
-  /// For eviction, the last time this cache item was used.
-  time_t cache_access_time;
-
-  /// Cache content, the hashes.
-  MultiHashes hashes;
-
-  /// Cache index, the file path.
-  std::string path;
-
-  /// Comparison function for organizing the LRU heap.
-  static bool greater(const FileHashCache* l, const FileHashCache* r) {
-    return l->cache_access_time > r->cache_access_time;
+  // Apply the max byte-read, the same as readFile.
+  auto read_max = static_cast<size_t>(FLAGS_read_max);
+  auto file_size = fd.size();
+  if (file_size > read_max) {
+    LOG(WARNING) << "Cannot hash file that exceeds size limit: " << path;
+    return mh;
   }
 
-  /**
-   * @brief Do-it-all access function.
-   *
-   * Maintains the cache of hash sums, stats file at path, if it has changed or
-   * it is not present in cache calculates the hashes and caches the result.
-   *
-   * @param path the path of file to hash.
-   * @param out stores the calculated hashes.
-   *
-   * @return true if succeeded, false if something went wrong.
-   */
-  static bool load(const std::string& path, MultiHashes& out);
-};
+  PlatformTime times;
+  fd.getFileTimes(times);
 
-#if defined(WIN32)
+#ifdef POSIX_FADV_SEQUENTIAL
+  // The content is read once, front to back, allow aggressive read-ahead.
+  ::posix_fadvise(fd.nativeHandle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
 
-#define stat _stat
-#define strerror_r(e, buf, sz) strerror_s((buf), (sz), (e))
+  // Small files are read with a single call into a buffer of their size.
+  size_t block_size = std::min<size_t>(file_size, HASH_CHUNK_SIZE);
+  std::vector<char> buffer(std::max<size_t>(block_size, HASH_MIN_CHUNK_SIZE));
+  size_t total_bytes = 0;
+  while (file_size == 0 || total_bytes < file_size) {
+    auto part_bytes = fd.read(buffer.data(), buffer.size());
+    if (part_bytes <= 0) {
+      break;
+    }
 
-#endif
+    auto bytes = static_cast<size_t>(part_bytes);
+    if (file_size > 0 && total_bytes + bytes > file_size) {
+      // The file grew while reading, hash the size that was opened.
+      bytes = file_size - total_bytes;
+    }
+    total_bytes += bytes;
+    if (total_bytes > read_max) {
+      return mh;
+    }
 
-/**
- * @brief Checks the current stat output against the cached view.
- *
- * If the modified/altered time or the file's inode has changed then the hash
- * should be recalculated.
- */
-static inline bool statInvalid(const struct stat& st, const FileHashCache& fh) {
-  if (st.st_ino != fh.file_inode || st.st_mtime != fh.file_mtime) {
-    // Most plausible case for modification detection.
-    return true;
+    HashIOBudget::get().consume(bytes);
+    for (auto& hash : hashes) {
+      hash.second->update(buffer.data(), bytes);
+    }
   }
 
-  if (st.st_size != fh.file_size) {
-    // Just in case there's tomfoolery.
-    return true;
+  // Attempt to restore the atime and mtime before the file read.
+  if (!FLAGS_disable_forensic) {
+    fd.setFileTimes(times);
   }
-  return false;
-}
 
-bool FileHashCache::load(const std::string& path, MultiHashes& out) {
-  // synchronize the access to cache
-  static Mutex mx;
-  // path => cache entry
-  static std::unordered_map<std::string, FileHashCache> cache;
-  // minheap on cache_access_time
-  static std::vector<FileHashCache*> lru;
-
-  WriteLock guard(mx);
-
-  struct stat st;
-  if (stat(path.c_str(), &st) != 0) {
-    char buf[0x200] = {0};
-    strerror_r(errno, buf, sizeof(buf));
-    LOG(WARNING) << "Cannot stat file: " << path << ": " << buf;
-    return false;
+  mh.mask = mask;
+  for (auto& hash : hashes) {
+    if (hash.first == HASH_TYPE_MD5) {
+      mh.md5 = hash.second->digest();
+    } else if (hash.first == HASH_TYPE_SHA1) {
+      mh.sha1 = hash.second->digest();
+    } else {
+      mh.sha256 = hash.second->digest();
+    }
   }
+  return mh;
+}
 
-  auto entry = cache.find(path);
-  if (entry == cache.end()) { // none, load
-    if (cache.size() >= FLAGS_hash_cache_max) {
-      // too large, evict
-      for (size_t i = 0; i < HASH_CACHE_EVICT_SIZE; ++i) {
-        if (lru.empty()) {
-          continue;
-        }
-        std::string key = lru[0]->path;
-        std::pop_heap(lru.begin(), lru.end(), FileHashCache::greater);
-        lru.pop_back();
-        if (cache.find(key) != cache.end()) {
-          cache.erase(key);
-        }
-      }
-    }
+std::vector<MultiHashes> hashMultiFromFiles(
+    int mask, const std::vector<std::string>& paths) {
+  std::vector<MultiHashes> hashes(paths.size());
+  forEachConcurrently(paths.size(), [&](size_t i) {
+    hashes[i] = hashMultiFromFile(mask, paths[i]);
+  });
+  return hashes;
+}
 
-    auto hashes = hashMultiFromFile(
-        HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
-    FileHashCache rec = {st.st_mtime, // .file_mtime
-                         st.st_ino, // .file_inode
-                         st.st_size, // .file_size
-                         time(nullptr), // .cache_access_time
-                         std::move(hashes), // .hashes
-                         path}; // .path
-    cache[path] = std::move(rec);
-    lru.push_back(&cache[path]);
-    std::push_heap(lru.begin(), lru.end(), FileHashCache::greater);
-    out = cache[path].hashes;
-  } else if (statInvalid(st, entry->second)) { // changed, update
-    auto hashes = hashMultiFromFile(
-        HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
-    entry->second.cache_access_time = time(nullptr);
-    entry->second.file_mtime = st.st_mtime;
-    entry->second.file_size = st.st_size;
-    entry->second.hashes = std::move(hashes);
-    std::make_heap(lru.begin(), lru.end(), FileHashCache::greater);
-    out = entry->second.hashes;
-  } else { // ok, got it
-    out = entry->second.hashes;
-    entry->second.cache_access_time = time(nullptr);
-    std::make_heap(lru.begin(), lru.end(), FileHashCache::greater);
+std::string hashFromFile(HashType hash_type, const std::string& path) {
+  auto hashes = hashMultiFromFile(hash_type, path);
+  if (hash_type == HASH_TYPE_MD5) {
+    return hashes.md5;
+  } else if (hash_type == HASH_TYPE_SHA1) {
+    return hashes.sha1;
+  } else {
+    return hashes.sha256;
   }
-  return true;
 }
 
 void genHashForFile(const std::string& path,
                     const std::string& dir,
-                    QueryContext& context,
-                    QueryData& results) {
+                    int mask,
+                    Row& r) {
   // Must provide the path, filename, directory separate from boost path->string
   // helpers to match any explicit (query-parsed) predicate constraints.
-  Row r;
-
   MultiHashes hashes;
-  if (!FLAGS_disable_hash_cache) {
-    FileHashCache::load(path, hashes);
+  if (mask == 0) {
+    // The query does not use any digest.
+  } else if (!FLAGS_disable_hash_cache) {
+    FileHashCache::get().load(path, mask, hashes);
   } else {
-    if (context.isCached(path)) {
-      // Use the inner-query cache if the global hash cache is disabled.
-      // This protects against hashing the same content twice in the same query.
-      r = context.getCache(path);
-    } else {
-      hashes = hashMultiFromFile(
-          HASH_TYPE_MD5 | HASH_TYPE_SHA1 | HASH_TYPE_SHA256, path);
-      std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_hash_delay));
-    }
+    hashes = hashMultiFromFile(mask, path);
+    std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_hash_delay));
   }
 
   r["path"] = path;
@@ -336,34 +318,35 @@ void genHashForFile(const std::string& path,
   r["md5"] = std::move(hashes.md5);
   r["sha1"] = std::move(hashes.sha1);
   r["sha256"] = std::move(hashes.sha256);
-  if (FLAGS_disable_hash_cache) {
-    context.setCache(path, r);
-  }
-
-  results.push_back(r);
 }
 
 namespace tables {
 
-QueryData genHash(QueryContext& context) {
-  QueryData results;
+void genHash(RowYield& yield, QueryContext& context) {
   boost::system::error_code ec;
 
+  // Files are collected first, then hashed concurrently in batches, as a pair
+  // of the file path and the directory column.
+  std::vector<std::pair<std::string, std::string>> files;
+
   // The query must provide a predicate with constraints including path or
   // directory. We search for the parsed predicate constraints with the equals
   // operator.
+  // Resolved paths keep the status read while walking their directories.
+  std::map<std::string, ResolvedPath> resolved;
   auto paths = context.constraints["path"].getAll(EQUALS);
   context.expandConstraints(
       "path",
       LIKE,
       paths,
       ([&](const std::string& pattern, std::set<std::string>& out) {
-        std::vector<std::string> patterns;
+        std::vector<ResolvedPath> patterns;
         auto status =
             resolveFilePattern(pattern, patterns, GLOB_ALL | GLOB_NO_CANON);
         if (status.ok()) {
-          for (const auto& resolved : patterns) {
-            out.insert(resolved);
+          for (auto& file : patterns) {
+            out.insert(file.path);
+            resolved[file.path] = std::move(file);
           }
         }
         return status;
@@ -372,11 +355,16 @@ QueryData genHash(QueryContext& context) {
   // Iterate through the file paths, adding the hash results
   for (const auto& path_string : paths) {
     boost::filesystem::path path = path_string;
-    if (!boost::filesystem::is_regular_file(path, ec)) {
+    auto file = resolved.find(path_string);
+    if (file != resolved.end() && file->second.has_stat) {
+      if (!S_ISREG(file->second.file_stat.st_mode)) {
+        continue;
+      }
+    } else if (!boost::filesystem::is_regular_file(path, ec)) {
       continue;
     }
 
-    genHashForFile(path_string, path.parent_path().string(), context, results);
+    files.emplace_back(path_string, path.parent_path().string());
   }
 
   // Now loop through constraints using the directory column constraint.
@@ -397,6 +385,14 @@ QueryData genHash(QueryContext& context) {
         return status;
       }));
 
+#ifndef WIN32
+  // Read each directory's entries with their status, including hidden files.
+  auto limits = getTraversalLimits();
+  limits.max_depth = 1;
+  limits.workers = 1;
+  limits.hidden = true;
+#endif
+
   // Iterate over the directory paths
   for (const auto& directory_string : directories) {
     boost::filesystem::path directory = directory_string;
@@ -406,16 +402,77 @@ QueryData genHash(QueryContext& context) {
 
     // Iterate over the directory files and generate a hash for each regular
     // file.
+#ifndef WIN32
+    std::vector<ResolvedPath> entries;
+    traverseDirectories({directory_string}, limits, entries);
+    for (auto& entry : entries) {
+      if (entry.has_stat && S_ISREG(entry.file_stat.st_mode)) {
+        files.emplace_back(std::move(entry.path), directory_string);
+      }
+    }
+#else
     boost::filesystem::directory_iterator begin(directory), end;
     for (; begin != end; ++begin) {
       if (boost::filesystem::is_regular_file(begin->path(), ec)) {
-        genHashForFile(
-            begin->path().string(), directory_string, context, results);
+        files.emplace_back(begin->path().string(), directory_string);
       }
     }
+#endif
+  }
+
+  // Only calculate the digests the query selects or filters.
+  int mask = 0;
+  if (context.isColumnUsed("md5")) {
+    mask |= HASH_TYPE_MD5;
   }
+  if (context.isColumnUsed("sha1")) {
+    mask |= HASH_TYPE_SHA1;
+  }
+  if (context.isColumnUsed("sha256")) {
+    mask |= HASH_TYPE_SHA256;
+  }
+
+  // Each batch is yielded before the next is hashed, a query that stops
+  // early does not hash the remaining files.
+  auto batch_size = std::max<size_t>(FLAGS_hash_workers, 1) * kHashBatchFiles;
+  auto cache_prefix = std::to_string(mask) + ":";
+  for (size_t start = 0; start < files.size(); start += batch_size) {
+    if (context.expired()) {
+      // The query's time budget is spent, return the files hashed so far.
+      break;
+    }
+    auto end = std::min(start + batch_size, files.size());
+
+    // Use the inner-query cache if the global hash cache is disabled.
+    // This protects against hashing the same content twice in the same query.
+    QueryData results(end - start);
+    std::vector<size_t> pending;
+    for (size_t i = start; i < end; ++i) {
+      auto index = cache_prefix + files[i].first;
+      if (FLAGS_disable_hash_cache && context.isCached(index)) {
+        results[i - start] = context.getCache(index);
+        results[i - start]["directory"] = files[i].second;
+      } else {
+        pending.push_back(i);
+      }
+    }
+
+    forEachConcurrently(pending.size(), [&](size_t i) {
+      const auto& file = files[pending[i]];
+      genHashForFile(
+          file.first, file.second, mask, results[pending[i] - start]);
+    });
+
+    if (FLAGS_disable_hash_cache) {
+      for (auto i : pending) {
+        context.setCache(cache_prefix + files[i].first, results[i - start]);
+      }
+    }
 
-  return results;
+    for (auto& r : results) {
+      yield(r);
+    }
+  }
 }
 }
 }
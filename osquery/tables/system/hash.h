@@ -11,6 +11,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 
 #include <boost/noncopyable.hpp>
 
@@ -29,7 +30,7 @@ enum HashType {
 
 /// A result structure for multiple hash requests.
 struct MultiHashes {
-  int mask;
+  int mask{0};
   std::string md5;
   std::string sha1;
   std::string sha256;
@@ -93,9 +94,9 @@ class Hash : private boost::noncopyable {
   /// The hashing algorithm which is used to compute the hash
   HashType algorithm_;
 
-  /// The buffer used to maintain the context and state of the hashing
+  /// The EVP digest context used to maintain the state of the hashing
   /// operations
-  void* ctx_;
+  void* ctx_{nullptr};
 
   /// The length of the hash to be returned
   size_t length_;
@@ -113,13 +114,28 @@ std::string hashFromFile(HashType hash_type, const std::string& path);
 /**
  * @brief Compute multiple hashes from a files contents simultaneously.
  *
+ * The content is read once, in large blocks, and only the algorithms within
+ * the mask are updated. Reads count against the hash_io_budget.
+ *
  * @param mask Bitmask specifying target osquery-supported algorithms.
  * @param path Filesystem path (the hash target).
  * @return A struct containing string (hex) representations
- *         of the hash digests.
+ *         of the hash digests, the mask is 0 if the file was not read.
  */
 MultiHashes hashMultiFromFile(int mask, const std::string& path);
 
+/**
+ * @brief Compute multiple hashes for many files concurrently.
+ *
+ * Files are hashed by at most hash_workers threads.
+ *
+ * @param mask Bitmask specifying target osquery-supported algorithms.
+ * @param paths Filesystem paths (the hash targets).
+ * @return The hashes of each path, in the order of the input paths.
+ */
+std::vector<MultiHashes> hashMultiFromFiles(
+    int mask, const std::vector<std::string>& paths);
+
 /**
  * @brief Compute a hash digest from the contents of a buffer.
  *
@@ -0,0 +1,365 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+// clang-format off
+#include <sys/types.h>
+#include <sys/stat.h>
+// clang-format on
+
+#if defined(WIN32)
+#include <windows.h>
+#endif
+
+#include <osquery/database.h>
+#include <osquery/flags.h>
+#include <osquery/logger.h>
+
+#include "osquery/core/conversions.h"
+#include "osquery/tables/system/hash_cache.h"
+
+namespace osquery {
+
+FLAG(uint64,
+     hash_cache_max_size,
+     1024 * 1024,
+     "Bytes of file hashes cached in memory and the database");
+
+HIDDEN_FLAG(uint32,
+            hash_cache_max,
+            500,
+            "Deprecated, the hash cache is bound by hash_cache_max_size");
+
+#if defined(WIN32)
+
+#define stat _stat
+#define strerror_r(e, buf, sz) strerror_s((buf), (sz), (e))
+
+#endif
+
+/// Estimated bytes used by the list and index nodes of an entry.
+#define HASH_CACHE_ENTRY_OVERHEAD (8 * sizeof(void*))
+
+/// Placeholder for a digest that was not calculated.
+#define HASH_CACHE_NO_DIGEST "-"
+
+/// Read the content version from the file's stat.
+static FileHashVersion getVersion(const struct stat& st) {
+  FileHashVersion version;
+  const int64_t kNanoseconds = 1000000000;
+#if defined(__APPLE__)
+  version.mtime = st.st_mtimespec.tv_sec * kNanoseconds +
+                  st.st_mtimespec.tv_nsec;
+  version.ctime = st.st_ctimespec.tv_sec * kNanoseconds +
+                  st.st_ctimespec.tv_nsec;
+#elif defined(WIN32)
+  version.mtime = static_cast<int64_t>(st.st_mtime) * kNanoseconds;
+  version.ctime = static_cast<int64_t>(st.st_ctime) * kNanoseconds;
+#else
+  version.mtime = st.st_mtim.tv_sec * kNanoseconds + st.st_mtim.tv_nsec;
+  version.ctime = st.st_ctim.tv_sec * kNanoseconds + st.st_ctim.tv_nsec;
+#endif
+  version.size = static_cast<uint64_t>(st.st_size);
+  return version;
+}
+
+/**
+ * @brief Read the identity and content version of a file.
+ *
+ * On Windows _stat reports no inode and times with a one second resolution.
+ * The volume serial number and NTFS file index identify the file, and the
+ * last write time is read with its full resolution.
+ */
+static bool getIdentity(const std::string& path,
+                        const struct stat& st,
+                        FileHashIdentity& identity,
+                        FileHashVersion& version) {
+  version = getVersion(st);
+#if defined(WIN32)
+  auto handle = CreateFileA(path.c_str(),
+                            0,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                FILE_SHARE_DELETE,
+                            nullptr,
+                            OPEN_EXISTING,
+                            FILE_FLAG_BACKUP_SEMANTICS,
+                            nullptr);
+  if (handle == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  BY_HANDLE_FILE_INFORMATION info;
+  auto found = GetFileInformationByHandle(handle, &info);
+  CloseHandle(handle);
+  if (!found) {
+    return false;
+  }
+
+  identity.device = info.dwVolumeSerialNumber;
+  identity.inode = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) |
+                   info.nFileIndexLow;
+
+  // FILETIME counts 100 nanosecond intervals.
+  auto mtime = (static_cast<int64_t>(info.ftLastWriteTime.dwHighDateTime)
+                << 32) |
+               info.ftLastWriteTime.dwLowDateTime;
+  version.mtime = mtime * 100;
+#else
+  identity.device = static_cast<uint64_t>(st.st_dev);
+  identity.inode = static_cast<uint64_t>(st.st_ino);
+#endif
+  return true;
+}
+
+/// Copy the digests from a set of hashes missing in another.
+static void mergeHashes(MultiHashes& to, const MultiHashes& from) {
+  auto missing = from.mask & ~to.mask;
+  if (missing & HASH_TYPE_MD5) {
+    to.md5 = from.md5;
+  }
+  if (missing & HASH_TYPE_SHA1) {
+    to.sha1 = from.sha1;
+  }
+  if (missing & HASH_TYPE_SHA256) {
+    to.sha256 = from.sha256;
+  }
+  to.mask |= from.mask;
+}
+
+FileHashCache& FileHashCache::get() {
+  static FileHashCache cache;
+  return cache;
+}
+
+FileHashCache::Shard& FileHashCache::getShard(
+    const FileHashIdentity& identity) {
+  return shards_[IdentityHash()(identity) % kShards];
+}
+
+std::string FileHashCache::getKey(const FileHashIdentity& identity) {
+  return std::to_string(identity.device) + ":" +
+         std::to_string(identity.inode);
+}
+
+std::string FileHashCache::serialize(const Entry& entry) {
+  auto digest = [](const std::string& value) {
+    return (value.empty()) ? HASH_CACHE_NO_DIGEST : value;
+  };
+
+  const auto& hashes = entry.hashes;
+  return std::to_string(entry.version.mtime) + " " +
+         std::to_string(entry.version.ctime) + " " +
+         std::to_string(entry.version.size) + " " +
+         std::to_string(hashes.mask) + " " + digest(hashes.md5) + " " +
+         digest(hashes.sha1) + " " + digest(hashes.sha256);
+}
+
+bool FileHashCache::deserialize(const std::string& key,
+                                const std::string& value,
+                                Entry& entry) {
+  auto identity = split(key, ":");
+  auto fields = split(value, " ");
+  if (identity.size() != 2 || fields.size() != 7) {
+    return false;
+  }
+
+  unsigned long long device = 0;
+  unsigned long long inode = 0;
+  long long mtime = 0;
+  long long ctime = 0;
+  unsigned long long size = 0;
+  long int mask = 0;
+  if (!safeStrtoull(identity[0], 10, device) ||
+      !safeStrtoull(identity[1], 10, inode) ||
+      !safeStrtoll(fields[0], 10, mtime) ||
+      !safeStrtoll(fields[1], 10, ctime) ||
+      !safeStrtoull(fields[2], 10, size) || !safeStrtol(fields[3], 10, mask)) {
+    return false;
+  }
+
+  entry.identity = {device, inode};
+  entry.version.mtime = mtime;
+  entry.version.ctime = ctime;
+  entry.version.size = size;
+  entry.hashes = MultiHashes();
+  entry.hashes.mask = static_cast<int>(mask);
+  auto digest = [&fields](size_t i) {
+    return (fields[i] == HASH_CACHE_NO_DIGEST) ? "" : fields[i];
+  };
+  entry.hashes.md5 = digest(4);
+  entry.hashes.sha1 = digest(5);
+  entry.hashes.sha256 = digest(6);
+  return true;
+}
+
+const FileHashCache::Entry& FileHashCache::insert(
+    Shard& shard, Entry entry, std::vector<FileHashIdentity>& evicted) {
+  const auto& hashes = entry.hashes;
+  entry.bytes = sizeof(Entry) + HASH_CACHE_ENTRY_OVERHEAD + hashes.md5.size() +
+                hashes.sha1.size() + hashes.sha256.size();
+
+  auto item = shard.index.find(entry.identity);
+  if (item != shard.index.end()) {
+    shard.bytes -= item->second->bytes;
+    *item->second = std::move(entry);
+    shard.lru.splice(shard.lru.begin(), shard.lru, item->second);
+  } else {
+    shard.lru.push_front(std::move(entry));
+    shard.index[shard.lru.front().identity] = shard.lru.begin();
+  }
+  shard.bytes += shard.lru.front().bytes;
+
+  // Evict the least recently used entries, the new entry is always kept.
+  auto max_size = FLAGS_hash_cache_max_size / kShards;
+  while (shard.bytes > max_size && shard.lru.size() > 1) {
+    const auto& last = shard.lru.back();
+    evicted.push_back(last.identity);
+    shard.bytes -= last.bytes;
+    shard.index.erase(last.identity);
+    shard.lru.pop_back();
+  }
+  return shard.lru.front();
+}
+
+void FileHashCache::restore() {
+  if (restored_) {
+    return;
+  }
+
+  WriteLock restore_lock(restore_mutex_);
+  if (restored_) {
+    return;
+  }
+  // Loads wait for the restore, which continues without a database.
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kHashes, keys);
+
+  // Entries beyond the size of the cache, or malformed, are removed.
+  std::vector<FileHashIdentity> evicted;
+  std::vector<std::string> removed;
+  for (const auto& key : keys) {
+    std::string value;
+    Entry entry;
+    if (!getDatabaseValue(kHashes, key, value) ||
+        !deserialize(key, value, entry)) {
+      removed.push_back(key);
+      continue;
+    }
+
+    auto& shard = getShard(entry.identity);
+    WriteLock lock(shard.mutex);
+    insert(shard, std::move(entry), evicted);
+  }
+
+  for (const auto& identity : evicted) {
+    removed.push_back(getKey(identity));
+  }
+  for (const auto& key : removed) {
+    deleteDatabaseValue(kHashes, key);
+  }
+  restored_ = true;
+  VLOG(1) << "Restored " << count() << " file hashes";
+}
+
+bool FileHashCache::load(const std::string& path,
+                         int mask,
+                         MultiHashes& out) {
+  restore();
+
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    char buf[0x200] = {0};
+    strerror_r(errno, buf, sizeof(buf));
+    LOG(WARNING) << "Cannot stat file: " << path << ": " << buf;
+    return false;
+  }
+
+  Entry entry;
+  if (!getIdentity(path, st, entry.identity, entry.version)) {
+    LOG(WARNING) << "Cannot identify file: " << path;
+    return false;
+  }
+  auto identity = entry.identity;
+  auto& shard = getShard(identity);
+  {
+    WriteLock lock(shard.mutex);
+    auto item = shard.index.find(identity);
+    if (item != shard.index.end() && item->second->version == entry.version) {
+      shard.lru.splice(shard.lru.begin(), shard.lru, item->second);
+      if ((item->second->hashes.mask & mask) == mask) {
+        out = item->second->hashes;
+        return true;
+      }
+      entry.hashes = item->second->hashes;
+    }
+  }
+
+  // Other files are looked up and hashed while this file is read.
+  auto missing = mask & ~entry.hashes.mask;
+  auto hashes = hashMultiFromFile(missing, path);
+  if (hashes.mask != missing) {
+    return false;
+  }
+  mergeHashes(entry.hashes, hashes);
+
+  std::string value;
+  std::vector<FileHashIdentity> evicted;
+  {
+    WriteLock lock(shard.mutex);
+    // Keep digests added by another query while this file was read.
+    auto item = shard.index.find(identity);
+    if (item != shard.index.end() && item->second->version == entry.version) {
+      mergeHashes(entry.hashes, item->second->hashes);
+    }
+
+    const auto& cached = insert(shard, std::move(entry), evicted);
+    out = cached.hashes;
+    value = serialize(cached);
+  }
+
+  // The database holds the same entries as memory.
+  setDatabaseValue(kHashes, getKey(identity), value);
+  for (const auto& evicted_identity : evicted) {
+    deleteDatabaseValue(kHashes, getKey(evicted_identity));
+  }
+  return true;
+}
+
+void FileHashCache::clear() {
+  WriteLock restore_lock(restore_mutex_);
+  restored_ = false;
+  for (auto& shard : shards_) {
+    WriteLock lock(shard.mutex);
+    shard.lru.clear();
+    shard.index.clear();
+    shard.bytes = 0;
+  }
+}
+
+size_t FileHashCache::size() const {
+  size_t bytes = 0;
+  for (const auto& shard : shards_) {
+    ReadLock lock(shard.mutex);
+    bytes += shard.bytes;
+  }
+  return bytes;
+}
+
+size_t FileHashCache::count() const {
+  size_t entries = 0;
+  for (const auto& shard : shards_) {
+    ReadLock lock(shard.mutex);
+    entries += shard.lru.size();
+  }
+  return entries;
+}
+} // namespace osquery
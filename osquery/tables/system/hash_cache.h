@@ -0,0 +1,171 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core.h>
+
+#include "osquery/tables/system/hash.h"
+
+namespace osquery {
+
+/**
+ * @brief The identity of a file's content, hard links share an identity.
+ *
+ * The device and inode, or on Windows the volume serial number and NTFS
+ * file index.
+ */
+struct FileHashIdentity {
+  uint64_t device{0};
+  uint64_t inode{0};
+
+  bool operator==(const FileHashIdentity& other) const {
+    return device == other.device && inode == other.inode;
+  }
+};
+
+/// The version of a file's content, any change invalidates the hashes.
+struct FileHashVersion {
+  /// Modification time in nanoseconds.
+  int64_t mtime{0};
+
+  /// Status change time in nanoseconds.
+  int64_t ctime{0};
+
+  uint64_t size{0};
+
+  bool operator==(const FileHashVersion& other) const {
+    return mtime == other.mtime && ctime == other.ctime && size == other.size;
+  }
+};
+
+/**
+ * @brief A persistent cache of file hashes.
+ *
+ * Entries are identified by the file's device and inode and are valid while
+ * the modification time, status change time, and size are unchanged. The
+ * cache is split into shards, each with a lock and an LRU list, and is
+ * bounded by hash_cache_max_size bytes.
+ *
+ * Entries are written through to the hashes database domain, which holds the
+ * same entries as memory. They are restored when the cache is first used, so
+ * hashes survive a restart of the worker.
+ */
+class FileHashCache : private boost::noncopyable {
+ public:
+  static FileHashCache& get();
+
+  /**
+   * @brief Return the hashes of a file, calculating those not cached.
+   *
+   * Only the digests within the mask, and missing from the cache, are
+   * calculated. The file is hashed without holding a lock.
+   *
+   * @param path the path of file to hash.
+   * @param mask the digests requested.
+   * @param out stores the calculated hashes.
+   *
+   * @return true if succeeded, false if something went wrong.
+   */
+  bool load(const std::string& path, int mask, MultiHashes& out);
+
+  /// Remove every entry from memory, the next use restores the database.
+  void clear();
+
+  /// The bytes used by entries in memory.
+  size_t size() const;
+
+  /// The number of entries in memory.
+  size_t count() const;
+
+ private:
+  FileHashCache() = default;
+
+  /// Restore the persisted entries, if not yet restored.
+  void restore();
+
+ private:
+  struct IdentityHash {
+    size_t operator()(const FileHashIdentity& id) const {
+      return std::hash<uint64_t>()(id.inode) ^
+             (std::hash<uint64_t>()(id.device) << 1);
+    }
+  };
+
+  struct Entry {
+    FileHashIdentity identity;
+    FileHashVersion version;
+    MultiHashes hashes;
+
+    /// The bytes accounted for this entry.
+    size_t bytes{0};
+  };
+
+  struct Shard {
+    /// Most recently used entries are at the front.
+    std::list<Entry> lru;
+
+    std::unordered_map<FileHashIdentity,
+                       std::list<Entry>::iterator,
+                       IdentityHash>
+        index;
+
+    size_t bytes{0};
+
+    mutable Mutex mutex;
+  };
+
+  /// The number of independently locked shards.
+  static const size_t kShards = 16;
+
+  Shard& getShard(const FileHashIdentity& identity);
+
+  /**
+   * @brief Insert or update an entry and evict old entries from its shard.
+   *
+   * @param shard the locked shard of the entry.
+   * @param entry the new content of the entry, moved into the shard.
+   * @param evicted the identities of evicted entries.
+   * @return the cached entry.
+   */
+  const Entry& insert(Shard& shard,
+                      Entry entry,
+                      std::vector<FileHashIdentity>& evicted);
+
+  /// The database key of a file identity.
+  static std::string getKey(const FileHashIdentity& identity);
+
+  /// Serialize an entry as a database value.
+  static std::string serialize(const Entry& entry);
+
+  /// Deserialize a database key and value, false if malformed.
+  static bool deserialize(const std::string& key,
+                          const std::string& value,
+                          Entry& entry);
+
+ private:
+  std::array<Shard, kShards> shards_;
+
+  /// Set when the persisted entries are restored.
+  std::atomic<bool> restored_{false};
+
+  Mutex restore_mutex_;
+};
+} // namespace osquery
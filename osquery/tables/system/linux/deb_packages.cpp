@@ -25,11 +25,30 @@ extern "C" {
 #include <osquery/system.h>
 #include <osquery/tables.h>
 
+#include "osquery/tables/system/linux/package_inventory.h"
+
 namespace osquery {
 namespace tables {
 
 static const std::string kDPKGPath{"/var/lib/dpkg"};
 
+/// An installed DEB package.
+struct DebPackage {
+  std::string name;
+  std::string version;
+  std::string source;
+  std::string size;
+  std::string arch;
+  std::string revision;
+};
+
+/// The status database and the journal of updates not yet merged into it.
+static PackageInventory<DebPackage>& getDebPackageInventory() {
+  static PackageInventory<DebPackage> inventory(
+      {kDPKGPath + "/status", kDPKGPath + "/updates"});
+  return inventory;
+}
+
 /// A comparator used to sort the packages array.
 int pkg_sorter(const void *a, const void *b) {
   const struct pkginfo *pa = *(const struct pkginfo **)a;
@@ -96,13 +115,13 @@ void dpkg_teardown(struct pkg_array *packages) {
   pop_error_context(ehflag_normaltidy);
 }
 
-const std::map<std::string, std::string> kFieldMappings = {
-    {"Package", "name"},
-    {"Version", "version"},
-    {"Installed-Size", "size"},
-    {"Architecture", "arch"},
-    {"Source", "source"},
-    {"Revision", "revision"}};
+const std::map<std::string, std::string DebPackage::*> kFieldMappings = {
+    {"Package", &DebPackage::name},
+    {"Version", &DebPackage::version},
+    {"Installed-Size", &DebPackage::size},
+    {"Architecture", &DebPackage::arch},
+    {"Source", &DebPackage::source},
+    {"Revision", &DebPackage::revision}};
 
 /**
 * @brief Field names and function references to extract information.
@@ -123,8 +142,9 @@ const struct fieldinfo fieldinfos[] = {
     {FIELD("Revision"), f_revision, w_revision, 0},
     {}};
 
-void extractDebPackageInfo(const struct pkginfo *pkg, QueryData &results) {
-  Row r;
+void extractDebPackageInfo(const struct pkginfo *pkg,
+                           std::vector<DebPackage> &packages) {
+  DebPackage package;
 
   struct varbuf vb;
   varbuf_init(&vb, 20);
@@ -144,24 +164,17 @@ void extractDebPackageInfo(const struct pkginfo *pkg, QueryData &results) {
       auto it = kFieldMappings.find(key);
       if (it != kFieldMappings.end()) {
         boost::algorithm::trim(value);
-        r[it->second] = std::move(value);
+        package.*(it->second) = std::move(value);
       }
     }
     varbuf_reset(&vb);
   }
   varbuf_destroy(&vb);
 
-  results.push_back(r);
+  packages.push_back(std::move(package));
 }
 
-QueryData genDebPackages(QueryContext &context) {
-  QueryData results;
-
-  if (!osquery::isDirectory(kDPKGPath)) {
-    TLOG << "Cannot find DPKG database: " << kDPKGPath;
-    return results;
-  }
-
+static Status readDebPackages(std::vector<DebPackage> &results) {
   auto dropper = DropPrivileges::get();
   dropper->dropTo("nobody");
 
@@ -181,6 +194,36 @@ QueryData genDebPackages(QueryContext &context) {
   }
 
   dpkg_teardown(&packages);
+  return Status(0, "OK");
+}
+
+QueryData genDebPackages(QueryContext &context) {
+  QueryData results;
+
+  if (!osquery::isDirectory(kDPKGPath)) {
+    TLOG << "Cannot find DPKG database: " << kDPKGPath;
+    return results;
+  }
+
+  // The packages are read again only if the database files changed.
+  auto packages = getDebPackageInventory().get(
+      [](const std::shared_ptr<const std::vector<DebPackage>> &,
+         std::vector<DebPackage> &loaded) { return readDebPackages(loaded); });
+  if (packages == nullptr) {
+    return results;
+  }
+
+  selectPackages(*packages, context, "name", [&results](const DebPackage &p) {
+    Row r;
+    r["name"] = p.name;
+    r["version"] = p.version;
+    r["source"] = p.source;
+    r["size"] = p.size;
+    r["arch"] = p.arch;
+    r["revision"] = p.revision;
+    results.push_back(std::move(r));
+  });
+
   return results;
 }
 }
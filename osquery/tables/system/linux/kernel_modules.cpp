@@ -24,19 +24,17 @@ namespace tables {
 
 static const std::string kKernelModulePath = "/proc/modules";
 
-QueryData genKernelModules(QueryContext& context) {
-  QueryData results;
-
+void genKernelModules(RowYield& yield, QueryContext& context) {
   if (!pathExists(kKernelModulePath).ok()) {
     VLOG(1) << "Cannot find kernel modules proc file: " << kKernelModulePath;
-    return {};
+    return;
   }
 
   // Cannot seek to the end of procfs.
   std::ifstream fd(kKernelModulePath, std::ios::in);
   if (!fd) {
     VLOG(1) << "Cannot read kernel modules from: " << kKernelModulePath;
-    return {};
+    return;
   }
 
   auto module_info = std::string(std::istreambuf_iterator<char>(fd),
@@ -63,10 +61,8 @@ QueryData genKernelModules(QueryContext& context) {
     r["used_by"] = details[3];
     r["status"] = details[4];
     r["address"] = details[5];
-    results.push_back(r);
+    yield(r);
   }
-
-  return results;
 }
 }
 }
@@ -690,8 +690,7 @@ QueryData genMDDrives(QueryContext& context) {
   return results;
 }
 
-QueryData genMDDevices(QueryContext& context) {
-  QueryData results;
+void genMDDevices(RowYield& yield, QueryContext& context) {
   MDStat mds;
   MD md;
   std::vector<std::string> lines;
@@ -703,12 +702,12 @@ QueryData genMDDevices(QueryContext& context) {
     std::string path(md.getPathByDevName(device.name));
     if (path.empty()) {
       LOG(ERROR) << "Could not get file path for " << device.name;
-      return results;
+      return;
     }
 
     mdu_array_info_t array;
     if (!md.getArrayInfo(path, array)) {
-      return results;
+      return;
     }
 
     Row r;
@@ -761,10 +760,8 @@ QueryData genMDDevices(QueryContext& context) {
     r["other"] = device.other;
     r["unused_devices"] = mds.unused;
 
-    results.push_back(r);
+    yield(r);
   }
-
-  return results;
 }
 
 QueryData genMDPersonalities(QueryContext& context) {
@@ -0,0 +1,45 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <sys/stat.h>
+
+#include "osquery/tables/system/linux/package_inventory.h"
+
+namespace osquery {
+namespace tables {
+
+/// Nanoseconds since the epoch of a stat timestamp.
+static long long getTimespecNanoseconds(const struct timespec& time) {
+  return static_cast<long long>(time.tv_sec) * 1000000000LL + time.tv_nsec;
+}
+
+std::vector<InventorySource> getInventorySources(
+    const std::vector<std::string>& paths) {
+  std::vector<InventorySource> sources;
+  sources.reserve(paths.size());
+  for (const auto& path : paths) {
+    InventorySource source;
+    source.path = path;
+
+    struct stat file_stat;
+    if (stat(path.c_str(), &file_stat) == 0) {
+      source.exists = true;
+      source.device = file_stat.st_dev;
+      source.inode = file_stat.st_ino;
+      source.mtime = getTimespecNanoseconds(file_stat.st_mtim);
+      source.ctime = getTimespecNanoseconds(file_stat.st_ctim);
+      source.size = file_stat.st_size;
+    }
+    sources.push_back(std::move(source));
+  }
+  return sources;
+}
+} // namespace tables
+} // namespace osquery
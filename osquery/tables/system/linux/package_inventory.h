@@ -0,0 +1,223 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/core.h>
+#include <osquery/logger.h>
+#include <osquery/tables.h>
+
+namespace osquery {
+namespace tables {
+
+/// The identity and version of a file a package database is read from.
+struct InventorySource {
+  std::string path;
+  bool exists{false};
+  unsigned long long device{0};
+  unsigned long long inode{0};
+  long long mtime{0};
+  long long ctime{0};
+  long long size{0};
+
+  bool operator==(const InventorySource& other) const {
+    return path == other.path && exists == other.exists &&
+           device == other.device && inode == other.inode &&
+           mtime == other.mtime && ctime == other.ctime && size == other.size;
+  }
+
+  bool operator!=(const InventorySource& other) const {
+    return !(*this == other);
+  }
+};
+
+/**
+ * @brief Stat each path of a package database.
+ *
+ * Missing paths are kept, so a database that appears or moves is a change.
+ * Modification times are compared in nanoseconds.
+ */
+std::vector<InventorySource> getInventorySources(
+    const std::vector<std::string>& paths);
+
+/**
+ * @brief The packages of a database, kept while its files are unchanged.
+ *
+ * Reading an RPM or dpkg database costs far more than the rows it returns,
+ * and both change only when packages are installed or removed. An inventory
+ * keeps the packages read by a table, as typed records sorted by name, with
+ * the version of each file the database is read from. Queries are served
+ * from memory until any of those files changes.
+ *
+ * A Package is a record with a `name` member.
+ */
+template <typename Package>
+class PackageInventory : private boost::noncopyable {
+ public:
+  using Packages = std::vector<Package>;
+
+  /**
+   * @brief Read every package of the database.
+   *
+   * The previous packages, which may be nullptr, are passed for a
+   * differential refresh. Packages are not kept if reading fails.
+   */
+  using Loader = std::function<Status(
+      const std::shared_ptr<const Packages>& previous, Packages& packages)>;
+
+  explicit PackageInventory(std::vector<std::string> paths)
+      : paths_(std::move(paths)) {}
+
+  /// The files the database is read from.
+  const std::vector<std::string>& paths() const {
+    return paths_;
+  }
+
+  /**
+   * @brief Return the packages if no file changed since they were read.
+   *
+   * If none of the files exist the database is elsewhere, for example a
+   * custom dbpath, and changes cannot be seen. It is read every time.
+   */
+  std::shared_ptr<const Packages> find(
+      const std::vector<InventorySource>& sources) const {
+    if (std::none_of(
+            sources.begin(), sources.end(), [](const InventorySource& source) {
+              return source.exists;
+            })) {
+      return nullptr;
+    }
+
+    ReadLock lock(mutex_);
+    if (packages_ != nullptr && sources == sources_) {
+      return packages_;
+    }
+    return nullptr;
+  }
+
+  /// Return the last packages read, even if the database changed since.
+  std::shared_ptr<const Packages> previous() const {
+    ReadLock lock(mutex_);
+    return packages_;
+  }
+
+  /**
+   * @brief Keep packages read from the database.
+   *
+   * The sources must be collected before the database is read. If the
+   * database changes while it is read the next find is a miss.
+   *
+   * @return the kept packages, sorted by name.
+   */
+  std::shared_ptr<const Packages> store(std::vector<InventorySource> sources,
+                                        Packages packages) {
+    std::stable_sort(
+        packages.begin(),
+        packages.end(),
+        [](const Package& a, const Package& b) { return a.name < b.name; });
+
+    auto stored = std::make_shared<const Packages>(std::move(packages));
+    WriteLock lock(mutex_);
+    sources_ = std::move(sources);
+    packages_ = stored;
+    return stored;
+  }
+
+  /**
+   * @brief Return the packages, reading the database if any file changed.
+   *
+   * Concurrent callers wait for a single read of the database.
+   *
+   * @return the packages, or nullptr if the database could not be read.
+   */
+  std::shared_ptr<const Packages> get(const Loader& loader) {
+    auto sources = getInventorySources(paths_);
+    auto packages = find(sources);
+    if (packages != nullptr) {
+      return packages;
+    }
+
+    WriteLock load_lock(load_mutex_);
+    sources = getInventorySources(paths_);
+    packages = find(sources);
+    if (packages != nullptr) {
+      return packages;
+    }
+
+    Packages loaded;
+    auto status = loader(previous(), loaded);
+    if (!status.ok()) {
+      VLOG(1) << "Cannot read package database: " << status.getMessage();
+      return nullptr;
+    }
+
+    return store(std::move(sources), std::move(loaded));
+  }
+
+  /// Drop the packages, the next get reads the database.
+  void clear() {
+    WriteLock lock(mutex_);
+    sources_.clear();
+    packages_ = nullptr;
+  }
+
+ private:
+  /// The files the database is read from.
+  std::vector<std::string> paths_;
+
+  /// The version of each file when the packages were read.
+  std::vector<InventorySource> sources_;
+
+  /// Packages sorted by name.
+  std::shared_ptr<const Packages> packages_{nullptr};
+
+  /// Protects the sources and packages.
+  mutable Mutex mutex_;
+
+  /// Serializes reads of the database.
+  Mutex load_mutex_;
+};
+
+/**
+ * @brief Call a function for each package a query may select.
+ *
+ * If the column is constrained with EQUALS only packages with those names
+ * are visited, found by binary search of the packages sorted by name.
+ */
+template <typename Package, typename Function>
+void selectPackages(const std::vector<Package>& packages,
+                    const QueryContext& context,
+                    const std::string& column,
+                    Function func) {
+  if (!context.hasConstraint(column, EQUALS)) {
+    std::for_each(packages.begin(), packages.end(), func);
+    return;
+  }
+
+  auto less = [](const Package& package, const std::string& name) {
+    return package.name < name;
+  };
+  for (const auto& name : context.constraints.at(column).getAll(EQUALS)) {
+    auto it = std::lower_bound(packages.begin(), packages.end(), name, less);
+    for (; it != packages.end() && it->name == name; ++it) {
+      func(*it);
+    }
+  }
+}
+} // namespace tables
+} // namespace osquery
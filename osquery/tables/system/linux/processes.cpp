@@ -26,6 +26,7 @@
 #include <osquery/tables.h>
 
 #include "osquery/core/conversions.h"
+#include "osquery/filesystem/linux/proc.h"
 
 namespace osquery {
 namespace tables {
@@ -35,37 +36,6 @@ inline std::string getProcAttr(const std::string& attr,
   return "/proc/" + pid + "/" + attr;
 }
 
-inline std::string readProcCMDLine(const std::string& pid) {
-  auto attr = getProcAttr("cmdline", pid);
-
-  std::string content;
-  readFile(attr, content);
-  // Remove \0 delimiters.
-  std::replace_if(content.begin(),
-                  content.end(),
-                  [](const char& c) { return c == 0; },
-                  ' ');
-  // Remove trailing delimiter.
-  boost::algorithm::trim(content);
-  return content;
-}
-
-inline std::string readProcLink(const std::string& attr,
-                                const std::string& pid) {
-  // The exe is a symlink to the binary on-disk.
-  auto attr_path = getProcAttr(attr, pid);
-  char full_path[PATH_MAX] = {0};
-
-  char* link_path = realpath(attr_path.c_str(), full_path);
-  if (link_path != nullptr) {
-    return std::string(link_path);
-  } else if (attr_path.compare(std::string(full_path)) != 0) {
-    return std::string(full_path);
-  }
-
-  return "";
-}
-
 // In the case where the linked binary path ends in " (deleted)", and a file
 // actually exists at that path, check whether the inode of that file matches
 // the inode of the mapped file in /proc/%pid/maps
@@ -99,27 +69,27 @@ Status deletedMatchesInode(const std::string& path, const std::string& pid) {
   }
 }
 
-std::set<std::string> getProcList(const QueryContext& context) {
-  std::set<std::string> pidlist;
+std::set<std::string> getProcList(const QueryContext& context,
+                                  ProcessSnapshot& snapshot) {
   if (context.constraints.count("pid") > 0 &&
       context.constraints.at("pid").exists(EQUALS)) {
+    std::set<std::string> pidlist;
     for (const auto& pid : context.constraints.at("pid").getAll(EQUALS)) {
-      if (isDirectory("/proc/" + pid)) {
+      if (snapshot.exists(pid)) {
         pidlist.insert(pid);
       }
     }
-  } else {
-    osquery::procProcesses(pidlist);
+    return pidlist;
   }
 
-  return pidlist;
+  return snapshot.pids();
 }
 
-void genProcessEnvironment(const std::string& pid, QueryData& results) {
-  auto attr = getProcAttr("environ", pid);
-
+void genProcessEnvironment(ProcessSnapshot& snapshot,
+                           const std::string& pid,
+                           RowYield& yield) {
   std::string content;
-  readFile(attr, content);
+  snapshot.read(pid, "environ", content);
   const char* variable = content.c_str();
 
   // Stop at the end of nul-delimited string content.
@@ -131,16 +101,16 @@ void genProcessEnvironment(const std::string& pid, QueryData& results) {
     r["pid"] = pid;
     r["key"] = buf.substr(0, idx);
     r["value"] = buf.substr(idx + 1);
-    results.push_back(r);
+    yield(r);
     variable += buf.size() + 1;
   }
 }
 
-void genProcessMap(const std::string& pid, QueryData& results) {
-  auto map = getProcAttr("maps", pid);
-
+void genProcessMap(ProcessSnapshot& snapshot,
+                   const std::string& pid,
+                   RowYield& yield) {
   std::string content;
-  readFile(map, content);
+  snapshot.read(pid, "maps", content);
   for (auto& line : osquery::split(content, "\n")) {
     auto fields = osquery::split(line, " ");
     // If can't read address, not sure.
@@ -181,110 +151,13 @@ void genProcessMap(const std::string& pid, QueryData& results) {
 
     // BSS with name in pathname.
     r["pseudo"] = (fields[4] == "0" && !r["path"].empty()) ? "1" : "0";
-    results.push_back(std::move(r));
+    yield(r);
   }
 }
 
-/**
- *  Output from string parsing /proc/<pid>/status.
- */
-struct SimpleProcStat : private boost::noncopyable {
- public:
-  std::string name;
-  std::string real_uid;
-  std::string real_gid;
-  std::string effective_uid;
-  std::string effective_gid;
-  std::string saved_uid;
-  std::string saved_gid;
-  std::string resident_size;
-  std::string total_size;
-  std::string state;
-  std::string parent;
-  std::string group;
-  std::string nice;
-  std::string threads;
-  std::string user_time;
-  std::string system_time;
-  std::string start_time;
-
-  /// For errors processing proc data.
-  Status status;
-
-  explicit SimpleProcStat(const std::string& pid);
-};
-
-SimpleProcStat::SimpleProcStat(const std::string& pid) {
-  std::string content;
-  if (readFile(getProcAttr("stat", pid), content).ok()) {
-    auto start = content.find_last_of(")");
-    // Start parsing stats from ") <MODE>..."
-    if (start == std::string::npos || content.size() <= start + 2) {
-      status = Status(1, "Invalid /proc/stat header");
-      return;
-    }
-
-    auto details = osquery::split(content.substr(start + 2), " ");
-    if (details.size() <= 19) {
-      status = Status(1, "Invalid /proc/stat content");
-      return;
-    }
-
-    this->state = details.at(0);
-    this->parent = details.at(1);
-    this->group = details.at(2);
-    this->user_time = details.at(11);
-    this->system_time = details.at(12);
-    this->nice = details.at(16);
-    this->threads = details.at(17);
-    try {
-      this->start_time = TEXT(AS_LITERAL(BIGINT_LITERAL, details.at(19)) / 100);
-    } catch (const boost::bad_lexical_cast& e) {
-      this->start_time = "-1";
-    }
-  }
-
-  // /proc/N/status may be not available, or readable by this user.
-  if (!readFile(getProcAttr("status", pid), content).ok()) {
-    status = Status(1, "Cannot read /proc/status");
-    return;
-  }
-
-  for (const auto& line : osquery::split(content, "\n")) {
-    // Status lines are formatted: Key: Value....\n.
-    auto detail = osquery::split(line, ":", 1);
-    if (detail.size() != 2) {
-      continue;
-    }
-
-    // There are specific fields from each detail.
-    if (detail.at(0) == "Name") {
-      this->name = detail.at(1);
-    } else if (detail.at(0) == "VmRSS") {
-      detail[1].erase(detail.at(1).end() - 3, detail.at(1).end());
-      // Memory is reported in kB.
-      this->resident_size = detail.at(1) + "000";
-    } else if (detail.at(0) == "VmSize") {
-      detail[1].erase(detail.at(1).end() - 3, detail.at(1).end());
-      // Memory is reported in kB.
-      this->total_size = detail.at(1) + "000";
-    } else if (detail.at(0) == "Gid") {
-      // Format is: R E - -
-      auto gid_detail = osquery::split(detail.at(1), "\t");
-      if (gid_detail.size() == 4) {
-        this->real_gid = gid_detail.at(0);
-        this->effective_gid = gid_detail.at(1);
-        this->saved_gid = gid_detail.at(2);
-      }
-    } else if (detail.at(0) == "Uid") {
-      auto uid_detail = osquery::split(detail.at(1), "\t");
-      if (uid_detail.size() == 4) {
-        this->real_uid = uid_detail.at(0);
-        this->effective_uid = uid_detail.at(1);
-        this->saved_uid = uid_detail.at(2);
-      }
-    }
-  }
+/// Format a /proc/<pid>/status value, empty if it was not reported.
+inline std::string getStatusValue(int64_t value, int64_t scale = 1) {
+  return (value < 0) ? "" : BIGINT(value * scale);
 }
 
 /**
@@ -339,46 +212,79 @@ int getOnDisk(const std::string& pid, std::string& path) {
   }
 }
 
-void genProcess(const std::string& pid, QueryData& results) {
-  // Parse the process stat and status.
-  SimpleProcStat proc_stat(pid);
-
-  if (!proc_stat.status.ok()) {
-    VLOG(1) << proc_stat.status.getMessage() << " for pid " << pid;
+void genProcess(ProcessSnapshot& snapshot,
+                const std::string& pid,
+                const QueryContext& context,
+                QueryData& results) {
+  // Parse the process stat, and the status if its columns are used.
+  ProcStat proc_stat;
+  auto status = snapshot.stat(pid, proc_stat);
+  if (!status.ok()) {
+    VLOG(1) << status.getMessage() << " for pid " << pid;
     return;
   }
 
   Row r;
   r["pid"] = pid;
-  r["parent"] = proc_stat.parent;
-  r["path"] = readProcLink("exe", pid);
-  r["name"] = proc_stat.name;
-  r["pgroup"] = proc_stat.group;
-  r["state"] = proc_stat.state;
-  r["nice"] = proc_stat.nice;
-  r["threads"] = proc_stat.threads;
+  r["parent"] = BIGINT(proc_stat.parent);
+  r["pgroup"] = BIGINT(proc_stat.group);
+  r["state"] = std::string(1, proc_stat.state);
+  r["nice"] = BIGINT(proc_stat.nice);
+  r["threads"] = BIGINT(proc_stat.threads);
+
+  if (context.isAnyColumnUsed({"name",
+                               "uid",
+                               "euid",
+                               "suid",
+                               "gid",
+                               "egid",
+                               "sgid",
+                               "resident_size",
+                               "total_size"})) {
+    ProcStatus proc_status;
+    status = snapshot.status(pid, proc_status);
+    if (!status.ok()) {
+      VLOG(1) << status.getMessage() << " for pid " << pid;
+      return;
+    }
+
+    r["name"] = proc_status.name;
+    r["uid"] = getStatusValue(proc_status.real_uid);
+    r["euid"] = getStatusValue(proc_status.effective_uid);
+    r["suid"] = getStatusValue(proc_status.saved_uid);
+    r["gid"] = getStatusValue(proc_status.real_gid);
+    r["egid"] = getStatusValue(proc_status.effective_gid);
+    r["sgid"] = getStatusValue(proc_status.saved_gid);
+
+    // Memory is reported in kB.
+    r["resident_size"] = getStatusValue(proc_status.resident_size, 1000);
+    r["total_size"] = getStatusValue(proc_status.total_size, 1000);
+  }
+
+  if (context.isAnyColumnUsed({"path", "on_disk"})) {
+    // The exe is a symlink to the binary on-disk.
+    r["path"] = snapshot.link(pid, "exe");
+    r["on_disk"] = INTEGER(getOnDisk(pid, r["path"]));
+  }
+
   // Read/parse cmdline arguments.
-  r["cmdline"] = readProcCMDLine(pid);
-  r["cwd"] = readProcLink("cwd", pid);
-  r["root"] = readProcLink("root", pid);
-  r["uid"] = proc_stat.real_uid;
-  r["euid"] = proc_stat.effective_uid;
-  r["suid"] = proc_stat.saved_uid;
-  r["gid"] = proc_stat.real_gid;
-  r["egid"] = proc_stat.effective_gid;
-  r["sgid"] = proc_stat.saved_gid;
-
-  r["on_disk"] = INTEGER(getOnDisk(pid, r["path"]));
+  if (context.isColumnUsed("cmdline")) {
+    r["cmdline"] = snapshot.cmdline(pid);
+  }
+  if (context.isColumnUsed("cwd")) {
+    r["cwd"] = snapshot.link(pid, "cwd");
+  }
+  if (context.isColumnUsed("root")) {
+    r["root"] = snapshot.link(pid, "root");
+  }
 
   // size/memory information
   r["wired_size"] = "0"; // No support for unpagable counters in linux.
-  r["resident_size"] = proc_stat.resident_size;
-  r["total_size"] = proc_stat.total_size;
 
   // time information
-  r["user_time"] = proc_stat.user_time;
-  r["system_time"] = proc_stat.system_time;
-  r["start_time"] = proc_stat.start_time;
+  r["user_time"] = BIGINT(proc_stat.user_time);
+  r["system_time"] = BIGINT(proc_stat.system_time);
+  r["start_time"] = BIGINT(proc_stat.start_time / 100);
 
   results.push_back(r);
 }
@@ -386,34 +292,29 @@ void genProcess(const std::string& pid, QueryData& results) {
 QueryData genProcesses(QueryContext& context) {
   QueryData results;
 
-  auto pidlist = getProcList(context);
+  auto snapshot = ProcessSnapshot::get();
+  auto pidlist = getProcList(context, *snapshot);
   for (const auto& pid : pidlist) {
-    genProcess(pid, results);
+    genProcess(*snapshot, pid, context, results);
   }
 
   return results;
 }
 
-QueryData genProcessEnvs(QueryContext& context) {
-  QueryData results;
-
-  auto pidlist = getProcList(context);
+void genProcessEnvs(RowYield& yield, QueryContext& context) {
+  auto snapshot = ProcessSnapshot::get();
+  auto pidlist = getProcList(context, *snapshot);
   for (const auto& pid : pidlist) {
-    genProcessEnvironment(pid, results);
+    genProcessEnvironment(*snapshot, pid, yield);
   }
-
-  return results;
 }
 
-QueryData genProcessMemoryMap(QueryContext& context) {
-  QueryData results;
-
-  auto pidlist = getProcList(context);
+void genProcessMemoryMap(RowYield& yield, QueryContext& context) {
+  auto snapshot = ProcessSnapshot::get();
+  auto pidlist = getProcList(context, *snapshot);
   for (const auto& pid : pidlist) {
-    genProcessMap(pid, results);
+    genProcessMap(*snapshot, pid, yield);
   }
-
-  return results;
 }
 }
 }
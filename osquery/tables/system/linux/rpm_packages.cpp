@@ -16,21 +16,87 @@
 #include <rpm/rpmpgp.h>
 #include <rpm/rpmts.h>
 
+#include <unordered_map>
+
 #include <boost/noncopyable.hpp>
 
 #include <osquery/filesystem.h>
+#include <osquery/flags.h>
 #include <osquery/logger.h>
 #include <osquery/system.h>
 #include <osquery/tables.h>
 
 #include "osquery/core/process.h"
+#include "osquery/tables/system/linux/package_inventory.h"
 
 namespace osquery {
+
+FLAG(uint64,
+     rpm_package_files_cache_size,
+     32 * 1024 * 1024,
+     "Bytes of rpm_package_files rows kept in memory (default 32MB)");
+
 namespace tables {
 
 // Maximum number of files per RPM.
 #define MAX_RPM_FILES (64 * 1024)
 
+/// Files the RPM database is read from, for each backend and location.
+const std::vector<std::string> kRpmDatabasePaths = {
+    "/var/lib/rpm/Packages",
+    "/var/lib/rpm/Packages.db",
+    "/var/lib/rpm/rpmdb.sqlite",
+    "/var/lib/rpm/rpmdb.sqlite-wal",
+    "/usr/lib/sysimage/rpm/Packages",
+    "/usr/lib/sysimage/rpm/Packages.db",
+    "/usr/lib/sysimage/rpm/rpmdb.sqlite",
+    "/usr/lib/sysimage/rpm/rpmdb.sqlite-wal",
+};
+
+/// An installed RPM package.
+struct RpmPackage {
+  std::string name;
+  std::string version;
+  std::string release;
+  std::string source;
+  std::string size;
+  std::string sha1;
+  std::string arch;
+};
+
+/// A file installed by an RPM package.
+struct RpmPackageFile {
+  std::string path;
+  std::string username;
+  std::string groupname;
+  std::string mode;
+  long long size{0};
+  std::string sha256;
+};
+
+using RpmPackageFileList = std::vector<RpmPackageFile>;
+
+/// The files of an installed RPM package.
+struct RpmPackageFiles {
+  std::string name;
+
+  /// The SHA1 of the package header, which identifies an installed version.
+  std::string header;
+
+  /// Files are shared with the next inventory if the package is unchanged.
+  std::shared_ptr<const RpmPackageFileList> files;
+};
+
+static PackageInventory<RpmPackage>& getRpmPackageInventory() {
+  static PackageInventory<RpmPackage> inventory(kRpmDatabasePaths);
+  return inventory;
+}
+
+static PackageInventory<RpmPackageFiles>& getRpmFilesInventory() {
+  static PackageInventory<RpmPackageFiles> inventory(kRpmDatabasePaths);
+  return inventory;
+}
+
 /**
  * @brief Return a string representation of the RPM tag type.
  *
@@ -111,13 +177,10 @@ class RpmEnvironmentManager : public boost::noncopyable {
   rpmlogCallback callback_{nullptr};
 };
 
-QueryData genRpmPackages(QueryContext& context) {
-  QueryData results;
-
+static Status readRpmPackages(std::vector<RpmPackage>& packages) {
   auto dropper = DropPrivileges::get();
   if (!dropper->dropTo("nobody") && isUserAdmin()) {
-    LOG(WARNING) << "Cannot drop privileges for rpm_packages";
-    return results;
+    return Status(1, "Cannot drop privileges for rpm_packages");
   }
 
   // Isolate RPM/package inspection to the canonical: /usr/lib/rpm.
@@ -126,33 +189,27 @@ QueryData genRpmPackages(QueryContext& context) {
   // The following implementation uses http://rpm.org/api/4.11.1/
   rpmInitCrypto();
   if (rpmReadConfigFiles(nullptr, nullptr) != 0) {
-    TLOG << "Cannot read RPM configuration files";
-    return results;
+    rpmFreeCrypto();
+    return Status(1, "Cannot read RPM configuration files");
   }
 
   rpmts ts = rpmtsCreate();
-  rpmdbMatchIterator matches;
-  if (context.constraints["name"].exists(EQUALS)) {
-    auto name = (*context.constraints["name"].getAll(EQUALS).begin());
-    matches = rpmtsInitIterator(ts, RPMTAG_NAME, name.c_str(), name.size());
-  } else {
-    matches = rpmtsInitIterator(ts, RPMTAG_NAME, nullptr, 0);
-  }
+  auto matches = rpmtsInitIterator(ts, RPMTAG_NAME, nullptr, 0);
 
   Header header;
   while ((header = rpmdbNextIterator(matches)) != nullptr) {
-    Row r;
+    RpmPackage package;
     rpmtd td = rpmtdNew();
-    r["name"] = getRpmAttribute(header, RPMTAG_NAME, td);
-    r["version"] = getRpmAttribute(header, RPMTAG_VERSION, td);
-    r["release"] = getRpmAttribute(header, RPMTAG_RELEASE, td);
-    r["source"] = getRpmAttribute(header, RPMTAG_SOURCERPM, td);
-    r["size"] = getRpmAttribute(header, RPMTAG_SIZE, td);
-    r["sha1"] = getRpmAttribute(header, RPMTAG_SHA1HEADER, td);
-    r["arch"] = getRpmAttribute(header, RPMTAG_ARCH, td);
+    package.name = getRpmAttribute(header, RPMTAG_NAME, td);
+    package.version = getRpmAttribute(header, RPMTAG_VERSION, td);
+    package.release = getRpmAttribute(header, RPMTAG_RELEASE, td);
+    package.source = getRpmAttribute(header, RPMTAG_SOURCERPM, td);
+    package.size = getRpmAttribute(header, RPMTAG_SIZE, td);
+    package.sha1 = getRpmAttribute(header, RPMTAG_SHA1HEADER, td);
+    package.arch = getRpmAttribute(header, RPMTAG_ARCH, td);
 
     rpmtdFree(td);
-    results.push_back(r);
+    packages.push_back(std::move(package));
   }
 
   rpmdbFreeIterator(matches);
@@ -160,10 +217,121 @@ QueryData genRpmPackages(QueryContext& context) {
   rpmFreeCrypto();
   rpmFreeRpmrc();
 
+  return Status(0, "OK");
+}
+
+QueryData genRpmPackages(QueryContext& context) {
+  QueryData results;
+
+  // The packages are read again only if the database files changed.
+  auto packages = getRpmPackageInventory().get(
+      [](const std::shared_ptr<const std::vector<RpmPackage>>&,
+         std::vector<RpmPackage>& loaded) { return readRpmPackages(loaded); });
+  if (packages == nullptr) {
+    LOG(WARNING) << "Cannot read the RPM database for rpm_packages";
+    return results;
+  }
+
+  selectPackages(*packages, context, "name", [&results](const RpmPackage& p) {
+    Row r;
+    r["name"] = p.name;
+    r["version"] = p.version;
+    r["release"] = p.release;
+    r["source"] = p.source;
+    r["size"] = p.size;
+    r["sha1"] = p.sha1;
+    r["arch"] = p.arch;
+    results.push_back(std::move(r));
+  });
+
   return results;
 }
 
+/// Read the files of a package from its header.
+static std::shared_ptr<const RpmPackageFileList> readRpmPackageFiles(
+    rpmts ts, Header header, const std::string& package_name) {
+  auto files = std::make_shared<RpmPackageFileList>();
+  rpmfi fi = rpmfiNew(ts, header, RPMTAG_BASENAMES, RPMFI_NOHEADER);
+
+  auto file_count = rpmfiFC(fi);
+  if (file_count <= 0) {
+    VLOG(1) << "RPM package " << package_name << " contains 0 files";
+    rpmfiFree(fi);
+    return files;
+  } else if (file_count > MAX_RPM_FILES) {
+    VLOG(1) << "RPM package " << package_name << " contains over "
+            << MAX_RPM_FILES << " files";
+    rpmfiFree(fi);
+    return files;
+  }
+
+  // Iterate over every file in this package.
+  files->reserve(file_count);
+  for (int i = 0; rpmfiNext(fi) >= 0 && i < file_count; i++) {
+    RpmPackageFile file;
+    auto path = rpmfiFN(fi);
+    file.path = (path != nullptr) ? path : "";
+    auto username = rpmfiFUser(fi);
+    file.username = (username != nullptr) ? username : "";
+    auto groupname = rpmfiFGroup(fi);
+    file.groupname = (groupname != nullptr) ? groupname : "";
+    file.mode = lsperms(rpmfiFMode(fi));
+    file.size = rpmfiFSize(fi);
+
+    int digest_algo;
+    auto digest = rpmfiFDigestHex(fi, &digest_algo);
+    if (digest_algo == PGPHASHALGO_SHA256 && digest != nullptr) {
+      file.sha256 = digest;
+    }
+    free(digest);
+
+    files->push_back(std::move(file));
+  }
+
+  rpmfiFree(fi);
+  return files;
+}
+
+/// Approximate bytes of memory used by the files of a package.
+static size_t getRpmPackageFilesSize(const RpmPackageFiles& package) {
+  size_t size = sizeof(package) + package.name.capacity() +
+                package.header.capacity();
+  for (const auto& file : *package.files) {
+    size += sizeof(file) + file.path.capacity() + file.username.capacity() +
+            file.groupname.capacity() + file.mode.capacity() +
+            file.sha256.capacity();
+  }
+  return size;
+}
+
+static void yieldRpmPackageFiles(const RpmPackageFiles& package,
+                                 RowYield& yield) {
+  for (const auto& file : *package.files) {
+    Row r;
+    r["package"] = package.name;
+    r["path"] = file.path;
+    r["username"] = file.username;
+    r["groupname"] = file.groupname;
+    r["mode"] = file.mode;
+    r["size"] = BIGINT(file.size);
+    r["sha256"] = file.sha256;
+    yield(r);
+  }
+}
+
 void genRpmPackageFiles(RowYield& yield, QueryContext& context) {
+  // Serve the rows of the last full scan if the database files are unchanged.
+  auto& inventory = getRpmFilesInventory();
+  auto sources = getInventorySources(inventory.paths());
+  auto cached = inventory.find(sources);
+  if (cached != nullptr) {
+    selectPackages(
+        *cached, context, "package", [&yield](const RpmPackageFiles& package) {
+          yieldRpmPackageFiles(package, yield);
+        });
+    return;
+  }
+
   auto dropper = DropPrivileges::get();
   if (!dropper->dropTo("nobody") && isUserAdmin()) {
     LOG(WARNING) << "Cannot drop privileges for rpm_package_files";
@@ -180,60 +348,66 @@ void genRpmPackageFiles(RowYield& yield, QueryContext& context) {
 
   rpmts ts = rpmtsCreate();
   rpmdbMatchIterator matches;
-  if (context.constraints["package"].exists(EQUALS)) {
+  bool scan = !context.constraints["package"].exists(EQUALS);
+  if (!scan) {
     auto name = (*context.constraints["package"].getAll(EQUALS).begin());
     matches = rpmtsInitIterator(ts, RPMTAG_NAME, name.c_str(), name.size());
   } else {
     matches = rpmtsInitIterator(ts, RPMTAG_NAME, nullptr, 0);
   }
 
+  // A full scan expands only the packages whose header changed since the
+  // last scan, and keeps its rows if they fit in the cache size.
+  std::unordered_map<std::string, std::shared_ptr<const RpmPackageFileList>>
+      previous_files;
+  auto previous = inventory.previous();
+  if (scan && previous != nullptr) {
+    for (const auto& package : *previous) {
+      if (!package.header.empty()) {
+        previous_files[package.header] = package.files;
+      }
+    }
+  }
+
+  bool keep = scan && FLAGS_rpm_package_files_cache_size > 0;
+  size_t kept_size = 0;
+  std::vector<RpmPackageFiles> packages;
+
   Header header;
   while ((header = rpmdbNextIterator(matches)) != nullptr) {
+    RpmPackageFiles package;
     rpmtd td = rpmtdNew();
-    rpmfi fi = rpmfiNew(ts, header, RPMTAG_BASENAMES, RPMFI_NOHEADER);
-    std::string package_name = getRpmAttribute(header, RPMTAG_NAME, td);
-
-    auto file_count = rpmfiFC(fi);
-    if (file_count <= 0) {
-      VLOG(1) << "RPM package " << package_name << " contains 0 files";
-      rpmfiFree(fi);
-      continue;
-    } else if (file_count > MAX_RPM_FILES) {
-      VLOG(1) << "RPM package " << package_name << " contains over "
-              << MAX_RPM_FILES << " files";
-      rpmfiFree(fi);
-      continue;
-    }
+    package.name = getRpmAttribute(header, RPMTAG_NAME, td);
+    package.header = getRpmAttribute(header, RPMTAG_SHA1HEADER, td);
+    rpmtdFree(td);
 
-    // Iterate over every file in this package.
-    for (size_t i = 0; rpmfiNext(fi) >= 0 && i < file_count; i++) {
-      Row r;
-      auto path = rpmfiFN(fi);
-      r["package"] = package_name;
-      r["path"] = (path != nullptr) ? path : "";
-      auto username = rpmfiFUser(fi);
-      r["username"] = (username != nullptr) ? username : "";
-      auto groupname = rpmfiFGroup(fi);
-      r["groupname"] = (groupname != nullptr) ? groupname : "";
-      r["mode"] = lsperms(rpmfiFMode(fi));
-      r["size"] = BIGINT(rpmfiFSize(fi));
-
-      int digest_algo;
-      auto digest = rpmfiFDigestHex(fi, &digest_algo);
-      if (digest_algo == PGPHASHALGO_SHA256) {
-        r["sha256"] = (digest != nullptr) ? digest : "";
+    auto files = previous_files.find(package.header);
+    if (files != previous_files.end()) {
+      package.files = files->second;
+    } else {
+      package.files = readRpmPackageFiles(ts, header, package.name);
+    }
+    yieldRpmPackageFiles(package, yield);
+
+    if (keep) {
+      kept_size += getRpmPackageFilesSize(package);
+      if (kept_size > FLAGS_rpm_package_files_cache_size) {
+        VLOG(1) << "RPM package files exceed the rpm_package_files cache";
+        keep = false;
+        packages.clear();
+      } else {
+        packages.push_back(std::move(package));
       }
-
-      yield(r);
     }
-
-    rpmfiFree(fi);
-    rpmtdFree(td);
   }
 
   rpmdbFreeIterator(matches);
   rpmtsFree(ts);
   rpmFreeRpmrc();
+
+  if (keep) {
+    inventory.store(std::move(sources), std::move(packages));
+  }
 }
 }
 }
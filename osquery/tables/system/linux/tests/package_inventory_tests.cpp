@@ -0,0 +1,156 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+#include <boost/filesystem.hpp>
+
+#include "osquery/tables/system/linux/package_inventory.h"
+#include "osquery/tests/test_util.h"
+
+namespace fs = boost::filesystem;
+
+namespace osquery {
+namespace tables {
+
+struct TestPackage {
+  std::string name;
+  std::string version;
+};
+
+class PackageInventoryTests : public testing::Test {
+ protected:
+  void SetUp() override {
+    database_ = kTestWorkingDirectory + "package-inventory-status";
+    journal_ = kTestWorkingDirectory + "package-inventory-updates";
+    fs::remove(database_);
+    fs::remove(journal_);
+    std::ofstream(database_) << "b 1\na 1\n";
+  }
+
+  void TearDown() override {
+    fs::remove(database_);
+    fs::remove(journal_);
+  }
+
+  /// Read the inventory, counting reads of the database.
+  std::shared_ptr<const std::vector<TestPackage>> get(
+      PackageInventory<TestPackage>& inventory) {
+    return inventory.get(
+        [this](const std::shared_ptr<const std::vector<TestPackage>>& previous,
+               std::vector<TestPackage>& packages) {
+          loads_++;
+          previous_ = previous;
+          std::ifstream database(database_);
+          TestPackage package;
+          while (database >> package.name >> package.version) {
+            packages.push_back(package);
+          }
+          return Status(0, "OK");
+        });
+  }
+
+ protected:
+  std::string database_;
+  std::string journal_;
+  size_t loads_{0};
+  std::shared_ptr<const std::vector<TestPackage>> previous_;
+};
+
+TEST_F(PackageInventoryTests, test_inventory_sources) {
+  auto sources = getInventorySources({database_, journal_});
+  ASSERT_EQ(sources.size(), 2U);
+  EXPECT_TRUE(sources[0].exists);
+  EXPECT_EQ(sources[0].size, 8);
+  EXPECT_FALSE(sources[1].exists);
+
+  EXPECT_TRUE(sources == getInventorySources({database_, journal_}));
+  std::ofstream(journal_) << "c 1\n";
+  EXPECT_TRUE(sources != getInventorySources({database_, journal_}));
+}
+
+TEST_F(PackageInventoryTests, test_inventory_reload) {
+  PackageInventory<TestPackage> inventory({database_, journal_});
+  auto packages = get(inventory);
+  ASSERT_NE(packages, nullptr);
+  EXPECT_EQ(loads_, 1U);
+  ASSERT_EQ(packages->size(), 2U);
+  EXPECT_EQ(packages->at(0).name, "a");
+  EXPECT_EQ(packages->at(1).name, "b");
+
+  // Unchanged files are served from memory.
+  EXPECT_EQ(get(inventory), packages);
+  EXPECT_EQ(loads_, 1U);
+
+  // A change to any file reads the database again, given the last packages.
+  std::ofstream(database_, std::ios::app) << "c 1\n";
+  auto changed = get(inventory);
+  EXPECT_EQ(loads_, 2U);
+  EXPECT_EQ(previous_, packages);
+  ASSERT_NE(changed, nullptr);
+  EXPECT_EQ(changed->size(), 3U);
+
+  std::ofstream(journal_) << "";
+  get(inventory);
+  EXPECT_EQ(loads_, 3U);
+
+  inventory.clear();
+  get(inventory);
+  EXPECT_EQ(loads_, 4U);
+  EXPECT_EQ(previous_, nullptr);
+}
+
+TEST_F(PackageInventoryTests, test_inventory_missing_sources) {
+  // Without any existing file changes cannot be seen, the database is read.
+  PackageInventory<TestPackage> inventory({journal_});
+  auto packages = get(inventory);
+  ASSERT_NE(packages, nullptr);
+  EXPECT_EQ(loads_, 1U);
+
+  EXPECT_NE(get(inventory), packages);
+  EXPECT_EQ(loads_, 2U);
+  EXPECT_EQ(previous_, packages);
+}
+
+TEST_F(PackageInventoryTests, test_inventory_failed_read) {
+  PackageInventory<TestPackage> inventory({database_});
+  auto packages = inventory.get(
+      [](const std::shared_ptr<const std::vector<TestPackage>>&,
+         std::vector<TestPackage>&) { return Status(1, "Cannot read"); });
+  EXPECT_EQ(packages, nullptr);
+  EXPECT_EQ(inventory.previous(), nullptr);
+}
+
+TEST_F(PackageInventoryTests, test_select_packages) {
+  PackageInventory<TestPackage> inventory({database_});
+  std::ofstream(database_) << "c 1\na 1\nb 1\nb 2\n";
+  auto packages = get(inventory);
+  ASSERT_NE(packages, nullptr);
+
+  std::vector<std::string> selected;
+  auto select = [&selected](const TestPackage& package) {
+    selected.push_back(package.name + package.version);
+  };
+
+  QueryContext context;
+  selectPackages(*packages, context, "name", select);
+  EXPECT_EQ(selected, std::vector<std::string>({"a1", "b1", "b2", "c1"}));
+
+  // Packages of the same name keep the order they were read in.
+  selected.clear();
+  context.constraints["name"].add(Constraint(EQUALS, "b"));
+  context.constraints["name"].add(Constraint(EQUALS, "d"));
+  selectPackages(*packages, context, "name", select);
+  EXPECT_EQ(selected, std::vector<std::string>({"b1", "b2"}));
+}
+} // namespace tables
+} // namespace osquery
@@ -31,16 +31,29 @@ const std::vector<std::string> kShellHistoryFiles = {
     ".bash_history", ".zsh_history", ".zhistory", ".history", ".sh_history",
 };
 
-void genShellHistoryForUser(const std::string& uid,
-                            const std::string& gid,
-                            const std::string& directory,
-                            QueryData& results) {
+/**
+ * @brief Read a history file as its user.
+ *
+ * Privileges are restored before the rows of the file are yielded, other
+ * tables in the query run while the generator is suspended.
+ */
+static bool readShellHistory(const std::string& uid,
+                             const std::string& gid,
+                             const boost::filesystem::path& history_file,
+                             std::string& history_content) {
   auto dropper = DropPrivileges::get();
   if (!dropper->dropTo(uid, gid)) {
     VLOG(1) << "Cannot drop privileges to UID " << uid;
-    return;
+    return false;
   }
 
+  return forensicReadFile(history_file, history_content).ok();
+}
+
+void genShellHistoryForUser(const std::string& uid,
+                            const std::string& gid,
+                            const std::string& directory,
+                            RowYield& yield) {
   auto bash_timestamp_rx = xp::sregex::compile("^#(?P<timestamp>[0-9]+)$");
   auto zsh_timestamp_rx = xp::sregex::compile(
       "^: {0,10}(?P<timestamp>[0-9]{1,11}):[0-9]+;(?P<command>.*)$");
@@ -50,7 +63,7 @@ void genShellHistoryForUser(const std::string& uid,
     history_file /= hfile;
 
     std::string history_content;
-    if (!forensicReadFile(history_file, history_content).ok()) {
+    if (!readShellHistory(uid, gid, history_file, history_content)) {
       // Cannot read a specific history file.
       continue;
     }
@@ -82,14 +95,12 @@ void genShellHistoryForUser(const std::string& uid,
 
       r["uid"] = uid;
       r["history_file"] = history_file.string();
-      results.push_back(r);
+      yield(r);
     }
   }
 }
 
-QueryData genShellHistory(QueryContext& context) {
-  QueryData results;
-
+void genShellHistory(RowYield& yield, QueryContext& context) {
   // Iterate over each user
   QueryData users = usersFromContext(context);
   for (const auto& row : users) {
@@ -97,11 +108,9 @@ QueryData genShellHistory(QueryContext& context) {
     auto gid = row.find("gid");
     auto dir = row.find("directory");
     if (uid != row.end() && gid != row.end() && dir != row.end()) {
-      genShellHistoryForUser(uid->second, gid->second, dir->second, results);
+      genShellHistoryForUser(uid->second, gid->second, dir->second, yield);
     }
   }
-
-  return results;
 }
 }
 }
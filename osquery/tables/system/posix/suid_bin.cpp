@@ -18,6 +18,8 @@
 #include <osquery/logger.h>
 #include <osquery/tables.h>
 
+#include "osquery/filesystem/traverse.h"
+
 namespace fs = boost::filesystem;
 
 namespace osquery {
@@ -28,12 +30,10 @@ std::vector<std::string> kBinarySearchPaths = {
     "/usr/local/bin", "/usr/local/sbin", "/tmp",
 };
 
-Status genBin(const fs::path& path, int perms, QueryData& results) {
-  struct stat info;
-  // store user and group
-  if (stat(path.c_str(), &info) != 0) {
-    return Status(1, "stat failed");
-  }
+Status genBin(const fs::path& path,
+              const struct stat& info,
+              QueryData& results) {
+  int perms = info.st_mode;
 
   // store path
   Row r;
@@ -72,49 +72,35 @@ Status genBin(const fs::path& path, int perms, QueryData& results) {
   return Status(0, "OK");
 }
 
-bool isSuidBin(const fs::path& path, int perms) {
-  if (!fs::is_regular_file(path)) {
+bool isSuidBin(const struct stat& info) {
+  if (!S_ISREG(info.st_mode)) {
     return false;
   }
 
-  if ((perms & 04000) == 04000 || (perms & 02000) == 02000) {
+  if ((info.st_mode & 04000) == 04000 || (info.st_mode & 02000) == 02000) {
     return true;
   }
   return false;
 }
 
 void genSuidBinsFromPath(const std::string& path, QueryData& results) {
-  if (!pathExists(path).ok()) {
-    // Creating an iterator on a missing path will except.
-    return;
+  // Walk the path with a status of each entry, without following symlinked
+  // directories. Symlinks to binaries are reported with the target's mode.
+  auto limits = getTraversalLimits();
+  limits.max_depth = 0;
+  limits.hidden = true;
+
+  std::vector<ResolvedPath> files;
+  auto status = traverseDirectories({path}, limits, files);
+  if (!status.ok()) {
+    VLOG(1) << "Cannot read all binaries from " << path << ": "
+            << status.getMessage();
   }
 
-  auto it = fs::recursive_directory_iterator(fs::path(path));
-  fs::recursive_directory_iterator end;
-  while (it != end) {
-    fs::path subpath = *it;
-    try {
-      // Do not traverse symlinked directories.
-      if (fs::is_directory(subpath) && fs::is_symlink(subpath)) {
-        it.no_push();
-      }
-
-      int perms = it.status().permissions();
-      if (isSuidBin(subpath, perms)) {
-        // Only emit suid bins.
-        genBin(subpath, perms, results);
-      }
-
-      ++it;
-    } catch (fs::filesystem_error& e) {
-      VLOG(1) << "Cannot read binary from " << subpath;
-      it.no_push();
-      // Try to recover, otherwise break.
-      try {
-        ++it;
-      } catch (fs::filesystem_error& e) {
-        break;
-      }
+  for (const auto& file : files) {
+    if (file.has_stat && isSuidBin(file.file_stat)) {
+      // Only emit suid bins.
+      genBin(file.path, file.file_stat, results);
     }
   }
 }
@@ -14,6 +14,7 @@
 #include <gflags/gflags.h>
 
 #include <osquery/core.h>
+#include <osquery/database.h>
 #include <osquery/filesystem.h>
 #include <osquery/flags.h>
 #include <osquery/logger.h>
@@ -21,11 +22,20 @@
 #include <osquery/tables.h>
 
 #include "osquery/core/conversions.h"
+#include "osquery/tables/system/hash_cache.h"
 #include "osquery/tests/test_util.h"
 
 namespace osquery {
+
+DECLARE_uint64(hash_cache_max_size);
+DECLARE_bool(disable_hash_cache);
+DECLARE_uint32(hash_workers);
+DECLARE_uint64(read_max);
+
 namespace tables {
 
+void genHash(RowYield& yield, QueryContext& context);
+
 class SystemsTablesTests : public testing::Test {};
 
 TEST_F(SystemsTablesTests, test_os_version) {
@@ -210,20 +220,25 @@ TEST_F(HashTableTest, hashes_are_correct) {
 }
 
 TEST_F(HashTableTest, test_cache_works) {
-  time_t last_mtime = 0;
-  for (int i = 0; i < 2; ++i) {
-    SetContent(i);
-    if (last_mtime == 0) {
-      last_mtime = boost::filesystem::last_write_time(tmpPath);
-    } else {
-      // make sure mtime doesn't change
-      boost::filesystem::last_write_time(tmpPath, last_mtime);
-    }
-    SQL results(qry);
-    auto rows = results.rows();
-    ASSERT_EQ(rows.size(), 1U);
-    EXPECT_EQ(rows[0].at("md5"), contentMd5);
-  }
+  SetContent(0);
+  SQL r1(qry);
+  ASSERT_EQ(r1.rows().size(), 1U);
+  auto count = FileHashCache::get().count();
+
+  // An unchanged file uses the cached hashes.
+  SQL r2(qry);
+  ASSERT_EQ(r2.rows().size(), 1U);
+  EXPECT_EQ(r2.rows()[0].at("md5"), contentMd5);
+  EXPECT_EQ(FileHashCache::get().count(), count);
+
+  // Restoring the mtime of changed content does not restore the ctime.
+  auto last_mtime = boost::filesystem::last_write_time(tmpPath);
+  SetContent(1);
+  boost::filesystem::last_write_time(tmpPath, last_mtime);
+  SQL r3(qry);
+  auto rows = r3.rows();
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(rows[0].at("md5"), badContentMd5);
 }
 
 TEST_F(HashTableTest, test_cache_updates) {
@@ -241,5 +256,170 @@ TEST_F(HashTableTest, test_cache_updates) {
   EXPECT_NE(rows[0].at("md5"), contentMd5);
   EXPECT_EQ(rows[0].at("md5"), badContentMd5);
 }
+
+TEST_F(HashTableTest, test_cache_distinct_files) {
+  auto& cache = FileHashCache::get();
+  cache.clear();
+
+  // Files with the same size and times are distinct entries.
+  boost::filesystem::create_directories(tmpPath);
+  auto first = tmpPath / "first";
+  auto second = tmpPath / "second";
+  writeTextFile(first, content[0]);
+  writeTextFile(second, content[1]);
+  ASSERT_EQ(boost::filesystem::file_size(first),
+            boost::filesystem::file_size(second));
+  auto mtime = time(nullptr) - 60 * 60;
+  boost::filesystem::last_write_time(first, mtime);
+  boost::filesystem::last_write_time(second, mtime);
+
+  MultiHashes hashes;
+  ASSERT_TRUE(cache.load(first.string(), HASH_TYPE_MD5, hashes));
+  EXPECT_EQ(hashes.md5, contentMd5);
+  ASSERT_TRUE(cache.load(second.string(), HASH_TYPE_MD5, hashes));
+  EXPECT_EQ(hashes.md5, badContentMd5);
+  EXPECT_EQ(2U, cache.count());
+}
+
+TEST_F(HashTableTest, test_cache_persists) {
+  SetContent(0);
+  auto& cache = FileHashCache::get();
+  MultiHashes hashes;
+  ASSERT_TRUE(cache.load(tmpPath.string(), HASH_TYPE_MD5, hashes));
+
+  // Replace the stored digest, the cache restores the database when emptied.
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kHashes, keys);
+  bool found = false;
+  for (const auto& key : keys) {
+    std::string value;
+    getDatabaseValue(kHashes, key, value);
+    auto pos = value.find(contentMd5);
+    if (pos != std::string::npos) {
+      value.replace(pos, contentMd5.size(), badContentMd5);
+      setDatabaseValue(kHashes, key, value);
+      found = true;
+    }
+  }
+  ASSERT_TRUE(found);
+
+  cache.clear();
+  ASSERT_TRUE(cache.load(tmpPath.string(), HASH_TYPE_MD5, hashes));
+  EXPECT_EQ(hashes.md5, badContentMd5);
+}
+
+TEST_F(HashTableTest, test_cache_size) {
+  auto max_size = FLAGS_hash_cache_max_size;
+  FLAGS_hash_cache_max_size = 16 * 1024;
+  auto& cache = FileHashCache::get();
+  cache.clear();
+
+  boost::filesystem::create_directories(tmpPath);
+  for (size_t i = 0; i < 256; i++) {
+    auto path = tmpPath / ("file" + std::to_string(i));
+    writeTextFile(path, content[i % 2]);
+    MultiHashes hashes;
+    ASSERT_TRUE(cache.load(path.string(), HASH_TYPE_SHA1, hashes));
+  }
+
+  // The least recently used entries are evicted from memory and the database.
+  EXPECT_LE(cache.size(), FLAGS_hash_cache_max_size);
+  EXPECT_LT(cache.count(), 256U);
+  std::vector<std::string> keys;
+  scanDatabaseKeys(kHashes, keys);
+  EXPECT_EQ(keys.size(), cache.count());
+  FLAGS_hash_cache_max_size = max_size;
+}
+
+TEST_F(HashTableTest, test_read_max) {
+  SetContent(0);
+  auto read_max = FLAGS_read_max;
+
+  // A file of exactly the maximum size is hashed.
+  FLAGS_read_max = content[0].size();
+  auto hashes = hashMultiFromFile(HASH_TYPE_MD5, tmpPath.string());
+  EXPECT_EQ(hashes.md5, contentMd5);
+
+  FLAGS_read_max = content[0].size() - 1;
+  hashes = hashMultiFromFile(HASH_TYPE_MD5, tmpPath.string());
+  EXPECT_TRUE(hashes.md5.empty());
+  FLAGS_read_max = read_max;
+}
+
+TEST_F(HashTableTest, test_columns_used) {
+  SetContent(0);
+  QueryContext context;
+  context.constraints["path"].add(Constraint(EQUALS, tmpPath.string()));
+  context.colsUsed = UsedColumns({"path", "sha1"});
+
+  // Only the digests used by the query are calculated.
+  auto rows = collectRows(genHash, context);
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_TRUE(rows[0].at("md5").empty());
+  EXPECT_EQ(rows[0].at("sha1"), contentSha1);
+  EXPECT_TRUE(rows[0].at("sha256").empty());
+
+  // The cached content gains the digests used by a later query.
+  context.colsUsed = UsedColumns({"path", "md5", "sha1"});
+  rows = collectRows(genHash, context);
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(rows[0].at("md5"), contentMd5);
+  EXPECT_EQ(rows[0].at("sha1"), contentSha1);
+}
+
+TEST_F(HashTableTest, test_directory) {
+  boost::filesystem::create_directories(tmpPath);
+  for (size_t i = 0; i < 16; i++) {
+    writeTextFile(tmpPath / ("file" + std::to_string(i)), content[i % 2]);
+  }
+
+  // The files of a directory are hashed concurrently.
+  SQL results("select path, md5 from hash where directory = '" +
+              tmpPath.string() + "'");
+  auto rows = results.rows();
+  ASSERT_EQ(rows.size(), 16U);
+  for (const auto& row : rows) {
+    auto index = row.at("path").substr(row.at("path").rfind("file") + 4);
+    auto expected = (std::stoul(index) % 2 == 0) ? contentMd5 : badContentMd5;
+    EXPECT_EQ(row.at("md5"), expected);
+  }
+}
+
+TEST_F(HashTableTest, test_directory_streams) {
+  boost::filesystem::create_directories(tmpPath);
+  for (size_t i = 0; i < 64; i++) {
+    writeTextFile(tmpPath / ("file" + std::to_string(i)), content[i % 2]);
+  }
+
+  auto disable_cache = FLAGS_disable_hash_cache;
+  auto workers = FLAGS_hash_workers;
+  FLAGS_disable_hash_cache = true;
+  FLAGS_hash_workers = 1;
+
+  QueryContext context;
+  context.constraints["directory"].add(Constraint(EQUALS, tmpPath.string()));
+  context.colsUsed = UsedColumns({"path", "md5"});
+  {
+    // Stop after the first row, like a query with a limit.
+    RowGenerator::pull_type rows(
+        [&context](RowYield& yield) { genHash(yield, context); });
+    ASSERT_TRUE(static_cast<bool>(rows));
+    EXPECT_FALSE(rows.get().at("md5").empty());
+  }
+
+  // Only the files of the first batch were hashed.
+  size_t hashed = 0;
+  for (size_t i = 0; i < 64; i++) {
+    auto path = tmpPath / ("file" + std::to_string(i));
+    if (context.isCached(std::to_string(HASH_TYPE_MD5) + ":" + path.string())) {
+      hashed++;
+    }
+  }
+  EXPECT_GT(hashed, 0U);
+  EXPECT_LT(hashed, 64U);
+
+  FLAGS_disable_hash_cache = disable_cache;
+  FLAGS_hash_workers = workers;
+}
 } // namespace tables
 } // namespace osquery
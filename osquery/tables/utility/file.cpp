@@ -16,11 +16,26 @@
 #include <osquery/logger.h>
 #include <osquery/tables.h>
 
+#if !defined(WIN32)
+#include "osquery/filesystem/traverse.h"
+#endif
+
 namespace fs = boost::filesystem;
 
 namespace osquery {
 namespace tables {
 
+#if !defined(WIN32)
+/// The file type column, by the format bits of a mode.
+const std::map<mode_t, std::string> kModeTypeNames{
+    {S_IFREG, "regular"},
+    {S_IFDIR, "directory"},
+    {S_IFBLK, "block"},
+    {S_IFCHR, "character"},
+    {S_IFIFO, "fifo"},
+    {S_IFSOCK, "socket"},
+};
+#else
 const std::map<fs::file_type, std::string> kTypeNames{
     {fs::regular_file, "regular"},
     {fs::directory_file, "directory"},
@@ -32,39 +47,48 @@ const std::map<fs::file_type, std::string> kTypeNames{
     {fs::type_unknown, "unknown"},
     {fs::status_error, "error"},
 };
+#endif
 
-void genFileInfo(const fs::path& path,
-                 const fs::path& parent,
-                 const std::string& pattern,
-                 QueryData& results) {
+/// Fill in the row of a file, return false if the file cannot be stat-ed.
+static bool genFileInfo(const ResolvedPath& file,
+                        const fs::path& parent,
+                        Row& r) {
   // Must provide the path, filename, directory separate from boost path->string
   // helpers to match any explicit (query-parsed) predicate constraints.
+  fs::path path = file.path;
 
-  Row r;
   r["path"] = path.string();
   r["filename"] = path.filename().string();
   r["directory"] = parent.string();
   r["symlink"] = "0";
 
+  // Paths found by walking a directory have a status, others are stat-ed.
   struct stat file_stat;
+  bool symlink = file.symlink;
+  if (file.has_stat) {
+    file_stat = file.file_stat;
+  } else {
 #if !defined(WIN32)
-  // On POSIX systems, first check the link state.
-  struct stat link_stat;
-  if (lstat(path.string().c_str(), &link_stat) < 0) {
-    // Path was not real, had too may links, or could not be accessed.
-    return;
-  }
-  if ((link_stat.st_mode & S_IFLNK) != 0) {
-    r["symlink"] = "1";
-  }
+    // On POSIX systems, first check the link state.
+    struct stat link_stat;
+    if (lstat(path.string().c_str(), &link_stat) < 0) {
+      // Path was not real, had too may links, or could not be accessed.
+      return false;
+    }
+    symlink = S_ISLNK(link_stat.st_mode);
 #endif
 
-  if (stat(path.string().c_str(), &file_stat)) {
+    if (stat(path.string().c_str(), &file_stat)) {
 #if !defined(WIN32)
-    file_stat = link_stat;
+      file_stat = link_stat;
 #else
-    return;
+      return false;
 #endif
+    }
+  }
+
+  if (symlink) {
+    r["symlink"] = "1";
   }
 
   r["inode"] = BIGINT(file_stat.st_ino);
@@ -91,6 +115,11 @@ void genFileInfo(const fs::path& path,
 #endif
 
   // Type booleans
+#if !defined(WIN32)
+  // The status follows symlinks, a broken symlink has an unknown type.
+  auto type = kModeTypeNames.find(file_stat.st_mode & S_IFMT);
+  r["type"] = (type != kModeTypeNames.end()) ? type->second : "unknown";
+#else
   boost::system::error_code ec;
   auto status = fs::status(path, ec);
   if (kTypeNames.count(status.type())) {
@@ -98,12 +127,24 @@ void genFileInfo(const fs::path& path,
   } else {
     r["type"] = "unknown";
   }
+#endif
 
-  results.push_back(r);
+  return true;
 }
 
-QueryData genFile(QueryContext& context) {
-  QueryData results;
+/// Yield the row of a file, each row is released before the next is built.
+static void yieldFileInfo(const ResolvedPath& file,
+                          const fs::path& parent,
+                          RowYield& yield) {
+  Row r;
+  if (genFileInfo(file, parent, r)) {
+    yield(r);
+  }
+}
+
+void genFile(RowYield& yield, QueryContext& context) {
+  // Resolved paths keep the status read while walking their directories.
+  std::map<std::string, ResolvedPath> resolved;
 
   // Resolve file paths for EQUALS and LIKE operations.
   auto paths = context.constraints["path"].getAll(EQUALS);
@@ -112,12 +153,13 @@ QueryData genFile(QueryContext& context) {
       LIKE,
       paths,
       ([&](const std::string& pattern, std::set<std::string>& out) {
-        std::vector<std::string> patterns;
+        std::vector<ResolvedPath> patterns;
         auto status =
             resolveFilePattern(pattern, patterns, GLOB_ALL | GLOB_NO_CANON);
         if (status.ok()) {
-          for (const auto& resolved : patterns) {
-            out.insert(resolved);
+          for (auto& file : patterns) {
+            out.insert(file.path);
+            resolved[file.path] = std::move(file);
           }
         }
         return status;
@@ -125,8 +167,16 @@ QueryData genFile(QueryContext& context) {
 
   // Iterate through each of the resolved/supplied paths.
   for (const auto& path_string : paths) {
+    if (context.expired()) {
+      return;
+    }
     fs::path path = path_string;
-    genFileInfo(path, path.parent_path(), "", results);
+    auto file = resolved.find(path_string);
+    if (file != resolved.end()) {
+      yieldFileInfo(file->second, path.parent_path(), yield);
+    } else {
+      yieldFileInfo(ResolvedPath(path_string), path.parent_path(), yield);
+    }
   }
 
   // Resolve directories for EQUALS and LIKE operations.
@@ -147,24 +197,45 @@ QueryData genFile(QueryContext& context) {
         return status;
       }));
 
+#if !defined(WIN32)
+  // Read each directory's entries with their status, including hidden files.
+  auto limits = getTraversalLimits();
+  limits.max_depth = 1;
+  limits.workers = 1;
+  limits.hidden = true;
+#endif
+
   // Now loop through constraints using the directory column constraint.
   for (const auto& directory_string : directories) {
+    if (context.expired()) {
+      return;
+    }
     if (!isReadable(directory_string) || !isDirectory(directory_string)) {
       continue;
     }
 
+#if !defined(WIN32)
+    std::vector<ResolvedPath> files;
+    traverseDirectories({directory_string}, limits, files);
+    for (auto& file : files) {
+      if (!file.path.empty() && file.path.back() == '/') {
+        file.path.pop_back();
+      }
+      yieldFileInfo(file, directory_string, yield);
+    }
+#else
     try {
       // Iterate over the directory and generate info for each regular file.
       fs::directory_iterator begin(directory_string), end;
       for (; begin != end; ++begin) {
-        genFileInfo(begin->path(), directory_string, "", results);
+        yieldFileInfo(
+            ResolvedPath(begin->path().string()), directory_string, yield);
       }
     } catch (const fs::filesystem_error& /* e */) {
       continue;
     }
+#endif
   }
-
-  return results;
 }
 }
 }
@@ -21,7 +21,11 @@
 #include <osquery/system.h>
 #include <osquery/tables.h>
 
+#include "osquery/core/metrics.h"
 #include "osquery/core/process.h"
+#include "osquery/core/startup_profile.h"
+#include "osquery/sql/query_profile.h"
+#include "osquery/sql/table_snapshot.h"
 
 namespace osquery {
 
@@ -227,6 +231,81 @@ QueryData genOsqueryInfo(QueryContext& context) {
   return results;
 }
 
+QueryData genOsqueryTableSnapshots(QueryContext& context) {
+  QueryData results;
+  for (const auto& table : TableSnapshotCache::get().stats()) {
+    Row r;
+    r["name"] = table.first;
+    r["hits"] = BIGINT(table.second.hits);
+    r["misses"] = BIGINT(table.second.misses);
+    r["evictions"] = BIGINT(table.second.evictions);
+    r["snapshots"] = INTEGER(table.second.snapshots);
+    r["size"] = BIGINT(table.second.size);
+    results.push_back(r);
+  }
+  return results;
+}
+
+QueryData genOsqueryMetrics(QueryContext& context) {
+  QueryData results;
+  for (const auto& sample : Metrics::get().samples()) {
+    Row r;
+    r["name"] = sample.name;
+    r["labels"] = sample.labels;
+    r["type"] = sample.type;
+    r["value"] = BIGINT(static_cast<long long int>(sample.value));
+    r["help"] = sample.help;
+    results.push_back(r);
+  }
+  return results;
+}
+
+QueryData genOsqueryStartup(QueryContext& context) {
+  QueryData results;
+  for (const auto& phase : StartupProfile::get().phases()) {
+    Row r;
+    r["phase"] = phase.name;
+    r["offset_us"] = BIGINT(phase.offset_us);
+    r["duration_us"] = BIGINT(phase.duration_us);
+    results.push_back(r);
+  }
+  return results;
+}
+
+QueryData genOsqueryQueryProfile(QueryContext& context) {
+  QueryData results;
+  for (const auto& profile : QueryProfiler::get().profiles()) {
+    Row r;
+    r["name"] = profile.name;
+    r["query"] = profile.query;
+    r["table_name"] = "";
+    r["time"] = BIGINT(profile.time);
+    r["wall_time_ns"] = BIGINT(profile.wall_time_ns);
+    r["query_time_ns"] = BIGINT(profile.query_time_ns);
+    r["rows"] = BIGINT(profile.rows);
+    r["diff_time_ns"] = BIGINT(profile.diff_time_ns);
+    r["serialize_time_ns"] = BIGINT(profile.serialize_time_ns);
+    r["log_time_ns"] = BIGINT(profile.log_time_ns);
+    r["database_read_bytes"] = BIGINT(profile.database_read_bytes);
+    r["database_write_bytes"] = BIGINT(profile.database_write_bytes);
+    results.push_back(r);
+
+    // Each table used by the query reports its own time and rows.
+    for (const auto& table : profile.tables) {
+      Row t;
+      t["name"] = profile.name;
+      t["query"] = profile.query;
+      t["table_name"] = table.first;
+      t["time"] = BIGINT(profile.time);
+      t["rows"] = BIGINT(table.second.rows);
+      t["scans"] = BIGINT(table.second.scans);
+      t["generate_time_ns"] = BIGINT(table.second.generate_time_ns);
+      results.push_back(t);
+    }
+  }
+  return results;
+}
+
 QueryData genOsquerySchedule(QueryContext& context) {
   QueryData results;
 
@@ -240,11 +319,19 @@ QueryData genOsquerySchedule(QueryContext& context) {
         // Set default (0) values for each query if it has not yet executed.
         r["executions"] = "0";
         r["output_size"] = "0";
+        r["output_rows"] = "0";
         r["wall_time"] = "0";
+        r["wall_time_ns"] = "0";
         r["user_time"] = "0";
         r["system_time"] = "0";
         r["average_memory"] = "0";
+        r["peak_memory"] = "0";
+        r["missed_deadlines"] = "0";
+        r["truncations"] = "0";
         r["last_executed"] = "0";
+        r["degradation"] = getQueryDegradationName(query.degradation);
+        r["degradations"] = "0";
+        r["last_degraded"] = "0";
 
         // Report optional performance information.
         Config::get().getPerformanceStats(
@@ -252,10 +339,22 @@ QueryData genOsquerySchedule(QueryContext& context) {
               r["executions"] = BIGINT(perf.executions);
               r["last_executed"] = BIGINT(perf.last_executed);
               r["output_size"] = BIGINT(perf.output_size);
+              r["output_rows"] = BIGINT(perf.output_rows);
               r["wall_time"] = BIGINT(perf.wall_time);
+              r["wall_time_ns"] = BIGINT(perf.wall_time_ns);
               r["user_time"] = BIGINT(perf.user_time);
               r["system_time"] = BIGINT(perf.system_time);
               r["average_memory"] = BIGINT(perf.average_memory);
+              r["peak_memory"] = BIGINT(perf.peak_memory);
+              r["missed_deadlines"] = BIGINT(perf.missed_deadlines);
+              r["truncations"] = BIGINT(perf.truncations);
+            });
+
+        // Report changes of the degradation level.
+        Config::get().getDegradation(
+            name, [&r](const QueryDegradationState& state) {
+              r["degradations"] = BIGINT(state.transitions);
+              r["last_degraded"] = BIGINT(state.last_transition);
             });
 
         results.push_back(r);
@@ -8,14 +8,32 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
 #include <gtest/gtest.h>
 
+#include <boost/filesystem.hpp>
+
+#include <osquery/dispatcher.h>
 #include <osquery/filesystem.h>
+#include <osquery/flags.h>
 
+#include "osquery/core/metrics.h"
+#include "osquery/tables/yara/yara_scanner.h"
 #include "osquery/tables/yara/yara_utils.h"
+#include "osquery/tests/test_util.h"
+
+namespace fs = boost::filesystem;
 
 namespace osquery {
 
+DECLARE_string(yara_cache_path);
+
 const std::string ruleFile = "/tmp/osquery-yara.sig";
 const std::string ls = "/bin/ls";
 const std::string alwaysTrue = "rule always_true { condition: true }";
@@ -28,10 +46,16 @@ class YARATest : public testing::Test {
     if (pathExists(ruleFile).ok()) {
       throw std::domain_error("Rule file exists.");
     }
+
+    cache_path_ = FLAGS_yara_cache_path;
+    FLAGS_yara_cache_path = kTestWorkingDirectory + "yara-cache";
+    fs::remove_all(FLAGS_yara_cache_path);
   }
 
   void TearDown() override {
     removePath(ruleFile);
+    fs::remove_all(FLAGS_yara_cache_path);
+    FLAGS_yara_cache_path = cache_path_;
   }
 
   Row scanFile(const std::string& ruleContent) {
@@ -56,6 +80,37 @@ class YARATest : public testing::Test {
 
     return r;
   }
+
+  YARARulesRef compileRules(const std::string& ruleContent) {
+    YR_RULES* rules = nullptr;
+    EXPECT_EQ(yr_initialize(), ERROR_SUCCESS);
+
+    removePath(ruleFile);
+    writeTextFile(ruleFile, ruleContent);
+    EXPECT_TRUE(compileSingleFile(ruleFile, &rules).ok());
+    return std::make_shared<const YARARules>(rules);
+  }
+
+  /// The compiled rules in the cache directory.
+  size_t countCachedRules() {
+    std::vector<std::string> files;
+    listFilesInDirectory(FLAGS_yara_cache_path, files);
+    return std::count_if(
+        files.begin(), files.end(), [](const std::string& file) {
+          return fs::path(file).extension() == ".yarc";
+        });
+  }
+
+  uint64_t countCache(const std::string& result) {
+    return Metrics::get()
+        .counter("osquery_yara_rules_cache_total",
+                 "Compiles of YARA rules served by the compiled rule cache",
+                 {{"result", result}})
+        .value();
+  }
+
+ private:
+  std::string cache_path_;
 };
 
 TEST_F(YARATest, test_match_true) {
@@ -69,4 +124,118 @@ TEST_F(YARATest, test_match_false) {
   // Should have 0 count
   EXPECT_TRUE(r["count"] == "0");
 }
+
+TEST_F(YARATest, test_compiled_rules_cache) {
+  auto hits = countCache("hit");
+  auto misses = countCache("miss");
+
+  Row r = scanFile(alwaysTrue);
+  EXPECT_EQ(r["count"], "1");
+  EXPECT_EQ(countCachedRules(), 1U);
+  EXPECT_EQ(countCache("miss"), misses + 1);
+
+  // Unchanged sources load the compiled rules.
+  removePath(ruleFile);
+  r = scanFile(alwaysTrue);
+  EXPECT_EQ(r["count"], "1");
+  EXPECT_EQ(countCache("hit"), hits + 1);
+
+  // Changed sources are compiled again.
+  removePath(ruleFile);
+  r = scanFile(alwaysFalse);
+  EXPECT_EQ(r["count"], "0");
+  EXPECT_EQ(countCachedRules(), 2U);
+  EXPECT_EQ(countCache("miss"), misses + 2);
+}
+
+TEST_F(YARATest, test_scanner_unchanged) {
+  YARAScanner::get().clearCache();
+
+  YARAScanRequest request;
+  request.path = ls;
+  request.rules = {{"true", compileRules(alwaysTrue)}};
+
+  std::vector<Row> rows;
+  ASSERT_TRUE(YARAScanner::get().scanFile(request, rows).ok());
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(rows[0]["count"], "1");
+  EXPECT_EQ(rows[0]["matches"], "always_true");
+
+  // The file did not change since it was scanned with these rules.
+  request.skip_unchanged = true;
+  ASSERT_TRUE(YARAScanner::get().scanFile(request, rows).ok());
+  EXPECT_TRUE(rows.empty());
+
+  // New rules, such as from a config update, scan the file again.
+  request.rules.push_back({"false", compileRules(alwaysFalse)});
+  ASSERT_TRUE(YARAScanner::get().scanFile(request, rows).ok());
+  ASSERT_EQ(rows.size(), 2U);
+  EXPECT_EQ(rows[0]["count"], "1");
+  EXPECT_EQ(rows[1]["count"], "0");
+
+  // Files that are not regular files are not scanned.
+  request.path = "/dev/null";
+  EXPECT_FALSE(YARAScanner::get().scanFile(request, rows).ok());
+  EXPECT_TRUE(rows.empty());
+}
+
+TEST_F(YARATest, test_scanner_rewrite) {
+  YARAScanner::get().clearCache();
+
+  auto path = kTestWorkingDirectory + "yara-rewrite";
+  writeTextFile(path, "aaaa");
+  struct stat file_stat;
+  ASSERT_EQ(::stat(path.c_str(), &file_stat), 0);
+
+  YARAScanRequest request;
+  request.path = path;
+  auto rules = "rule has_b { strings: $b = \"bbbb\" condition: $b }";
+  request.rules = {{"b", compileRules(rules)}};
+  request.skip_unchanged = true;
+
+  std::vector<Row> rows;
+  ASSERT_TRUE(YARAScanner::get().scanFile(request, rows).ok());
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(rows[0]["count"], "0");
+
+  // Rewrite the file with the same size, then restore its mtime.
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  writeTextFile(path, "bbbb");
+#ifdef __APPLE__
+  struct timespec times[2] = {file_stat.st_atimespec, file_stat.st_mtimespec};
+#else
+  struct timespec times[2] = {file_stat.st_atim, file_stat.st_mtim};
+#endif
+  ASSERT_EQ(::utimensat(AT_FDCWD, path.c_str(), times, 0), 0);
+
+  // The changed ctime scans the file again.
+  ASSERT_TRUE(YARAScanner::get().scanFile(request, rows).ok());
+  ASSERT_EQ(rows.size(), 1U);
+  EXPECT_EQ(rows[0]["count"], "1");
+  removePath(path);
+}
+
+TEST_F(YARATest, test_scanner_scan) {
+  auto rules = compileRules(alwaysTrue);
+
+  std::vector<YARAScanRequest> requests(8);
+  std::vector<std::vector<Row>> scanned(requests.size());
+  for (size_t i = 0; i < requests.size(); ++i) {
+    requests[i].path = ls;
+    requests[i].rules = {{"true", rules}};
+    requests[i].done = [&scanned, i](const Status& status,
+                                     std::vector<Row>& rows) {
+      scanned[i] = rows;
+    };
+  }
+
+  YARAScanner::get().scan(requests);
+  for (const auto& rows : scanned) {
+    ASSERT_EQ(rows.size(), 1U);
+    EXPECT_EQ(rows[0].at("count"), "1");
+  }
+
+  Dispatcher::stopServices();
+  Dispatcher::joinServices();
+}
 } // namespace osquery
@@ -8,6 +8,8 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#include <map>
+
 #include <boost/filesystem.hpp>
 
 #include <osquery/filesystem.h>
@@ -15,6 +17,7 @@
 #include <osquery/status.h>
 #include <osquery/tables.h>
 
+#include "osquery/tables/yara/yara_scanner.h"
 #include "osquery/tables/yara/yara_utils.h"
 
 #ifdef CONCAT
@@ -25,32 +28,6 @@
 namespace osquery {
 namespace tables {
 
-void doYARAScan(YR_RULES* rules,
-                const std::string& path,
-                QueryData& results,
-                const std::string& group,
-                const std::string& sigfile) {
-  Row r;
-
-  // These are default values, to be updated in YARACallback.
-  r["count"] = INTEGER(0);
-  r["matches"] = std::string("");
-  r["strings"] = std::string("");
-  r["tags"] = std::string("");
-
-  // This could use target_path instead to be consistent with yara_events.
-  r["path"] = path;
-  r["sig_group"] = std::string(group);
-  r["sigfile"] = std::string(sigfile);
-
-  // Perform the scan, using the static YARA subscriber callback.
-  int result = yr_rules_scan_file(
-      rules, path.c_str(), SCAN_FLAGS_FAST_MODE, YARACallback, (void*)&r, 0);
-  if (result == ERROR_SUCCESS) {
-    results.push_back(std::move(r));
-  }
-}
-
 QueryData genYara(QueryContext& context) {
   QueryData results;
 
@@ -61,25 +38,14 @@ QueryData genYara(QueryContext& context) {
     return results;
   }
 
-  // This could be abstracted into a common "get rules for group" function.
-  auto parser = Config::getParser("yara");
-  if (parser == nullptr || parser.get() == nullptr) {
+  auto yaraParser = getYARAParser();
+  if (yaraParser == nullptr) {
     LOG(ERROR) << "YARA config parser plugin has no pointer";
     return results;
   }
 
-  std::shared_ptr<YARAConfigParserPlugin> yaraParser = nullptr;
-  try {
-    yaraParser = std::dynamic_pointer_cast<YARAConfigParserPlugin>(parser);
-  } catch (const std::bad_cast& e) {
-    LOG(ERROR) << "Error casting yara config parser plugin";
-    return results;
-  }
-  if (yaraParser == nullptr || yaraParser.get() == nullptr) {
-    LOG(ERROR) << "YARA config parser plugin has no pointer";
-    return results;
-  }
-  auto& rules = yaraParser->rules();
+  // Scans use the rules of the config when the query started.
+  auto snapshot = yaraParser->snapshot();
 
   // Collect all paths specified too.
   auto paths = context.constraints["path"].getAll(EQUALS);
@@ -88,50 +54,93 @@ QueryData genYara(QueryContext& context) {
       LIKE,
       paths,
       ([&](const std::string& pattern, std::set<std::string>& out) {
-        std::vector<std::string> patterns;
+        std::vector<ResolvedPath> patterns;
         auto status =
             resolveFilePattern(pattern, patterns, GLOB_FILES | GLOB_NO_CANON);
         if (status.ok()) {
           for (const auto& resolved : patterns) {
+            // Skip devices and pipes found while walking directories.
+            if (resolved.has_stat && !S_ISREG(resolved.file_stat.st_mode)) {
+              continue;
+            }
+
             // Check that each resolved path is readable.
-            if (isReadable(resolved)) {
-              paths.insert(resolved);
+            if (isReadable(resolved.path)) {
+              paths.insert(resolved.path);
             }
           }
         }
         return status;
       }));
 
-  // Compile all sigfiles into a map.
-  for (const auto& file : sigfiles) {
-    // Check if this "ad-hoc" signature file has not been used/compiled.
-    if (rules.count(file) == 0) {
-      // If this is a relative path append the default yara search path.
-      auto path = (file[0] != '/') ? kYARAHome : "";
-      path += file;
-
-      YR_RULES* tmp_rules = nullptr;
-      auto status = compileSingleFile(path, &tmp_rules);
-      if (!status.ok()) {
-        VLOG(1) << "YARA compile error: " << status.toString();
-        continue;
+  // Collect the rules of each signature group and ad-hoc signature file.
+  std::map<std::string, YARARulesRef> named_rules;
+  if (snapshot != nullptr) {
+    for (const auto& group : groups) {
+      auto rules = snapshot->groups.find(group);
+      if (rules != snapshot->groups.end()) {
+        named_rules[group] = rules->second;
       }
-      // Cache the compiled rules by setting the unique signature file path
-      // as the lookup name. Additional signature file uses will skip the
-      // compile step and be added as rule groups.
-      rules[file] = tmp_rules;
+    }
+  }
+
+  for (const auto& file : sigfiles) {
+    if (named_rules.count(file) > 0) {
+      continue;
+    }
+
+    YARARulesRef rules;
+    auto status = yaraParser->sigfileRules(file, rules);
+    if (!status.ok()) {
+      VLOG(1) << "YARA compile error: " << status.toString();
+      continue;
     }
     // Assemble an "ad-hoc" group using the signature file path as the name.
-    groups.insert(file);
+    named_rules[file] = rules;
+  }
+
+  std::vector<YARAScanRules> scan_rules;
+  for (const auto& rules : named_rules) {
+    scan_rules.push_back({rules.first, rules.second});
+  }
+
+  if (scan_rules.empty()) {
+    return results;
   }
 
-  // Scan every path pair.
+  // Scan every path with every group, on the YARA scan workers.
+  std::vector<YARAScanRequest> requests;
   for (const auto& path : paths) {
-    // Scan using the signature groups.
-    for (const auto& group : groups) {
-      if (rules.count(group) > 0) {
-        doYARAScan(rules[group], path.c_str(), results, group, group);
+    YARAScanRequest request;
+    request.path = path;
+    request.rules = scan_rules;
+    request.deadline = context.deadline();
+    requests.push_back(std::move(request));
+  }
+
+  std::vector<std::vector<Row>> scanned(requests.size());
+  for (size_t i = 0; i < requests.size(); ++i) {
+    requests[i].done = [&scanned, i](const Status& status,
+                                     std::vector<Row>& rows) {
+      scanned[i] = std::move(rows);
+    };
+  }
+  YARAScanner::get().scan(requests);
+
+  size_t i = 0;
+  for (const auto& path : paths) {
+    auto& rows = scanned[i++];
+    for (size_t j = 0; j < rows.size(); ++j) {
+      // A group that failed to scan the file has an empty row.
+      if (rows[j].empty()) {
+        continue;
       }
+
+      // This could use target_path instead to be consistent with yara_events.
+      rows[j]["path"] = path;
+      rows[j]["sig_group"] = scan_rules[j].name;
+      rows[j]["sigfile"] = scan_rules[j].name;
+      results.push_back(std::move(rows[j]));
     }
   }
 
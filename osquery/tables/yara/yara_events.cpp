@@ -21,6 +21,7 @@
 #include "osquery/events/linux/inotify.h"
 #endif
 
+#include "osquery/tables/yara/yara_scanner.h"
 #include "osquery/tables/yara/yara_utils.h"
 
 #ifdef CONCAT
@@ -57,6 +58,11 @@ class YARAEventSubscriber : public FileEventSubscriber {
 
   void configure() override;
 
+  /// Drop queued scans, and wait for scans adding events, before removal.
+  void tearDown() override {
+    YARAScanner::get().cancel(this);
+  }
+
  private:
   /**
    * @brief This exports a single Callback for FSEventsEventPublisher events.
@@ -126,6 +132,16 @@ void YARAEventSubscriber::configure() {
   }
 }
 
+/// Append the comma-separated values of a column of scan results.
+static void appendMatches(const std::string& value, std::string& matches) {
+  if (value.empty()) {
+    return;
+  } else if (!matches.empty()) {
+    matches += ",";
+  }
+  matches += value;
+}
+
 Status YARAEventSubscriber::Callback(const FileEventContextRef& ec,
                                      const FileSubscriptionContextRef& sc) {
   if (ec->action != "UPDATED" && ec->action != "CREATED") {
@@ -140,55 +156,66 @@ Status YARAEventSubscriber::Callback(const FileEventContextRef& ec,
   // Only FSEvents transactions updates (inotify is a no-op).
   r["transaction_id"] = INTEGER(ec->transaction_id);
 
-  // These are default values, to be updated in YARACallback.
-  r["count"] = INTEGER(0);
-  r["matches"] = std::string("");
-  r["strings"] = std::string("");
-  r["tags"] = std::string("");
-
-  auto parser = Config::getParser("yara");
-  if (parser == nullptr || parser.get() == nullptr) {
-    return Status(1, "ConfigParser unknown.");
-  }
-
-  std::shared_ptr<YARAConfigParserPlugin> yaraParser;
-  try {
-    yaraParser = std::dynamic_pointer_cast<YARAConfigParserPlugin>(parser);
-  } catch (const std::bad_cast& e) {
-    return Status(1, "Error casting yara config parser plugin");
-  }
-  if (yaraParser == nullptr || yaraParser.get() == nullptr) {
+  auto yaraParser = getYARAParser();
+  if (yaraParser == nullptr) {
     return Status(1, "Yara parser unknown.");
   }
 
-  auto rules = yaraParser->rules();
+  auto snapshot = yaraParser->snapshot();
+  if (snapshot == nullptr) {
+    return Status(0, "OK");
+  }
 
   // Use the category as a lookup into the yara file_paths. The value will be
   // a list of signature groups to scan with.
-  auto category = r.at("category");
-  const auto& yara_config = parser->getData().doc();
-  const auto& yara_paths = yara_config["file_paths"];
-  const auto group_iter = yara_paths.FindMember(category);
-  if (group_iter != yara_paths.MemberEnd()) {
-    for (const auto& rule : group_iter->value.GetArray()) {
-      std::string group = rule.GetString();
-      int result = yr_rules_scan_file(rules[group],
-                                      ec->path.c_str(),
-                                      SCAN_FLAGS_FAST_MODE,
-                                      YARACallback,
-                                      (void*)&r,
-                                      0);
-
-      if (result != ERROR_SUCCESS) {
-        return Status(1, "YARA error: " + std::to_string(result));
-      }
+  const auto groups = snapshot->file_paths.find(sc->category);
+  if (groups == snapshot->file_paths.end()) {
+    return Status(0, "OK");
+  }
+
+  YARAScanRequest request;
+  request.path = ec->path;
+  for (const auto& group : groups->second) {
+    auto rules = snapshot->groups.find(group);
+    if (rules != snapshot->groups.end()) {
+      request.rules.push_back({group, rules->second});
     }
   }
 
-  if (ec->action != "" && !r.at("matches").empty()) {
-    add(r);
+  if (request.rules.empty()) {
+    return Status(0, "OK");
   }
 
-  return Status(0, "OK");
+  // The scan completes on a YARA scan worker, so the publisher may continue.
+  // Repeated events for a file that did not change since its last scan, such
+  // as a modify followed by a close, do not add an event.
+  request.skip_unchanged = true;
+  request.owner = this;
+  request.done = [this, r](const Status& status,
+                           std::vector<Row>& rows) mutable {
+    if (!status.ok()) {
+      VLOG(1) << "YARA scan of " << r.at("target_path")
+              << " failed: " << status.getMessage();
+      return;
+    }
+
+    size_t count = 0;
+    for (const auto& scanned : rows) {
+      if (scanned.empty()) {
+        continue;
+      }
+      count += std::stoul(scanned.at("count"));
+      appendMatches(scanned.at("matches"), r["matches"]);
+      appendMatches(scanned.at("strings"), r["strings"]);
+      appendMatches(scanned.at("tags"), r["tags"]);
+    }
+
+    if (!r["matches"].empty()) {
+      r["count"] = INTEGER(count);
+      add(r);
+    }
+  };
+
+  return YARAScanner::get().submit(std::move(request));
 }
 }
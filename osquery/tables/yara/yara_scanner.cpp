@@ -0,0 +1,399 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <tuple>
+
+#include <osquery/flags.h>
+#include <osquery/logger.h>
+
+#include "osquery/core/metrics.h"
+#include "osquery/tables/yara/yara_scanner.h"
+
+namespace osquery {
+
+FLAG(uint64, yara_scan_workers, 2, "Threads scanning files with YARA rules");
+
+FLAG(uint64,
+     yara_scan_queue_size,
+     1024,
+     "Maximum files waiting for a YARA scan, events beyond are dropped");
+
+FLAG(uint64,
+     yara_scan_max_size,
+     0,
+     "Maximum bytes of a file scanned with YARA rules, 0 is unlimited");
+
+FLAG(uint64,
+     yara_scan_timeout,
+     60,
+     "Seconds a YARA scan of a file may take, 0 is unlimited");
+
+/// Files and rules with matches kept by the scanner.
+const size_t kYARAScanCacheSize{8192};
+
+/// Concurrent scans with the same rules are limited by YARA, keep a margin
+/// for scans on query threads.
+const size_t kYARAMaxScanWorkers{16};
+
+/// Count a file scanned, skipped, or dropped by the scanner.
+static void countScan(const std::string& result) {
+  static MetricCounterFamily counters("osquery_yara_scans_total",
+                                      "Files handled by the YARA scanner",
+                                      "result",
+                                      {"scanned",
+                                       "cached",
+                                       "skipped",
+                                       "failed",
+                                       "timeout",
+                                       "dropped",
+                                       "deduplicated"});
+  counters.get(result).increment();
+}
+
+bool YARAScanner::CacheKey::operator<(const CacheKey& other) const {
+  return std::tie(device, inode, mtime, ctime, size, rules) <
+         std::tie(other.device,
+                  other.inode,
+                  other.mtime,
+                  other.ctime,
+                  other.size,
+                  other.rules);
+}
+
+YARAScanner& YARAScanner::get() {
+  static YARAScanner scanner;
+  return scanner;
+}
+
+void YARAScanner::start() {
+  // The Dispatcher locks its services while stopping a worker, which locks
+  // the queue, so workers are added without the queue locked.
+  std::call_once(started_, []() {
+    auto workers = std::min<size_t>(
+        std::max<size_t>(FLAGS_yara_scan_workers, 1), kYARAMaxScanWorkers);
+    for (size_t i = 0; i < workers; ++i) {
+      Dispatcher::addService(std::make_shared<YARAScanRunner>());
+    }
+  });
+}
+
+Status YARAScanner::submit(YARAScanRequest request) {
+  auto key = std::make_pair(request.owner, request.path);
+
+  start();
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (stopped_) {
+    countScan("dropped");
+    return Status(1, "YARA scan workers are stopped");
+  }
+
+  if (request.owner != nullptr && queued_paths_.count(key) > 0) {
+    countScan("deduplicated");
+    return Status(0, "Already queued");
+  }
+
+  if (queued_ >= FLAGS_yara_scan_queue_size) {
+    countScan("dropped");
+    return Status(1, "YARA scan queue is full");
+  }
+
+  auto job = std::make_shared<Job>();
+  job->request = std::move(request);
+  job->queued = true;
+  if (job->request.owner != nullptr) {
+    queued_paths_.insert(std::move(key));
+  }
+  queue_.push_back(std::move(job));
+  queued_++;
+  lock.unlock();
+
+  cv_.notify_all();
+  return Status(0, "OK");
+}
+
+void YARAScanner::scan(std::vector<YARAScanRequest>& requests) {
+  std::vector<JobRef> jobs;
+  jobs.reserve(requests.size());
+  auto charge = getThreadResourceCharge();
+  for (auto& request : requests) {
+    auto job = std::make_shared<Job>();
+    job->request = std::move(request);
+    job->charge = charge;
+    jobs.push_back(std::move(job));
+  }
+
+  // Queue the scans the queue has room for, this thread scans the others.
+  start();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& job : jobs) {
+      if (stopped_ || queued_ >= FLAGS_yara_scan_queue_size) {
+        break;
+      }
+      job->queued = true;
+      queue_.push_back(job);
+      queued_++;
+    }
+  }
+  cv_.notify_all();
+
+  // Scan the files no worker has taken, from the last queued.
+  for (auto it = jobs.rbegin(); it != jobs.rend(); ++it) {
+    run(*it);
+  }
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  cv_.wait(lock, [&jobs]() {
+    return std::all_of(jobs.begin(), jobs.end(), [](const JobRef& job) {
+      return job->done;
+    });
+  });
+}
+
+void YARAScanner::cancel(const void* owner) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (auto& job : queue_) {
+    if (!job->taken && job->request.owner == owner) {
+      job->taken = true;
+      job->done = true;
+      queued_--;
+    }
+  }
+
+  auto it = queued_paths_.lower_bound(std::make_pair(owner, std::string()));
+  while (it != queued_paths_.end() && it->first == owner) {
+    it = queued_paths_.erase(it);
+  }
+
+  cv_.wait(lock, [this, owner]() { return running_.count(owner) == 0; });
+}
+
+void YARAScanner::run(const JobRef& job) {
+  const auto& request = job->request;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (job->taken) {
+      return;
+    }
+    job->taken = true;
+    if (job->queued) {
+      queued_--;
+    }
+    running_[request.owner]++;
+    if (request.owner != nullptr) {
+      queued_paths_.erase(std::make_pair(request.owner, request.path));
+    }
+  }
+
+  {
+    ScopedResourceCharge scope(job->charge);
+    job->status = scanFile(request, job->rows);
+  }
+  if (request.done != nullptr) {
+    request.done(job->status, job->rows);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    job->done = true;
+    if (--running_[request.owner] == 0) {
+      running_.erase(request.owner);
+    }
+  }
+  cv_.notify_all();
+}
+
+Status YARAScanner::scanFile(const YARAScanRequest& request,
+                             std::vector<Row>& rows) {
+  rows.clear();
+  struct stat file_stat;
+  if (::stat(request.path.c_str(), &file_stat) != 0) {
+    countScan("failed");
+    return Status(1, "Cannot stat file: " + request.path);
+  }
+
+  if (!S_ISREG(file_stat.st_mode)) {
+    countScan("skipped");
+    return Status(1, "Not a regular file: " + request.path);
+  }
+
+  if (FLAGS_yara_scan_max_size > 0 &&
+      static_cast<size_t>(file_stat.st_size) > FLAGS_yara_scan_max_size) {
+    countScan("skipped");
+    return Status(1, "File exceeds yara_scan_max_size: " + request.path);
+  }
+
+  // A rewrite of the same size may restore the mtime, the ctime still changes.
+#ifdef __APPLE__
+  const auto& mtime = file_stat.st_mtimespec;
+  const auto& ctime = file_stat.st_ctimespec;
+#else
+  const auto& mtime = file_stat.st_mtim;
+  const auto& ctime = file_stat.st_ctim;
+#endif
+
+  CacheKey key;
+  key.device = file_stat.st_dev;
+  key.inode = file_stat.st_ino;
+  key.mtime = static_cast<long long>(mtime.tv_sec) * 1000000000LL +
+              mtime.tv_nsec;
+  key.ctime = static_cast<long long>(ctime.tv_sec) * 1000000000LL +
+              ctime.tv_nsec;
+  key.size = file_stat.st_size;
+
+  Status status;
+  bool unchanged = true;
+  rows.resize(request.rules.size());
+  for (size_t i = 0; i < request.rules.size(); ++i) {
+    const auto& rules = request.rules[i].rules;
+    if (rules == nullptr) {
+      continue;
+    }
+
+    key.rules = rules->id();
+    if (findCached(key, rows[i])) {
+      countScan("cached");
+      continue;
+    }
+    unchanged = false;
+
+    // A scan for a query ends by the query's deadline, YARA counts seconds.
+    auto timeout = static_cast<int>(FLAGS_yara_scan_timeout);
+    if (request.deadline != std::chrono::steady_clock::time_point::max()) {
+      auto remaining = request.deadline - std::chrono::steady_clock::now();
+      if (remaining <= std::chrono::steady_clock::duration::zero()) {
+        countScan("timeout");
+        status = Status(1, "Query deadline exceeded: " + request.path);
+        break;
+      }
+
+      auto milliseconds =
+          std::chrono::duration_cast<std::chrono::milliseconds>(remaining);
+      auto seconds = static_cast<int>((milliseconds.count() + 999) / 1000);
+      timeout = (timeout == 0) ? seconds : std::min(timeout, seconds);
+    }
+
+    // These are default values, to be updated in YARACallback.
+    Row r;
+    r["count"] = INTEGER(0);
+    r["matches"] = std::string("");
+    r["strings"] = std::string("");
+    r["tags"] = std::string("");
+
+    int result = yr_rules_scan_file(rules->get(),
+                                    request.path.c_str(),
+                                    SCAN_FLAGS_FAST_MODE,
+                                    YARACallback,
+                                    (void*)&r,
+                                    timeout);
+    if (result != ERROR_SUCCESS) {
+      countScan((result == ERROR_SCAN_TIMEOUT) ? "timeout" : "failed");
+      if (status.ok()) {
+        status = Status(1, "YARA error: " + std::to_string(result));
+      }
+      continue;
+    }
+
+    countScan("scanned");
+    storeCached(key, r);
+    rows[i] = std::move(r);
+  }
+
+  if (request.skip_unchanged && unchanged) {
+    rows.clear();
+  }
+  return status;
+}
+
+bool YARAScanner::findCached(const CacheKey& key, Row& row) {
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  auto it = cache_index_.find(key);
+  if (it == cache_index_.end()) {
+    return false;
+  }
+
+  cache_.splice(cache_.begin(), cache_, it->second);
+  row = it->second->second;
+  return true;
+}
+
+void YARAScanner::storeCached(const CacheKey& key, const Row& row) {
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  auto it = cache_index_.find(key);
+  if (it != cache_index_.end()) {
+    it->second->second = row;
+    cache_.splice(cache_.begin(), cache_, it->second);
+    return;
+  }
+
+  cache_.emplace_front(key, row);
+  cache_index_[key] = cache_.begin();
+  if (cache_.size() > kYARAScanCacheSize) {
+    cache_index_.erase(cache_.back().first);
+    cache_.pop_back();
+  }
+}
+
+void YARAScanner::clearCache() {
+  std::lock_guard<std::mutex> lock(cache_mutex_);
+  cache_index_.clear();
+  cache_.clear();
+}
+
+void YARAScanner::work(const std::function<bool()>& interrupted) {
+  while (true) {
+    JobRef job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this, &interrupted]() {
+        return !queue_.empty() || interrupted();
+      });
+
+      if (interrupted()) {
+        // Queued file events are dropped, queries scan their own files.
+        stopped_ = true;
+        for (auto& queued : queue_) {
+          if (!queued->taken && queued->request.owner != nullptr) {
+            queued->taken = true;
+            queued->done = true;
+            queued_--;
+          }
+        }
+        queued_paths_.clear();
+        break;
+      }
+
+      job = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    run(job);
+  }
+  cv_.notify_all();
+}
+
+void YARAScanner::wake() {
+  // Lock the queue so a worker checking its predicate sees the interrupt.
+  std::lock_guard<std::mutex> lock(mutex_);
+  cv_.notify_all();
+}
+
+void YARAScanRunner::start() {
+  YARAScanner::get().work([this]() { return interrupted(); });
+
+  // Release the YARA state of this thread.
+  yr_finalize_thread();
+}
+
+void YARAScanRunner::stop() {
+  YARAScanner::get().wake();
+}
+} // namespace osquery
@@ -0,0 +1,211 @@
+/**
+ *  Copyright (c) 2014-present, Facebook, Inc.
+ *  All rights reserved.
+ *
+ *  This source code is licensed under both the Apache 2.0 license (found in the
+ *  LICENSE file in the root directory of this source tree) and the GPLv2 (found
+ *  in the COPYING file in the root directory of this source tree).
+ *  You may select, at your option, one of the above-listed licenses.
+ */
+
+#pragma once
+
+#include <sys/stat.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <osquery/dispatcher.h>
+#include <osquery/tables.h>
+
+#include "osquery/core/process.h"
+#include "osquery/tables/yara/yara_utils.h"
+
+namespace osquery {
+
+/// Compiled rules a file is scanned with, named by signature group or file.
+struct YARAScanRules {
+  std::string name;
+  YARARulesRef rules;
+};
+
+/**
+ * @brief A file to scan with one or more sets of rules.
+ *
+ * The result of each set of rules is a row with the count, matches, strings,
+ * and tags columns of the yara tables. A set of rules that failed to scan the
+ * file has an empty row.
+ */
+struct YARAScanRequest {
+  std::string path;
+
+  std::vector<YARAScanRules> rules;
+
+  /// Return no rows if every set of rules scanned the file since it changed.
+  bool skip_unchanged{false};
+
+  /// The queued scans of an owner may be cancelled.
+  const void* owner{nullptr};
+
+  /// A scan is not started after, nor continues past, a query's deadline.
+  std::chrono::steady_clock::time_point deadline{
+      std::chrono::steady_clock::time_point::max()};
+
+  /// Called with the result of the scan, and a row for each set of rules.
+  std::function<void(const Status& status, std::vector<Row>& rows)> done;
+};
+
+/**
+ * @brief A pool of threads scanning files with YARA rules.
+ *
+ * Scans of file events are queued and the event publisher continues, the
+ * scan completes on a worker. The queue is bounded, and a file waiting to be
+ * scanned for an owner is queued once. Files larger than yara_scan_max_size
+ * are not scanned and each scan is limited to yara_scan_timeout seconds.
+ *
+ * The matches of a file are kept by device, inode, modification and status
+ * change time, and size for each set of rules, a file that did not change is
+ * not scanned again. Rules are immutable and reference counted, a config update does not
+ * affect scans in progress.
+ *
+ * Workers are Dispatcher services, started by the first scan.
+ */
+class YARAScanner : private boost::noncopyable {
+ public:
+  static YARAScanner& get();
+
+  /**
+   * @brief Queue a scan and return, the request's done is called by a worker.
+   *
+   * @return failure if the queue is full or the file is already queued for
+   * the owner, the scan is dropped.
+   */
+  Status submit(YARAScanRequest request);
+
+  /**
+   * @brief Scan files and wait for every scan to complete.
+   *
+   * Files are scanned by the workers and the calling thread. When the queue
+   * is full, or the workers stopped, the calling thread scans every file.
+   */
+  void scan(std::vector<YARAScanRequest>& requests);
+
+  /// Drop the queued scans of an owner and wait for its scans in progress.
+  void cancel(const void* owner);
+
+  /// Scan a file on the calling thread.
+  Status scanFile(const YARAScanRequest& request, std::vector<Row>& rows);
+
+  /// Forget the matches of every file.
+  void clearCache();
+
+ public:
+  /// The loop of a worker, until it is interrupted.
+  void work(const std::function<bool()>& interrupted);
+
+  /// Wake every worker to check if it was interrupted.
+  void wake();
+
+ private:
+  YARAScanner() = default;
+
+  struct Job {
+    YARAScanRequest request;
+    std::vector<Row> rows;
+    Status status;
+
+    /// Set when the job is added to the queue.
+    bool queued{false};
+
+    /// Set when a thread starts the scan, guarded by the scanner's mutex.
+    bool taken{false};
+
+    /// Set when the scan completed, guarded by the scanner's mutex.
+    bool done{false};
+
+    /// The query thread charged for a worker's scan, null for submitted scans.
+    ResourceChargeRef charge;
+  };
+
+  using JobRef = std::shared_ptr<Job>;
+
+  /// Identity of a file and the rules it was scanned with.
+  struct CacheKey {
+    dev_t device;
+    ino_t inode;
+    long long mtime;
+    long long ctime;
+    off_t size;
+    size_t rules;
+
+    bool operator<(const CacheKey& other) const;
+  };
+
+  /// Start the workers if they have not been started.
+  void start();
+
+  /// Take and scan a job, unless another thread has taken it.
+  void run(const JobRef& job);
+
+  /// Find the matches of a file, moving it to the front of the cache.
+  bool findCached(const CacheKey& key, Row& row);
+
+  /// Keep the matches of a file, evicting the least recently used.
+  void storeCached(const CacheKey& key, const Row& row);
+
+ private:
+  /// Scans not yet taken by a thread, may contain taken jobs.
+  std::deque<JobRef> queue_;
+
+  /// Number of jobs in the queue that are not taken.
+  size_t queued_{0};
+
+  /// Owner and path of each queued scan with an owner.
+  std::set<std::pair<const void*, std::string>> queued_paths_;
+
+  /// Number of scans in progress for each owner.
+  std::map<const void*, size_t> running_;
+
+  /// Workers are started by the first scan.
+  std::once_flag started_;
+
+  /// Set when a worker stops, the Dispatcher is stopping.
+  bool stopped_{false};
+
+  /// Protects the queue and job states.
+  std::mutex mutex_;
+
+  /// Signaled when a scan is queued or completes.
+  std::condition_variable cv_;
+
+  /// Matches of the most recently scanned files, by identity and rules.
+  std::list<std::pair<CacheKey, Row>> cache_;
+  std::map<CacheKey, std::list<std::pair<CacheKey, Row>>::iterator>
+      cache_index_;
+  std::mutex cache_mutex_;
+};
+
+/// A worker of the YARA scanner.
+class YARAScanRunner : public InternalRunnable {
+ public:
+  YARAScanRunner() : InternalRunnable("YARAScanRunner") {}
+
+  /// The Dispatcher thread entry point.
+  void start() override;
+
+  /// The Dispatcher interrupt point.
+  void stop() override;
+};
+} // namespace osquery
@@ -9,15 +9,25 @@
  */
 
 #include <map>
+#include <set>
+#include <sstream>
 #include <string>
 
+#include <boost/filesystem.hpp>
+
 #include <osquery/config.h>
+#include <osquery/filesystem.h>
 #include <osquery/logger.h>
 
+#include "osquery/core/conversions.h"
+#include "osquery/core/metrics.h"
+#include "osquery/core/process.h"
 #include "osquery/tables/yara/yara_utils.h"
 #include "osquery/remote/serializers/json.h"
 #include "osquery/remote/utility.h"
 
+namespace fs = boost::filesystem;
+
 namespace osquery {
 
 FLAG(string,
@@ -31,6 +41,18 @@ FLAG(uint64,
      3,
      "Number of times to attempt a request")
 
+FLAG(bool,
+     yara_tls_conditional,
+     true,
+     "Skip downloading an unchanged YARA rule if the server sends an ETag");
+
+FLAG(string,
+     yara_cache_path,
+     OSQUERY_DB_HOME "/yara",
+     "Directory of compiled YARA rules, empty to compile on each update");
+
+std::atomic<size_t> YARARules::next_id_{0};
+
 /**
  * The callback used when there are compilation problems in the rules.
  */
@@ -47,10 +69,43 @@ void YARACompilerCallback(int error_level,
 }
 
 
+/// The last source of a rule downloaded from the TLS endpoint.
+struct DownloadedRule {
+  std::string etag;
+  std::string source;
+};
+
+/// Downloaded rules by path, for conditional requests.
+static std::map<std::string, DownloadedRule> kDownloadedRules;
+static Mutex kDownloadedRulesMutex;
+
+/// Count a download of YARA rules from the TLS endpoint.
+static void countDownload(const std::string& result) {
+  static MetricCounterFamily counters(
+      "osquery_yara_rule_downloads_total",
+      "YARA rules requested from the TLS endpoint",
+      "result",
+      {"downloaded", "not_modified"});
+  counters.get(result).increment();
+}
+
+/// Count a lookup of compiled YARA rules in the cache.
+static void countCache(const std::string& result) {
+  static MetricCounterFamily counters(
+      "osquery_yara_rules_cache_total",
+      "Compiles of YARA rules served by the compiled rule cache",
+      "result",
+      {"hit", "miss", "uncacheable"});
+  counters.get(result).increment();
+}
+
 /**
  * Download yara rule from endpoint
+ *
+ * A rule downloaded before is requested with its entity tag, the source is
+ * not sent again if it did not change.
  */
-Status downloadYaraRule(const std::string rule, YR_COMPILER* compiler) {
+Status downloadYaraRule(const std::string& rule, std::string& source) {
   std::string yara_uri = TLSRequestHelper::makeURI(FLAGS_yara_tls_endpoint);
   VLOG(1) << "YARA RULE FILE: file=" << rule  << "endpoint=" << FLAGS_yara_tls_endpoint << "url=" << yara_uri;
 
@@ -59,13 +114,30 @@ Status downloadYaraRule(const std::string rule, YR_COMPILER* compiler) {
   params.add("_verb", "POST");
   params.add("node_key", getNodeKey("tls"));
   params.add("path", rule);
+  if (FLAGS_yara_tls_conditional) {
+    ReadLock lock(kDownloadedRulesMutex);
+    auto it = kDownloadedRules.find(rule);
+    if (it != kDownloadedRules.end() && !it->second.etag.empty()) {
+      params.add("_etag", it->second.etag);
+    }
+  }
+
   auto tls_result = TLSRequestHelper::go<JSONSerializer>(
     yara_uri, params, response, FLAGS_yara_tls_max_attempts
   );
+
+  if (tls_result.ok() && params.doc().HasMember("_not_modified")) {
+    ReadLock lock(kDownloadedRulesMutex);
+    auto it = kDownloadedRules.find(rule);
+    if (it != kDownloadedRules.end()) {
+      countDownload("not_modified");
+      source = it->second.source;
+      return Status(0, "OK");
+    }
+  }
   VLOG(1) << "YARA response=" << response;
 
   if (!tls_result.ok() || !response.length()) {
-    yr_compiler_destroy(compiler);
     LOG(ERROR) << "TLS yara API did not return data";
     return Status(1, "Endpoint did not return rule text: " + rule);
   }
@@ -76,198 +148,325 @@ Status downloadYaraRule(const std::string rule, YR_COMPILER* compiler) {
       LOG(ERROR) << "Could not parse JSON from TLS yara API";
       return Status(1, "Could not parse JSON from TLS yara API: " + rule);
   }
-  if (!tree.doc().HasMember("yara")) {
+  if (!tree.doc().HasMember("yara") || !tree.doc()["yara"].IsString()) {
     LOG(ERROR) << "TLS yara api returned blank yara rule";
     return Status(1, "TLS yara api returned blank yara rule: " + rule);
   }
 
-  int errors = yr_compiler_add_string(compiler, tree.doc()["yara"].GetString(), nullptr);
-  if (errors > 0) {
-    yr_compiler_destroy(compiler);
-    // Errors printed via callback.
-    return Status(1, "Compilation errors");
+  countDownload("downloaded");
+  source = tree.doc()["yara"].GetString();
+
+  auto etag = params.doc().FindMember("_etag");
+  if (FLAGS_yara_tls_conditional && etag != params.doc().MemberEnd() &&
+      etag->value.IsString()) {
+    WriteLock lock(kDownloadedRulesMutex);
+    kDownloadedRules[rule] = {etag->value.GetString(), source};
   }
+  return Status(0, "OK");
+}
 
+/// The path of compiled rules in the cache.
+static std::string getYARACachePath(const std::string& key) {
+  return (fs::path(FLAGS_yara_cache_path) / (key + ".yarc")).string();
+}
+
+/**
+ * The cache key of rules compiled from a list of files.
+ *
+ * The key covers the YARA version, the order and path of the files, and their
+ * content. Rules are compiled again if any of them change.
+ */
+static std::string getYARACacheKey(const std::vector<std::string>& files,
+                                   const std::vector<std::string>& sources) {
+  std::string content = std::to_string(YR_MAJOR_VERSION) + "." +
+                        std::to_string(YR_MINOR_VERSION) + "." +
+                        std::to_string(YR_MICRO_VERSION) + '\n';
+  for (size_t i = 0; i < files.size(); ++i) {
+    content += files[i] + '\n' + std::to_string(sources[i].size()) + '\n';
+    content += sources[i];
+  }
+  return getBufferSHA1(content.data(), content.size());
+}
+
+/// Load compiled rules from the cache, an unreadable entry is removed.
+static Status loadCachedRules(const std::string& key, YR_RULES** rules) {
+  auto path = getYARACachePath(key);
+  if (!pathExists(path).ok()) {
+    return Status(1, "Not cached");
+  }
+
+  // Compiled rules are trusted as much as rule sources, the cache must only
+  // be writable by the owner of osquery.
+  if (!safePermissions(FLAGS_yara_cache_path, path, false)) {
+    LOG(WARNING) << "Ignoring compiled YARA rules with unsafe permissions: "
+                 << path;
+    return Status(1, "Unsafe permissions");
+  }
+
+  int result = yr_rules_load(path.c_str(), rules);
+  if (result != ERROR_SUCCESS) {
+    VLOG(1) << "Cannot load compiled YARA rules " << path << ": " << result;
+    removePath(path);
+    return Status(1, "YARA load error " + std::to_string(result));
+  }
   return Status(0, "OK");
 }
 
+/// Save compiled rules to the cache, replacing the entry atomically.
+static void saveCachedRules(const std::string& key, YR_RULES* rules) {
+  static std::atomic<size_t> saves{0};
+
+  boost::system::error_code ec;
+  fs::create_directories(FLAGS_yara_cache_path, ec);
+  fs::permissions(FLAGS_yara_cache_path, fs::owner_all, ec);
+
+  auto path = getYARACachePath(key);
+  auto temp = path + "." + std::to_string(platformGetPid()) + "." +
+              std::to_string(++saves) + ".tmp";
+  int result = yr_rules_save(rules, temp.c_str());
+  if (result != ERROR_SUCCESS) {
+    VLOG(1) << "Cannot save compiled YARA rules " << path << ": " << result;
+    removePath(temp);
+    return;
+  }
+
+  fs::rename(temp, path, ec);
+  if (ec) {
+    VLOG(1) << "Cannot save compiled YARA rules " << path << ": "
+            << ec.message();
+    removePath(temp);
+  }
+}
+
+/// Remove compiled rules from the cache that are not in use.
+static void pruneYARACache(const std::set<std::string>& keys) {
+  if (FLAGS_yara_cache_path.empty()) {
+    return;
+  }
+
+  std::vector<std::string> files;
+  if (!listFilesInDirectory(FLAGS_yara_cache_path, files).ok()) {
+    return;
+  }
+
+  for (const auto& file : files) {
+    fs::path path(file);
+    if (path.extension() != ".yarc" || keys.count(path.stem().string()) > 0) {
+      continue;
+    }
+    removePath(path);
+  }
+}
+
+/// Check if rule source has an include directive, at the start of a line.
+static bool hasIncludes(const std::string& source) {
+  std::istringstream stream(source);
+  std::string word;
+  std::string line;
+  while (std::getline(stream, line)) {
+    std::istringstream words(line);
+    if (words >> word && (word == "include" || word.find("include\"") == 0)) {
+      return true;
+    }
+  }
+  return false;
+}
 
 /**
- * Compile a single rule file and load it into rule pointer.
+ * Compile a list of rule files, from the TLS endpoint if configured.
+ *
+ * Rules compiled from sources are saved to the cache, keyed by the sources,
+ * and loaded from the cache while the sources do not change. The key is empty
+ * if the rules are not in the cache.
  */
-Status compileSingleFile(const std::string& file, YR_RULES** rules) {
+static Status compileRuleFiles(const std::vector<std::string>& files,
+                               YR_RULES** rules,
+                               std::string& cache_key) {
+  cache_key.clear();
+
+  bool tls = !FLAGS_yara_tls_endpoint.empty();
+  bool cacheable = !FLAGS_yara_cache_path.empty();
+  std::vector<std::string> sources(files.size());
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (tls) {
+      auto status = downloadYaraRule(files[i], sources[i]);
+      if (!status.ok()) {
+        LOG(ERROR) << "Failed to load rule from yara tls endpoint: "
+                   << files[i];
+        return status;
+      }
+    } else if (!readFile(files[i], sources[i]).ok()) {
+      // The compile reports the missing file.
+      cacheable = false;
+    }
+
+    // Files included by a rule are not part of the key.
+    if (hasIncludes(sources[i])) {
+      cacheable = false;
+    }
+  }
+
+  if (cacheable) {
+    cache_key = getYARACacheKey(files, sources);
+    if (loadCachedRules(cache_key, rules).ok()) {
+      countCache("hit");
+      VLOG(1) << "Loaded compiled YARA rules from the cache: " << cache_key;
+      return Status(0, "OK");
+    }
+  }
+  countCache((cacheable) ? "miss" : "uncacheable");
+
   YR_COMPILER* compiler = nullptr;
   int result = yr_compiler_create(&compiler);
   if (result != ERROR_SUCCESS) {
-    VLOG(1) << "Could not create compiler: " + std::to_string(result);
-    return Status(1, "Could not create compiler: " + std::to_string(result));
+    VLOG(1) << "Could not create compiler: error " + std::to_string(result);
+    return Status(1, "YARA compile error " + std::to_string(result));
   }
 
   yr_compiler_set_callback(compiler, YARACompilerCallback, nullptr);
 
   bool compiled = false;
+  YR_RULES* loaded_rules = nullptr;
+  auto fail = [&compiler, &loaded_rules](const Status& status) {
+    yr_compiler_destroy(compiler);
+    if (loaded_rules != nullptr) {
+      yr_rules_destroy(loaded_rules);
+    }
+    return status;
+  };
 
-  YR_RULES* tmp_rules;
-  VLOG(1) << "Loading YARA signature file: " << file;
-
-  if (FLAGS_yara_tls_endpoint.length()) {
-    Status tmpstatus = downloadYaraRule(file, compiler);
-    if (!tmpstatus.ok()) {
-        LOG(ERROR) << "Failed to load rule from yara tls endpoint: " << file;
-        return tmpstatus;
+  for (size_t i = 0; i < files.size(); ++i) {
+    const auto& rule = files[i];
+    if (tls) {
+      int errors =
+          yr_compiler_add_string(compiler, sources[i].c_str(), nullptr);
+      if (errors > 0) {
+        // Errors printed via callback.
+        return fail(Status(1, "Compilation errors"));
+      }
+      compiled = true;
+      continue;
     }
-    compiled = true;
-  } else {
+
     // First attempt to load the file, in case it is saved (pre-compiled)
-    // rules.
+    // rules. Sadly there is no way to load multiple compiled rules in
+    // succession. This means that:
+    //
+    // saved1, saved2
+    // results in saved2 being the only file used.
+    //
+    // Also, mixing source and saved rules results in the saved rules being
+    // overridden by the combination of the source rules once compiled, e.g.:
+    //
+    // file1, saved1
+    // result in file1 being the only file used.
     //
     // If you want to use saved rule files you must have them all in a single
     // file. This is easy to accomplish with yarac(1).
-    result = yr_rules_load(file.c_str(), &tmp_rules);
+    YR_RULES* tmp_rules = nullptr;
+    result = yr_rules_load(rule.c_str(), &tmp_rules);
     if (result != ERROR_SUCCESS && result != ERROR_INVALID_FILE) {
-      yr_compiler_destroy(compiler);
-      return Status(1, "Error loading YARA rules: " + std::to_string(result));
+      return fail(Status(1, "YARA load error " + std::to_string(result)));
     } else if (result == ERROR_SUCCESS) {
-      *rules = tmp_rules;
+      // If saved rules were loaded before, destroy them and use these.
+      if (loaded_rules != nullptr) {
+        yr_rules_destroy(loaded_rules);
+      }
+      loaded_rules = tmp_rules;
     } else {
       compiled = true;
-      // Try to compile the rules.
-      FILE* rule_file = fopen(file.c_str(), "r");
+      if (cacheable) {
+        // Compile the source the cache key was computed from, the file may
+        // have changed since it was read.
+        int errors =
+            yr_compiler_add_string(compiler, sources[i].c_str(), nullptr);
+        if (errors > 0) {
+          // Errors printed via callback.
+          return fail(Status(1, "Compilation errors"));
+        }
+        continue;
+      }
 
+      // Try to compile the rules.
+      FILE* rule_file = fopen(rule.c_str(), "r");
       if (rule_file == nullptr) {
-        yr_compiler_destroy(compiler);
-        return Status(1, "Could not open file: " + file);
+        return fail(Status(1, "Could not open file: " + rule));
       }
 
       int errors =
-          yr_compiler_add_file(compiler, rule_file, nullptr, file.c_str());
-
+          yr_compiler_add_file(compiler, rule_file, nullptr, rule.c_str());
+      fclose(rule_file);
       if (errors > 0) {
-        yr_compiler_destroy(compiler);
         // Errors printed via callback.
-        return Status(1, "Compilation errors");
+        return fail(Status(1, "Compilation errors"));
       }
-      fclose(rule_file);
-      rule_file = nullptr;
     }
   }
 
   if (compiled) {
-    // All the rules for this category have been compiled, save them in the map.
-    result = yr_compiler_get_rules(compiler, *(&rules));
-
+    // All the rules have been compiled, they override the saved rules.
+    YR_RULES* compiled_rules = nullptr;
+    result = yr_compiler_get_rules(compiler, &compiled_rules);
     if (result != ERROR_SUCCESS) {
-      yr_compiler_destroy(compiler);
-      return Status(1, "Insufficient memory to get YARA rules");
+      return fail(Status(1, "Insufficient memory to get YARA rules"));
+    }
+
+    if (loaded_rules != nullptr) {
+      yr_rules_destroy(loaded_rules);
     }
+    loaded_rules = compiled_rules;
   }
+  yr_compiler_destroy(compiler);
 
-  if (compiler != nullptr) {
-    yr_compiler_destroy(compiler);
-    compiler = nullptr;
+  if (loaded_rules == nullptr) {
+    return Status(1, "No YARA rules");
+  }
+
+  // Saved rules are already compiled, only compiled sources are cached.
+  if (compiled && cacheable) {
+    saveCachedRules(cache_key, loaded_rules);
+  } else {
+    cache_key.clear();
   }
 
+  *rules = loaded_rules;
   return Status(0, "OK");
 }
 
+/**
+ * Compile a single rule file and load it into rule pointer.
+ */
+Status compileSingleFile(const std::string& file, YR_RULES** rules) {
+  VLOG(1) << "Loading YARA signature file: " << file;
+
+  std::string cache_key;
+  return compileRuleFiles({file}, rules, cache_key);
+}
+
 /**
  * Given a vector of strings, attempt to compile them and store the result
  * in the map under the given category.
  */
 Status handleRuleFiles(const std::string& category,
                        const rapidjson::Value& rule_files,
-                       std::map<std::string, YR_RULES*>& rules) {
-  YR_COMPILER* compiler = nullptr;
-  int result = yr_compiler_create(&compiler);
-  if (result != ERROR_SUCCESS) {
-    VLOG(1) << "Could not create compiler: error " + std::to_string(result);
-    return Status(1, "YARA compile error " + std::to_string(result));
-  }
-
-  yr_compiler_set_callback(compiler, YARACompilerCallback, nullptr);
-
-  bool compiled = false;
+                       std::map<std::string, YARARulesRef>& rules) {
+  std::vector<std::string> files;
   for (const auto& item : rule_files.GetArray()) {
-    YR_RULES* tmp_rules = nullptr;
     std::string rule = item.GetString();
-
-    if (FLAGS_yara_tls_endpoint.length()) {
-        Status tmpstatus = downloadYaraRule(rule, compiler);
-      if (!tmpstatus.ok()) {
-        LOG(ERROR) << "Failed to load rule from yara tls endpoint: " << rule;
-        return tmpstatus;
-      }
-      compiled = true;
-    } else {
-      if (rule[0] != '/') {
-        rule = kYARAHome + rule;
-      }
-
-      // First attempt to load the file, in case it is saved (pre-compiled)
-      // rules. Sadly there is no way to load multiple compiled rules in
-      // succession. This means that:
-      //
-      // saved1, saved2
-      // results in saved2 being the only file used.
-      //
-      // Also, mixing source and saved rules results in the saved rules being
-      // overridden by the combination of the source rules once compiled, e.g.:
-      //
-      // file1, saved1
-      // result in file1 being the only file used.
-      //
-      // If you want to use saved rule files you must have them all in a single
-      // file. This is easy to accomplish with yarac(1).
-      result = yr_rules_load(rule.c_str(), &tmp_rules);
-      if (result != ERROR_SUCCESS && result != ERROR_INVALID_FILE) {
-        yr_compiler_destroy(compiler);
-        return Status(1, "YARA load error " + std::to_string(result));
-      } else if (result == ERROR_SUCCESS) {
-        // If there are already rules there, destroy them and put new ones in.
-        if (rules.count(category) > 0) {
-          yr_rules_destroy(rules[category]);
-        }
-
-        rules[category] = tmp_rules;
-      } else {
-        compiled = true;
-        // Try to compile the rules.
-        FILE* rule_file = fopen(rule.c_str(), "r");
-
-        if (rule_file == nullptr) {
-          yr_compiler_destroy(compiler);
-          return Status(1, "Could not open file: " + rule);
-        }
-
-        int errors = yr_compiler_add_file(compiler, rule_file, nullptr, rule.c_str());
-        if (errors > 0) {
-          yr_compiler_destroy(compiler);
-          // Errors printed via callback.
-          return Status(1, "Compilation errors");
-        }
-
-        fclose(rule_file);
-        rule_file = nullptr;
-
-      }
+    if (FLAGS_yara_tls_endpoint.empty() && rule[0] != '/') {
+      rule = kYARAHome + rule;
     }
+    files.push_back(std::move(rule));
   }
 
-  if (compiled) {
-    // All the rules for this category have been compiled, save them in the map.
-    result = yr_compiler_get_rules(compiler, &rules[category]);
-
-    if (result != ERROR_SUCCESS) {
-      yr_compiler_destroy(compiler);
-      return Status(1, "Insufficient memory to get YARA rules");
-    }
-  }
-
-  if (compiler != nullptr) {
-    yr_compiler_destroy(compiler);
-    compiler = nullptr;
+  YR_RULES* tmp_rules = nullptr;
+  std::string cache_key;
+  auto status = compileRuleFiles(files, &tmp_rules, cache_key);
+  if (!status.ok()) {
+    return status;
   }
 
+  rules[category] = std::make_shared<const YARARules>(tmp_rules, cache_key);
   return Status(0, "OK");
 }
 
@@ -327,11 +526,48 @@ Status YARAConfigParserPlugin::setUp() {
   return Status();
 }
 
+YARARulesSnapshotRef YARAConfigParserPlugin::snapshot() const {
+  ReadLock lock(snapshot_mutex_);
+  return snapshot_;
+}
+
+Status YARAConfigParserPlugin::sigfileRules(const std::string& file,
+                                            YARARulesRef& rules) {
+  WriteLock lock(sigfiles_mutex_);
+  auto it = sigfiles_.find(file);
+  if (it != sigfiles_.end()) {
+    rules = it->second;
+    return Status(0, "OK");
+  }
+
+  // If this is a relative path append the default yara search path.
+  auto path = (file[0] != '/') ? kYARAHome : "";
+  path += file;
+
+  YR_RULES* tmp_rules = nullptr;
+  std::string cache_key;
+  auto status = compileRuleFiles({path}, &tmp_rules, cache_key);
+  if (!status.ok()) {
+    return status;
+  }
+
+  // Cache the compiled rules by the signature file path, additional uses
+  // skip the compile step.
+  rules = std::make_shared<const YARARules>(tmp_rules, cache_key);
+  sigfiles_[file] = rules;
+  return Status(0, "OK");
+}
+
 Status YARAConfigParserPlugin::update(const std::string& source,
                                       const ParserConfig& config) {
   // The YARA config parser requested the "yara" top-level key in the config.
   const auto& yara_config = config.at("yara").doc();
 
+  // Build the next snapshot, scans in progress keep using the current one.
+  auto previous = snapshot();
+  auto next = std::make_shared<YARARulesSnapshot>();
+  Status status;
+
   // Look for a "signatures" key with the group/file content.
   if (yara_config.HasMember("signatures")) {
     auto& signatures = yara_config["signatures"];
@@ -343,10 +579,17 @@ Status YARAConfigParserPlugin::update(const std::string& source,
       for (const auto& element : data_.doc()["signatures"].GetObject()) {
         std::string category = element.name.GetString();
         VLOG(1) << "Compiling YARA signature group: " << category;
-        auto status = handleRuleFiles(category, element.value, rules_);
-        if (!status.ok()) {
-          VLOG(1) << "YARA rule compile error: " << status.getMessage();
-          return status;
+        auto group_status =
+            handleRuleFiles(category, element.value, next->groups);
+        if (!group_status.ok()) {
+          VLOG(1) << "YARA rule compile error: " << group_status.getMessage();
+          // Keep scanning with the last rules that compiled for this group.
+          if (previous != nullptr && previous->groups.count(category) > 0) {
+            next->groups[category] = previous->groups.at(category);
+          }
+          if (status.ok()) {
+            status = group_status;
+          }
         }
       }
     }
@@ -360,9 +603,46 @@ Status YARAConfigParserPlugin::update(const std::string& source,
       auto obj = data_.getObject();
       data_.copyFrom(file_paths, obj);
       data_.add("file_paths", obj);
+
+      for (const auto& element : file_paths.GetObject()) {
+        if (!element.value.IsArray()) {
+          continue;
+        }
+
+        auto& groups = next->file_paths[element.name.GetString()];
+        for (const auto& group : element.value.GetArray()) {
+          if (group.IsString()) {
+            groups.push_back(group.GetString());
+          }
+        }
+      }
     }
   }
-  return Status();
+
+  // Remove compiled rules of groups and signature files no longer used.
+  std::set<std::string> keys;
+  for (const auto& group : next->groups) {
+    keys.insert(group.second->cacheKey());
+  }
+  {
+    WriteLock lock(sigfiles_mutex_);
+    for (const auto& sigfile : sigfiles_) {
+      keys.insert(sigfile.second->cacheKey());
+    }
+  }
+  pruneYARACache(keys);
+
+  WriteLock lock(snapshot_mutex_);
+  snapshot_ = std::move(next);
+  return status;
+}
+
+std::shared_ptr<YARAConfigParserPlugin> getYARAParser() {
+  auto parser = Config::getParser("yara");
+  if (parser == nullptr || parser.get() == nullptr) {
+    return nullptr;
+  }
+  return std::dynamic_pointer_cast<YARAConfigParserPlugin>(parser);
 }
 
 /// Call the simple YARA ConfigParserPlugin "yara".
@@ -8,6 +8,16 @@
  *  You may select, at your option, one of the above-listed licenses.
  */
 
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
 #include <osquery/config.h>
 #include <osquery/tables.h>
 
@@ -16,12 +26,67 @@
 #endif
 #include <yara.h>
 
-namespace pt = boost::property_tree;
-
 namespace osquery {
 
 const std::string kYARAHome{OSQUERY_HOME "/yara/"};
 
+/**
+ * @brief Compiled rules, destroyed when the last scan using them ends.
+ *
+ * Each set of compiled rules has a unique id, results of a scan are only
+ * reused for the same rules. Rules compiled from sources are saved in the
+ * yara_cache_path directory under their cache key.
+ */
+class YARARules : private boost::noncopyable {
+ public:
+  explicit YARARules(YR_RULES* rules, std::string cache_key = "")
+      : rules_(rules), id_(++next_id_), cache_key_(std::move(cache_key)) {}
+
+  ~YARARules() {
+    if (rules_ != nullptr) {
+      yr_rules_destroy(rules_);
+    }
+  }
+
+  YR_RULES* get() const {
+    return rules_;
+  }
+
+  size_t id() const {
+    return id_;
+  }
+
+  /// The key of the rules in the compiled rule cache, or empty.
+  const std::string& cacheKey() const {
+    return cache_key_;
+  }
+
+ private:
+  YR_RULES* rules_{nullptr};
+  size_t id_{0};
+  std::string cache_key_;
+
+  static std::atomic<size_t> next_id_;
+};
+
+using YARARulesRef = std::shared_ptr<const YARARules>;
+
+/**
+ * @brief The rules of every signature group as of a config update.
+ *
+ * A snapshot is never changed. A config update compiles a new snapshot and
+ * replaces the current one, scans keep the snapshot they started with.
+ */
+struct YARARulesSnapshot {
+  /// Compiled rules of each signature group.
+  std::map<std::string, YARARulesRef> groups;
+
+  /// The signature groups scanning each category of file_paths.
+  std::map<std::string, std::vector<std::string>> file_paths;
+};
+
+using YARARulesSnapshotRef = std::shared_ptr<const YARARulesSnapshot>;
+
 void YARACompilerCallback(int error_level,
                           const char* file_name,
                           int line_number,
@@ -31,8 +96,8 @@ void YARACompilerCallback(int error_level,
 Status compileSingleFile(const std::string& file, YR_RULES** rule);
 
 Status handleRuleFiles(const std::string& category,
-                       const pt::ptree& rule_files,
-                       std::map<std::string, YR_RULES*>& rules);
+                       const rapidjson::Value& rule_files,
+                       std::map<std::string, YARARulesRef>& rules);
 
 int YARACallback(int message, void* message_data, void* user_data);
 
@@ -53,18 +118,31 @@ class YARAConfigParserPlugin : public ConfigParserPlugin {
     return {"yara"};
   }
 
-  // Retrieve compiled rules.
-  std::map<std::string, YR_RULES*>& rules() {
-    return rules_;
-  }
+  /// The rules of the last config update.
+  YARARulesSnapshotRef snapshot() const;
+
+  /// Compile an ad-hoc signature file once, kept across config updates.
+  Status sigfileRules(const std::string& file, YARARulesRef& rules);
 
   Status setUp() override;
 
  private:
-  // Store compiled rules in a map (group => rules).
-  std::map<std::string, YR_RULES*> rules_;
+  /// Compiled rules and file_paths, replaced by each config update.
+  YARARulesSnapshotRef snapshot_;
+
+  /// Compiled ad-hoc signature files, by their path.
+  std::map<std::string, YARARulesRef> sigfiles_;
+
+  /// Protects the snapshot.
+  mutable Mutex snapshot_mutex_;
+
+  /// Serializes compiles of ad-hoc signature files.
+  Mutex sigfiles_mutex_;
 
   /// Store the signatures and file_paths and compile the rules.
   Status update(const std::string& source, const ParserConfig& config) override;
 };
+
+/// The YARA config parser, or nullptr if it is not registered.
+std::shared_ptr<YARAConfigParserPlugin> getYARAParser();
 }
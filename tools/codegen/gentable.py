@@ -399,6 +399,12 @@ def implementation(impl_string, generator=False):
       # the path is "osquery/table/implementations/foo.cpp"
       # the function is "QueryData genFoo();"
       implementation("foo@genFoo")
+
+    A generator implementation yields each row instead, and a platform check
+    selects the platforms where the implementation is a generator:
+
+      # the function is "void genFoo(RowYield& yield, QueryContext& context);"
+      implementation("foo@genFoo", generator=LINUX)
     """
     logging.debug("- implementation")
     filename, function = impl_string.split("@")
@@ -412,7 +418,7 @@ def implementation(impl_string, generator=False):
     table.impl = impl
     table.function = function
     table.class_name = class_name
-    table.generator = generator
+    table.generator = generator() if callable(generator) else generator
 
     '''Check if the table has a subscriber attribute, if so, enforce time.'''
     if "event_subscriber" in table.attributes:
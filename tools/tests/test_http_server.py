@@ -15,6 +15,7 @@ from __future__ import unicode_literals
 
 import argparse
 import base64
+import hashlib
 import json
 import os
 import random
@@ -134,6 +135,10 @@ class RealSimpleHandler(BaseHTTPRequestHandler):
 
     def do_POST(self):
         debug("RealSimpleHandler::post %s" % self.path)
+        if self.path == '/config_etag':
+            self.config_etag()
+            return
+
         self._set_headers()
         content_len = int(self.headers.getheader('content-length', 0))
 
@@ -211,6 +216,28 @@ class RealSimpleHandler(BaseHTTPRequestHandler):
             return
         self._reply(EXAMPLE_CONFIG)
 
+    def config_etag(self):
+        '''A config endpoint supporting conditional requests'''
+
+        # The response includes an ETag header. A request with a matching
+        # If-None-Match header receives a 304 without the config content.
+        content_len = int(self.headers.getheader('content-length', 0))
+        self._push_request('config', json.loads(self.rfile.read(content_len)))
+
+        config = json.dumps(EXAMPLE_CONFIG, sort_keys=True)
+        etag = '"%s"' % hashlib.sha1(config).hexdigest()
+        if self.headers.getheader('if-none-match') == etag:
+            self.send_response(304)
+            self.send_header('ETag', etag)
+            self.end_headers()
+            return
+
+        self.send_response(200)
+        self.send_header('Content-type', 'application/json')
+        self.send_header('ETag', etag)
+        self.end_headers()
+        self._reply(EXAMPLE_CONFIG)
+
     def distributed_read(self, request):
         '''A basic distributed read endpoint'''
         if "node_key" not in request or request["node_key"] not in NODE_KEYS: